@@ -17,10 +17,14 @@
  */
 
 
+#include <math.h>
 #include "base_blitter.h"
 
 #include "../common/phys_mem_meta.h"
+#include "../common/dmabuf.h"
 #include "../common/phys_mem_buffer_pool.h"
+#include "../common/phys_mem_pool_registry.h"
+#include "../common/phys_mem_caps.h"
 
 
 
@@ -31,6 +35,61 @@ GST_DEBUG_CATEGORY_STATIC(imx_base_blitter_debug);
 G_DEFINE_ABSTRACT_TYPE(GstImxBaseBlitter, gst_imx_base_blitter, GST_TYPE_OBJECT)
 
 
+/* Number of input pixels around each tile which are blitted along with the tile,
+ * to give scaling filters the same neighbourhood they would see without tiling */
+#define GST_IMX_BASE_BLITTER_TILE_BORDER 8
+/* Tile edges are aligned to this value, to keep chroma subsampled
+ * formats from shifting chroma samples between tiles */
+#define GST_IMX_BASE_BLITTER_TILE_ALIGNMENT 2
+
+/* Buffer pools created by gst_imx_base_blitter_create_bufferpool() are elastic:
+ * pools without a maximum number of buffers grow up to this cap, and buffers
+ * which were not needed for this long are returned to the allocator */
+#define GST_IMX_BASE_BLITTER_POOL_MAX_BUFFERS 32
+#define GST_IMX_BASE_BLITTER_POOL_IDLE_TIMEOUT (2 * GST_SECOND)
+
+
+struct _GstImxBaseBlitterFence
+{
+	/* The input frame used by the blit operation; ref'd, since the
+	 * engine might still be reading from it until the fence is waited for */
+	GstBuffer *input_frame;
+	/* Handle returned by @submit_blit ; NULL if the blit was performed
+	 * synchronously or was not necessary */
+	gpointer handle;
+};
+
+
+/* Tile span along one axis */
+typedef struct
+{
+	/* Inner part of the span in the output frame; inner parts of
+	 * adjacent spans touch, but do not overlap */
+	gint out1, out2;
+	/* Input pixels for this span, including the border */
+	gint in1, in2;
+	/* Size of the scaled span (including border) in the scratch frame,
+	 * and offset of the inner part within it */
+	gint scratch_size, scratch_offset;
+}
+GstImxBaseBlitterTileSpan;
+
+
+typedef struct
+{
+	/* Region of the input frame to blit into the scratch frame */
+	GstImxBaseBlitterRegion input_region;
+	/* Region of the scratch frame the input region is blitted into */
+	GstImxBaseBlitterRegion scratch_region;
+	/* Inner part of the tile in the scratch frame and in the output frame */
+	GstImxBaseBlitterRegion scratch_inner_region, output_region;
+
+	GstBuffer *scratch_frame;
+	gpointer handle;
+}
+GstImxBaseBlitterTile;
+
+
 static void gst_imx_base_blitter_finalize(GObject *object);
 
 static gboolean gst_imx_base_blitter_do_regions_intersect(GstImxBaseBlitterRegion const *first_region, GstImxBaseBlitterRegion const *second_region);
@@ -38,6 +97,14 @@ static void gst_imx_base_blitter_calc_region_intersection(GstImxBaseBlitterRegio
 static gboolean gst_imx_base_blitter_is_region_contained(GstImxBaseBlitterRegion const *outer_region, GstImxBaseBlitterRegion const *inner_region);
 static void gst_imx_base_blitter_computer_visible_input_region(GstImxBaseBlitter *base_blitter);
 static GstImxBaseBlitterRegion const * gst_imx_base_blitter_calc_region_visibility(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *region, GstImxBaseBlitterVisibilityType *visibility_type, GstImxBaseBlitterRegion *sub_out_region);
+static GstImxBaseBlitterRegion const * gst_imx_base_blitter_get_input_region(GstImxBaseBlitter *base_blitter);
+static gboolean gst_imx_base_blitter_needs_tiling(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *input_region);
+static GArray* gst_imx_base_blitter_plan_tile_spans(gint in1, gint in2, gint out1, gint out2, gint max_size);
+static gboolean gst_imx_base_blitter_blit_tiled(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *input_region);
+static gboolean gst_imx_base_blitter_copy_to_dma_frame(GstImxBaseBlitter *base_blitter, GstBuffer *input_buffer, GstBuffer **dma_frame);
+static gboolean gst_imx_base_blitter_clip_batch_entry(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterBatchEntry *entry);
+static gboolean gst_imx_base_blitter_blit_batch_native(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterBatchEntry const *entries, guint num_entries);
+static gboolean gst_imx_base_blitter_blit_batch_sequential(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterBatchEntry const *entries, guint num_entries);
 
 
 
@@ -57,6 +124,15 @@ void gst_imx_base_blitter_class_init(GstImxBaseBlitterClass *klass)
 	klass->get_phys_mem_allocator = NULL;
 	klass->blit_frame             = NULL;
 	klass->flush                  = NULL;
+	klass->submit_blit            = NULL;
+	klass->wait_blit              = NULL;
+	klass->set_input_alpha        = NULL;
+	klass->fill_region            = NULL;
+	klass->blit_batch             = NULL;
+
+	klass->accepts_system_memory = FALSE;
+	klass->horiz_alignment = GST_IMX_PHYS_MEM_BUFFER_POOL_DEFAULT_HORIZ_ALIGNMENT;
+	klass->vert_alignment = GST_IMX_PHYS_MEM_BUFFER_POOL_DEFAULT_VERT_ALIGNMENT;
 
 	GST_DEBUG_CATEGORY_INIT(imx_base_blitter_debug, "imxbaseblitter", 0, "Freescale i.MX base blitter class");
 }
@@ -66,8 +142,11 @@ void gst_imx_base_blitter_init(GstImxBaseBlitter *base_blitter)
 {
 	GST_TRACE_OBJECT(base_blitter, "initializing base blitter");
 
+	base_blitter->pool_registry = NULL;
 	base_blitter->internal_bufferpool = NULL;
 	base_blitter->internal_input_frame = NULL;
+	base_blitter->num_input_frame_copies = 0;
+	base_blitter->current_input_frame = NULL;
 	base_blitter->visible_input_region_uptodate = FALSE;
 
 	base_blitter->video_visibility_type = GST_IMX_BASE_BLITTER_VISIBILITY_FULL;
@@ -76,6 +155,15 @@ void gst_imx_base_blitter_init(GstImxBaseBlitter *base_blitter)
 	gst_video_info_init(&(base_blitter->input_video_info));
 
 	base_blitter->apply_crop_metadata = GST_IMX_BASE_BLITTER_CROP_DEFAULT;
+
+	base_blitter->output_regions_set = FALSE;
+	base_blitter->current_output_frame = NULL;
+
+	base_blitter->max_blit_width = 0;
+	base_blitter->max_blit_height = 0;
+	base_blitter->tile_bufferpool = NULL;
+	gst_video_info_init(&(base_blitter->tile_video_info));
+	base_blitter->num_tiled_blits = 0;
 }
 
 
@@ -89,10 +177,22 @@ static void gst_imx_base_blitter_finalize(GObject *object)
 
 	GST_TRACE_OBJECT(base_blitter, "finalizing base blitter");
 
+	if (base_blitter->num_input_frame_copies > 0)
+		GST_DEBUG_OBJECT(base_blitter, "%" G_GUINT64_FORMAT " input frame(s) were copied because they were not physically contiguous", base_blitter->num_input_frame_copies);
+
 	if (base_blitter->internal_input_frame != NULL)
 		gst_buffer_unref(base_blitter->internal_input_frame);
 	if (base_blitter->internal_bufferpool != NULL)
-		gst_object_unref(base_blitter->internal_bufferpool);
+		gst_imx_base_blitter_release_bufferpool(base_blitter, base_blitter->internal_bufferpool);
+
+	if (base_blitter->num_tiled_blits > 0)
+		GST_DEBUG_OBJECT(base_blitter, "%" G_GUINT64_FORMAT " blit(s) were split into tiles because they exceeded the maximum blit size", base_blitter->num_tiled_blits);
+
+	if (base_blitter->tile_bufferpool != NULL)
+		gst_imx_base_blitter_release_bufferpool(base_blitter, base_blitter->tile_bufferpool);
+
+	if (base_blitter->pool_registry != NULL)
+		gst_object_unref(GST_OBJECT(base_blitter->pool_registry));
 
 	G_OBJECT_CLASS(gst_imx_base_blitter_parent_class)->finalize(object);
 }
@@ -120,6 +220,7 @@ gboolean gst_imx_base_blitter_set_input_buffer(GstImxBaseBlitter *base_blitter,
 		gst_buffer_unref(base_blitter->internal_input_frame);
 		base_blitter->internal_input_frame = NULL;
 	}
+	base_blitter->current_input_frame = NULL;
 
 	video_meta = gst_buffer_get_video_meta(input_buffer);
 	phys_mem_meta = GST_IMX_PHYS_MEM_META_GET(input_buffer);
@@ -145,87 +246,44 @@ gboolean gst_imx_base_blitter_set_input_buffer(GstImxBaseBlitter *base_blitter,
 		}
 	}
 
+	/* Buffers with DMA-BUF memory from other elements can be used directly
+	 * if their physical address can be resolved */
+	if ((phys_mem_meta == NULL) && !(klass->accepts_system_memory) && ((base_blitter->internal_input_frame = gst_imx_dmabuf_import_buffer(input_buffer)) != NULL))
+	{
+		GST_TRACE_OBJECT(base_blitter, "imported DMA-BUF input buffer");
+		input_buffer = base_blitter->internal_input_frame;
+		phys_mem_meta = GST_IMX_PHYS_MEM_META_GET(input_buffer);
+	}
+
 	/* Test if the input buffer uses DMA memory */
 	if ((phys_mem_meta != NULL) && (phys_mem_meta->phys_addr != 0))
 	{
 		/* DMA memory present - the input buffer can be used as an actual input buffer */
+		gst_imx_phys_mem_buffer_begin_device_access(input_buffer, GST_MAP_READ);
 		klass->set_input_frame(base_blitter, input_buffer);
+		base_blitter->current_input_frame = input_buffer;
 
 		GST_TRACE_OBJECT(base_blitter, "input buffer uses DMA memory - setting it as actual input buffer");
 	}
+	else if (klass->accepts_system_memory)
+	{
+		/* The blitter reads the frame with the CPU, so a copy would gain nothing */
+		klass->set_input_frame(base_blitter, input_buffer);
+		base_blitter->current_input_frame = input_buffer;
+
+		GST_TRACE_OBJECT(base_blitter, "input buffer does not use DMA memory, but blitter accepts system memory - setting it as actual input buffer");
+	}
 	else
 	{
 		/* No DMA memory present; the input buffer needs to be copied to an internal
 		 * temporary input buffer */
 
-		GstFlowReturn flow_ret;
-
-		GST_TRACE_OBJECT(base_blitter, "input buffer does not use DMA memory - need to copy it to an internal input DMA buffer");
-
-		{
-			/* The internal input buffer is the temp input frame's DMA memory.
-			 * If it does not exist yet, it needs to be created here. The temp input
-			 * frame is then mapped. */
-
-			if (base_blitter->internal_bufferpool == NULL)
-			{
-				GST_TRACE_OBJECT(base_blitter, "need to create internal bufferpool");
-
-				/* Internal bufferpool does not exist yet - create it now,
-				 * so that it can in turn create the internal input buffer */
-
-				GstCaps *caps = gst_video_info_to_caps(&(base_blitter->input_video_info));
-
-				base_blitter->internal_bufferpool = gst_imx_base_blitter_create_bufferpool(
-					base_blitter,
-					caps,
-					base_blitter->input_video_info.size,
-					0, 0,
-					NULL,
-					NULL
-				);
-
-				gst_caps_unref(caps);
-
-				if (base_blitter->internal_bufferpool == NULL)
-				{
-					GST_ERROR_OBJECT(base_blitter, "failed to create internal bufferpool");
-					return FALSE;
-				}
-			}
-
-			/* Future versions of this code may propose the internal bufferpool upstream;
-			 * hence the is_active check */
-			if (!gst_buffer_pool_is_active(base_blitter->internal_bufferpool))
-				gst_buffer_pool_set_active(base_blitter->internal_bufferpool, TRUE);
-		}
-
-		/* Create new temporary internal input frame */
-		GST_TRACE_OBJECT(base_blitter, "acquiring buffer for temporary internal input frame");
-		flow_ret = gst_buffer_pool_acquire_buffer(base_blitter->internal_bufferpool, &(base_blitter->internal_input_frame), NULL);
-		if (flow_ret != GST_FLOW_OK)
-		{
-			GST_ERROR_OBJECT(base_blitter, "error acquiring input frame buffer: %s", gst_pad_mode_get_name(flow_ret));
+		if (!gst_imx_base_blitter_copy_to_dma_frame(base_blitter, input_buffer, &(base_blitter->internal_input_frame)))
 			return FALSE;
-		}
-
-		/* Copy the input buffer's pixels to the temp input frame */
-		{
-			GstVideoFrame input_frame, temp_input_frame;
-
-			gst_video_frame_map(&input_frame, &(base_blitter->input_video_info), input_buffer, GST_MAP_READ);
-			gst_video_frame_map(&temp_input_frame, &(base_blitter->input_video_info), base_blitter->internal_input_frame, GST_MAP_WRITE);
-
-			/* gst_video_frame_copy() makes sure stride and plane offset values from both frames are respected */
-			gst_video_frame_copy(&temp_input_frame, &input_frame);
-
-			GST_BUFFER_FLAGS(base_blitter->internal_input_frame) |= (GST_BUFFER_FLAGS(input_buffer) & (GST_VIDEO_BUFFER_FLAG_INTERLACED | GST_VIDEO_BUFFER_FLAG_TFF | GST_VIDEO_BUFFER_FLAG_RFF | GST_VIDEO_BUFFER_FLAG_ONEFIELD));
-
-			gst_video_frame_unmap(&temp_input_frame);
-			gst_video_frame_unmap(&input_frame);
-		}
 
+		gst_imx_phys_mem_buffer_begin_device_access(base_blitter->internal_input_frame, GST_MAP_READ);
 		klass->set_input_frame(base_blitter, base_blitter->internal_input_frame);
+		base_blitter->current_input_frame = base_blitter->internal_input_frame;
 	}
 
 	return TRUE;
@@ -251,6 +309,13 @@ gboolean gst_imx_base_blitter_set_output_buffer(GstImxBaseBlitter *base_blitter,
 	base_blitter->output_buffer_region.x2 = video_meta->width;
 	base_blitter->output_buffer_region.y2 = video_meta->height;
 
+	base_blitter->current_output_frame = output_buffer;
+
+	/* Blitters which access frames with the CPU map them, so the
+	 * allocator already knows about their accesses */
+	if (!(klass->accepts_system_memory))
+		gst_imx_phys_mem_buffer_begin_device_access(output_buffer, GST_MAP_WRITE);
+
 	return klass->set_output_frame(base_blitter, output_buffer);
 }
 
@@ -316,6 +381,12 @@ gboolean gst_imx_base_blitter_set_output_regions(GstImxBaseBlitter *base_blitter
 	base_blitter->full_video_region = *orig_video_region;
 	base_blitter->visible_video_region = *video_region;
 
+	/* The visible output region is needed by the tile planner; the video
+	 * region is stored above already. Unlike the output buffer, the regions
+	 * are not set for every frame, so this flag is never reset. */
+	base_blitter->visible_output_region = *output_region;
+	base_blitter->output_regions_set = TRUE;
+
 	if ((out_vis_type == GST_IMX_BASE_BLITTER_VISIBILITY_NONE) || (video_vis_type == GST_IMX_BASE_BLITTER_VISIBILITY_NONE))
 		return TRUE;
 	else
@@ -434,6 +505,7 @@ gboolean gst_imx_base_blitter_set_input_video_info(GstImxBaseBlitter *base_blitt
 		gst_buffer_unref(base_blitter->internal_input_frame);
 		base_blitter->internal_input_frame = NULL;
 	}
+	base_blitter->current_input_frame = NULL;
 
 	/* New videoinfo means new frame sizes, new strides etc.
 	 * making the existing internal bufferpool unusable
@@ -443,7 +515,7 @@ gboolean gst_imx_base_blitter_set_input_video_info(GstImxBaseBlitter *base_blitt
 	 * pool, it will keep the pool alive until it is unref'd) */
 	if (base_blitter->internal_bufferpool != NULL)
 	{
-		gst_object_unref(base_blitter->internal_bufferpool);
+		gst_imx_base_blitter_release_bufferpool(base_blitter, base_blitter->internal_bufferpool);
 		base_blitter->internal_bufferpool = NULL;
 	}
 
@@ -456,35 +528,182 @@ gboolean gst_imx_base_blitter_set_input_video_info(GstImxBaseBlitter *base_blitt
 gboolean gst_imx_base_blitter_blit(GstImxBaseBlitter *base_blitter)
 {
 	GstImxBaseBlitterClass *klass;
-	GstImxBaseBlitterRegion *input_region;
+	GstImxBaseBlitterRegion const *input_region;
 
 	g_assert(base_blitter != NULL);
 	klass = GST_IMX_BASE_BLITTER_CLASS(G_OBJECT_GET_CLASS(base_blitter));
 
 	g_assert(klass->blit_frame != NULL);
 
-	if (base_blitter->output_visibility_type == GST_IMX_BASE_BLITTER_VISIBILITY_NONE)
-	{
-		GST_TRACE_OBJECT(base_blitter, "output region outside of output buffer bounds -> no need to draw anything");
+	input_region = gst_imx_base_blitter_get_input_region(base_blitter);
+	if (input_region == NULL)
 		return TRUE;
+
+	if (gst_imx_base_blitter_needs_tiling(base_blitter, input_region))
+		return gst_imx_base_blitter_blit_tiled(base_blitter, input_region);
+
+	return klass->blit_frame(base_blitter, input_region);
+}
+
+
+GstImxBaseBlitterFence* gst_imx_base_blitter_submit(GstImxBaseBlitter *base_blitter)
+{
+	GstImxBaseBlitterClass *klass;
+	GstImxBaseBlitterRegion const *input_region;
+	GstImxBaseBlitterFence *fence;
+
+	g_assert(base_blitter != NULL);
+	klass = GST_IMX_BASE_BLITTER_CLASS(G_OBJECT_GET_CLASS(base_blitter));
+
+	g_assert(klass->blit_frame != NULL);
+	g_assert((klass->submit_blit == NULL) || (klass->wait_blit != NULL));
+
+	fence = g_slice_alloc(sizeof(GstImxBaseBlitterFence));
+	fence->input_frame = NULL;
+	fence->handle = NULL;
+
+	input_region = gst_imx_base_blitter_get_input_region(base_blitter);
+	if (input_region == NULL)
+		return fence;
+
+	if (gst_imx_base_blitter_needs_tiling(base_blitter, input_region))
+	{
+		/* The tiles are submitted in parallel internally, but stitching them
+		 * together requires waiting for them, so the tiled blit as a whole is
+		 * synchronous -> return an already signaled fence */
+		if (!gst_imx_base_blitter_blit_tiled(base_blitter, input_region))
+		{
+			g_slice_free1(sizeof(GstImxBaseBlitterFence), fence);
+			return NULL;
+		}
+
+		return fence;
 	}
 
-	if (base_blitter->video_visibility_type == GST_IMX_BASE_BLITTER_VISIBILITY_NONE)
+	if (klass->submit_blit == NULL)
 	{
-		GST_TRACE_OBJECT(base_blitter, "video region outside of output buffer bounds -> no need to draw anything");
-		return TRUE;
+		/* No asynchronous blits supported -> blit synchronously,
+		 * and return an already signaled fence */
+		if (!klass->blit_frame(base_blitter, input_region))
+		{
+			g_slice_free1(sizeof(GstImxBaseBlitterFence), fence);
+			return NULL;
+		}
+
+		return fence;
 	}
 
-	if (base_blitter->output_visibility_type == GST_IMX_BASE_BLITTER_VISIBILITY_FULL)
-		input_region = &(base_blitter->full_input_region);
-	else
+	if (!klass->submit_blit(base_blitter, input_region, &(fence->handle)))
 	{
-		input_region = &(base_blitter->visible_input_region);
-		if (!(base_blitter->visible_input_region_uptodate))
-			gst_imx_base_blitter_computer_visible_input_region(base_blitter);
+		g_slice_free1(sizeof(GstImxBaseBlitterFence), fence);
+		return NULL;
 	}
 
-	return klass->blit_frame(base_blitter, input_region);
+	g_assert(fence->handle != NULL);
+
+	if (base_blitter->current_input_frame != NULL)
+		fence->input_frame = gst_buffer_ref(base_blitter->current_input_frame);
+
+	GST_LOG_OBJECT(base_blitter, "submitted blit with handle %p", fence->handle);
+
+	return fence;
+}
+
+
+gboolean gst_imx_base_blitter_wait(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterFence *fence)
+{
+	GstImxBaseBlitterClass *klass;
+	gboolean ret = TRUE;
+
+	g_assert(base_blitter != NULL);
+	g_assert(fence != NULL);
+	klass = GST_IMX_BASE_BLITTER_CLASS(G_OBJECT_GET_CLASS(base_blitter));
+
+	if (fence->handle != NULL)
+	{
+		g_assert(klass->wait_blit != NULL);
+		GST_LOG_OBJECT(base_blitter, "waiting for blit with handle %p", fence->handle);
+		ret = klass->wait_blit(base_blitter, fence->handle);
+	}
+
+	if (fence->input_frame != NULL)
+		gst_buffer_unref(fence->input_frame);
+	g_slice_free1(sizeof(GstImxBaseBlitterFence), fence);
+
+	return ret;
+}
+
+
+void gst_imx_base_blitter_set_max_blit_size(GstImxBaseBlitter *base_blitter, gint max_width, gint max_height)
+{
+	g_assert(base_blitter != NULL);
+
+	GST_DEBUG_OBJECT(base_blitter, "set maximum blit size to %dx%d", max_width, max_height);
+
+	base_blitter->max_blit_width = max_width;
+	base_blitter->max_blit_height = max_height;
+}
+
+
+gboolean gst_imx_base_blitter_set_input_alpha(GstImxBaseBlitter *base_blitter, guint8 alpha)
+{
+	GstImxBaseBlitterClass *klass;
+
+	g_assert(base_blitter != NULL);
+	klass = GST_IMX_BASE_BLITTER_CLASS(G_OBJECT_GET_CLASS(base_blitter));
+
+	if (klass->set_input_alpha == NULL)
+		return (alpha == 255);
+
+	return klass->set_input_alpha(base_blitter, alpha);
+}
+
+
+gboolean gst_imx_base_blitter_can_fill_regions(GstImxBaseBlitter *base_blitter)
+{
+	g_assert(base_blitter != NULL);
+	return GST_IMX_BASE_BLITTER_CLASS(G_OBJECT_GET_CLASS(base_blitter))->fill_region != NULL;
+}
+
+
+gboolean gst_imx_base_blitter_fill_region(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *region, guint32 color)
+{
+	GstImxBaseBlitterClass *klass;
+
+	g_assert(base_blitter != NULL);
+	g_assert(region != NULL);
+	klass = GST_IMX_BASE_BLITTER_CLASS(G_OBJECT_GET_CLASS(base_blitter));
+
+	if (klass->fill_region == NULL)
+		return FALSE;
+
+	return klass->fill_region(base_blitter, region, color);
+}
+
+
+gboolean gst_imx_base_blitter_blit_batch(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterBatchEntry const *entries, guint num_entries)
+{
+	GstImxBaseBlitterClass *klass;
+	gboolean ret;
+
+	g_assert(base_blitter != NULL);
+	g_assert((entries != NULL) || (num_entries == 0));
+	g_assert(base_blitter->current_output_frame != NULL);
+	klass = GST_IMX_BASE_BLITTER_CLASS(G_OBJECT_GET_CLASS(base_blitter));
+
+	if (num_entries == 0)
+		return TRUE;
+
+	/* Batched blits are not split into tiles, so blitters with a maximum
+	 * blit size use the sequential path, which does that */
+	if ((klass->blit_batch != NULL) && ((base_blitter->max_blit_width <= 0) || (base_blitter->max_blit_height <= 0)))
+		ret = gst_imx_base_blitter_blit_batch_native(base_blitter, entries, num_entries);
+	else
+		ret = gst_imx_base_blitter_blit_batch_sequential(base_blitter, entries, num_entries);
+
+	gst_imx_base_blitter_set_input_alpha(base_blitter, 255);
+
+	return ret;
 }
 
 
@@ -499,7 +718,7 @@ gboolean gst_imx_base_blitter_flush(GstImxBaseBlitter *base_blitter)
 }
 
 
-GstBufferPool* gst_imx_base_blitter_create_bufferpool(GstImxBaseBlitter *base_blitter, GstCaps *caps, guint size, guint min_buffers, guint max_buffers, GstAllocator *allocator, GstAllocationParams *alloc_params)
+GstBufferPool* gst_imx_base_blitter_create_bufferpool(GstImxBaseBlitter *base_blitter, GstCaps *caps, guint size, guint min_buffers, guint max_buffers, GstAllocator *allocator, GstAllocationParams *alloc_params, GstImxPhysMemCachePolicy cache_policy)
 {
 	GstBufferPool *pool;
 	GstStructure *config;
@@ -526,6 +745,8 @@ GstBufferPool* gst_imx_base_blitter_create_bufferpool(GstImxBaseBlitter *base_bl
 	}
 
 	gst_buffer_pool_config_set_allocator(config, allocator, alloc_params);
+	gst_imx_phys_mem_buffer_pool_config_set_cache_policy(config, cache_policy);
+	gst_imx_phys_mem_buffer_pool_config_set_elastic(config, GST_IMX_BASE_BLITTER_POOL_MAX_BUFFERS, GST_IMX_BASE_BLITTER_POOL_IDLE_TIMEOUT);
 	gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_IMX_PHYS_MEM);
 	gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_VIDEO_META);
 	gst_buffer_pool_set_config(pool, config);
@@ -534,6 +755,78 @@ GstBufferPool* gst_imx_base_blitter_create_bufferpool(GstImxBaseBlitter *base_bl
 }
 
 
+GstBufferPool* gst_imx_base_blitter_acquire_bufferpool(GstImxBaseBlitter *base_blitter, GstCaps *caps, guint size, guint min_buffers, guint max_buffers, GstImxPhysMemCachePolicy cache_policy)
+{
+	GstBufferPool *pool;
+
+	g_assert(base_blitter != NULL);
+
+	if (base_blitter->pool_registry != NULL)
+	{
+		GstAllocator *allocator = gst_imx_base_blitter_get_phys_mem_allocator(base_blitter);
+		if (allocator == NULL)
+		{
+			GST_ERROR_OBJECT(base_blitter, "could not create physical memory bufferpool allocator");
+			return NULL;
+		}
+
+		/* The pool config uses the default alignment, so pass 0 for it */
+		pool = gst_imx_phys_mem_pool_registry_acquire_pool(base_blitter->pool_registry, allocator, caps, size, min_buffers, 0, 0, cache_policy);
+		gst_object_unref(GST_OBJECT(allocator));
+
+		return pool;
+	}
+
+	pool = gst_imx_base_blitter_create_bufferpool(base_blitter, caps, size, min_buffers, max_buffers, NULL, NULL, cache_policy);
+	if (pool == NULL)
+		return NULL;
+
+	if (!gst_buffer_pool_set_active(pool, TRUE))
+	{
+		GST_ERROR_OBJECT(base_blitter, "could not activate bufferpool");
+		gst_object_unref(GST_OBJECT(pool));
+		return NULL;
+	}
+
+	return pool;
+}
+
+
+void gst_imx_base_blitter_release_bufferpool(GstImxBaseBlitter *base_blitter, GstBufferPool *pool)
+{
+	g_assert(base_blitter != NULL);
+	g_assert(pool != NULL);
+
+	if (base_blitter->pool_registry != NULL)
+	{
+		gst_imx_phys_mem_pool_registry_release_pool(base_blitter->pool_registry, pool);
+	}
+	else
+	{
+		gst_buffer_pool_set_active(pool, FALSE);
+		gst_object_unref(GST_OBJECT(pool));
+	}
+}
+
+
+void gst_imx_base_blitter_set_pool_registry(GstImxBaseBlitter *base_blitter, GstImxPhysMemPoolRegistry *registry)
+{
+	g_assert(base_blitter != NULL);
+
+	if (registry == base_blitter->pool_registry)
+		return;
+
+	/* Pools are released through the registry they were acquired from */
+	g_assert((base_blitter->internal_bufferpool == NULL) && (base_blitter->tile_bufferpool == NULL));
+
+	if (registry != NULL)
+		gst_object_ref(GST_OBJECT(registry));
+	if (base_blitter->pool_registry != NULL)
+		gst_object_unref(GST_OBJECT(base_blitter->pool_registry));
+	base_blitter->pool_registry = registry;
+}
+
+
 GstAllocator* gst_imx_base_blitter_get_phys_mem_allocator(GstImxBaseBlitter *base_blitter)
 {
 	GstImxBaseBlitterClass *klass;
@@ -657,3 +950,642 @@ static GstImxBaseBlitterRegion const * gst_imx_base_blitter_calc_region_visibili
 
 	return region;
 }
+
+
+static GstImxBaseBlitterRegion const * gst_imx_base_blitter_get_input_region(GstImxBaseBlitter *base_blitter)
+{
+	/* Returns NULL if nothing needs to be drawn */
+
+	if (base_blitter->output_visibility_type == GST_IMX_BASE_BLITTER_VISIBILITY_NONE)
+	{
+		GST_TRACE_OBJECT(base_blitter, "output region outside of output buffer bounds -> no need to draw anything");
+		return NULL;
+	}
+
+	if (base_blitter->video_visibility_type == GST_IMX_BASE_BLITTER_VISIBILITY_NONE)
+	{
+		GST_TRACE_OBJECT(base_blitter, "video region outside of output buffer bounds -> no need to draw anything");
+		return NULL;
+	}
+
+	if (base_blitter->output_visibility_type == GST_IMX_BASE_BLITTER_VISIBILITY_FULL)
+		return &(base_blitter->full_input_region);
+	else
+	{
+		if (!(base_blitter->visible_input_region_uptodate))
+			gst_imx_base_blitter_computer_visible_input_region(base_blitter);
+		return &(base_blitter->visible_input_region);
+	}
+}
+
+
+static gboolean gst_imx_base_blitter_needs_tiling(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *input_region)
+{
+	GstImxBaseBlitterClass *klass = GST_IMX_BASE_BLITTER_CLASS(G_OBJECT_GET_CLASS(base_blitter));
+	GstImxBaseBlitterRegion const *video_region;
+	gint max_w = base_blitter->max_blit_width, max_h = base_blitter->max_blit_height;
+
+	if ((max_w <= 0) || (max_h <= 0))
+		return FALSE;
+
+	video_region = base_blitter->output_regions_set ? &(base_blitter->visible_video_region) : &(base_blitter->output_buffer_region);
+
+	if (((input_region->x2 - input_region->x1) <= max_w) && ((input_region->y2 - input_region->y1) <= max_h) && ((video_region->x2 - video_region->x1) <= max_w) && ((video_region->y2 - video_region->y1) <= max_h))
+		return FALSE;
+
+	if ((klass->set_output_regions == NULL) || (base_blitter->current_output_frame == NULL))
+	{
+		GST_WARNING_OBJECT(base_blitter, "blit exceeds the maximum blit size of %dx%d, but cannot be split into tiles", max_w, max_h);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+static GArray* gst_imx_base_blitter_plan_tile_spans(gint in1, gint in2, gint out1, gint out2, gint max_size)
+{
+	/* Splits the output range out1-out2 into spans whose inner parts are at most
+	 * max_inner_size wide. Each span's input range covers the input pixels which
+	 * map to the inner part, plus a border of GST_IMX_BASE_BLITTER_TILE_BORDER
+	 * pixels on both sides (except at the edges of the input range). max_inner_size
+	 * is chosen such that both the input range and the scaled range (which is
+	 * blitted into the scratch frame) fit in max_size.
+	 * Returns NULL if max_size is too small for tiling. */
+
+	GArray *spans;
+	gint in_size = in2 - in1, out_size = out2 - out1;
+	gint border = GST_IMX_BASE_BLITTER_TILE_BORDER, alignment = GST_IMX_BASE_BLITTER_TILE_ALIGNMENT;
+	gint scaled_border, max_inner_size, num_spans, i;
+	gdouble scale;
+
+	scale = (gdouble)out_size / (gdouble)in_size;
+	scaled_border = (gint)ceil(border * scale);
+
+	/* Reserve space for the border on both sides, plus extra pixels for
+	 * the rounding and alignment of the span edges */
+	max_inner_size = MIN(
+		max_size - 2 * (scaled_border + alignment + 1),
+		(gint)((max_size - 2 * (border + alignment + 1)) * scale)
+	);
+	max_inner_size &= ~(alignment - 1);
+	if (max_inner_size <= 0)
+		return NULL;
+
+	num_spans = (out_size + max_inner_size - 1) / max_inner_size;
+
+	spans = g_array_sized_new(FALSE, FALSE, sizeof(GstImxBaseBlitterTileSpan), num_spans);
+
+	for (i = 0; i < num_spans; ++i)
+	{
+		GstImxBaseBlitterTileSpan span;
+		gdouble exact_in1, exact_in2;
+
+		/* Distribute the output range evenly across the spans */
+		span.out1 = (i == 0) ? out1 : (out1 + ((out_size * i / num_spans) & ~(alignment - 1)));
+		span.out2 = (i == (num_spans - 1)) ? out2 : (out1 + ((out_size * (i + 1) / num_spans) & ~(alignment - 1)));
+
+		/* The exact input coordinates which correspond to the inner part */
+		exact_in1 = in1 + (span.out1 - out1) / scale;
+		exact_in2 = in1 + (span.out2 - out1) / scale;
+
+		span.in1 = (i == 0) ? in1 : MAX(in1, ((gint)floor(exact_in1) - border) & ~(alignment - 1));
+		span.in2 = (i == (num_spans - 1)) ? in2 : MIN(in2, ((gint)ceil(exact_in2) + border + alignment - 1) & ~(alignment - 1));
+		span.in2 = MIN(span.in2, span.in1 + max_size);
+
+		span.scratch_size = MIN((gint)((span.in2 - span.in1) * scale + 0.5), max_size);
+		span.scratch_size = MAX(span.scratch_size, span.out2 - span.out1);
+
+		span.scratch_offset = ((gint)((exact_in1 - span.in1) * scale + 0.5)) & ~(alignment - 1);
+		span.scratch_offset = CLAMP(span.scratch_offset, 0, span.scratch_size - (span.out2 - span.out1));
+
+		g_array_append_val(spans, span);
+	}
+
+	return spans;
+}
+
+
+static gboolean gst_imx_base_blitter_blit_tiled(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *input_region)
+{
+	/* Tiled blits happen in two stages. First, each tile is blitted (scaled and
+	 * converted) into its own scratch frame, together with a border of neighbouring
+	 * input pixels. Then, the inner part of each scratch frame is blitted 1:1 into
+	 * the output frame. Thanks to the borders, the scaling filter sees the same
+	 * input pixels at tile edges as it would in an untiled blit, so no seams
+	 * appear between the tiles. Scratch frames use the output format, and are
+	 * never larger than the maximum blit size. */
+
+	GstImxBaseBlitterClass *klass = GST_IMX_BASE_BLITTER_CLASS(G_OBJECT_GET_CLASS(base_blitter));
+	GstImxBaseBlitterRegion video_region, output_region;
+	GstBuffer *output_frame = base_blitter->current_output_frame;
+	GstVideoMeta *output_video_meta;
+	GstVideoInfo orig_input_video_info;
+	GArray *x_spans, *y_spans;
+	GstImxBaseBlitterTile *tiles;
+	guint num_tiles, tile_index, x, y;
+	gboolean ret = TRUE;
+
+	if (base_blitter->output_regions_set)
+	{
+		video_region = base_blitter->visible_video_region;
+		output_region = base_blitter->visible_output_region;
+	}
+	else
+		video_region = output_region = base_blitter->output_buffer_region;
+
+	/* Plan the tiles */
+
+	x_spans = gst_imx_base_blitter_plan_tile_spans(input_region->x1, input_region->x2, video_region.x1, video_region.x2, base_blitter->max_blit_width);
+	y_spans = gst_imx_base_blitter_plan_tile_spans(input_region->y1, input_region->y2, video_region.y1, video_region.y2, base_blitter->max_blit_height);
+	if ((x_spans == NULL) || (y_spans == NULL))
+	{
+		GST_WARNING_OBJECT(base_blitter, "scale factor too large for a maximum blit size of %dx%d - cannot split blit into tiles", base_blitter->max_blit_width, base_blitter->max_blit_height);
+		if (x_spans != NULL)
+			g_array_free(x_spans, TRUE);
+		if (y_spans != NULL)
+			g_array_free(y_spans, TRUE);
+		return klass->blit_frame(base_blitter, input_region);
+	}
+
+	num_tiles = x_spans->len * y_spans->len;
+	tiles = g_new0(GstImxBaseBlitterTile, num_tiles);
+
+	GST_LOG_OBJECT(
+		base_blitter,
+		"splitting blit of input region (%d, %d) - (%d, %d) into video region (%d, %d) - (%d, %d) into %u x %u tiles",
+		input_region->x1, input_region->y1, input_region->x2, input_region->y2,
+		video_region.x1, video_region.y1, video_region.x2, video_region.y2,
+		x_spans->len, y_spans->len
+	);
+
+	for (y = 0, tile_index = 0; y < y_spans->len; ++y)
+	{
+		GstImxBaseBlitterTileSpan *y_span = &g_array_index(y_spans, GstImxBaseBlitterTileSpan, y);
+
+		for (x = 0; x < x_spans->len; ++x, ++tile_index)
+		{
+			GstImxBaseBlitterTileSpan *x_span = &g_array_index(x_spans, GstImxBaseBlitterTileSpan, x);
+			GstImxBaseBlitterTile *tile = &(tiles[tile_index]);
+
+			tile->input_region.x1 = x_span->in1;
+			tile->input_region.y1 = y_span->in1;
+			tile->input_region.x2 = x_span->in2;
+			tile->input_region.y2 = y_span->in2;
+
+			tile->scratch_region.x1 = 0;
+			tile->scratch_region.y1 = 0;
+			tile->scratch_region.x2 = x_span->scratch_size;
+			tile->scratch_region.y2 = y_span->scratch_size;
+
+			tile->scratch_inner_region.x1 = x_span->scratch_offset;
+			tile->scratch_inner_region.y1 = y_span->scratch_offset;
+			tile->scratch_inner_region.x2 = x_span->scratch_offset + (x_span->out2 - x_span->out1);
+			tile->scratch_inner_region.y2 = y_span->scratch_offset + (y_span->out2 - y_span->out1);
+
+			tile->output_region.x1 = x_span->out1;
+			tile->output_region.y1 = y_span->out1;
+			tile->output_region.x2 = x_span->out2;
+			tile->output_region.y2 = y_span->out2;
+		}
+	}
+
+	g_array_free(x_spans, TRUE);
+	g_array_free(y_spans, TRUE);
+
+	/* (Re)create the scratch frame pool if necessary */
+
+	output_video_meta = gst_buffer_get_video_meta(output_frame);
+	if ((base_blitter->tile_bufferpool != NULL) && ((GST_VIDEO_INFO_FORMAT(&(base_blitter->tile_video_info)) != output_video_meta->format) || (GST_VIDEO_INFO_WIDTH(&(base_blitter->tile_video_info)) != base_blitter->max_blit_width) || (GST_VIDEO_INFO_HEIGHT(&(base_blitter->tile_video_info)) != base_blitter->max_blit_height)))
+	{
+		GST_DEBUG_OBJECT(base_blitter, "output format or maximum blit size changed - need to recreate tile bufferpool");
+		gst_imx_base_blitter_release_bufferpool(base_blitter, base_blitter->tile_bufferpool);
+		base_blitter->tile_bufferpool = NULL;
+	}
+
+	if (base_blitter->tile_bufferpool == NULL)
+	{
+		GstCaps *caps;
+
+		gst_video_info_set_format(&(base_blitter->tile_video_info), output_video_meta->format, base_blitter->max_blit_width, base_blitter->max_blit_height);
+		caps = gst_video_info_to_caps(&(base_blitter->tile_video_info));
+
+		base_blitter->tile_bufferpool = gst_imx_base_blitter_acquire_bufferpool(
+			base_blitter,
+			caps,
+			base_blitter->tile_video_info.size,
+			0,
+			/* all tiles of a blit are acquired at the same time, so the pool
+			 * must not be capped; idle tiles are still freed */
+			G_MAXUINT,
+			/* scratch tiles are only accessed by the blitter engine */
+			GST_IMX_PHYS_MEM_CACHE_POLICY_UNCACHED
+		);
+
+		gst_caps_unref(caps);
+
+		if (base_blitter->tile_bufferpool == NULL)
+		{
+			GST_ERROR_OBJECT(base_blitter, "failed to create tile bufferpool");
+			g_free(tiles);
+			return FALSE;
+		}
+	}
+
+	for (tile_index = 0; tile_index < num_tiles; ++tile_index)
+	{
+		GstFlowReturn flow_ret = gst_buffer_pool_acquire_buffer(base_blitter->tile_bufferpool, &(tiles[tile_index].scratch_frame), NULL);
+		if (flow_ret != GST_FLOW_OK)
+		{
+			GST_ERROR_OBJECT(base_blitter, "error acquiring scratch frame for tile: %s", gst_flow_get_name(flow_ret));
+			ret = FALSE;
+			goto cleanup;
+		}
+	}
+
+	/* Stage 1: blit the tiles (with borders) into the scratch frames; these blits
+	 * are independent of each other, so they can all be in flight at the same time */
+
+	for (tile_index = 0; ret && (tile_index < num_tiles); ++tile_index)
+	{
+		GstImxBaseBlitterTile *tile = &(tiles[tile_index]);
+
+		ret = klass->set_output_frame(base_blitter, tile->scratch_frame)
+		   && klass->set_output_regions(base_blitter, &(tile->scratch_region), &(tile->scratch_region));
+		if (!ret)
+			break;
+
+		if (klass->submit_blit != NULL)
+			ret = klass->submit_blit(base_blitter, &(tile->input_region), &(tile->handle));
+		else
+			ret = klass->blit_frame(base_blitter, &(tile->input_region));
+	}
+
+	for (tile_index = 0; tile_index < num_tiles; ++tile_index)
+	{
+		if (tiles[tile_index].handle != NULL)
+		{
+			ret = klass->wait_blit(base_blitter, tiles[tile_index].handle) && ret;
+			tiles[tile_index].handle = NULL;
+		}
+	}
+
+	if (!ret)
+	{
+		GST_ERROR_OBJECT(base_blitter, "could not blit tiles into scratch frames");
+		goto restore;
+	}
+
+	/* Stage 2: stitch the inner parts of the scratch frames together in the output frame.
+	 * Tiles at the edges of the video region get output regions which extend to the
+	 * edges of the output region, so together, the tiles fill all of the empty regions
+	 * around the video region. These extended output regions do not overlap, so the
+	 * tiles can be blitted in parallel. The output regions may be larger than the
+	 * maximum blit size; derived blitters must be able to fill such regions. */
+
+	orig_input_video_info = base_blitter->input_video_info;
+	base_blitter->input_video_info = base_blitter->tile_video_info;
+	if (klass->set_input_video_info != NULL)
+		klass->set_input_video_info(base_blitter, &(base_blitter->tile_video_info));
+
+	for (tile_index = 0; ret && (tile_index < num_tiles); ++tile_index)
+	{
+		GstImxBaseBlitterTile *tile = &(tiles[tile_index]);
+		GstImxBaseBlitterRegion tile_output_region = tile->output_region;
+
+		if (tile->output_region.x1 == video_region.x1)
+			tile_output_region.x1 = output_region.x1;
+		if (tile->output_region.y1 == video_region.y1)
+			tile_output_region.y1 = output_region.y1;
+		if (tile->output_region.x2 == video_region.x2)
+			tile_output_region.x2 = output_region.x2;
+		if (tile->output_region.y2 == video_region.y2)
+			tile_output_region.y2 = output_region.y2;
+
+		ret = klass->set_input_frame(base_blitter, tile->scratch_frame)
+		   && klass->set_output_frame(base_blitter, output_frame)
+		   && klass->set_output_regions(base_blitter, &(tile->output_region), &tile_output_region);
+		if (!ret)
+			break;
+
+		if (klass->submit_blit != NULL)
+			ret = klass->submit_blit(base_blitter, &(tile->scratch_inner_region), &(tile->handle));
+		else
+			ret = klass->blit_frame(base_blitter, &(tile->scratch_inner_region));
+	}
+
+	for (tile_index = 0; tile_index < num_tiles; ++tile_index)
+	{
+		if (tiles[tile_index].handle != NULL)
+		{
+			ret = klass->wait_blit(base_blitter, tiles[tile_index].handle) && ret;
+			tiles[tile_index].handle = NULL;
+		}
+	}
+
+	if (!ret)
+		GST_ERROR_OBJECT(base_blitter, "could not stitch tiles together in the output frame");
+
+	base_blitter->input_video_info = orig_input_video_info;
+	if (klass->set_input_video_info != NULL)
+		klass->set_input_video_info(base_blitter, &(base_blitter->input_video_info));
+
+restore:
+	/* Restore the frames and regions of the untiled blit in the derived blitter */
+	if (base_blitter->current_input_frame != NULL)
+		klass->set_input_frame(base_blitter, base_blitter->current_input_frame);
+	klass->set_output_frame(base_blitter, output_frame);
+	klass->set_output_regions(base_blitter, &video_region, &output_region);
+
+	if (ret)
+		base_blitter->num_tiled_blits++;
+
+cleanup:
+	for (tile_index = 0; tile_index < num_tiles; ++tile_index)
+	{
+		if (tiles[tile_index].scratch_frame != NULL)
+			gst_buffer_unref(tiles[tile_index].scratch_frame);
+	}
+	g_free(tiles);
+
+	return ret;
+}
+
+
+static gboolean gst_imx_base_blitter_copy_to_dma_frame(GstImxBaseBlitter *base_blitter, GstBuffer *input_buffer, GstBuffer **dma_frame)
+{
+	/* Copies the pixels of an input buffer which does not use DMA memory into
+	 * a new frame from the internal bufferpool, which does. The new frame is
+	 * written to dma_frame. */
+
+	GstFlowReturn flow_ret;
+
+	gst_imx_phys_mem_caps_count_fallback_copy(GST_OBJECT(base_blitter), &(base_blitter->num_input_frame_copies));
+	GST_LOG_OBJECT(base_blitter, "input buffer does not use DMA memory - need to copy it to an internal input DMA buffer (%" G_GUINT64_FORMAT " copies so far)", base_blitter->num_input_frame_copies);
+
+	{
+		/* The internal input buffer is the temp input frame's DMA memory.
+		 * If it does not exist yet, it needs to be created here. The temp input
+		 * frame is then mapped. */
+
+		if (base_blitter->internal_bufferpool == NULL)
+		{
+			GST_TRACE_OBJECT(base_blitter, "need to create internal bufferpool");
+
+			/* Internal bufferpool does not exist yet - create it now,
+			 * so that it can in turn create the internal input buffer */
+
+			GstCaps *caps = gst_video_info_to_caps(&(base_blitter->input_video_info));
+
+			base_blitter->internal_bufferpool = gst_imx_base_blitter_acquire_bufferpool(
+				base_blitter,
+				caps,
+				base_blitter->input_video_info.size,
+				0, 0,
+				/* the CPU only writes the copied frames, sequentially */
+				GST_IMX_PHYS_MEM_CACHE_POLICY_WRITE_COMBINED
+			);
+
+			gst_caps_unref(caps);
+
+			if (base_blitter->internal_bufferpool == NULL)
+			{
+				GST_ERROR_OBJECT(base_blitter, "failed to create internal bufferpool");
+				return FALSE;
+			}
+		}
+
+		/* The internal bufferpool is only used for these copies; video transforms
+		 * propose a separate physical memory bufferpool upstream. */
+	}
+
+	/* Create new temporary internal input frame */
+	GST_TRACE_OBJECT(base_blitter, "acquiring buffer for temporary internal input frame");
+	flow_ret = gst_buffer_pool_acquire_buffer(base_blitter->internal_bufferpool, dma_frame, NULL);
+	if (flow_ret != GST_FLOW_OK)
+	{
+		GST_ERROR_OBJECT(base_blitter, "error acquiring input frame buffer: %s", gst_flow_get_name(flow_ret));
+		return FALSE;
+	}
+
+	/* Copy the input buffer's pixels to the temp input frame */
+	{
+		GstVideoFrame input_frame, temp_input_frame;
+
+		gst_video_frame_map(&input_frame, &(base_blitter->input_video_info), input_buffer, GST_MAP_READ);
+		gst_video_frame_map(&temp_input_frame, &(base_blitter->input_video_info), *dma_frame, GST_MAP_WRITE);
+
+		/* gst_video_frame_copy() makes sure stride and plane offset values from both frames are respected */
+		gst_video_frame_copy(&temp_input_frame, &input_frame);
+
+		GST_BUFFER_FLAGS(*dma_frame) |= (GST_BUFFER_FLAGS(input_buffer) & (GST_VIDEO_BUFFER_FLAG_INTERLACED | GST_VIDEO_BUFFER_FLAG_TFF | GST_VIDEO_BUFFER_FLAG_RFF | GST_VIDEO_BUFFER_FLAG_ONEFIELD));
+
+		gst_video_frame_unmap(&temp_input_frame);
+		gst_video_frame_unmap(&input_frame);
+	}
+
+	return TRUE;
+}
+
+
+static gboolean gst_imx_base_blitter_clip_batch_entry(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterBatchEntry *entry)
+{
+	/* Clips the entry's output region to the output buffer region, and shrinks
+	 * the input region so it only contains the pixels which end up in the
+	 * visible part of the output region. Returns FALSE if the entry is not
+	 * visible at all. */
+
+	GstImxBaseBlitterRegion full_input_region = entry->input_region;
+	GstImxBaseBlitterRegion full_output_region = entry->output_region;
+	GstImxBaseBlitterRegion *vis = &(entry->output_region);
+	gint64 cut_left, cut_right, cut_top, cut_bottom;
+	gint64 in_width, in_height, span_x, span_y;
+	gboolean transposed;
+
+	if ((full_input_region.x1 >= full_input_region.x2) || (full_input_region.y1 >= full_input_region.y2))
+		return FALSE;
+
+	if (!gst_imx_base_blitter_do_regions_intersect(&(base_blitter->output_buffer_region), &full_output_region))
+		return FALSE;
+
+	if (gst_imx_base_blitter_is_region_contained(&(base_blitter->output_buffer_region), &full_output_region))
+		return TRUE;
+
+	gst_imx_base_blitter_calc_region_intersection(&(base_blitter->output_buffer_region), &full_output_region, vis);
+
+	/* Determine how many output pixels were cut off at each edge of the input
+	 * region; with rotations, the edges of the input and output regions differ */
+	switch (entry->rotation)
+	{
+		case GST_IMX_BASE_BLITTER_ROTATION_HFLIP:
+			cut_left   = full_output_region.x2 - vis->x2;
+			cut_right  = vis->x1 - full_output_region.x1;
+			cut_top    = vis->y1 - full_output_region.y1;
+			cut_bottom = full_output_region.y2 - vis->y2;
+			transposed = FALSE;
+			break;
+
+		case GST_IMX_BASE_BLITTER_ROTATION_VFLIP:
+			cut_left   = vis->x1 - full_output_region.x1;
+			cut_right  = full_output_region.x2 - vis->x2;
+			cut_top    = full_output_region.y2 - vis->y2;
+			cut_bottom = vis->y1 - full_output_region.y1;
+			transposed = FALSE;
+			break;
+
+		case GST_IMX_BASE_BLITTER_ROTATION_180:
+			cut_left   = full_output_region.x2 - vis->x2;
+			cut_right  = vis->x1 - full_output_region.x1;
+			cut_top    = full_output_region.y2 - vis->y2;
+			cut_bottom = vis->y1 - full_output_region.y1;
+			transposed = FALSE;
+			break;
+
+		case GST_IMX_BASE_BLITTER_ROTATION_90:
+			/* the input's left edge ends up at the top, its top edge at the right */
+			cut_left   = vis->y1 - full_output_region.y1;
+			cut_right  = full_output_region.y2 - vis->y2;
+			cut_top    = full_output_region.x2 - vis->x2;
+			cut_bottom = vis->x1 - full_output_region.x1;
+			transposed = TRUE;
+			break;
+
+		case GST_IMX_BASE_BLITTER_ROTATION_270:
+			/* the input's left edge ends up at the bottom, its top edge at the left */
+			cut_left   = full_output_region.y2 - vis->y2;
+			cut_right  = vis->y1 - full_output_region.y1;
+			cut_top    = vis->x1 - full_output_region.x1;
+			cut_bottom = full_output_region.x2 - vis->x2;
+			transposed = TRUE;
+			break;
+
+		default:
+			cut_left   = vis->x1 - full_output_region.x1;
+			cut_right  = full_output_region.x2 - vis->x2;
+			cut_top    = vis->y1 - full_output_region.y1;
+			cut_bottom = full_output_region.y2 - vis->y2;
+			transposed = FALSE;
+			break;
+	}
+
+	in_width = full_input_region.x2 - full_input_region.x1;
+	in_height = full_input_region.y2 - full_input_region.y1;
+	span_x = transposed ? (full_output_region.y2 - full_output_region.y1) : (full_output_region.x2 - full_output_region.x1);
+	span_y = transposed ? (full_output_region.x2 - full_output_region.x1) : (full_output_region.y2 - full_output_region.y1);
+
+	entry->input_region.x1 = full_input_region.x1 + (gint)(cut_left * in_width / span_x);
+	entry->input_region.x2 = full_input_region.x2 - (gint)(cut_right * in_width / span_x);
+	entry->input_region.y1 = full_input_region.y1 + (gint)(cut_top * in_height / span_y);
+	entry->input_region.y2 = full_input_region.y2 - (gint)(cut_bottom * in_height / span_y);
+
+	return (entry->input_region.x1 < entry->input_region.x2) && (entry->input_region.y1 < entry->input_region.y2);
+}
+
+
+static gboolean gst_imx_base_blitter_blit_batch_native(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterBatchEntry const *entries, guint num_entries)
+{
+	GstImxBaseBlitterClass *klass = GST_IMX_BASE_BLITTER_CLASS(G_OBJECT_GET_CLASS(base_blitter));
+	GstImxBaseBlitterBatchEntry *prepared_entries;
+	GstBuffer **dma_frames;
+	guint i, num_prepared_entries = 0;
+	gboolean ret = TRUE;
+
+	prepared_entries = g_new(GstImxBaseBlitterBatchEntry, num_entries);
+	/* Internal copies of input buffers which do not use DMA memory;
+	 * they must stay alive until the batch is finished */
+	dma_frames = g_new0(GstBuffer*, num_entries);
+
+	for (i = 0; i < num_entries; ++i)
+	{
+		GstImxBaseBlitterBatchEntry *prepared_entry = &(prepared_entries[num_prepared_entries]);
+		GstImxPhysMemMeta *phys_mem_meta;
+
+		*prepared_entry = entries[i];
+
+		if (!gst_imx_base_blitter_clip_batch_entry(base_blitter, prepared_entry))
+		{
+			GST_TRACE_OBJECT(base_blitter, "batch entry #%u is not visible - skipping", i);
+			continue;
+		}
+
+		phys_mem_meta = GST_IMX_PHYS_MEM_META_GET(prepared_entry->input_buffer);
+		if (((phys_mem_meta == NULL) || (phys_mem_meta->phys_addr == 0)) && !(klass->accepts_system_memory))
+		{
+			/* Import DMA-BUF buffers if possible; copy otherwise */
+			dma_frames[num_prepared_entries] = gst_imx_dmabuf_import_buffer(prepared_entry->input_buffer);
+			if ((dma_frames[num_prepared_entries] == NULL) && !gst_imx_base_blitter_copy_to_dma_frame(base_blitter, prepared_entry->input_buffer, &(dma_frames[num_prepared_entries])))
+			{
+				ret = FALSE;
+				break;
+			}
+
+			prepared_entry->input_buffer = dma_frames[num_prepared_entries];
+		}
+
+		++num_prepared_entries;
+	}
+
+	if (ret && (num_prepared_entries > 0))
+	{
+		GST_LOG_OBJECT(base_blitter, "blitting batch with %u visible entries (out of %u)", num_prepared_entries, num_entries);
+		ret = klass->blit_batch(base_blitter, prepared_entries, num_prepared_entries);
+	}
+
+	for (i = 0; i < num_prepared_entries; ++i)
+	{
+		if (dma_frames[i] != NULL)
+			gst_buffer_unref(dma_frames[i]);
+	}
+	g_free(dma_frames);
+	g_free(prepared_entries);
+
+	return ret;
+}
+
+
+static gboolean gst_imx_base_blitter_blit_batch_sequential(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterBatchEntry const *entries, guint num_entries)
+{
+	GstImxBaseBlitterClass *klass = GST_IMX_BASE_BLITTER_CLASS(G_OBJECT_GET_CLASS(base_blitter));
+	guint i;
+
+	if (klass->set_output_regions == NULL)
+	{
+		GST_ERROR_OBJECT(base_blitter, "blitter does not support output regions; cannot blit batch");
+		return FALSE;
+	}
+
+	GST_LOG_OBJECT(base_blitter, "blitting batch with %u entries sequentially", num_entries);
+
+	for (i = 0; i < num_entries; ++i)
+	{
+		GstImxBaseBlitterBatchEntry const *entry = &(entries[i]);
+
+		if (entry->rotation != GST_IMX_BASE_BLITTER_ROTATION_NONE)
+		{
+			GST_ERROR_OBJECT(base_blitter, "batch entry #%u is rotated, but the blitter cannot rotate batch entries", i);
+			return FALSE;
+		}
+
+		if (!gst_imx_base_blitter_set_input_alpha(base_blitter, entry->alpha))
+		{
+			GST_ERROR_OBJECT(base_blitter, "batch entry #%u has alpha value %u, but the blitter cannot blend", i, (guint)(entry->alpha));
+			return FALSE;
+		}
+
+		if (!gst_imx_base_blitter_set_input_buffer(base_blitter, entry->input_buffer))
+			return FALSE;
+
+		/* set_input_buffer() set the input region to the entire frame;
+		 * use the entry's region instead. Using the output region as video
+		 * region as well makes sure nothing around it is painted black. */
+		base_blitter->full_input_region = entry->input_region;
+
+		if (!gst_imx_base_blitter_set_output_regions(base_blitter, &(entry->output_region), &(entry->output_region)))
+			return FALSE;
+
+		if (!gst_imx_base_blitter_blit(base_blitter))
+			return FALSE;
+	}
+
+	return TRUE;
+}
@@ -24,6 +24,7 @@
 #include <gst/video/video.h>
 
 #include "phys_mem_allocator.h"
+#include "phys_mem_pool_registry.h"
 
 
 G_BEGIN_DECLS
@@ -33,6 +34,8 @@ typedef struct _GstImxBaseBlitter GstImxBaseBlitter;
 typedef struct _GstImxBaseBlitterRegion GstImxBaseBlitterRegion;
 typedef struct _GstImxBaseBlitterClass GstImxBaseBlitterClass;
 typedef struct _GstImxBaseBlitterPrivate GstImxBaseBlitterPrivate;
+typedef struct _GstImxBaseBlitterFence GstImxBaseBlitterFence;
+typedef struct _GstImxBaseBlitterBatchEntry GstImxBaseBlitterBatchEntry;
 
 
 #define GST_TYPE_IMX_BASE_BLITTER             (gst_imx_base_blitter_get_type())
@@ -88,6 +91,42 @@ typedef enum
 GstImxBaseBlitterVisibilityType;
 
 
+/**
+ * GstImxBaseBlitterRotationMode:
+ *
+ * Rotation and flip modes for batch entries. Rotations are clockwise.
+ */
+typedef enum
+{
+	GST_IMX_BASE_BLITTER_ROTATION_NONE,
+	GST_IMX_BASE_BLITTER_ROTATION_HFLIP,
+	GST_IMX_BASE_BLITTER_ROTATION_VFLIP,
+	GST_IMX_BASE_BLITTER_ROTATION_90,
+	GST_IMX_BASE_BLITTER_ROTATION_180,
+	GST_IMX_BASE_BLITTER_ROTATION_270
+}
+GstImxBaseBlitterRotationMode;
+
+
+/**
+ * GstImxBaseBlitterBatchEntry:
+ *
+ * One blit operation of a batch passed to @gst_imx_base_blitter_blit_batch .
+ * The input_region of input_buffer is blitted into the output_region of the
+ * current output buffer, rotated by rotation, and blended over the output
+ * pixels with alpha (255 = opaque). Unlike with regular blits, the pixels
+ * around the output region are left untouched.
+ */
+struct _GstImxBaseBlitterBatchEntry
+{
+	GstBuffer *input_buffer;
+	GstImxBaseBlitterRegion input_region;
+	GstImxBaseBlitterRegion output_region;
+	GstImxBaseBlitterRotationMode rotation;
+	guint8 alpha;
+};
+
+
 /**
  * GstImxBaseBlitter:
  *
@@ -99,6 +138,11 @@ struct _GstImxBaseBlitter
 
 	/*< protected >*/
 
+	/* Registry the internal buffer pools are shared through; if NULL,
+	 * the blitter creates its own pools. Set with
+	 * @gst_imx_base_blitter_set_pool_registry . */
+	GstImxPhysMemPoolRegistry *pool_registry;
+
 	/* Internal buffer pool and video frame for temporary storage
 	 * of frames in a DMA buffer. This is needed if upstream delivers
 	 * frames in buffers which are not physically contiguous. Since
@@ -107,11 +151,19 @@ struct _GstImxBaseBlitter
 	 * to the derived blitter. If upstream delivers DMA buffers, then
 	 * these are passed on directly, since they by definition are
 	 * physically contiguous.
-	 * This buffer pool is created internally by using
-	 * @gst_imx_base_blitter_create_bufferpool . */
+	 * This buffer pool is acquired internally by using
+	 * @gst_imx_base_blitter_acquire_bufferpool . */
 	GstBufferPool *internal_bufferpool;
 	GstBuffer *internal_input_frame;
 
+	/* Number of input frames that had to be copied to an internal
+	 * input frame because they were not physically contiguous */
+	guint64 num_input_frame_copies;
+
+	/* The frame that was last passed to @set_input_frame (either the
+	 * input buffer itself or internal_input_frame). Not ref'd. */
+	GstBuffer *current_input_frame;
+
 	/* Internal copy of the latest video info for the incoming video data. */
 	GstVideoInfo input_video_info;
 
@@ -124,6 +176,29 @@ struct _GstImxBaseBlitter
 	GstImxBaseBlitterRegion full_input_region, visible_input_region, output_buffer_region, full_video_region, visible_video_region;
 	gboolean visible_input_region_uptodate;
 	GstImxBaseBlitterVisibilityType video_visibility_type, output_visibility_type;
+
+	/* Visible portion of the output region from the last
+	 * @gst_imx_base_blitter_set_output_regions call. Only valid if
+	 * output_regions_set is TRUE; otherwise, the entire output buffer
+	 * is the output and video region. */
+	GstImxBaseBlitterRegion visible_output_region;
+	gboolean output_regions_set;
+
+	/* The buffer that was last passed to @set_output_frame. Not ref'd. */
+	GstBuffer *current_output_frame;
+
+	/* Maximum width and height a single blit operation may have in the input
+	 * and the output frame. Blits which exceed this are split into tiles.
+	 * 0 means there is no limit. Set with @gst_imx_base_blitter_set_max_blit_size . */
+	gint max_blit_width, max_blit_height;
+
+	/* Buffer pool for the scratch frames tiles are blitted into before they
+	 * are stitched into the output frame, and the video info of these frames */
+	GstBufferPool *tile_bufferpool;
+	GstVideoInfo tile_video_info;
+
+	/* Number of blits that had to be split into tiles */
+	guint64 num_tiled_blits;
 };
 
 
@@ -177,6 +252,50 @@ struct _GstImxBaseBlitter
  * @flush:                  Optional.
  *                          Flushes any internal cached or temporary states, buffers etc.
  *                          Returns TRUE if it successfully completed, FALSE otherwise.
+ * @submit_blit:            Optional.
+ *                          Like @blit_frame, except that it only starts the blit operation,
+ *                          and returns without waiting for it to finish. An opaque non-NULL
+ *                          handle identifying the operation must be written to "handle".
+ *                          The input & output frames must not be modified by anybody else
+ *                          until @wait_blit was called with this handle. (The base class
+ *                          keeps the input frame alive until then.)
+ *                          If this is NULL, @blit_frame is used instead, and the blit is
+ *                          performed synchronously.
+ *                          Returns TRUE if it successfully completed, FALSE otherwise.
+ * @wait_blit:              Required if @submit_blit is set.
+ *                          Waits until the blit operation identified by "handle" is finished.
+ *                          Handles are always waited for in the order they were submitted.
+ *                          Returns TRUE if it successfully completed, FALSE otherwise.
+ * @set_input_alpha:        Optional.
+ *                          Sets the alpha value the input frame is blended over the output
+ *                          frame with. 255 means the input frame is opaque, and replaces the
+ *                          output pixels; this is the default. If this is NULL, frames are
+ *                          always blitted opaque.
+ *                          Returns TRUE if it successfully completed, FALSE otherwise.
+ * @fill_region:            Optional.
+ *                          Fills the given region of the output frame with a color (in
+ *                          0xRRGGBB format). The fill is finished when this returns.
+ *                          Returns TRUE if it successfully completed, FALSE otherwise.
+ * @blit_batch:             Optional.
+ *                          Performs all blits of a batch, preferably in one engine operation.
+ *                          The base class prepares the entries: their input buffers are
+ *                          physically contiguous, their output regions are clipped to the
+ *                          output frame (with the input regions adjusted accordingly), and
+ *                          entries which are not visible at all are removed. The blits must
+ *                          be finished when this returns.
+ *                          If this is NULL, the base class performs the entries one by one.
+ *                          Returns TRUE if it successfully completed, FALSE otherwise.
+ * @accepts_system_memory:  If TRUE, the blitter accesses the frames with the CPU (or forwards
+ *                          them to other blitters which copy them as needed), so input buffers
+ *                          are passed to @set_input_frame directly even if they are not
+ *                          physically contiguous. Default value is FALSE.
+ * @horiz_alignment:        Horizontal alignment (in pixels, a power of two) the blitter needs
+ *                          its input frames to have. Elements publish this upstream in
+ *                          allocation queries (see phys_mem_buffer_pool.h). Default value is
+ *                          GST_IMX_PHYS_MEM_BUFFER_POOL_DEFAULT_HORIZ_ALIGNMENT.
+ * @vert_alignment:         Vertical alignment (in rows, a power of two) the blitter needs its
+ *                          input frames to have. Default value is
+ *                          GST_IMX_PHYS_MEM_BUFFER_POOL_DEFAULT_VERT_ALIGNMENT.
  */
 struct _GstImxBaseBlitterClass
 {
@@ -189,6 +308,14 @@ struct _GstImxBaseBlitterClass
 	GstAllocator* (*get_phys_mem_allocator)(GstImxBaseBlitter *base_blitter);
 	gboolean (*blit_frame)(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *input_region);
 	gboolean (*flush)(GstImxBaseBlitter *base_blitter);
+	gboolean (*submit_blit)(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *input_region, gpointer *handle);
+	gboolean (*wait_blit)(GstImxBaseBlitter *base_blitter, gpointer handle);
+	gboolean (*set_input_alpha)(GstImxBaseBlitter *base_blitter, guint8 alpha);
+	gboolean (*fill_region)(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *region, guint32 color);
+	gboolean (*blit_batch)(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterBatchEntry const *entries, guint num_entries);
+
+	gboolean accepts_system_memory;
+	guint horiz_alignment, vert_alignment;
 };
 
 
@@ -265,6 +392,84 @@ gboolean gst_imx_base_blitter_set_input_video_info(GstImxBaseBlitter *base_blitt
  */
 gboolean gst_imx_base_blitter_blit(GstImxBaseBlitter *base_blitter);
 
+/* Starts the blit operation without waiting for it to finish.
+ *
+ * Returns a fence which must be passed to @gst_imx_base_blitter_wait later.
+ * Once this function returns, the next frame can be set up with the input/output
+ * buffer & region functions and submitted, even if the operation is still running.
+ * The input buffer is kept alive by the fence; the output buffer must not be
+ * accessed until the fence was waited for.
+ * If the blitter does not implement @submit_blit, the blit is performed
+ * synchronously, and the returned fence is already signaled.
+ * Returns NULL if an error occurred.
+ */
+GstImxBaseBlitterFence* gst_imx_base_blitter_submit(GstImxBaseBlitter *base_blitter);
+
+/* Waits until the blit operation associated with the fence is finished, and frees the fence.
+ *
+ * Fences must be waited for in the order they were returned by @gst_imx_base_blitter_submit.
+ * Returns TRUE if the blit operation finished successfully, FALSE otherwise.
+ */
+gboolean gst_imx_base_blitter_wait(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterFence *fence);
+
+/* Sets the maximum size of a single blit operation.
+ *
+ * Derived blitters call this if their engine cannot process frames beyond a
+ * certain size in one operation. @gst_imx_base_blitter_blit and
+ * @gst_imx_base_blitter_submit then split blits whose input or video region
+ * is larger than max_width x max_height into tiles. Each tile is blitted
+ * into a scratch frame together with a border of neighbouring input pixels,
+ * so the engine's scaling filter sees the same pixels it would see without
+ * tiling. The inner part of each tile is then copied into the output frame
+ * with an unscaled blit, which avoids visible seams between tiles. If the
+ * blitter implements @submit_blit, the tiles are submitted in parallel.
+ * The tiles at the edges of the video region also fill the empty regions
+ * next to them, so their output regions can exceed the maximum size; derived
+ * blitters must still be able to fill such output regions. Only set a
+ * maximum size which the engine cannot exceed, since tiling costs extra
+ * memory bandwidth.
+ *
+ * Tiling requires @set_output_regions, and assumes that the blit does not
+ * rotate or flip frames; blitters must disable tiling (by passing 0 as
+ * max_width and max_height) while they do so.
+ */
+void gst_imx_base_blitter_set_max_blit_size(GstImxBaseBlitter *base_blitter, gint max_width, gint max_height);
+
+/* Sets the alpha value subsequent blits blend the input frame over the output frame with.
+ * 255 means opaque (no blending).
+ * Returns FALSE if the blitter does not support blending and alpha is not 255, or if
+ * an error occurred, TRUE otherwise.
+ */
+gboolean gst_imx_base_blitter_set_input_alpha(GstImxBaseBlitter *base_blitter, guint8 alpha);
+
+/* Returns TRUE if the blitter implements @fill_region , FALSE otherwise. */
+gboolean gst_imx_base_blitter_can_fill_regions(GstImxBaseBlitter *base_blitter);
+
+/* Fills a region of the output frame (which must have been set with
+ * @gst_imx_base_blitter_set_output_buffer) with the given 0xRRGGBB color.
+ * Returns FALSE if the blitter does not support fills or an error occurred, TRUE otherwise.
+ */
+gboolean gst_imx_base_blitter_fill_region(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *region, guint32 color);
+
+/* Blits a batch of input buffers into the current output buffer.
+ *
+ * This is meant for many small blits per output frame (overlays, for example),
+ * which would otherwise each need their own set_input_buffer / set_output_regions /
+ * blit sequence. The output buffer must have been set with
+ * @gst_imx_base_blitter_set_output_buffer . Input buffers which are not physically
+ * contiguous are copied first; for this, they must match the input video info.
+ *
+ * If the blitter implements @blit_batch (and has no maximum blit size), the batch
+ * is passed to it. Otherwise, the entries are blitted one after the other; in that
+ * case, entries can only be rotated if the blitter implements @blit_batch, and
+ * blended if it implements @set_input_alpha .
+ *
+ * Afterwards, the input buffer and the output regions have to be set again before
+ * the next regular blit. The input alpha value is reset to 255.
+ * Returns TRUE if all entries were blitted successfully, FALSE otherwise.
+ */
+gboolean gst_imx_base_blitter_blit_batch(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterBatchEntry const *entries, guint num_entries);
+
 /* Flush any temporary and/or cached data in the blitter.
  *
  * Return TRUE is @flush completed successfully (or if @flush is NULL), FALSE otherwise.
@@ -278,12 +483,32 @@ gboolean gst_imx_base_blitter_flush(GstImxBaseBlitter *base_blitter);
  * output buffers.
  * caps, size, min_buffers, max_buffers are passed to @gst_buffer_pool_config_set_params.
  * If allocator is NULL, an allocator is created, by using the class' @get_phys_mem_allocator
- * function.
+ * function. cache_policy is stored in the pool's config (see phys_mem_buffer_pool.h).
+ * The pool is created in elastic mode: if max_buffers is 0, it grows up to an
+ * internal cap, and buffers that stay idle for a while are freed again, down to
+ * min_buffers.
  * Returns the newly created buffer pool. As with other buffer pools, use @gst_object_unref
  * to unref the buffer when it is no longer needed. At refcount 0, all of its memory is freed.
  * If creating the buffer pool failed, it returns NULL.
  */
-GstBufferPool* gst_imx_base_blitter_create_bufferpool(GstImxBaseBlitter *base_blitter, GstCaps *caps, guint size, guint min_buffers, guint max_buffers, GstAllocator *allocator, GstAllocationParams *alloc_params);
+GstBufferPool* gst_imx_base_blitter_create_bufferpool(GstImxBaseBlitter *base_blitter, GstCaps *caps, guint size, guint min_buffers, guint max_buffers, GstAllocator *allocator, GstAllocationParams *alloc_params, GstImxPhysMemCachePolicy cache_policy);
+
+/* Acquires an active buffer pool for internal use, such as intermediate frames.
+ *
+ * If a pool registry was set with @gst_imx_base_blitter_set_pool_registry , the pool
+ * is shared with other users of the registry that need identical buffers; max_buffers
+ * is then ignored, and min_buffers is only used if the pool does not exist yet.
+ * Otherwise, a new pool is created with @gst_imx_base_blitter_create_bufferpool and
+ * activated. The pool must not be reconfigured or deactivated by the caller; release
+ * it with @gst_imx_base_blitter_release_bufferpool instead.
+ * Returns NULL if the pool could not be created or activated.
+ */
+GstBufferPool* gst_imx_base_blitter_acquire_bufferpool(GstImxBaseBlitter *base_blitter, GstCaps *caps, guint size, guint min_buffers, guint max_buffers, GstImxPhysMemCachePolicy cache_policy);
+/* Releases and unrefs a pool acquired with @gst_imx_base_blitter_acquire_bufferpool . */
+void gst_imx_base_blitter_release_bufferpool(GstImxBaseBlitter *base_blitter, GstBufferPool *pool);
+/* Sets the registry internal buffer pools are acquired from. Must be called before
+ * the blitter acquires any pools; elements do this right after creating the blitter. */
+void gst_imx_base_blitter_set_pool_registry(GstImxBaseBlitter *base_blitter, GstImxPhysMemPoolRegistry *registry);
 
 /* Gets a new physical memory allocator from the blitter.
  *
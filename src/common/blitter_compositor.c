@@ -0,0 +1,1582 @@
+/* GStreamer base class for i.MX blitter based video compositors
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include <stdio.h>
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <gst/video/gstvideometa.h>
+
+#include "phys_mem_meta.h"
+#include "phys_mem_buffer_pool.h"
+#include "blitter_compositor.h"
+
+
+
+
+GST_DEBUG_CATEGORY_STATIC(imx_blitter_compositor_debug);
+#define GST_CAT_DEFAULT imx_blitter_compositor_debug
+
+
+enum
+{
+	PROP_0,
+	PROP_BACKGROUND_COLOR
+};
+
+enum
+{
+	PROP_PAD_0,
+	PROP_PAD_XPOS,
+	PROP_PAD_YPOS,
+	PROP_PAD_WIDTH,
+	PROP_PAD_HEIGHT,
+	PROP_PAD_ZORDER,
+	PROP_PAD_ALPHA
+};
+
+#define DEFAULT_BACKGROUND_COLOR 0x000000
+#define DEFAULT_PAD_XPOS 0
+#define DEFAULT_PAD_YPOS 0
+#define DEFAULT_PAD_WIDTH 0
+#define DEFAULT_PAD_HEIGHT 0
+#define DEFAULT_PAD_ZORDER 0
+#define DEFAULT_PAD_ALPHA 1.0
+
+
+/* Snapshot of a sink pad's states, taken for each output frame, so the
+ * pad properties can be changed while the frame is being composited */
+typedef struct
+{
+	GstImxBlitterCompositorPad *pad;
+	GstImxBaseBlitterRegion region;
+	guint zorder;
+	guint8 alpha;
+	gboolean redraw;
+}
+GstImxBlitterCompositorInput;
+
+
+G_DEFINE_TYPE(GstImxBlitterCompositorPad, gst_imx_blitter_compositor_pad, GST_TYPE_PAD)
+G_DEFINE_ABSTRACT_TYPE(GstImxBlitterCompositor, gst_imx_blitter_compositor, GST_TYPE_ELEMENT)
+
+
+static void gst_imx_blitter_compositor_pad_finalize(GObject *object);
+static void gst_imx_blitter_compositor_pad_set_property(GObject *object, guint prop_id, GValue const *value, GParamSpec *pspec);
+static void gst_imx_blitter_compositor_pad_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec);
+
+static void gst_imx_blitter_compositor_finalize(GObject *object);
+static void gst_imx_blitter_compositor_set_property(GObject *object, guint prop_id, GValue const *value, GParamSpec *pspec);
+static void gst_imx_blitter_compositor_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec);
+static GstStateChangeReturn gst_imx_blitter_compositor_change_state(GstElement *element, GstStateChange transition);
+static void gst_imx_blitter_compositor_set_context(GstElement *element, GstContext *context);
+static GstPad* gst_imx_blitter_compositor_request_new_pad(GstElement *element, GstPadTemplate *templ, gchar const *name, GstCaps const *caps);
+static void gst_imx_blitter_compositor_release_pad(GstElement *element, GstPad *pad);
+
+static gboolean gst_imx_blitter_compositor_sink_event(GstCollectPads *pads, GstCollectData *collect_data, GstEvent *event, gpointer user_data);
+static gboolean gst_imx_blitter_compositor_sink_query(GstPad *pad, GstObject *parent, GstQuery *query);
+static gboolean gst_imx_blitter_compositor_src_query(GstPad *pad, GstObject *parent, GstQuery *query);
+static gboolean gst_imx_blitter_compositor_query_caps(GstPad *pad, GstQuery *query);
+static gboolean gst_imx_blitter_compositor_propose_allocation(GstImxBlitterCompositor *blitter_compositor, GstQuery *query);
+static GstFlowReturn gst_imx_blitter_compositor_collected(GstCollectPads *pads, gpointer user_data);
+
+static void gst_imx_blitter_compositor_update_live_state(GstImxBlitterCompositor *blitter_compositor, GstCollectPads *pads, GstCollectData *collect_data);
+static GstClockTime gst_imx_blitter_compositor_get_running_time(GstCollectData *collect_data, GstBuffer *buffer);
+static gboolean gst_imx_blitter_compositor_update_output_caps(GstImxBlitterCompositor *blitter_compositor);
+static GArray* gst_imx_blitter_compositor_get_inputs(GstImxBlitterCompositor *blitter_compositor, GstCollectPads *pads, guint64 output_frame_generation);
+static gint gst_imx_blitter_compositor_compare_inputs(gconstpointer first, gconstpointer second);
+static gboolean gst_imx_blitter_compositor_do_regions_intersect(GstImxBaseBlitterRegion const *first_region, GstImxBaseBlitterRegion const *second_region);
+static void gst_imx_blitter_compositor_subtract_region(GstImxBlitterCompositor *blitter_compositor, GArray *regions, GArray *remaining, GstImxBaseBlitterRegion const *region);
+static gboolean gst_imx_blitter_compositor_fill_background(GstImxBlitterCompositor *blitter_compositor, GArray *inputs);
+static gboolean gst_imx_blitter_compositor_blit_input(GstImxBlitterCompositor *blitter_compositor, GstImxBlitterCompositorInput *input, gboolean clear_around);
+static GstFlowReturn gst_imx_blitter_compositor_compose(GstImxBlitterCompositor *blitter_compositor, GstCollectPads *pads, GstBuffer **output_buffer);
+static GstFlowReturn gst_imx_blitter_compositor_acquire_output_frame(GstImxBlitterCompositor *blitter_compositor, GstBuffer **output_buffer, GstImxBlitterCompositorOutputFrame **output_frame);
+static void gst_imx_blitter_compositor_invalidate_output_frames(GstImxBlitterCompositor *blitter_compositor);
+static void gst_imx_blitter_compositor_release_output_pool(GstImxBlitterCompositor *blitter_compositor);
+
+
+
+
+/* functions declared by G_DEFINE_TYPE */
+
+void gst_imx_blitter_compositor_pad_class_init(GstImxBlitterCompositorPadClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS(klass);
+
+	object_class->finalize     = GST_DEBUG_FUNCPTR(gst_imx_blitter_compositor_pad_finalize);
+	object_class->set_property = GST_DEBUG_FUNCPTR(gst_imx_blitter_compositor_pad_set_property);
+	object_class->get_property = GST_DEBUG_FUNCPTR(gst_imx_blitter_compositor_pad_get_property);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_PAD_XPOS,
+		g_param_spec_int(
+			"xpos",
+			"X position",
+			"X coordinate of the frame's top left corner in the output, in pixels",
+			G_MININT, G_MAXINT,
+			DEFAULT_PAD_XPOS,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
+		)
+	);
+	g_object_class_install_property(
+		object_class,
+		PROP_PAD_YPOS,
+		g_param_spec_int(
+			"ypos",
+			"Y position",
+			"Y coordinate of the frame's top left corner in the output, in pixels",
+			G_MININT, G_MAXINT,
+			DEFAULT_PAD_YPOS,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
+		)
+	);
+	g_object_class_install_property(
+		object_class,
+		PROP_PAD_WIDTH,
+		g_param_spec_uint(
+			"width",
+			"Width",
+			"Width of the frame in the output, in pixels (0 = use the input width)",
+			0, G_MAXINT,
+			DEFAULT_PAD_WIDTH,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
+		)
+	);
+	g_object_class_install_property(
+		object_class,
+		PROP_PAD_HEIGHT,
+		g_param_spec_uint(
+			"height",
+			"Height",
+			"Height of the frame in the output, in pixels (0 = use the input height)",
+			0, G_MAXINT,
+			DEFAULT_PAD_HEIGHT,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
+		)
+	);
+	g_object_class_install_property(
+		object_class,
+		PROP_PAD_ZORDER,
+		g_param_spec_uint(
+			"zorder",
+			"Z-order",
+			"Z-order of the frame; frames with higher values are drawn over frames with lower ones",
+			0, G_MAXUINT,
+			DEFAULT_PAD_ZORDER,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
+		)
+	);
+	g_object_class_install_property(
+		object_class,
+		PROP_PAD_ALPHA,
+		g_param_spec_double(
+			"alpha",
+			"Alpha",
+			"Alpha value the frame is blended over the frames below with (1.0 = opaque)",
+			0.0, 1.0,
+			DEFAULT_PAD_ALPHA,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
+		)
+	);
+}
+
+
+void gst_imx_blitter_compositor_pad_init(GstImxBlitterCompositorPad *compositor_pad)
+{
+	compositor_pad->collect_data = NULL;
+	compositor_pad->xpos = DEFAULT_PAD_XPOS;
+	compositor_pad->ypos = DEFAULT_PAD_YPOS;
+	compositor_pad->width = DEFAULT_PAD_WIDTH;
+	compositor_pad->height = DEFAULT_PAD_HEIGHT;
+	compositor_pad->zorder = DEFAULT_PAD_ZORDER;
+	compositor_pad->alpha = DEFAULT_PAD_ALPHA;
+	compositor_pad->geometry_changed = TRUE;
+
+	gst_video_info_init(&(compositor_pad->video_info));
+	compositor_pad->video_info_set = FALSE;
+
+	compositor_pad->current_frame = NULL;
+	compositor_pad->frame_generation = 0;
+}
+
+
+void gst_imx_blitter_compositor_class_init(GstImxBlitterCompositorClass *klass)
+{
+	GObjectClass *object_class;
+	GstElementClass *element_class;
+
+	GST_DEBUG_CATEGORY_INIT(imx_blitter_compositor_debug, "imxblittercompositor", 0, "Freescale i.MX blitter compositor base class");
+
+	object_class = G_OBJECT_CLASS(klass);
+	element_class = GST_ELEMENT_CLASS(klass);
+
+	object_class->finalize          = GST_DEBUG_FUNCPTR(gst_imx_blitter_compositor_finalize);
+	object_class->set_property      = GST_DEBUG_FUNCPTR(gst_imx_blitter_compositor_set_property);
+	object_class->get_property      = GST_DEBUG_FUNCPTR(gst_imx_blitter_compositor_get_property);
+	element_class->change_state     = GST_DEBUG_FUNCPTR(gst_imx_blitter_compositor_change_state);
+	element_class->set_context      = GST_DEBUG_FUNCPTR(gst_imx_blitter_compositor_set_context);
+	element_class->request_new_pad  = GST_DEBUG_FUNCPTR(gst_imx_blitter_compositor_request_new_pad);
+	element_class->release_pad      = GST_DEBUG_FUNCPTR(gst_imx_blitter_compositor_release_pad);
+
+	klass->start = NULL;
+	klass->stop  = NULL;
+
+	g_object_class_install_property(
+		object_class,
+		PROP_BACKGROUND_COLOR,
+		g_param_spec_uint(
+			"background-color",
+			"Background color",
+			"Color of the output regions not covered by any frame, in 0xRRGGBB format",
+			0, 0xFFFFFF,
+			DEFAULT_BACKGROUND_COLOR,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
+		)
+	);
+}
+
+
+void gst_imx_blitter_compositor_init(GstImxBlitterCompositor *blitter_compositor)
+{
+	GstPadTemplate *src_template = gst_element_class_get_pad_template(GST_ELEMENT_GET_CLASS(blitter_compositor), "src");
+	g_assert(src_template != NULL);
+
+	blitter_compositor->srcpad = gst_pad_new_from_template(src_template, "src");
+	gst_pad_set_query_function(blitter_compositor->srcpad, GST_DEBUG_FUNCPTR(gst_imx_blitter_compositor_src_query));
+	gst_pad_use_fixed_caps(blitter_compositor->srcpad);
+	gst_element_add_pad(GST_ELEMENT(blitter_compositor), blitter_compositor->srcpad);
+
+	blitter_compositor->collect = gst_collect_pads_new();
+	gst_collect_pads_set_function(blitter_compositor->collect, GST_DEBUG_FUNCPTR(gst_imx_blitter_compositor_collected), blitter_compositor);
+	gst_collect_pads_set_event_function(blitter_compositor->collect, GST_DEBUG_FUNCPTR(gst_imx_blitter_compositor_sink_event), blitter_compositor);
+
+	blitter_compositor->initialized = FALSE;
+	blitter_compositor->blitter = NULL;
+	blitter_compositor->pool_registry = NULL;
+	blitter_compositor->next_pad_index = 0;
+	blitter_compositor->background_color = DEFAULT_BACKGROUND_COLOR;
+
+	gst_video_info_init(&(blitter_compositor->output_video_info));
+	blitter_compositor->output_caps_set = FALSE;
+	blitter_compositor->requested_width = 0;
+	blitter_compositor->requested_height = 0;
+	blitter_compositor->requested_fps_n = 0;
+	blitter_compositor->requested_fps_d = 1;
+	blitter_compositor->stream_start_sent = FALSE;
+	blitter_compositor->segment_sent = FALSE;
+
+	blitter_compositor->output_pool = NULL;
+	blitter_compositor->num_output_frames_tracked = 0;
+	blitter_compositor->output_generation = 0;
+	blitter_compositor->min_valid_generation = 1;
+
+	blitter_compositor->live = FALSE;
+	blitter_compositor->last_output_time = GST_CLOCK_TIME_NONE;
+
+	blitter_compositor->last_input_pad = NULL;
+	blitter_compositor->last_input_info_set = FALSE;
+	blitter_compositor->alpha_warning_shown = FALSE;
+
+	blitter_compositor->num_output_frames = 0;
+	blitter_compositor->num_pad_blits = 0;
+	blitter_compositor->num_skipped_pad_blits = 0;
+	blitter_compositor->num_reused_output_frames = 0;
+
+	g_mutex_init(&(blitter_compositor->mutex));
+}
+
+
+
+/* pad functions */
+
+static void gst_imx_blitter_compositor_pad_finalize(GObject *object)
+{
+	GstImxBlitterCompositorPad *compositor_pad = GST_IMX_BLITTER_COMPOSITOR_PAD(object);
+
+	if (compositor_pad->current_frame != NULL)
+		gst_buffer_unref(compositor_pad->current_frame);
+
+	G_OBJECT_CLASS(gst_imx_blitter_compositor_pad_parent_class)->finalize(object);
+}
+
+
+static void gst_imx_blitter_compositor_pad_set_property(GObject *object, guint prop_id, GValue const *value, GParamSpec *pspec)
+{
+	GstImxBlitterCompositorPad *compositor_pad = GST_IMX_BLITTER_COMPOSITOR_PAD(object);
+
+	GST_OBJECT_LOCK(compositor_pad);
+
+	switch (prop_id)
+	{
+		case PROP_PAD_XPOS:
+			compositor_pad->xpos = g_value_get_int(value);
+			break;
+
+		case PROP_PAD_YPOS:
+			compositor_pad->ypos = g_value_get_int(value);
+			break;
+
+		case PROP_PAD_WIDTH:
+			compositor_pad->width = g_value_get_uint(value);
+			break;
+
+		case PROP_PAD_HEIGHT:
+			compositor_pad->height = g_value_get_uint(value);
+			break;
+
+		case PROP_PAD_ZORDER:
+			compositor_pad->zorder = g_value_get_uint(value);
+			break;
+
+		case PROP_PAD_ALPHA:
+			compositor_pad->alpha = g_value_get_double(value);
+			break;
+
+		default:
+			GST_OBJECT_UNLOCK(compositor_pad);
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+			return;
+	}
+
+	compositor_pad->geometry_changed = TRUE;
+
+	GST_OBJECT_UNLOCK(compositor_pad);
+}
+
+
+static void gst_imx_blitter_compositor_pad_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
+{
+	GstImxBlitterCompositorPad *compositor_pad = GST_IMX_BLITTER_COMPOSITOR_PAD(object);
+
+	switch (prop_id)
+	{
+		case PROP_PAD_XPOS:
+			GST_OBJECT_LOCK(compositor_pad);
+			g_value_set_int(value, compositor_pad->xpos);
+			GST_OBJECT_UNLOCK(compositor_pad);
+			break;
+
+		case PROP_PAD_YPOS:
+			GST_OBJECT_LOCK(compositor_pad);
+			g_value_set_int(value, compositor_pad->ypos);
+			GST_OBJECT_UNLOCK(compositor_pad);
+			break;
+
+		case PROP_PAD_WIDTH:
+			GST_OBJECT_LOCK(compositor_pad);
+			g_value_set_uint(value, compositor_pad->width);
+			GST_OBJECT_UNLOCK(compositor_pad);
+			break;
+
+		case PROP_PAD_HEIGHT:
+			GST_OBJECT_LOCK(compositor_pad);
+			g_value_set_uint(value, compositor_pad->height);
+			GST_OBJECT_UNLOCK(compositor_pad);
+			break;
+
+		case PROP_PAD_ZORDER:
+			GST_OBJECT_LOCK(compositor_pad);
+			g_value_set_uint(value, compositor_pad->zorder);
+			GST_OBJECT_UNLOCK(compositor_pad);
+			break;
+
+		case PROP_PAD_ALPHA:
+			GST_OBJECT_LOCK(compositor_pad);
+			g_value_set_double(value, compositor_pad->alpha);
+			GST_OBJECT_UNLOCK(compositor_pad);
+			break;
+
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+			break;
+	}
+}
+
+
+
+/* base class functions */
+
+static void gst_imx_blitter_compositor_finalize(GObject *object)
+{
+	GstImxBlitterCompositor *blitter_compositor = GST_IMX_BLITTER_COMPOSITOR(object);
+
+	gst_object_unref(GST_OBJECT(blitter_compositor->collect));
+
+	g_mutex_clear(&(blitter_compositor->mutex));
+
+	if (blitter_compositor->pool_registry != NULL)
+		gst_object_unref(GST_OBJECT(blitter_compositor->pool_registry));
+
+	G_OBJECT_CLASS(gst_imx_blitter_compositor_parent_class)->finalize(object);
+}
+
+
+static void gst_imx_blitter_compositor_set_context(GstElement *element, GstContext *context)
+{
+	GstImxBlitterCompositor *blitter_compositor = GST_IMX_BLITTER_COMPOSITOR(element);
+
+	gst_imx_phys_mem_pool_registry_handle_set_context(element, context, &(blitter_compositor->pool_registry));
+
+	if (GST_ELEMENT_CLASS(gst_imx_blitter_compositor_parent_class)->set_context != NULL)
+		GST_ELEMENT_CLASS(gst_imx_blitter_compositor_parent_class)->set_context(element, context);
+}
+
+
+static void gst_imx_blitter_compositor_set_property(GObject *object, guint prop_id, GValue const *value, GParamSpec *pspec)
+{
+	GstImxBlitterCompositor *blitter_compositor = GST_IMX_BLITTER_COMPOSITOR(object);
+
+	switch (prop_id)
+	{
+		case PROP_BACKGROUND_COLOR:
+			GST_IMX_BLITTER_COMPOSITOR_LOCK(blitter_compositor);
+			blitter_compositor->background_color = g_value_get_uint(value);
+			gst_imx_blitter_compositor_invalidate_output_frames(blitter_compositor);
+			GST_IMX_BLITTER_COMPOSITOR_UNLOCK(blitter_compositor);
+			break;
+
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+			break;
+	}
+}
+
+
+static void gst_imx_blitter_compositor_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
+{
+	GstImxBlitterCompositor *blitter_compositor = GST_IMX_BLITTER_COMPOSITOR(object);
+
+	switch (prop_id)
+	{
+		case PROP_BACKGROUND_COLOR:
+			GST_IMX_BLITTER_COMPOSITOR_LOCK(blitter_compositor);
+			g_value_set_uint(value, blitter_compositor->background_color);
+			GST_IMX_BLITTER_COMPOSITOR_UNLOCK(blitter_compositor);
+			break;
+
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+			break;
+	}
+}
+
+
+static GstStateChangeReturn gst_imx_blitter_compositor_change_state(GstElement *element, GstStateChange transition)
+{
+	GstImxBlitterCompositor *blitter_compositor = GST_IMX_BLITTER_COMPOSITOR(element);
+	GstImxBlitterCompositorClass *klass = GST_IMX_BLITTER_COMPOSITOR_CLASS(G_OBJECT_GET_CLASS(element));
+	GstStateChangeReturn ret = GST_STATE_CHANGE_SUCCESS;
+
+	g_assert(blitter_compositor != NULL);
+	g_assert(klass->start != NULL);
+
+	switch (transition)
+	{
+		case GST_STATE_CHANGE_NULL_TO_READY:
+		{
+			/* Done before start(), so the registry can be passed on to
+			 * the blitter in gst_imx_blitter_compositor_set_blitter() */
+			gst_imx_phys_mem_pool_registry_ensure(element, &(blitter_compositor->pool_registry));
+
+			GST_IMX_BLITTER_COMPOSITOR_LOCK(blitter_compositor);
+
+			if (!(klass->start(blitter_compositor)))
+			{
+				GST_ERROR_OBJECT(blitter_compositor, "start() failed");
+				GST_IMX_BLITTER_COMPOSITOR_UNLOCK(blitter_compositor);
+				return GST_STATE_CHANGE_FAILURE;
+			}
+
+			/* start() must call gst_imx_blitter_compositor_set_blitter(),
+			 * otherwise the compositor cannot function properly */
+			g_assert(blitter_compositor->blitter != NULL);
+
+			blitter_compositor->initialized = TRUE;
+
+			GST_IMX_BLITTER_COMPOSITOR_UNLOCK(blitter_compositor);
+
+			break;
+		}
+
+		case GST_STATE_CHANGE_READY_TO_PAUSED:
+		{
+			GST_IMX_BLITTER_COMPOSITOR_LOCK(blitter_compositor);
+			blitter_compositor->output_caps_set = FALSE;
+			blitter_compositor->stream_start_sent = FALSE;
+			blitter_compositor->segment_sent = FALSE;
+			blitter_compositor->live = FALSE;
+			blitter_compositor->last_output_time = GST_CLOCK_TIME_NONE;
+			GST_IMX_BLITTER_COMPOSITOR_UNLOCK(blitter_compositor);
+
+			gst_collect_pads_start(blitter_compositor->collect);
+			break;
+		}
+
+		case GST_STATE_CHANGE_PAUSED_TO_READY:
+		{
+			/* Stop the collect pads before the parent class deactivates
+			 * the pads, to unblock any waiting streaming threads */
+			gst_collect_pads_stop(blitter_compositor->collect);
+			break;
+		}
+
+		default:
+			break;
+	}
+
+	ret = GST_ELEMENT_CLASS(gst_imx_blitter_compositor_parent_class)->change_state(element, transition);
+	if (ret == GST_STATE_CHANGE_FAILURE)
+		return ret;
+
+	switch (transition)
+	{
+		case GST_STATE_CHANGE_PAUSED_TO_READY:
+		{
+			GST_IMX_BLITTER_COMPOSITOR_LOCK(blitter_compositor);
+
+			if (blitter_compositor->num_output_frames > 0)
+			{
+				GST_DEBUG_OBJECT(
+					blitter_compositor,
+					"output frames: %" G_GUINT64_FORMAT "  input frame blits: %" G_GUINT64_FORMAT "  blits skipped because frames did not change: %" G_GUINT64_FORMAT "  reused output frames: %" G_GUINT64_FORMAT,
+					blitter_compositor->num_output_frames,
+					blitter_compositor->num_pad_blits,
+					blitter_compositor->num_skipped_pad_blits,
+					blitter_compositor->num_reused_output_frames
+				);
+			}
+
+			gst_imx_blitter_compositor_release_output_pool(blitter_compositor);
+			blitter_compositor->last_input_pad = NULL;
+			blitter_compositor->last_input_info_set = FALSE;
+
+			GST_IMX_BLITTER_COMPOSITOR_UNLOCK(blitter_compositor);
+
+			break;
+		}
+
+		case GST_STATE_CHANGE_READY_TO_NULL:
+		{
+			GST_IMX_BLITTER_COMPOSITOR_LOCK(blitter_compositor);
+
+			blitter_compositor->initialized = FALSE;
+
+			if ((klass->stop != NULL) && !(klass->stop(blitter_compositor)))
+				GST_ERROR_OBJECT(blitter_compositor, "stop() failed");
+
+			GST_IMX_BLITTER_COMPOSITOR_UNLOCK(blitter_compositor);
+
+			if (blitter_compositor->blitter != NULL)
+			{
+				gst_object_unref(GST_OBJECT(blitter_compositor->blitter));
+				blitter_compositor->blitter = NULL;
+			}
+
+			break;
+		}
+
+		default:
+			break;
+	}
+
+	return ret;
+}
+
+
+static GstPad* gst_imx_blitter_compositor_request_new_pad(GstElement *element, GstPadTemplate *templ, gchar const *name, G_GNUC_UNUSED GstCaps const *caps)
+{
+	GstImxBlitterCompositor *blitter_compositor = GST_IMX_BLITTER_COMPOSITOR(element);
+	GstImxBlitterCompositorPad *compositor_pad;
+	gchar *pad_name;
+	guint index;
+
+	if ((templ->direction != GST_PAD_SINK) || (templ->presence != GST_PAD_REQUEST))
+	{
+		GST_WARNING_OBJECT(blitter_compositor, "requested pad is not a sink request pad");
+		return NULL;
+	}
+
+	GST_IMX_BLITTER_COMPOSITOR_LOCK(blitter_compositor);
+
+	/* Use the index from the requested name if there is one, and
+	 * make sure pads requested without a name do not reuse it */
+	if ((name != NULL) && (sscanf(name, "sink_%u", &index) == 1))
+		blitter_compositor->next_pad_index = MAX(blitter_compositor->next_pad_index, index + 1);
+	else
+		index = blitter_compositor->next_pad_index++;
+
+	pad_name = g_strdup_printf("sink_%u", index);
+	compositor_pad = g_object_new(
+		GST_TYPE_IMX_BLITTER_COMPOSITOR_PAD,
+		"name", pad_name,
+		"direction", templ->direction,
+		"template", templ,
+		NULL
+	);
+	g_free(pad_name);
+
+	/* By default, pads requested later are drawn over earlier ones */
+	compositor_pad->zorder = index;
+
+	/* The waiting state is not locked, since live pads are switched to non-waiting */
+	compositor_pad->collect_data = gst_collect_pads_add_pad(blitter_compositor->collect, GST_PAD(compositor_pad), sizeof(GstCollectData), NULL, FALSE);
+
+	/* The collect pads do not handle queries; allocation queries are
+	 * answered by the compositor, to propose physical memory buffers */
+	gst_pad_set_query_function(GST_PAD(compositor_pad), GST_DEBUG_FUNCPTR(gst_imx_blitter_compositor_sink_query));
+
+	/* The new pad's frames have to be drawn; redraw everything, since the
+	 * output size may change */
+	gst_imx_blitter_compositor_invalidate_output_frames(blitter_compositor);
+
+	GST_IMX_BLITTER_COMPOSITOR_UNLOCK(blitter_compositor);
+
+	GST_DEBUG_OBJECT(blitter_compositor, "created new sink pad %s", GST_PAD_NAME(compositor_pad));
+
+	gst_element_add_pad(element, GST_PAD(compositor_pad));
+
+	return GST_PAD(compositor_pad);
+}
+
+
+static void gst_imx_blitter_compositor_release_pad(GstElement *element, GstPad *pad)
+{
+	GstImxBlitterCompositor *blitter_compositor = GST_IMX_BLITTER_COMPOSITOR(element);
+
+	GST_DEBUG_OBJECT(blitter_compositor, "releasing sink pad %s", GST_PAD_NAME(pad));
+
+	GST_IMX_BLITTER_COMPOSITOR_LOCK(blitter_compositor);
+
+	if (blitter_compositor->last_input_pad == GST_IMX_BLITTER_COMPOSITOR_PAD(pad))
+	{
+		blitter_compositor->last_input_pad = NULL;
+		blitter_compositor->last_input_info_set = FALSE;
+	}
+
+	/* The region previously covered by the pad's frames must be cleared */
+	gst_imx_blitter_compositor_invalidate_output_frames(blitter_compositor);
+
+	GST_IMX_BLITTER_COMPOSITOR_UNLOCK(blitter_compositor);
+
+	gst_collect_pads_remove_pad(blitter_compositor->collect, pad);
+	gst_element_remove_pad(element, pad);
+}
+
+
+static gboolean gst_imx_blitter_compositor_sink_event(GstCollectPads *pads, GstCollectData *collect_data, GstEvent *event, gpointer user_data)
+{
+	GstImxBlitterCompositor *blitter_compositor = GST_IMX_BLITTER_COMPOSITOR(user_data);
+	GstImxBlitterCompositorPad *compositor_pad = GST_IMX_BLITTER_COMPOSITOR_PAD(collect_data->pad);
+
+	switch (GST_EVENT_TYPE(event))
+	{
+		case GST_EVENT_CAPS:
+		{
+			GstCaps *caps;
+			GstVideoInfo video_info;
+
+			gst_event_parse_caps(event, &caps);
+
+			gst_video_info_init(&video_info);
+			if (!gst_video_info_from_caps(&video_info, caps))
+			{
+				GST_ERROR_OBJECT(compositor_pad, "could not get video info from caps %" GST_PTR_FORMAT, (gpointer)caps);
+				gst_event_unref(event);
+				return FALSE;
+			}
+
+			GST_DEBUG_OBJECT(compositor_pad, "new caps %" GST_PTR_FORMAT, (gpointer)caps);
+
+			GST_IMX_BLITTER_COMPOSITOR_LOCK(blitter_compositor);
+
+			compositor_pad->video_info = video_info;
+			compositor_pad->video_info_set = TRUE;
+
+			/* The current frame no longer matches the video info */
+			if (compositor_pad->current_frame != NULL)
+			{
+				gst_buffer_unref(compositor_pad->current_frame);
+				compositor_pad->current_frame = NULL;
+			}
+
+			if (blitter_compositor->last_input_pad == compositor_pad)
+				blitter_compositor->last_input_info_set = FALSE;
+
+			gst_imx_blitter_compositor_invalidate_output_frames(blitter_compositor);
+
+			GST_IMX_BLITTER_COMPOSITOR_UNLOCK(blitter_compositor);
+
+			gst_imx_blitter_compositor_update_live_state(blitter_compositor, pads, collect_data);
+
+			/* The output caps are set by the compositor itself, so discard the event */
+			return gst_collect_pads_event_default(pads, collect_data, event, TRUE);
+		}
+
+		case GST_EVENT_FLUSH_STOP:
+		{
+			GST_IMX_BLITTER_COMPOSITOR_LOCK(blitter_compositor);
+			if ((blitter_compositor->blitter != NULL) && !gst_imx_base_blitter_flush(blitter_compositor->blitter))
+				GST_WARNING_OBJECT(blitter_compositor, "could not flush blitter");
+			GST_IMX_BLITTER_COMPOSITOR_UNLOCK(blitter_compositor);
+			break;
+		}
+
+		default:
+			break;
+	}
+
+	return gst_collect_pads_event_default(pads, collect_data, event, FALSE);
+}
+
+
+static gboolean gst_imx_blitter_compositor_sink_query(GstPad *pad, GstObject *parent, GstQuery *query)
+{
+	GstImxBlitterCompositor *blitter_compositor = GST_IMX_BLITTER_COMPOSITOR(parent);
+
+	switch (GST_QUERY_TYPE(query))
+	{
+		case GST_QUERY_CAPS:
+			return gst_imx_blitter_compositor_query_caps(pad, query);
+
+		case GST_QUERY_ALLOCATION:
+			return gst_imx_blitter_compositor_propose_allocation(blitter_compositor, query);
+
+		case GST_QUERY_CONTEXT:
+			if (gst_imx_phys_mem_pool_registry_handle_context_query(GST_ELEMENT(blitter_compositor), query, &(blitter_compositor->pool_registry)))
+				return TRUE;
+			return gst_pad_query_default(pad, parent, query);
+
+		default:
+			return gst_pad_query_default(pad, parent, query);
+	}
+}
+
+
+static gboolean gst_imx_blitter_compositor_src_query(GstPad *pad, GstObject *parent, GstQuery *query)
+{
+	GstImxBlitterCompositor *blitter_compositor = GST_IMX_BLITTER_COMPOSITOR(parent);
+
+	switch (GST_QUERY_TYPE(query))
+	{
+		case GST_QUERY_CAPS:
+			return gst_imx_blitter_compositor_query_caps(pad, query);
+
+		case GST_QUERY_CONTEXT:
+			if (gst_imx_phys_mem_pool_registry_handle_context_query(GST_ELEMENT(blitter_compositor), query, &(blitter_compositor->pool_registry)))
+				return TRUE;
+			return gst_pad_query_default(pad, parent, query);
+
+		default:
+			return gst_pad_query_default(pad, parent, query);
+	}
+}
+
+
+static gboolean gst_imx_blitter_compositor_query_caps(GstPad *pad, GstQuery *query)
+{
+	/* The blitter can convert between any of the formats in the templates,
+	 * and the frames can be placed anywhere in the output, so the template
+	 * caps are always valid, regardless of what the other pads use */
+
+	GstCaps *filter, *caps;
+
+	gst_query_parse_caps(query, &filter);
+
+	caps = gst_pad_get_pad_template_caps(pad);
+	if (filter != NULL)
+	{
+		GstCaps *intersection = gst_caps_intersect_full(filter, caps, GST_CAPS_INTERSECT_FIRST);
+		gst_caps_unref(caps);
+		caps = intersection;
+	}
+
+	gst_query_set_caps_result(query, caps);
+	gst_caps_unref(caps);
+
+	return TRUE;
+}
+
+
+static gboolean gst_imx_blitter_compositor_propose_allocation(GstImxBlitterCompositor *blitter_compositor, GstQuery *query)
+{
+	GstCaps *caps;
+	GstVideoInfo info;
+	gboolean need_pool;
+	GstAllocator *allocator;
+	GstImxBaseBlitterClass *blitter_klass;
+
+	gst_query_parse_allocation(query, &caps, &need_pool);
+
+	if (caps == NULL)
+	{
+		GST_DEBUG_OBJECT(blitter_compositor, "no caps specified");
+		return FALSE;
+	}
+
+	if (!gst_video_info_from_caps(&info, caps))
+	{
+		GST_DEBUG_OBJECT(blitter_compositor, "could not get video info from caps %" GST_PTR_FORMAT, (gpointer)caps);
+		return FALSE;
+	}
+
+	GST_IMX_BLITTER_COMPOSITOR_LOCK(blitter_compositor);
+
+	if (blitter_compositor->blitter == NULL)
+	{
+		GST_IMX_BLITTER_COMPOSITOR_UNLOCK(blitter_compositor);
+		GST_DEBUG_OBJECT(blitter_compositor, "no blitter set; cannot propose allocation");
+		return FALSE;
+	}
+
+	blitter_klass = GST_IMX_BASE_BLITTER_GET_CLASS(blitter_compositor->blitter);
+
+	/* Propose a buffer pool with physically contiguous memory, so the
+	 * input frames can be blitted without copying them first */
+	allocator = gst_imx_base_blitter_get_phys_mem_allocator(blitter_compositor->blitter);
+	if (allocator == NULL)
+	{
+		GST_IMX_BLITTER_COMPOSITOR_UNLOCK(blitter_compositor);
+		GST_ERROR_OBJECT(blitter_compositor, "could not get physical memory allocator from blitter");
+		return FALSE;
+	}
+
+	if (need_pool)
+	{
+		GstBufferPool *pool = gst_imx_base_blitter_create_bufferpool(blitter_compositor->blitter, caps, info.size, 0, 0, allocator, NULL, GST_IMX_PHYS_MEM_CACHE_POLICY_WRITE_COMBINED);
+		if (pool == NULL)
+		{
+			GST_IMX_BLITTER_COMPOSITOR_UNLOCK(blitter_compositor);
+			GST_ERROR_OBJECT(blitter_compositor, "could not create physical memory buffer pool");
+			gst_object_unref(GST_OBJECT(allocator));
+			return FALSE;
+		}
+
+		gst_query_add_allocation_pool(query, pool, info.size, 0, 0);
+		gst_object_unref(GST_OBJECT(pool));
+	}
+
+	GST_IMX_BLITTER_COMPOSITOR_UNLOCK(blitter_compositor);
+
+	gst_query_add_allocation_param(query, allocator, NULL);
+	gst_object_unref(GST_OBJECT(allocator));
+
+	gst_query_add_allocation_meta(query, GST_VIDEO_META_API_TYPE, NULL);
+	gst_imx_phys_mem_buffer_pool_query_add_alignment(query, blitter_klass->horiz_alignment, blitter_klass->vert_alignment);
+
+	return TRUE;
+}
+
+
+static GstFlowReturn gst_imx_blitter_compositor_collected(GstCollectPads *pads, gpointer user_data)
+{
+	GstImxBlitterCompositor *blitter_compositor = GST_IMX_BLITTER_COMPOSITOR(user_data);
+	GSList *walk;
+	GstClockTime output_time = GST_CLOCK_TIME_NONE;
+	gboolean all_eos = TRUE, have_frames = FALSE;
+	GstBuffer *output_buffer = NULL;
+	GstFlowReturn flow_ret;
+
+	/* The running time of the next output frame is the earliest
+	 * running time of the queued input frames */
+	for (walk = pads->data; walk != NULL; walk = g_slist_next(walk))
+	{
+		GstCollectData *collect_data = (GstCollectData *)(walk->data);
+		GstBuffer *buffer = gst_collect_pads_peek(pads, collect_data);
+		GstClockTime running_time;
+
+		if (!GST_COLLECT_PADS_STATE_IS_SET(collect_data, GST_COLLECT_PADS_STATE_EOS))
+			all_eos = FALSE;
+
+		if (buffer == NULL)
+			continue;
+
+		all_eos = FALSE;
+		have_frames = TRUE;
+
+		running_time = gst_imx_blitter_compositor_get_running_time(collect_data, buffer);
+		if (GST_CLOCK_TIME_IS_VALID(running_time) && (!GST_CLOCK_TIME_IS_VALID(output_time) || (running_time < output_time)))
+			output_time = running_time;
+
+		gst_buffer_unref(buffer);
+	}
+
+	if (all_eos)
+	{
+		GST_DEBUG_OBJECT(blitter_compositor, "all sink pads are at EOS");
+		gst_pad_push_event(blitter_compositor->srcpad, gst_event_new_eos());
+		return GST_FLOW_EOS;
+	}
+
+	/* Non-waiting (live) pads do not have to have a frame queued when this
+	 * function is called; if none of the pads has one, there is nothing to do */
+	if (!have_frames)
+		return GST_FLOW_OK;
+
+	GST_IMX_BLITTER_COMPOSITOR_LOCK(blitter_compositor);
+
+	/* Take the input frames which are due. Frames with a later running time
+	 * stay queued; until they are due, the pad's current frame is drawn. */
+	for (walk = pads->data; walk != NULL; walk = g_slist_next(walk))
+	{
+		GstCollectData *collect_data = (GstCollectData *)(walk->data);
+		GstImxBlitterCompositorPad *compositor_pad = GST_IMX_BLITTER_COMPOSITOR_PAD(collect_data->pad);
+		GstBuffer *buffer = gst_collect_pads_peek(pads, collect_data);
+		GstClockTime running_time;
+
+		if (buffer == NULL)
+			continue;
+
+		running_time = gst_imx_blitter_compositor_get_running_time(collect_data, buffer);
+		gst_buffer_unref(buffer);
+
+		if (GST_CLOCK_TIME_IS_VALID(running_time) && GST_CLOCK_TIME_IS_VALID(output_time) && (running_time > output_time))
+			continue;
+
+		buffer = gst_collect_pads_pop(pads, collect_data);
+
+		if (compositor_pad->current_frame != NULL)
+			gst_buffer_unref(compositor_pad->current_frame);
+		compositor_pad->current_frame = buffer;
+		compositor_pad->frame_generation = blitter_compositor->output_generation + 1;
+	}
+
+	if (!gst_imx_blitter_compositor_update_output_caps(blitter_compositor))
+	{
+		GST_IMX_BLITTER_COMPOSITOR_UNLOCK(blitter_compositor);
+		GST_ELEMENT_ERROR(blitter_compositor, CORE, NEGOTIATION, ("could not negotiate output caps"), (NULL));
+		return GST_FLOW_NOT_NEGOTIATED;
+	}
+
+	/* With live pads, this function is called for each frame that arrives at
+	 * any of them. Skip output frames which would come earlier than the output
+	 * framerate permits; the taken frames are drawn in the next output frame. */
+	if (blitter_compositor->live && GST_CLOCK_TIME_IS_VALID(output_time) && GST_CLOCK_TIME_IS_VALID(blitter_compositor->last_output_time))
+	{
+		GstClockTime frame_duration = 0;
+
+		if (GST_VIDEO_INFO_FPS_N(&(blitter_compositor->output_video_info)) > 0)
+			frame_duration = gst_util_uint64_scale_int(GST_SECOND, GST_VIDEO_INFO_FPS_D(&(blitter_compositor->output_video_info)), GST_VIDEO_INFO_FPS_N(&(blitter_compositor->output_video_info)));
+
+		if (output_time < (blitter_compositor->last_output_time + frame_duration))
+		{
+			GST_LOG_OBJECT(blitter_compositor, "skipping output frame with running time %" GST_TIME_FORMAT " since it would come too early", GST_TIME_ARGS(output_time));
+			GST_IMX_BLITTER_COMPOSITOR_UNLOCK(blitter_compositor);
+			return GST_FLOW_OK;
+		}
+	}
+
+	flow_ret = gst_imx_blitter_compositor_compose(blitter_compositor, pads, &output_buffer);
+
+	if (flow_ret == GST_FLOW_OK)
+		blitter_compositor->last_output_time = output_time;
+
+	GST_IMX_BLITTER_COMPOSITOR_UNLOCK(blitter_compositor);
+
+	if (flow_ret != GST_FLOW_OK)
+		return flow_ret;
+
+	GST_BUFFER_PTS(output_buffer) = output_time;
+	GST_BUFFER_DTS(output_buffer) = GST_CLOCK_TIME_NONE;
+	if (GST_VIDEO_INFO_FPS_N(&(blitter_compositor->output_video_info)) > 0)
+		GST_BUFFER_DURATION(output_buffer) = gst_util_uint64_scale_int(GST_SECOND, GST_VIDEO_INFO_FPS_D(&(blitter_compositor->output_video_info)), GST_VIDEO_INFO_FPS_N(&(blitter_compositor->output_video_info)));
+
+	return gst_pad_push(blitter_compositor->srcpad, output_buffer);
+}
+
+
+
+/* miscellaneous functions */
+
+gboolean gst_imx_blitter_compositor_set_blitter(GstImxBlitterCompositor *blitter_compositor, GstImxBaseBlitter *blitter)
+{
+	g_assert(blitter_compositor != NULL);
+	g_assert(blitter != NULL);
+
+	if (blitter == blitter_compositor->blitter)
+		return TRUE;
+
+	if (blitter_compositor->blitter != NULL)
+		gst_object_unref(GST_OBJECT(blitter_compositor->blitter));
+
+	blitter_compositor->blitter = GST_IMX_BASE_BLITTER(gst_object_ref(GST_OBJECT(blitter)));
+
+	{
+		GstImxPhysMemPoolRegistry *pool_registry;
+
+		GST_OBJECT_LOCK(blitter_compositor);
+		pool_registry = (blitter_compositor->pool_registry != NULL) ? GST_IMX_PHYS_MEM_POOL_REGISTRY(gst_object_ref(GST_OBJECT(blitter_compositor->pool_registry))) : NULL;
+		GST_OBJECT_UNLOCK(blitter_compositor);
+
+		if (pool_registry != NULL)
+		{
+			gst_imx_base_blitter_set_pool_registry(blitter, pool_registry);
+			gst_object_unref(GST_OBJECT(pool_registry));
+		}
+	}
+
+	/* The new blitter knows nothing about the previous input video info and output frame */
+	blitter_compositor->last_input_pad = NULL;
+	blitter_compositor->last_input_info_set = FALSE;
+	gst_imx_blitter_compositor_invalidate_output_frames(blitter_compositor);
+
+	return TRUE;
+}
+
+
+static void gst_imx_blitter_compositor_update_live_state(GstImxBlitterCompositor *blitter_compositor, GstCollectPads *pads, GstCollectData *collect_data)
+{
+	/* Live sources deliver frames at their own pace, and may stall (network
+	 * cameras for example). Waiting for such a source would stall the entire
+	 * output, so live sink pads are switched to non-waiting. */
+
+	GstQuery *query;
+	gboolean live = FALSE;
+
+	query = gst_query_new_latency();
+	if (gst_pad_peer_query(collect_data->pad, query))
+		gst_query_parse_latency(query, &live, NULL, NULL);
+	gst_query_unref(query);
+
+	GST_DEBUG_OBJECT(collect_data->pad, "upstream is %slive", live ? "" : "not ");
+
+	/* This is called from the event function, so the collect pads'
+	 * stream lock is held, as gst_collect_pads_set_waiting() requires */
+	gst_collect_pads_set_waiting(pads, collect_data, !live);
+
+	if (live)
+	{
+		GST_IMX_BLITTER_COMPOSITOR_LOCK(blitter_compositor);
+		blitter_compositor->live = TRUE;
+		GST_IMX_BLITTER_COMPOSITOR_UNLOCK(blitter_compositor);
+	}
+}
+
+
+static GstClockTime gst_imx_blitter_compositor_get_running_time(GstCollectData *collect_data, GstBuffer *buffer)
+{
+	GstClockTime timestamp = GST_BUFFER_PTS(buffer);
+
+	if (!GST_CLOCK_TIME_IS_VALID(timestamp) || (collect_data->segment.format != GST_FORMAT_TIME))
+		return GST_CLOCK_TIME_NONE;
+
+	return gst_segment_to_running_time(&(collect_data->segment), GST_FORMAT_TIME, timestamp);
+}
+
+
+static gboolean gst_imx_blitter_compositor_update_output_caps(GstImxBlitterCompositor *blitter_compositor)
+{
+	/* The output frame is large enough to contain all input frames, and uses
+	 * the highest input framerate. Renegotiate only if these change. */
+
+	GstElement *element = GST_ELEMENT(blitter_compositor);
+	GList *walk;
+	gint width = 0, height = 0, fps_n = 0, fps_d = 1;
+	GstCaps *template_caps, *caps;
+	GstStructure *structure;
+	GstVideoInfo video_info;
+
+	GST_OBJECT_LOCK(element);
+	for (walk = element->sinkpads; walk != NULL; walk = g_list_next(walk))
+	{
+		GstImxBlitterCompositorPad *compositor_pad = GST_IMX_BLITTER_COMPOSITOR_PAD(walk->data);
+		GstVideoInfo *info = &(compositor_pad->video_info);
+
+		if (!(compositor_pad->video_info_set))
+			continue;
+
+		GST_OBJECT_LOCK(compositor_pad);
+		width = MAX(width, compositor_pad->xpos + (gint)((compositor_pad->width != 0) ? compositor_pad->width : (guint)GST_VIDEO_INFO_WIDTH(info)));
+		height = MAX(height, compositor_pad->ypos + (gint)((compositor_pad->height != 0) ? compositor_pad->height : (guint)GST_VIDEO_INFO_HEIGHT(info)));
+		GST_OBJECT_UNLOCK(compositor_pad);
+
+		if ((GST_VIDEO_INFO_FPS_D(info) > 0) && (gst_util_fraction_compare(GST_VIDEO_INFO_FPS_N(info), GST_VIDEO_INFO_FPS_D(info), fps_n, fps_d) > 0))
+		{
+			fps_n = GST_VIDEO_INFO_FPS_N(info);
+			fps_d = GST_VIDEO_INFO_FPS_D(info);
+		}
+	}
+	GST_OBJECT_UNLOCK(element);
+
+	if ((width <= 0) || (height <= 0))
+	{
+		GST_ERROR_OBJECT(blitter_compositor, "no input frame is inside the output");
+		return FALSE;
+	}
+
+	if (blitter_compositor->output_caps_set && (width == blitter_compositor->requested_width) && (height == blitter_compositor->requested_height) && (fps_n == blitter_compositor->requested_fps_n) && (fps_d == blitter_compositor->requested_fps_d))
+		return TRUE;
+
+	GST_DEBUG_OBJECT(blitter_compositor, "negotiating output caps with size %dx%d and framerate %d/%d", width, height, fps_n, fps_d);
+
+	template_caps = gst_pad_get_pad_template_caps(blitter_compositor->srcpad);
+	caps = gst_pad_peer_query_caps(blitter_compositor->srcpad, template_caps);
+	gst_caps_unref(template_caps);
+
+	if (gst_caps_is_empty(caps))
+	{
+		GST_ERROR_OBJECT(blitter_compositor, "downstream does not accept any of the output formats");
+		gst_caps_unref(caps);
+		return FALSE;
+	}
+
+	caps = gst_caps_truncate(gst_caps_make_writable(caps));
+	structure = gst_caps_get_structure(caps, 0);
+	gst_structure_fixate_field_nearest_int(structure, "width", width);
+	gst_structure_fixate_field_nearest_int(structure, "height", height);
+	gst_structure_fixate_field_nearest_fraction(structure, "framerate", fps_n, fps_d);
+	if (gst_structure_has_field(structure, "pixel-aspect-ratio"))
+		gst_structure_fixate_field_nearest_fraction(structure, "pixel-aspect-ratio", 1, 1);
+	caps = gst_caps_fixate(caps);
+
+	gst_video_info_init(&video_info);
+	if (!gst_video_info_from_caps(&video_info, caps))
+	{
+		GST_ERROR_OBJECT(blitter_compositor, "could not get video info from output caps %" GST_PTR_FORMAT, (gpointer)caps);
+		gst_caps_unref(caps);
+		return FALSE;
+	}
+
+	if (!(blitter_compositor->stream_start_sent))
+	{
+		gchar *stream_id = gst_pad_create_stream_id(blitter_compositor->srcpad, element, NULL);
+		gst_pad_push_event(blitter_compositor->srcpad, gst_event_new_stream_start(stream_id));
+		g_free(stream_id);
+		blitter_compositor->stream_start_sent = TRUE;
+	}
+
+	if (!gst_pad_set_caps(blitter_compositor->srcpad, caps))
+	{
+		GST_ERROR_OBJECT(blitter_compositor, "could not set output caps %" GST_PTR_FORMAT, (gpointer)caps);
+		gst_caps_unref(caps);
+		return FALSE;
+	}
+
+	if (!(blitter_compositor->segment_sent))
+	{
+		/* Output timestamps are running times */
+		GstSegment segment;
+		gst_segment_init(&segment, GST_FORMAT_TIME);
+		gst_pad_push_event(blitter_compositor->srcpad, gst_event_new_segment(&segment));
+		blitter_compositor->segment_sent = TRUE;
+	}
+
+	/* Output frames have a new size and/or format */
+	gst_imx_blitter_compositor_release_output_pool(blitter_compositor);
+
+	blitter_compositor->output_pool = gst_imx_base_blitter_acquire_bufferpool(blitter_compositor->blitter, caps, video_info.size, 0, 0, GST_IMX_PHYS_MEM_CACHE_POLICY_CACHED);
+	gst_caps_unref(caps);
+
+	if (blitter_compositor->output_pool == NULL)
+	{
+		GST_ERROR_OBJECT(blitter_compositor, "could not create output buffer pool");
+		gst_imx_blitter_compositor_release_output_pool(blitter_compositor);
+		return FALSE;
+	}
+
+	blitter_compositor->output_video_info = video_info;
+	blitter_compositor->output_caps_set = TRUE;
+	blitter_compositor->requested_width = width;
+	blitter_compositor->requested_height = height;
+	blitter_compositor->requested_fps_n = fps_n;
+	blitter_compositor->requested_fps_d = fps_d;
+
+	if (blitter_compositor->last_input_pad == NULL)
+		blitter_compositor->last_input_info_set = FALSE;
+
+	return TRUE;
+}
+
+
+static GArray* gst_imx_blitter_compositor_get_inputs(GstImxBlitterCompositor *blitter_compositor, GstCollectPads *pads, guint64 output_frame_generation)
+{
+	/* Takes a snapshot of the states of all pads which have a frame to draw,
+	 * sorted by z-order (lowest first). Frames which are not contained in
+	 * the output frame of the given generation are marked for redrawing. */
+
+	GArray *inputs;
+	GSList *walk;
+
+	inputs = g_array_new(FALSE, FALSE, sizeof(GstImxBlitterCompositorInput));
+
+	for (walk = pads->data; walk != NULL; walk = g_slist_next(walk))
+	{
+		GstCollectData *collect_data = (GstCollectData *)(walk->data);
+		GstImxBlitterCompositorPad *compositor_pad = GST_IMX_BLITTER_COMPOSITOR_PAD(collect_data->pad);
+		GstImxBlitterCompositorInput input;
+
+		if ((compositor_pad->current_frame == NULL) || !(compositor_pad->video_info_set))
+			continue;
+
+		GST_OBJECT_LOCK(compositor_pad);
+
+		input.pad = compositor_pad;
+		input.region.x1 = compositor_pad->xpos;
+		input.region.y1 = compositor_pad->ypos;
+		input.region.x2 = compositor_pad->xpos + (gint)((compositor_pad->width != 0) ? compositor_pad->width : (guint)GST_VIDEO_INFO_WIDTH(&(compositor_pad->video_info)));
+		input.region.y2 = compositor_pad->ypos + (gint)((compositor_pad->height != 0) ? compositor_pad->height : (guint)GST_VIDEO_INFO_HEIGHT(&(compositor_pad->video_info)));
+		input.zorder = compositor_pad->zorder;
+		input.alpha = (guint8)(compositor_pad->alpha * 255.0 + 0.5);
+		input.redraw = (compositor_pad->frame_generation > output_frame_generation);
+
+		/* A moved, resized, or restacked frame requires a full redraw */
+		if (compositor_pad->geometry_changed)
+		{
+			gst_imx_blitter_compositor_invalidate_output_frames(blitter_compositor);
+			compositor_pad->geometry_changed = FALSE;
+		}
+
+		GST_OBJECT_UNLOCK(compositor_pad);
+
+		g_array_append_val(inputs, input);
+	}
+
+	g_array_sort(inputs, gst_imx_blitter_compositor_compare_inputs);
+
+	return inputs;
+}
+
+
+static gint gst_imx_blitter_compositor_compare_inputs(gconstpointer first, gconstpointer second)
+{
+	guint first_zorder = ((GstImxBlitterCompositorInput const *)first)->zorder;
+	guint second_zorder = ((GstImxBlitterCompositorInput const *)second)->zorder;
+	return (first_zorder < second_zorder) ? -1 : ((first_zorder > second_zorder) ? 1 : 0);
+}
+
+
+static gboolean gst_imx_blitter_compositor_do_regions_intersect(GstImxBaseBlitterRegion const *first_region, GstImxBaseBlitterRegion const *second_region)
+{
+	return
+		(first_region->x1 < second_region->x2) && (second_region->x1 < first_region->x2) &&
+		(first_region->y1 < second_region->y2) && (second_region->y1 < first_region->y2);
+}
+
+
+static void gst_imx_blitter_compositor_subtract_region(GstImxBlitterCompositor *blitter_compositor, GArray *regions, GArray *remaining, GstImxBaseBlitterRegion const *region)
+{
+	/* Cuts region out of the given regions, and stores the parts of them which
+	 * remain in the remaining array. Cutting a region out of another one yields
+	 * up to 4 regions around it, which is what
+	 * gst_imx_base_blitter_calculate_empty_regions() computes. The blitter's
+	 * video region must be fully visible, as calculate_empty_regions() expects. */
+
+	guint i;
+
+	g_array_set_size(remaining, 0);
+
+	for (i = 0; i < regions->len; ++i)
+	{
+		GstImxBaseBlitterRegion *other_region = &g_array_index(regions, GstImxBaseBlitterRegion, i);
+		GstImxBaseBlitterRegion covered_region, empty_regions[4];
+		guint num_empty_regions;
+
+		if (!gst_imx_blitter_compositor_do_regions_intersect(other_region, region))
+		{
+			g_array_append_val(remaining, *other_region);
+			continue;
+		}
+
+		covered_region.x1 = MAX(other_region->x1, region->x1);
+		covered_region.y1 = MAX(other_region->y1, region->y1);
+		covered_region.x2 = MIN(other_region->x2, region->x2);
+		covered_region.y2 = MIN(other_region->y2, region->y2);
+
+		gst_imx_base_blitter_calculate_empty_regions(blitter_compositor->blitter, empty_regions, &num_empty_regions, &covered_region, other_region);
+		g_array_append_vals(remaining, empty_regions, num_empty_regions);
+	}
+}
+
+
+static gboolean gst_imx_blitter_compositor_fill_background(GstImxBlitterCompositor *blitter_compositor, GArray *inputs)
+{
+	/* Fill only the parts of the output frame which are not covered by opaque
+	 * frames. Starting with the entire output frame, the region of each opaque
+	 * frame is cut out of the remaining background regions. */
+
+	GstImxBaseBlitter *blitter = blitter_compositor->blitter;
+	GArray *regions, *remaining, *tmp;
+	GstImxBaseBlitterRegion output_region;
+	guint i, j;
+	gboolean ret = TRUE;
+
+	output_region.x1 = 0;
+	output_region.y1 = 0;
+	output_region.x2 = GST_VIDEO_INFO_WIDTH(&(blitter_compositor->output_video_info));
+	output_region.y2 = GST_VIDEO_INFO_HEIGHT(&(blitter_compositor->output_video_info));
+
+	/* Use the entire output frame as video and output region, so the blitter's
+	 * video region is fully visible, as calculate_empty_regions() expects */
+	if (!gst_imx_base_blitter_set_output_regions(blitter, NULL, NULL))
+		return FALSE;
+
+	regions = g_array_new(FALSE, FALSE, sizeof(GstImxBaseBlitterRegion));
+	remaining = g_array_new(FALSE, FALSE, sizeof(GstImxBaseBlitterRegion));
+	g_array_append_val(regions, output_region);
+
+	for (i = 0; (i < inputs->len) && (regions->len > 0); ++i)
+	{
+		GstImxBlitterCompositorInput *input = &g_array_index(inputs, GstImxBlitterCompositorInput, i);
+
+		if (input->alpha != 255)
+			continue;
+
+		gst_imx_blitter_compositor_subtract_region(blitter_compositor, regions, remaining, &(input->region));
+
+		tmp = regions;
+		regions = remaining;
+		remaining = tmp;
+	}
+
+	GST_LOG_OBJECT(blitter_compositor, "filling %u background region(s)", regions->len);
+
+	for (j = 0; ret && (j < regions->len); ++j)
+		ret = gst_imx_base_blitter_fill_region(blitter, &g_array_index(regions, GstImxBaseBlitterRegion, j), blitter_compositor->background_color);
+
+	g_array_free(regions, TRUE);
+	g_array_free(remaining, TRUE);
+
+	return ret;
+}
+
+
+static gboolean gst_imx_blitter_compositor_blit_input(GstImxBlitterCompositor *blitter_compositor, GstImxBlitterCompositorInput *input, gboolean clear_around)
+{
+	GstImxBaseBlitter *blitter = blitter_compositor->blitter;
+	GstImxBlitterCompositorPad *compositor_pad = input->pad;
+
+	/* Setting the input video info discards the blitter's internal
+	 * copy buffers, so only do it if the input pad changed */
+	if ((blitter_compositor->last_input_pad != compositor_pad) || !(blitter_compositor->last_input_info_set))
+	{
+		if (!gst_imx_base_blitter_set_input_video_info(blitter, &(compositor_pad->video_info)))
+			return FALSE;
+		blitter_compositor->last_input_pad = compositor_pad;
+		blitter_compositor->last_input_info_set = TRUE;
+	}
+
+	if (!gst_imx_base_blitter_set_input_alpha(blitter, input->alpha))
+	{
+		if (!(blitter_compositor->alpha_warning_shown))
+		{
+			GST_WARNING_OBJECT(blitter_compositor, "blitter does not support blending; frames are drawn opaque");
+			blitter_compositor->alpha_warning_shown = TRUE;
+		}
+		gst_imx_base_blitter_set_input_alpha(blitter, 255);
+	}
+
+	/* If clear_around is TRUE, the output region is the entire output frame, which
+	 * makes the blitter clear everything around the frame's region */
+	return gst_imx_base_blitter_set_input_buffer(blitter, compositor_pad->current_frame)
+	    && gst_imx_base_blitter_set_output_regions(blitter, &(input->region), clear_around ? NULL : &(input->region))
+	    && gst_imx_base_blitter_blit(blitter);
+}
+
+
+static GstFlowReturn gst_imx_blitter_compositor_compose(GstImxBlitterCompositor *blitter_compositor, GstCollectPads *pads, GstBuffer **output_buffer)
+{
+	GstImxBaseBlitter *blitter = blitter_compositor->blitter;
+	GstImxBlitterCompositorOutputFrame *output_frame;
+	GArray *inputs;
+	GstFlowReturn flow_ret;
+	gboolean full_redraw, clear_around, ret;
+	guint64 output_frame_generation;
+	guint i, j;
+
+	flow_ret = gst_imx_blitter_compositor_acquire_output_frame(blitter_compositor, output_buffer, &output_frame);
+	if (flow_ret != GST_FLOW_OK)
+	{
+		GST_ERROR_OBJECT(blitter_compositor, "could not acquire output buffer: %s", gst_flow_get_name(flow_ret));
+		return flow_ret;
+	}
+
+	/* Untracked output frames have unknown contents */
+	output_frame_generation = (output_frame != NULL) ? output_frame->generation : 0;
+
+	inputs = gst_imx_blitter_compositor_get_inputs(blitter_compositor, pads, output_frame_generation);
+
+	/* The output frame must be redrawn completely if it does not contain
+	 * an earlier output frame, or if that frame was invalidated since */
+	full_redraw = (output_frame_generation < blitter_compositor->min_valid_generation);
+
+	/* Only frames that changed need to be redrawn, unless they are blended or
+	 * overlap other frames; then, the frames below and above them would have
+	 * to be redrawn as well, so redraw everything in that case */
+	for (i = 0; !full_redraw && (i < inputs->len); ++i)
+	{
+		GstImxBlitterCompositorInput *input = &g_array_index(inputs, GstImxBlitterCompositorInput, i);
+
+		if (!(input->redraw))
+			continue;
+
+		if (input->alpha != 255)
+		{
+			full_redraw = TRUE;
+			break;
+		}
+
+		for (j = 0; j < inputs->len; ++j)
+		{
+			if ((j != i) && gst_imx_blitter_compositor_do_regions_intersect(&(input->region), &(g_array_index(inputs, GstImxBlitterCompositorInput, j).region)))
+			{
+				full_redraw = TRUE;
+				break;
+			}
+		}
+	}
+
+	ret = gst_imx_base_blitter_set_output_buffer(blitter, *output_buffer);
+
+	/* If the blitter cannot fill regions, the first frame is blitted with the
+	 * entire output frame as output region, to let the blitter clear the rest */
+	clear_around = FALSE;
+	if (ret && full_redraw)
+	{
+		GST_LOG_OBJECT(blitter_compositor, "redrawing entire output frame");
+
+		if (gst_imx_base_blitter_can_fill_regions(blitter))
+			ret = gst_imx_blitter_compositor_fill_background(blitter_compositor, inputs);
+		else
+			clear_around = TRUE;
+	}
+
+	for (i = 0; ret && (i < inputs->len); ++i)
+	{
+		GstImxBlitterCompositorInput *input = &g_array_index(inputs, GstImxBlitterCompositorInput, i);
+
+		if (full_redraw || input->redraw)
+		{
+			ret = gst_imx_blitter_compositor_blit_input(blitter_compositor, input, clear_around);
+			clear_around = FALSE;
+			blitter_compositor->num_pad_blits++;
+		}
+		else
+			blitter_compositor->num_skipped_pad_blits++;
+	}
+
+	g_array_free(inputs, TRUE);
+
+	ret = ret && gst_imx_base_blitter_flush(blitter);
+
+	if (!ret)
+	{
+		GST_ERROR_OBJECT(blitter_compositor, "could not composite input frames");
+		/* The output frame's contents are undefined now */
+		if (output_frame != NULL)
+			output_frame->generation = 0;
+		gst_buffer_unref(*output_buffer);
+		*output_buffer = NULL;
+		gst_imx_blitter_compositor_invalidate_output_frames(blitter_compositor);
+		return GST_FLOW_ERROR;
+	}
+
+	blitter_compositor->output_generation++;
+	if (output_frame != NULL)
+		output_frame->generation = blitter_compositor->output_generation;
+
+	blitter_compositor->num_output_frames++;
+
+	return GST_FLOW_OK;
+}
+
+
+static GstFlowReturn gst_imx_blitter_compositor_acquire_output_frame(GstImxBlitterCompositor *blitter_compositor, GstBuffer **output_buffer, GstImxBlitterCompositorOutputFrame **output_frame)
+{
+	/* Picks the tracked output frame which downstream released and which
+	 * has the most recent contents, since it requires the fewest blits. If
+	 * there is none, a new frame is acquired from the pool, and tracked if
+	 * possible. *output_frame is set to NULL for untracked frames. */
+
+	GstImxBlitterCompositorOutputFrame *best_frame = NULL;
+	GstFlowReturn flow_ret;
+	guint i;
+
+	for (i = 0; i < blitter_compositor->num_output_frames_tracked; ++i)
+	{
+		GstImxBlitterCompositorOutputFrame *frame = &(blitter_compositor->output_frames[i]);
+		guint j, num_memories;
+		gboolean released;
+
+		/* If only the compositor holds references to the buffer and its
+		 * memory blocks, downstream is done with it */
+		released = (GST_MINI_OBJECT_REFCOUNT_VALUE(frame->buffer) == 1);
+		num_memories = gst_buffer_n_memory(frame->buffer);
+		for (j = 0; released && (j < num_memories); ++j)
+			released = (GST_MINI_OBJECT_REFCOUNT_VALUE(gst_buffer_peek_memory(frame->buffer, j)) == 1);
+
+		if (released && ((best_frame == NULL) || (frame->generation > best_frame->generation)))
+			best_frame = frame;
+	}
+
+	if (best_frame != NULL)
+	{
+		/* Downstream could not modify the buffer, since it was not writable
+		 * while the compositor held its reference; the caller sets the
+		 * timestamps, so the buffer can be pushed again as it is */
+		*output_buffer = gst_buffer_ref(best_frame->buffer);
+		*output_frame = best_frame;
+		blitter_compositor->num_reused_output_frames++;
+		return GST_FLOW_OK;
+	}
+
+	flow_ret = gst_buffer_pool_acquire_buffer(blitter_compositor->output_pool, output_buffer, NULL);
+	if (flow_ret != GST_FLOW_OK)
+		return flow_ret;
+
+	if (blitter_compositor->num_output_frames_tracked < GST_IMX_BLITTER_COMPOSITOR_MAX_OUTPUT_FRAMES)
+	{
+		best_frame = &(blitter_compositor->output_frames[blitter_compositor->num_output_frames_tracked]);
+		best_frame->buffer = gst_buffer_ref(*output_buffer);
+		best_frame->generation = 0;
+		blitter_compositor->num_output_frames_tracked++;
+
+		GST_DEBUG_OBJECT(blitter_compositor, "tracking %u output frame(s)", blitter_compositor->num_output_frames_tracked);
+	}
+
+	*output_frame = best_frame;
+
+	return GST_FLOW_OK;
+}
+
+
+static void gst_imx_blitter_compositor_invalidate_output_frames(GstImxBlitterCompositor *blitter_compositor)
+{
+	/* The contents of all output frames composited so far are outdated;
+	 * each one is redrawn completely when it is reused */
+	blitter_compositor->min_valid_generation = blitter_compositor->output_generation + 1;
+}
+
+
+static void gst_imx_blitter_compositor_release_output_pool(GstImxBlitterCompositor *blitter_compositor)
+{
+	guint i;
+
+	for (i = 0; i < blitter_compositor->num_output_frames_tracked; ++i)
+		gst_buffer_unref(blitter_compositor->output_frames[i].buffer);
+	blitter_compositor->num_output_frames_tracked = 0;
+	gst_imx_blitter_compositor_invalidate_output_frames(blitter_compositor);
+
+	if (blitter_compositor->output_pool != NULL)
+	{
+		/* The blitter exists as long as the output pool does, since the pool
+		 * is released in the PAUSED->READY state change at the latest */
+		gst_imx_base_blitter_release_bufferpool(blitter_compositor->blitter, blitter_compositor->output_pool);
+		blitter_compositor->output_pool = NULL;
+	}
+}
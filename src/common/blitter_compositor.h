@@ -0,0 +1,238 @@
+/* GStreamer base class for i.MX blitter based video compositors
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#ifndef GST_IMX_COMMON_BLITTER_COMPOSITOR_H
+#define GST_IMX_COMMON_BLITTER_COMPOSITOR_H
+
+#include <gst/gst.h>
+#include <gst/base/gstcollectpads.h>
+#include <gst/video/video.h>
+
+#include "base_blitter.h"
+
+
+G_BEGIN_DECLS
+
+
+typedef struct _GstImxBlitterCompositor GstImxBlitterCompositor;
+typedef struct _GstImxBlitterCompositorClass GstImxBlitterCompositorClass;
+typedef struct _GstImxBlitterCompositorPad GstImxBlitterCompositorPad;
+typedef struct _GstImxBlitterCompositorPadClass GstImxBlitterCompositorPadClass;
+
+
+#define GST_TYPE_IMX_BLITTER_COMPOSITOR             (gst_imx_blitter_compositor_get_type())
+#define GST_IMX_BLITTER_COMPOSITOR(obj)             (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_IMX_BLITTER_COMPOSITOR, GstImxBlitterCompositor))
+#define GST_IMX_BLITTER_COMPOSITOR_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_IMX_BLITTER_COMPOSITOR, GstImxBlitterCompositorClass))
+#define GST_IS_IMX_BLITTER_COMPOSITOR(obj)          (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_IMX_BLITTER_COMPOSITOR))
+#define GST_IS_IMX_BLITTER_COMPOSITOR_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_IMX_BLITTER_COMPOSITOR))
+
+#define GST_TYPE_IMX_BLITTER_COMPOSITOR_PAD             (gst_imx_blitter_compositor_pad_get_type())
+#define GST_IMX_BLITTER_COMPOSITOR_PAD(obj)             (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_IMX_BLITTER_COMPOSITOR_PAD, GstImxBlitterCompositorPad))
+#define GST_IMX_BLITTER_COMPOSITOR_PAD_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_IMX_BLITTER_COMPOSITOR_PAD, GstImxBlitterCompositorPadClass))
+#define GST_IS_IMX_BLITTER_COMPOSITOR_PAD(obj)          (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_IMX_BLITTER_COMPOSITOR_PAD))
+#define GST_IS_IMX_BLITTER_COMPOSITOR_PAD_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_IMX_BLITTER_COMPOSITOR_PAD))
+
+
+/* Macros for locking/unlocking the blitter compositor's mutex.
+ * These should always be used when a property is set that affects
+ * the blit operation. */
+#define GST_IMX_BLITTER_COMPOSITOR_LOCK(obj) do { g_mutex_lock(&(((GstImxBlitterCompositor*)(obj))->mutex)); } while (0)
+#define GST_IMX_BLITTER_COMPOSITOR_UNLOCK(obj) do { g_mutex_unlock(&(((GstImxBlitterCompositor*)(obj))->mutex)); } while (0)
+
+
+/* Maximum number of output frames whose contents are tracked for reuse */
+#define GST_IMX_BLITTER_COMPOSITOR_MAX_OUTPUT_FRAMES 8
+
+
+typedef struct
+{
+	GstBuffer *buffer;
+	guint64 generation;
+}
+GstImxBlitterCompositorOutputFrame;
+
+
+/**
+ * GstImxBlitterCompositorPad:
+ *
+ * Sink pad of the blitter compositor. The position, size, z-order and alpha
+ * properties are protected by the pad's object lock.
+ */
+struct _GstImxBlitterCompositorPad
+{
+	GstPad parent;
+
+	/*< private >*/
+
+	/* Collect data for this pad, owned by the collect pads */
+	GstCollectData *collect_data;
+
+	/* Position and size of the frame in the output; a width or height of 0
+	 * means that the width or height of the input frames is used */
+	gint xpos, ypos;
+	guint width, height;
+	/* Pads with a higher z-order are drawn over pads with a lower one */
+	guint zorder;
+	/* Alpha value for blending the frames over the ones below; 1.0 = opaque */
+	gdouble alpha;
+	/* Set when one of the properties above changed; the next output
+	 * frame is then redrawn completely */
+	gboolean geometry_changed;
+
+	/* Copy of the GstVideoInfo structure generated from the caps */
+	GstVideoInfo video_info;
+	gboolean video_info_set;
+
+	/* Frame that was last received through this pad; ref'd. This frame
+	 * is drawn again if no new one arrives in time for the next output frame. */
+	GstBuffer *current_frame;
+	/* Generation of the first output frame which contains current_frame;
+	 * output frames of earlier generations do not contain it yet */
+	guint64 frame_generation;
+};
+
+
+struct _GstImxBlitterCompositorPadClass
+{
+	GstPadClass parent_class;
+};
+
+
+/**
+ * GstImxBlitterCompositor:
+ *
+ * The opaque #GstImxBlitterCompositor data structure.
+ */
+struct _GstImxBlitterCompositor
+{
+	GstElement parent;
+
+	/*< protected >*/
+
+	/* Mutex protecting the blit operations and the element states below */
+	GMutex mutex;
+
+	/* The blitter to be used; is unref'd in the READY->NULL state change */
+	GstImxBaseBlitter *blitter;
+
+	/* Registry for sharing the blitter's buffer pools with other elements;
+	 * obtained in the NULL->READY state change. Protected by the object lock. */
+	GstImxPhysMemPoolRegistry *pool_registry;
+
+	/* Flag to indicate initialization status; FALSE if
+	 * the compositor is in the NULL state, TRUE otherwise */
+	gboolean initialized;
+
+	GstPad *srcpad;
+	GstCollectPads *collect;
+
+	/* Index for the next requested sink pad */
+	guint next_pad_index;
+
+	/* Background color for regions not covered by any frame, in 0xRRGGBB format */
+	guint background_color;
+
+	/* Output caps states; if output_caps_set is FALSE, or the size or
+	 * framerate computed from the sink pads changed, the output caps are
+	 * renegotiated. The requested_* values are the ones computed from the
+	 * sink pads; downstream may have fixated the caps differently. */
+	GstVideoInfo output_video_info;
+	gboolean output_caps_set;
+	gint requested_width, requested_height, requested_fps_n, requested_fps_d;
+	gboolean stream_start_sent, segment_sent;
+
+	/* Pool for the output frames */
+	GstBufferPool *output_pool;
+	/* Output frames acquired from the pool, along with the generation of the
+	 * output frame they last contained; the buffers are ref'd. Input frames
+	 * are composited directly in the output frames. Once downstream released
+	 * a tracked frame, it is reused, and only the input frames which changed
+	 * since its generation are redrawn in it. The references keep the frames
+	 * out of the pool (which may be shared with other elements), and make
+	 * them non-writable for downstream, so their contents stay intact. */
+	GstImxBlitterCompositorOutputFrame output_frames[GST_IMX_BLITTER_COMPOSITOR_MAX_OUTPUT_FRAMES];
+	guint num_output_frames_tracked;
+	/* Generation of the last composited output frame; output frames with a
+	 * generation lower than min_valid_generation are redrawn completely */
+	guint64 output_generation, min_valid_generation;
+
+	/* Set if at least one of the sink pads is fed by a live source. Live
+	 * sink pads are not waited for, so a stalled live source does not stall
+	 * the output; instead, the frame last received through it is drawn again.
+	 * Output frames are then paced by the output framerate. */
+	gboolean live;
+	GstClockTime last_output_time;
+
+	/* The sink pad whose video info was last passed to the blitter;
+	 * NULL if none was passed yet */
+	GstImxBlitterCompositorPad *last_input_pad;
+	gboolean last_input_info_set;
+
+	gboolean alpha_warning_shown;
+
+	/* Statistics for the debug log */
+	guint64 num_output_frames, num_pad_blits, num_skipped_pad_blits, num_reused_output_frames;
+};
+
+
+/**
+ * GstImxBlitterCompositorClass
+ * @parent_class: The parent class structure
+ * @start:        Required.
+ *                Called during the NULL->READY state change. Call
+ *                @gst_imx_blitter_compositor_set_blitter in here.
+ *                (This function must be called in @start.)
+ * @stop:         Optional.
+ *                Called during the READY->NULL state change, before the blitter
+ *                is unref'd.
+ *
+ * The blitter compositor is an abstract base class for defining blitter-based video
+ * compositors. It has one always present "src" pad and request "sink_%u" pads; derived
+ * classes must add templates for them. Each sink pad has a position, size, z-order and
+ * alpha value. Input frames are composited directly in the output frames. Output frames are
+ * reused once downstream released them; frames which did not change since a reused output
+ * frame was composited are not blitted again, unless they overlap other frames that changed.
+ */
+struct _GstImxBlitterCompositorClass
+{
+	GstElementClass parent_class;
+
+	gboolean (*start)(GstImxBlitterCompositor *blitter_compositor);
+	gboolean (*stop)(GstImxBlitterCompositor *blitter_compositor);
+};
+
+
+GType gst_imx_blitter_compositor_get_type(void);
+GType gst_imx_blitter_compositor_pad_get_type(void);
+
+/* Sets the blitter the compositor uses for compositing frames. The blitter is
+ * ref'd. If a pointer to another blitter was set previously, this older blitter
+ * is first unref'd. If the new and the old blitter pointer are the same, this
+ * function does nothing. This function must be called inside @start.
+ *
+ * NOTE: This function must be called with a mutex lock. Surround this call
+ * with GST_IMX_BLITTER_COMPOSITOR_LOCK/UNLOCK calls.
+ */
+gboolean gst_imx_blitter_compositor_set_blitter(GstImxBlitterCompositor *blitter_compositor, GstImxBaseBlitter *blitter);
+
+
+G_END_DECLS
+
+
+#endif
@@ -30,6 +30,8 @@
 #include <gst/video/gstvideometa.h>
 
 #include "phys_mem_meta.h"
+#include "phys_mem_stats.h"
+#include "phys_mem_buffer_pool.h"
 #include "blitter_video_sink.h"
 
 
@@ -66,8 +68,10 @@ static void gst_imx_blitter_video_sink_finalize(GObject *object);
 static void gst_imx_blitter_video_sink_set_property(GObject *object, guint prop_id, GValue const *value, GParamSpec *pspec);
 static void gst_imx_blitter_video_sink_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec);
 static GstStateChangeReturn gst_imx_blitter_video_sink_change_state(GstElement *element, GstStateChange transition);
+static void gst_imx_blitter_video_sink_set_context(GstElement *element, GstContext *context);
 static gboolean gst_imx_blitter_video_sink_set_caps(GstBaseSink *sink, GstCaps *caps);
 static gboolean gst_imx_blitter_video_sink_event(GstBaseSink *sink, GstEvent *event);
+static gboolean gst_imx_blitter_video_sink_query(GstBaseSink *sink, GstQuery *query);
 static gboolean gst_imx_blitter_video_sink_propose_allocation(GstBaseSink *sink, GstQuery *query);
 static GstFlowReturn gst_imx_blitter_video_sink_show_frame(GstVideoSink *video_sink, GstBuffer *buf);
 
@@ -101,8 +105,10 @@ void gst_imx_blitter_video_sink_class_init(GstImxBlitterVideoSinkClass *klass)
 	object_class->set_property     = GST_DEBUG_FUNCPTR(gst_imx_blitter_video_sink_set_property);
 	object_class->get_property     = GST_DEBUG_FUNCPTR(gst_imx_blitter_video_sink_get_property);
 	element_class->change_state    = GST_DEBUG_FUNCPTR(gst_imx_blitter_video_sink_change_state);
+	element_class->set_context     = GST_DEBUG_FUNCPTR(gst_imx_blitter_video_sink_set_context);
 	base_class->set_caps           = GST_DEBUG_FUNCPTR(gst_imx_blitter_video_sink_set_caps);
 	base_class->event              = GST_DEBUG_FUNCPTR(gst_imx_blitter_video_sink_event);
+	base_class->query              = GST_DEBUG_FUNCPTR(gst_imx_blitter_video_sink_query);
 	base_class->propose_allocation = GST_DEBUG_FUNCPTR(gst_imx_blitter_video_sink_propose_allocation);
 	parent_class->show_frame       = GST_DEBUG_FUNCPTR(gst_imx_blitter_video_sink_show_frame);
 
@@ -197,6 +203,7 @@ void gst_imx_blitter_video_sink_init(GstImxBlitterVideoSink *blitter_video_sink)
 {
 	blitter_video_sink->initialized = FALSE;
 	blitter_video_sink->blitter = NULL;
+	blitter_video_sink->pool_registry = NULL;
 	blitter_video_sink->force_aspect_ratio = DEFAULT_FORCE_ASPECT_RATIO;
 	blitter_video_sink->framebuffer_name = g_strdup(DEFAULT_FBDEV_NAME);
 	blitter_video_sink->framebuffer = NULL;
@@ -226,10 +233,24 @@ static void gst_imx_blitter_video_sink_finalize(GObject *object)
 
 	g_mutex_clear(&(blitter_video_sink->mutex));
 
+	if (blitter_video_sink->pool_registry != NULL)
+		gst_object_unref(GST_OBJECT(blitter_video_sink->pool_registry));
+
 	G_OBJECT_CLASS(gst_imx_blitter_video_sink_parent_class)->finalize(object);
 }
 
 
+static void gst_imx_blitter_video_sink_set_context(GstElement *element, GstContext *context)
+{
+	GstImxBlitterVideoSink *blitter_video_sink = GST_IMX_BLITTER_VIDEO_SINK(element);
+
+	gst_imx_phys_mem_pool_registry_handle_set_context(element, context, &(blitter_video_sink->pool_registry));
+
+	if (GST_ELEMENT_CLASS(gst_imx_blitter_video_sink_parent_class)->set_context != NULL)
+		GST_ELEMENT_CLASS(gst_imx_blitter_video_sink_parent_class)->set_context(element, context);
+}
+
+
 static void gst_imx_blitter_video_sink_set_property(GObject *object, guint prop_id, GValue const *value, GParamSpec *pspec)
 {
 	GstImxBlitterVideoSink *blitter_video_sink = GST_IMX_BLITTER_VIDEO_SINK(object);
@@ -418,6 +439,10 @@ static GstStateChangeReturn gst_imx_blitter_video_sink_change_state(GstElement *
 	{
 		case GST_STATE_CHANGE_NULL_TO_READY:
 		{
+			/* Done before start(), so the registry can be passed on to
+			 * the blitter in gst_imx_blitter_video_sink_set_blitter() */
+			gst_imx_phys_mem_pool_registry_ensure(element, &(blitter_video_sink->pool_registry));
+
 			GST_IMX_BLITTER_VIDEO_SINK_LOCK(blitter_video_sink);
 
 			/* Set this to TRUE here, since gst_imx_blitter_video_sink_update_regions()
@@ -461,6 +486,14 @@ static GstStateChangeReturn gst_imx_blitter_video_sink_change_state(GstElement *
 
 	switch (transition)
 	{
+		case GST_STATE_CHANGE_PAUSED_TO_READY:
+		{
+			/* Publish the physical memory statistics gathered during
+			 * streaming, so applications can size their memory budgets */
+			gst_element_post_message(element, gst_imx_phys_mem_stats_message_new(GST_OBJECT(element)));
+			break;
+		}
+
 		case GST_STATE_CHANGE_READY_TO_NULL:
 		{
 			GST_IMX_BLITTER_VIDEO_SINK_LOCK(blitter_video_sink);
@@ -541,12 +574,36 @@ static gboolean gst_imx_blitter_video_sink_event(GstBaseSink *sink, GstEvent *ev
 }
 
 
+static gboolean gst_imx_blitter_video_sink_query(GstBaseSink *sink, GstQuery *query)
+{
+	GstImxBlitterVideoSink *blitter_video_sink = GST_IMX_BLITTER_VIDEO_SINK(sink);
+
+	if (gst_imx_phys_mem_stats_handle_query(query))
+	{
+		GST_LOG_OBJECT(sink, "answered physical memory statistics query");
+		return TRUE;
+	}
+
+	if (gst_imx_phys_mem_pool_registry_handle_context_query(GST_ELEMENT(sink), query, &(blitter_video_sink->pool_registry)))
+	{
+		GST_LOG_OBJECT(sink, "answered pool registry context query");
+		return TRUE;
+	}
+
+	return GST_BASE_SINK_CLASS(gst_imx_blitter_video_sink_parent_class)->query(sink, query);
+}
+
+
 static gboolean gst_imx_blitter_video_sink_propose_allocation(GstBaseSink *sink, GstQuery *query)
 {
+	GstImxBlitterVideoSink *blitter_video_sink = GST_IMX_BLITTER_VIDEO_SINK(sink);
 	GstCaps *caps;
 	GstVideoInfo info;
+	GstVideoAlignment align;
 	GstBufferPool *pool;
 	guint size;
+	guint horiz_alignment = GST_IMX_PHYS_MEM_BUFFER_POOL_DEFAULT_HORIZ_ALIGNMENT;
+	guint vert_alignment = GST_IMX_PHYS_MEM_BUFFER_POOL_DEFAULT_VERT_ALIGNMENT;
 
 	gst_query_parse_allocation(query, &caps, NULL);
 
@@ -561,11 +618,22 @@ static gboolean gst_imx_blitter_video_sink_propose_allocation(GstBaseSink *sink,
 
 	size = GST_VIDEO_INFO_SIZE(&info);
 
+	/* Frames are blitted into the framebuffer, so the blitter's alignment applies */
+	GST_IMX_BLITTER_VIDEO_SINK_LOCK(blitter_video_sink);
+	if (blitter_video_sink->blitter != NULL)
+	{
+		GstImxBaseBlitterClass *blitter_klass = GST_IMX_BASE_BLITTER_GET_CLASS(blitter_video_sink->blitter);
+		horiz_alignment = blitter_klass->horiz_alignment;
+		vert_alignment = blitter_klass->vert_alignment;
+	}
+	GST_IMX_BLITTER_VIDEO_SINK_UNLOCK(blitter_video_sink);
+
 	if (gst_query_get_n_allocation_pools(query) == 0)
 	{
 		GstStructure *structure;
 		GstAllocationParams params;
 		GstAllocator *allocator = NULL;
+		guint min_buffers;
 
 		memset(&params, 0, sizeof(params));
 		params.flags = 0;
@@ -578,12 +646,23 @@ static gboolean gst_imx_blitter_video_sink_propose_allocation(GstBaseSink *sink,
 		else
 			gst_query_add_allocation_param(query, allocator, &params);
 
+		/* The frame being blitted, and the last sample the base class keeps
+		 * if enabled; during the handover to the next frame, these are two
+		 * different frames */
+		min_buffers = 1 + (gst_base_sink_is_last_sample_enabled(sink) ? 1 : 0);
+
 		pool = gst_video_buffer_pool_new();
 
 		structure = gst_buffer_pool_get_config(pool);
-		gst_buffer_pool_config_set_params(structure, caps, size, 0, 0);
+		gst_buffer_pool_config_set_params(structure, caps, size, min_buffers, 0);
 		gst_buffer_pool_config_set_allocator(structure, allocator, &params);
 
+		/* Pad the frames of the proposed pool like a physical memory pool would */
+		gst_imx_phys_mem_buffer_pool_compute_video_alignment(&info, horiz_alignment, vert_alignment, &align);
+		gst_buffer_pool_config_add_option(structure, GST_BUFFER_POOL_OPTION_VIDEO_META);
+		gst_buffer_pool_config_add_option(structure, GST_BUFFER_POOL_OPTION_VIDEO_ALIGNMENT);
+		gst_buffer_pool_config_set_video_alignment(structure, &align);
+
 		if (allocator)
 			gst_object_unref(allocator);
 
@@ -594,11 +673,18 @@ static gboolean gst_imx_blitter_video_sink_propose_allocation(GstBaseSink *sink,
 			return FALSE;
 		}
 
-		gst_query_add_allocation_pool(query, pool, size, 0, 0);
+		/* The pool updated the size to include the padding */
+		structure = gst_buffer_pool_get_config(pool);
+		gst_buffer_pool_config_get_params(structure, NULL, &size, NULL, NULL);
+		gst_structure_free(structure);
+
+		gst_query_add_allocation_pool(query, pool, size, min_buffers, 0);
 		gst_object_unref(pool);
 		gst_query_add_allocation_meta(query, GST_VIDEO_META_API_TYPE, NULL);
 	}
 
+	gst_imx_phys_mem_buffer_pool_query_add_alignment(query, horiz_alignment, vert_alignment);
+
 	return TRUE;
 }
 
@@ -642,6 +728,20 @@ gboolean gst_imx_blitter_video_sink_set_blitter(GstImxBlitterVideoSink *blitter_
 
 	gst_object_ref(GST_OBJECT(blitter_video_sink->blitter));
 
+	{
+		GstImxPhysMemPoolRegistry *pool_registry;
+
+		GST_OBJECT_LOCK(blitter_video_sink);
+		pool_registry = (blitter_video_sink->pool_registry != NULL) ? GST_IMX_PHYS_MEM_POOL_REGISTRY(gst_object_ref(GST_OBJECT(blitter_video_sink->pool_registry))) : NULL;
+		GST_OBJECT_UNLOCK(blitter_video_sink);
+
+		if (pool_registry != NULL)
+		{
+			gst_imx_base_blitter_set_pool_registry(blitter, pool_registry);
+			gst_object_unref(GST_OBJECT(pool_registry));
+		}
+	}
+
 	gst_imx_blitter_video_sink_update_regions(blitter_video_sink);
 
 	if (!gst_imx_base_blitter_set_output_buffer(blitter_video_sink->blitter, blitter_video_sink->framebuffer))
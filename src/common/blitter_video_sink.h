@@ -71,6 +71,11 @@ struct _GstImxBlitterVideoSink
 	/* The blitter to be used; is unref'd in the READY->NULL state change */
 	GstImxBaseBlitter *blitter;
 
+	/* Registry for sharing the blitter's internal buffer pools with other
+	 * elements; obtained in the NULL->READY state change. Protected by
+	 * the object lock. */
+	GstImxPhysMemPoolRegistry *pool_registry;
+
 	/* Whether or not to enforce the aspect ratio defined by the input caps
 	 * and the output framebuffer */
 	gboolean force_aspect_ratio;
@@ -22,6 +22,10 @@
 
 #include "blitter_video_transform.h"
 #include "../common/phys_mem_meta.h"
+#include "../common/phys_mem_stats.h"
+#include "../common/phys_mem_caps.h"
+#include "../common/phys_mem_buffer_pool.h"
+#include "../common/dmabuf.h"
 
 
 GST_DEBUG_CATEGORY_STATIC(imx_blitter_video_transform_debug);
@@ -31,20 +35,41 @@ GST_DEBUG_CATEGORY_STATIC(imx_blitter_video_transform_debug);
 enum
 {
 	PROP_0,
-	PROP_INPUT_CROP
+	PROP_INPUT_CROP,
+	PROP_FRAMES_IN_FLIGHT,
+	PROP_EXPORT_DMABUF,
+	PROP_LOAD_BALANCE_ENGINES
 };
 
 
+#define DEFAULT_FRAMES_IN_FLIGHT 1
+#define DEFAULT_EXPORT_DMABUF FALSE
+#define MAX_FRAMES_IN_FLIGHT 16
+
+
+typedef struct
+{
+	GstBuffer *output_buffer;
+	GstImxBaseBlitterFence *fence;
+}
+GstImxBlitterVideoTransformPendingFrame;
+
+
 G_DEFINE_ABSTRACT_TYPE(GstImxBlitterVideoTransform, gst_imx_blitter_video_transform, GST_TYPE_BASE_TRANSFORM)
 
 
 /* general element operations */
 static void gst_imx_blitter_video_transform_finalize(GObject *object);
 static GstStateChangeReturn gst_imx_blitter_video_transform_change_state(GstElement *element, GstStateChange transition);
+static void gst_imx_blitter_video_transform_set_context(GstElement *element, GstContext *context);
 static gboolean gst_imx_blitter_video_transform_sink_event(GstBaseTransform *transform, GstEvent *event);
 static gboolean gst_imx_blitter_video_transform_src_event(GstBaseTransform *transform, GstEvent *event);
+static gboolean gst_imx_blitter_video_transform_query(GstBaseTransform *transform, GstPadDirection direction, GstQuery *query);
 static void gst_imx_blitter_video_transform_set_property(GObject *object, guint prop_id, GValue const *value, GParamSpec *pspec);
 static void gst_imx_blitter_video_transform_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec);
+static GstFlowReturn gst_imx_blitter_video_transform_finish_oldest_pending_frame(GstImxBlitterVideoTransform *blitter_video_transform, GstBuffer **outbuf);
+static GstFlowReturn gst_imx_blitter_video_transform_finish_pending_frames(GstImxBlitterVideoTransform *blitter_video_transform, gboolean push);
+static void gst_imx_blitter_video_transform_setup_load_balancing(GstImxBlitterVideoTransform *blitter_video_transform);
 
 /* caps handling */
 static GstCaps* gst_imx_blitter_video_transform_transform_caps(GstBaseTransform *transform, GstPadDirection direction, GstCaps *caps, GstCaps *filter);
@@ -52,14 +77,20 @@ static GstCaps* gst_imx_blitter_video_transform_fixate_caps(GstBaseTransform *tr
 static GstCaps* gst_imx_blitter_video_transform_fixate_size_caps(GstBaseTransform *transform, GstPadDirection direction, GstCaps *caps, GstCaps *othercaps);
 static void gst_imx_blitter_video_transform_fixate_format_caps(GstBaseTransform *transform, GstCaps *caps, GstCaps *othercaps);
 static gboolean gst_imx_blitter_video_transform_set_caps(GstBaseTransform *transform, GstCaps *in, GstCaps *out);
+static gboolean gst_imx_blitter_video_transform_outputs_phys_mem(GstImxBlitterVideoTransform *blitter_video_transform);
 
 /* allocator */
 static gboolean gst_imx_blitter_video_transform_propose_allocation(GstBaseTransform *transform, GstQuery *decide_query, GstQuery *query);
 static gboolean gst_imx_blitter_video_transform_decide_allocation(GstBaseTransform *transform, GstQuery *query);
+static GstBufferPool* gst_imx_blitter_video_transform_acquire_output_pool(GstImxBlitterVideoTransform *blitter_video_transform, GstCaps *caps, guint size, guint min_buffers, guint horiz_alignment, guint vert_alignment);
+static void gst_imx_blitter_video_transform_release_output_pool(GstImxBlitterVideoTransform *blitter_video_transform);
 
 /* frame output */
 static GstFlowReturn gst_imx_blitter_video_transform_prepare_output_buffer(GstBaseTransform *transform, GstBuffer *input, GstBuffer **outbuf);
 static GstFlowReturn gst_imx_blitter_video_transform_transform_frame(GstBaseTransform *transform, GstBuffer *in, GstBuffer *out);
+#if GST_CHECK_VERSION(1, 6, 0)
+static GstFlowReturn gst_imx_blitter_video_transform_generate_output(GstBaseTransform *transform, GstBuffer **outbuf);
+#endif
 static gboolean gst_imx_blitter_video_transform_transform_size(GstBaseTransform *transform, GstPadDirection direction, GstCaps *caps, gsize size, GstCaps *othercaps, gsize *othersize);
 
 /* metadata and meta information */
@@ -85,11 +116,13 @@ void gst_imx_blitter_video_transform_class_init(GstImxBlitterVideoTransformClass
 	element_class = GST_ELEMENT_CLASS(klass);
 
 	element_class->change_state                 = GST_DEBUG_FUNCPTR(gst_imx_blitter_video_transform_change_state);
+	element_class->set_context                  = GST_DEBUG_FUNCPTR(gst_imx_blitter_video_transform_set_context);
 	object_class->finalize                      = GST_DEBUG_FUNCPTR(gst_imx_blitter_video_transform_finalize);
 	object_class->set_property                  = GST_DEBUG_FUNCPTR(gst_imx_blitter_video_transform_set_property);
 	object_class->get_property                  = GST_DEBUG_FUNCPTR(gst_imx_blitter_video_transform_get_property);
 	base_transform_class->sink_event            = GST_DEBUG_FUNCPTR(gst_imx_blitter_video_transform_sink_event);
 	base_transform_class->src_event             = GST_DEBUG_FUNCPTR(gst_imx_blitter_video_transform_src_event);
+	base_transform_class->query                 = GST_DEBUG_FUNCPTR(gst_imx_blitter_video_transform_query);
 	base_transform_class->transform_caps        = GST_DEBUG_FUNCPTR(gst_imx_blitter_video_transform_transform_caps);
 	base_transform_class->fixate_caps           = GST_DEBUG_FUNCPTR(gst_imx_blitter_video_transform_fixate_caps);
 	base_transform_class->propose_allocation    = GST_DEBUG_FUNCPTR(gst_imx_blitter_video_transform_propose_allocation);
@@ -97,6 +130,9 @@ void gst_imx_blitter_video_transform_class_init(GstImxBlitterVideoTransformClass
 	base_transform_class->set_caps              = GST_DEBUG_FUNCPTR(gst_imx_blitter_video_transform_set_caps);
 	base_transform_class->prepare_output_buffer = GST_DEBUG_FUNCPTR(gst_imx_blitter_video_transform_prepare_output_buffer);
 	base_transform_class->transform             = GST_DEBUG_FUNCPTR(gst_imx_blitter_video_transform_transform_frame);
+#if GST_CHECK_VERSION(1, 6, 0)
+	base_transform_class->generate_output       = GST_DEBUG_FUNCPTR(gst_imx_blitter_video_transform_generate_output);
+#endif
 	base_transform_class->transform_size        = GST_DEBUG_FUNCPTR(gst_imx_blitter_video_transform_transform_size);
 	base_transform_class->transform_meta        = GST_DEBUG_FUNCPTR(gst_imx_blitter_video_transform_transform_meta);
 	base_transform_class->get_unit_size         = GST_DEBUG_FUNCPTR(gst_imx_blitter_video_transform_get_unit_size);
@@ -111,6 +147,11 @@ void gst_imx_blitter_video_transform_class_init(GstImxBlitterVideoTransformClass
 
 	klass->are_transforms_necessary = NULL;
 
+	klass->set_video_infos = NULL;
+
+	klass->engine_name = NULL;
+	klass->engine_capabilities = 0;
+
 	g_object_class_install_property(
 		object_class,
 		PROP_INPUT_CROP,
@@ -122,6 +163,40 @@ void gst_imx_blitter_video_transform_class_init(GstImxBlitterVideoTransformClass
 			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
 		)
 	);
+	g_object_class_install_property(
+		object_class,
+		PROP_FRAMES_IN_FLIGHT,
+		g_param_spec_uint(
+			"frames-in-flight",
+			"Frames in flight",
+			"Maximum number of frames that can be processed by the blitter at the same time (1 = blit synchronously; requires GStreamer 1.6 or newer)",
+			1, MAX_FRAMES_IN_FLIGHT,
+			DEFAULT_FRAMES_IN_FLIGHT,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
+		)
+	);
+	g_object_class_install_property(
+		object_class,
+		PROP_EXPORT_DMABUF,
+		g_param_spec_boolean(
+			"export-dmabuf",
+			"Export DMA-BUFs",
+			"Push output frames as DMA-BUF memory, for DMA-BUF capable downstream elements like kmssink (takes effect with the next allocation; requires GStreamer 1.6 or newer)",
+			DEFAULT_EXPORT_DMABUF,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
+		)
+	);
+	g_object_class_install_property(
+		object_class,
+		PROP_LOAD_BALANCE_ENGINES,
+		g_param_spec_string(
+			"load-balance-engines",
+			"Load balance engines",
+			"Comma separated list of other i.MX video transform elements (for example, imxg2dvideotransform) whose engines shall share the blitting work with the engine of this element; frames are then given to the least loaded engine. Empty or NULL disables load balancing. Only supported by elements which use one engine; takes effect in the NULL->READY state change",
+			NULL,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
+		)
+	);
 }
 
 
@@ -137,9 +212,24 @@ void gst_imx_blitter_video_transform_init(GstImxBlitterVideoTransform *blitter_v
 	gst_video_info_init(&(blitter_video_transform->output_video_info));
 
 	blitter_video_transform->blitter = NULL;
+	blitter_video_transform->pool_registry = NULL;
+	blitter_video_transform->output_pool = NULL;
+	blitter_video_transform->output_pool_registry = NULL;
 
 	blitter_video_transform->input_crop = GST_IMX_BASE_BLITTER_CROP_DEFAULT;
 
+	blitter_video_transform->max_frames_in_flight = DEFAULT_FRAMES_IN_FLIGHT;
+	g_queue_init(&(blitter_video_transform->pending_frames));
+	blitter_video_transform->drain_pending_frames = FALSE;
+	blitter_video_transform->submitted_fence = NULL;
+
+	blitter_video_transform->export_dmabuf = DEFAULT_EXPORT_DMABUF;
+
+	blitter_video_transform->load_balance_engines = NULL;
+	blitter_video_transform->dispatch_blitter = NULL;
+	blitter_video_transform->engine_blitter = NULL;
+	blitter_video_transform->engine_exclusive = FALSE;
+
 	g_mutex_init(&(blitter_video_transform->mutex));
 
 	/* Set passthrough initially to FALSE ; passthrough will later be
@@ -160,10 +250,28 @@ static void gst_imx_blitter_video_transform_finalize(GObject *object)
 
 	g_mutex_clear(&(blitter_video_transform->mutex));
 
+	gst_imx_blitter_video_transform_release_output_pool(blitter_video_transform);
+
+	if (blitter_video_transform->pool_registry != NULL)
+		gst_object_unref(GST_OBJECT(blitter_video_transform->pool_registry));
+
+	g_free(blitter_video_transform->load_balance_engines);
+
 	G_OBJECT_CLASS(gst_imx_blitter_video_transform_parent_class)->finalize(object);
 }
 
 
+static void gst_imx_blitter_video_transform_set_context(GstElement *element, GstContext *context)
+{
+	GstImxBlitterVideoTransform *blitter_video_transform = GST_IMX_BLITTER_VIDEO_TRANSFORM(element);
+
+	gst_imx_phys_mem_pool_registry_handle_set_context(element, context, &(blitter_video_transform->pool_registry));
+
+	if (GST_ELEMENT_CLASS(gst_imx_blitter_video_transform_parent_class)->set_context != NULL)
+		GST_ELEMENT_CLASS(gst_imx_blitter_video_transform_parent_class)->set_context(element, context);
+}
+
+
 static GstStateChangeReturn gst_imx_blitter_video_transform_change_state(GstElement *element, GstStateChange transition)
 {
 	GstImxBlitterVideoTransform *blitter_video_transform = GST_IMX_BLITTER_VIDEO_TRANSFORM(element);
@@ -177,6 +285,10 @@ static GstStateChangeReturn gst_imx_blitter_video_transform_change_state(GstElem
 	{
 		case GST_STATE_CHANGE_NULL_TO_READY:
 		{
+			/* Done before start(), so the registry can be passed on to
+			 * the blitter in gst_imx_blitter_video_transform_set_blitter() */
+			gst_imx_phys_mem_pool_registry_ensure(element, &(blitter_video_transform->pool_registry));
+
 			GST_IMX_BLITTER_VIDEO_TRANSFORM_LOCK(blitter_video_transform);
 
 			blitter_video_transform->initialized = TRUE;
@@ -193,6 +305,8 @@ static GstStateChangeReturn gst_imx_blitter_video_transform_change_state(GstElem
 			 * otherwise the video transform element cannot function properly */
 			g_assert(blitter_video_transform->blitter != NULL);
 
+			gst_imx_blitter_video_transform_setup_load_balancing(blitter_video_transform);
+
 			gst_imx_base_blitter_enable_crop(blitter_video_transform->blitter, blitter_video_transform->input_crop);
 
 			GST_IMX_BLITTER_VIDEO_TRANSFORM_UNLOCK(blitter_video_transform);
@@ -210,6 +324,21 @@ static GstStateChangeReturn gst_imx_blitter_video_transform_change_state(GstElem
 
 	switch (transition)
 	{
+		case GST_STATE_CHANGE_PAUSED_TO_READY:
+		{
+			/* Streaming has stopped at this point; discard any frames
+			 * that have not been pushed yet */
+			gst_imx_blitter_video_transform_finish_pending_frames(blitter_video_transform, FALSE);
+
+			gst_imx_blitter_video_transform_release_output_pool(blitter_video_transform);
+
+			/* Publish the physical memory statistics gathered during
+			 * streaming, so applications can size their memory budgets */
+			gst_element_post_message(element, gst_imx_phys_mem_stats_message_new(GST_OBJECT(element)));
+
+			break;
+		}
+
 		case GST_STATE_CHANGE_READY_TO_NULL:
 		{
 			GST_IMX_BLITTER_VIDEO_TRANSFORM_LOCK(blitter_video_transform);
@@ -219,6 +348,11 @@ static GstStateChangeReturn gst_imx_blitter_video_transform_change_state(GstElem
 			if ((klass->stop != NULL) && !(klass->stop(blitter_video_transform)))
 				GST_ERROR_OBJECT(blitter_video_transform, "stop() failed");
 
+			/* The dispatch blitter is unref'd below together with the
+			 * blitter, which also shuts down the other engines' elements */
+			blitter_video_transform->dispatch_blitter = NULL;
+			blitter_video_transform->engine_blitter = NULL;
+
 			GST_IMX_BLITTER_VIDEO_TRANSFORM_UNLOCK(blitter_video_transform);
 
 			if (blitter_video_transform->blitter != NULL)
@@ -252,6 +386,25 @@ static void gst_imx_blitter_video_transform_set_property(GObject *object, guint
 			GST_IMX_BLITTER_VIDEO_TRANSFORM_UNLOCK(blitter_video_transform);
 			break;
 
+		case PROP_FRAMES_IN_FLIGHT:
+			GST_IMX_BLITTER_VIDEO_TRANSFORM_LOCK(blitter_video_transform);
+			blitter_video_transform->max_frames_in_flight = g_value_get_uint(value);
+			GST_IMX_BLITTER_VIDEO_TRANSFORM_UNLOCK(blitter_video_transform);
+			break;
+
+		case PROP_EXPORT_DMABUF:
+			GST_IMX_BLITTER_VIDEO_TRANSFORM_LOCK(blitter_video_transform);
+			blitter_video_transform->export_dmabuf = g_value_get_boolean(value);
+			GST_IMX_BLITTER_VIDEO_TRANSFORM_UNLOCK(blitter_video_transform);
+			break;
+
+		case PROP_LOAD_BALANCE_ENGINES:
+			GST_IMX_BLITTER_VIDEO_TRANSFORM_LOCK(blitter_video_transform);
+			g_free(blitter_video_transform->load_balance_engines);
+			blitter_video_transform->load_balance_engines = g_value_dup_string(value);
+			GST_IMX_BLITTER_VIDEO_TRANSFORM_UNLOCK(blitter_video_transform);
+			break;
+
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 			break;
@@ -271,6 +424,24 @@ static void gst_imx_blitter_video_transform_get_property(GObject *object, guint
 			GST_IMX_BLITTER_VIDEO_TRANSFORM_UNLOCK(blitter_video_transform);
 			break;
 
+		case PROP_FRAMES_IN_FLIGHT:
+			GST_IMX_BLITTER_VIDEO_TRANSFORM_LOCK(blitter_video_transform);
+			g_value_set_uint(value, blitter_video_transform->max_frames_in_flight);
+			GST_IMX_BLITTER_VIDEO_TRANSFORM_UNLOCK(blitter_video_transform);
+			break;
+
+		case PROP_EXPORT_DMABUF:
+			GST_IMX_BLITTER_VIDEO_TRANSFORM_LOCK(blitter_video_transform);
+			g_value_set_boolean(value, blitter_video_transform->export_dmabuf);
+			GST_IMX_BLITTER_VIDEO_TRANSFORM_UNLOCK(blitter_video_transform);
+			break;
+
+		case PROP_LOAD_BALANCE_ENGINES:
+			GST_IMX_BLITTER_VIDEO_TRANSFORM_LOCK(blitter_video_transform);
+			g_value_set_string(value, blitter_video_transform->load_balance_engines);
+			GST_IMX_BLITTER_VIDEO_TRANSFORM_UNLOCK(blitter_video_transform);
+			break;
+
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 			break;
@@ -278,14 +449,64 @@ static void gst_imx_blitter_video_transform_get_property(GObject *object, guint
 }
 
 
+static void gst_imx_blitter_video_transform_setup_load_balancing(GstImxBlitterVideoTransform *blitter_video_transform)
+{
+	GstImxBlitterVideoTransformClass *klass = GST_IMX_BLITTER_VIDEO_TRANSFORM_CLASS(G_OBJECT_GET_CLASS(blitter_video_transform));
+	GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+	GstImxDispatchBlitter *dispatch_blitter;
+	GstCaps *sink_caps, *src_caps;
+
+	blitter_video_transform->dispatch_blitter = NULL;
+	blitter_video_transform->engine_blitter = NULL;
+
+	if ((blitter_video_transform->load_balance_engines == NULL) || (blitter_video_transform->load_balance_engines[0] == '\0'))
+		return;
+
+	if (klass->engine_name == NULL)
+	{
+		GST_WARNING_OBJECT(blitter_video_transform, "this element does not support load balancing; ignoring load balance engines \"%s\"", blitter_video_transform->load_balance_engines);
+		return;
+	}
+
+	/* Wrap the blitter in a dispatch blitter, which routes each frame to the
+	 * least loaded engine. The element's own blitter is added first, so it
+	 * is preferred if the engines are equally loaded. */
+	blitter_video_transform->engine_blitter = blitter_video_transform->blitter;
+	dispatch_blitter = gst_imx_dispatch_blitter_new();
+	sink_caps = gst_pad_template_get_caps(gst_element_class_get_pad_template(element_class, "sink"));
+	src_caps = gst_pad_template_get_caps(gst_element_class_get_pad_template(element_class, "src"));
+
+	gst_imx_dispatch_blitter_add_backend(dispatch_blitter, blitter_video_transform->engine_blitter, sink_caps, src_caps, klass->engine_capabilities);
+	if (gst_imx_dispatch_blitter_add_backend_elements(dispatch_blitter, blitter_video_transform->load_balance_engines, GST_IMX_DISPATCH_BLITTER_CAPABILITY_SCALING) == 0)
+		GST_WARNING_OBJECT(blitter_video_transform, "none of the load balance engines \"%s\" is available; using only the %s", blitter_video_transform->load_balance_engines, klass->engine_name);
+
+	gst_caps_unref(sink_caps);
+	gst_caps_unref(src_caps);
+
+	/* The dispatch blitter holds a reference to the engine blitter,
+	 * so it stays alive even though it is replaced here */
+	gst_imx_blitter_video_transform_set_blitter(blitter_video_transform, GST_IMX_BASE_BLITTER(dispatch_blitter));
+	gst_object_unref(GST_OBJECT(dispatch_blitter));
+
+	blitter_video_transform->dispatch_blitter = dispatch_blitter;
+	gst_imx_blitter_video_transform_set_engine_exclusive(blitter_video_transform, blitter_video_transform->engine_exclusive);
+}
+
+
 static gboolean gst_imx_blitter_video_transform_sink_event(GstBaseTransform *transform, GstEvent *event)
 {
 	GstImxBlitterVideoTransform *blitter_video_transform = GST_IMX_BLITTER_VIDEO_TRANSFORM(transform);
 
+	/* Serialized events must not overtake frames that are still in flight */
+	if (GST_EVENT_IS_SERIALIZED(event) && (GST_EVENT_TYPE(event) != GST_EVENT_FLUSH_STOP))
+		gst_imx_blitter_video_transform_finish_pending_frames(blitter_video_transform, TRUE);
+
 	switch (GST_EVENT_TYPE(event))
 	{
 		case GST_EVENT_FLUSH_STOP:
 		{
+			gst_imx_blitter_video_transform_finish_pending_frames(blitter_video_transform, FALSE);
+
 			GST_IMX_BLITTER_VIDEO_TRANSFORM_LOCK(blitter_video_transform);
 			if (blitter_video_transform->blitter != NULL)
 			{
@@ -358,11 +579,31 @@ static gboolean gst_imx_blitter_video_transform_src_event(GstBaseTransform *tran
 }
 
 
+static gboolean gst_imx_blitter_video_transform_query(GstBaseTransform *transform, GstPadDirection direction, GstQuery *query)
+{
+	GstImxBlitterVideoTransform *blitter_video_transform = GST_IMX_BLITTER_VIDEO_TRANSFORM(transform);
+
+	if (gst_imx_phys_mem_stats_handle_query(query))
+	{
+		GST_LOG_OBJECT(transform, "answered physical memory statistics query");
+		return TRUE;
+	}
+
+	if (gst_imx_phys_mem_pool_registry_handle_context_query(GST_ELEMENT(transform), query, &(blitter_video_transform->pool_registry)))
+	{
+		GST_LOG_OBJECT(transform, "answered pool registry context query");
+		return TRUE;
+	}
+
+	return GST_BASE_TRANSFORM_CLASS(gst_imx_blitter_video_transform_parent_class)->query(transform, direction, query);
+}
+
+
 
 
 /* caps handling */
 
-static GstCaps* gst_imx_blitter_video_transform_transform_caps(GstBaseTransform *transform, G_GNUC_UNUSED GstPadDirection direction, GstCaps *caps, GstCaps *filter)
+static GstCaps* gst_imx_blitter_video_transform_transform_caps(GstBaseTransform *transform, GstPadDirection direction, GstCaps *caps, GstCaps *filter)
 {
 	GstCaps *tmpcaps1, *tmpcaps2, *result;
 	GstStructure *structure;
@@ -402,6 +643,18 @@ static GstCaps* gst_imx_blitter_video_transform_transform_caps(GstBaseTransform
 		gst_caps_append_structure(tmpcaps1, structure);
 	}
 
+	/* Input frames in system memory are copied into physical memory, and output
+	 * frames are in physical memory if the blitter's allocator provides it, so
+	 * both caps features are possible on either side; the physical memory one
+	 * is preferred. Output frames from a system memory allocator (like the one
+	 * of the software blitter) must not be advertised as physical memory. */
+	if ((direction == GST_PAD_SINK) && !gst_imx_blitter_video_transform_outputs_phys_mem(GST_IMX_BLITTER_VIDEO_TRANSFORM(transform)))
+		tmpcaps2 = gst_imx_phys_mem_caps_remove_feature(tmpcaps1);
+	else
+		tmpcaps2 = gst_imx_phys_mem_caps_add_feature_variants(tmpcaps1);
+	gst_caps_unref(tmpcaps1);
+	tmpcaps1 = tmpcaps2;
+
 	if (filter != NULL)
 	{
 		tmpcaps2 = gst_caps_intersect_full(filter, tmpcaps1, GST_CAPS_INTERSECT_FIRST);
@@ -998,18 +1251,48 @@ static gboolean gst_imx_blitter_video_transform_set_caps(GstBaseTransform *trans
 
 	inout_info_equal = klass->are_video_infos_equal(blitter_video_transform, &in_info, &out_info);
 
+	/* Passing through system memory frames is not possible if downstream
+	 * negotiated physical memory frames */
+	if (gst_imx_phys_mem_caps_has_feature(out, 0) && !gst_imx_phys_mem_caps_has_feature(in, 0))
+		inout_info_equal = FALSE;
+
 	if (inout_info_equal)
 		GST_DEBUG_OBJECT(transform, "input and output caps are equal");
 	else
 		GST_DEBUG_OBJECT(transform, "input and output caps are not equal:  input: %" GST_PTR_FORMAT "  output: %" GST_PTR_FORMAT, (gpointer)in, (gpointer)out);
 
+	GST_IMX_BLITTER_VIDEO_TRANSFORM_LOCK(blitter_video_transform);
+
+	if ((klass->set_video_infos != NULL) && !(klass->set_video_infos(blitter_video_transform, &in_info, &out_info)))
+	{
+		GST_IMX_BLITTER_VIDEO_TRANSFORM_UNLOCK(blitter_video_transform);
+		GST_ERROR_OBJECT(transform, "could not handle input caps %" GST_PTR_FORMAT " and output caps %" GST_PTR_FORMAT, (gpointer)in, (gpointer)out);
+		blitter_video_transform->inout_info_set = FALSE;
+		return FALSE;
+	}
+
+	/* set_video_infos may have replaced the blitter */
+	gst_imx_base_blitter_enable_crop(blitter_video_transform->blitter, blitter_video_transform->input_crop);
+
 	if (!gst_imx_base_blitter_set_input_video_info(blitter_video_transform->blitter, &in_info))
 	{
+		GST_IMX_BLITTER_VIDEO_TRANSFORM_UNLOCK(blitter_video_transform);
 		GST_ERROR_OBJECT(transform, "could not use input caps: %" GST_PTR_FORMAT, (gpointer)in);
 		blitter_video_transform->inout_info_set = FALSE;
 		return FALSE;
 	}
 
+	GST_IMX_BLITTER_VIDEO_TRANSFORM_UNLOCK(blitter_video_transform);
+
+	/* If set_video_infos selected a blitter whose output frames are not in
+	 * physical memory, the output caps must not have the physical memory
+	 * caps feature; renegotiate, now that transform_caps sees that blitter */
+	if (gst_imx_phys_mem_caps_has_feature(out, 0) && !gst_imx_blitter_video_transform_outputs_phys_mem(blitter_video_transform))
+	{
+		GST_DEBUG_OBJECT(transform, "blitter does not output physical memory frames; renegotiating output caps");
+		gst_base_transform_reconfigure_src(transform);
+	}
+
 	blitter_video_transform->input_video_info = in_info;
 	blitter_video_transform->output_video_info = out_info;
 	blitter_video_transform->inout_info_equal = inout_info_equal;
@@ -1019,13 +1302,119 @@ static gboolean gst_imx_blitter_video_transform_set_caps(GstBaseTransform *trans
 }
 
 
+static gboolean gst_imx_blitter_video_transform_outputs_phys_mem(GstImxBlitterVideoTransform *blitter_video_transform)
+{
+	/* Output frames are allocated with the blitter's allocator. Until a
+	 * blitter is set, physical memory output is assumed, since all
+	 * blitters except the software one provide it. */
+
+	GstAllocator *allocator;
+	gboolean ret = TRUE;
+
+	GST_IMX_BLITTER_VIDEO_TRANSFORM_LOCK(blitter_video_transform);
+
+	if (blitter_video_transform->blitter != NULL)
+	{
+		allocator = gst_imx_base_blitter_get_phys_mem_allocator(blitter_video_transform->blitter);
+		if (allocator != NULL)
+		{
+			ret = gst_imx_phys_mem_allocator_is_contiguous(allocator);
+			gst_object_unref(GST_OBJECT(allocator));
+		}
+	}
+
+	GST_IMX_BLITTER_VIDEO_TRANSFORM_UNLOCK(blitter_video_transform);
+
+	return ret;
+}
+
+
 
 
 /* allocator */
 
 static gboolean gst_imx_blitter_video_transform_propose_allocation(GstBaseTransform *transform, G_GNUC_UNUSED GstQuery *decide_query, GstQuery *query)
 {
-	return gst_pad_peer_query(GST_BASE_TRANSFORM_SRC_PAD(transform), query);
+	GstImxBlitterVideoTransform *blitter_video_transform = GST_IMX_BLITTER_VIDEO_TRANSFORM(transform);
+	GstCaps *caps;
+	GstVideoInfo info;
+	gboolean need_pool;
+	GstAllocator *allocator;
+	GstImxBaseBlitterClass *blitter_klass;
+
+	/* If input and output formats are equal, the input buffers might be
+	 * passed through (see prepare_output_buffer), so let downstream decide
+	 * the allocation in that case */
+	if (!(blitter_video_transform->inout_info_set) || blitter_video_transform->inout_info_equal)
+		return gst_pad_peer_query(GST_BASE_TRANSFORM_SRC_PAD(transform), query);
+
+	gst_query_parse_allocation(query, &caps, &need_pool);
+
+	if (caps == NULL)
+	{
+		GST_DEBUG_OBJECT(transform, "no caps specified");
+		return FALSE;
+	}
+
+	if (!gst_video_info_from_caps(&info, caps))
+	{
+		GST_DEBUG_OBJECT(transform, "could not get video info from caps %" GST_PTR_FORMAT, (gpointer)caps);
+		return FALSE;
+	}
+
+	GST_IMX_BLITTER_VIDEO_TRANSFORM_LOCK(blitter_video_transform);
+
+	if (blitter_video_transform->blitter == NULL)
+	{
+		GST_IMX_BLITTER_VIDEO_TRANSFORM_UNLOCK(blitter_video_transform);
+		GST_DEBUG_OBJECT(transform, "no blitter set; cannot propose allocation");
+		return FALSE;
+	}
+
+	blitter_klass = GST_IMX_BASE_BLITTER_GET_CLASS(blitter_video_transform->blitter);
+
+	/* Propose a buffer pool with physically contiguous memory from the blitter's
+	 * allocator, so upstream can write directly into memory the blitter can use,
+	 * and the base blitter's copy fallback is not needed */
+	allocator = gst_imx_base_blitter_get_phys_mem_allocator(blitter_video_transform->blitter);
+	if (allocator == NULL)
+	{
+		GST_IMX_BLITTER_VIDEO_TRANSFORM_UNLOCK(blitter_video_transform);
+		GST_ERROR_OBJECT(transform, "could not get physical memory allocator from blitter");
+		return FALSE;
+	}
+
+	if (need_pool)
+	{
+		GstBufferPool *pool = gst_imx_base_blitter_create_bufferpool(blitter_video_transform->blitter, caps, info.size, 0, 0, allocator, NULL, GST_IMX_PHYS_MEM_CACHE_POLICY_WRITE_COMBINED);
+		if (pool == NULL)
+		{
+			GST_IMX_BLITTER_VIDEO_TRANSFORM_UNLOCK(blitter_video_transform);
+			GST_ERROR_OBJECT(transform, "could not create physical memory buffer pool");
+			gst_object_unref(GST_OBJECT(allocator));
+			return FALSE;
+		}
+
+		GST_DEBUG_OBJECT(transform, "proposing physical memory buffer pool %" GST_PTR_FORMAT " with size %u upstream", (gpointer)pool, (guint)(info.size));
+
+		gst_query_add_allocation_pool(query, pool, info.size, 0, 0);
+		gst_object_unref(GST_OBJECT(pool));
+	}
+
+	GST_IMX_BLITTER_VIDEO_TRANSFORM_UNLOCK(blitter_video_transform);
+
+	gst_query_add_allocation_param(query, allocator, NULL);
+	gst_object_unref(GST_OBJECT(allocator));
+
+	/* The pool aligns frames, so upstream must respect the strides & plane offsets */
+	gst_query_add_allocation_meta(query, GST_VIDEO_META_API_TYPE, NULL);
+	if (blitter_video_transform->input_crop)
+		gst_query_add_allocation_meta(query, GST_VIDEO_CROP_META_API_TYPE, NULL);
+
+	/* Tell upstream how the blitter needs the input frames to be padded */
+	gst_imx_phys_mem_buffer_pool_query_add_alignment(query, blitter_klass->horiz_alignment, blitter_klass->vert_alignment);
+
+	return TRUE;
 }
 
 
@@ -1038,13 +1427,33 @@ static gboolean gst_imx_blitter_video_transform_decide_allocation(GstBaseTransfo
 	GstStructure *config;
 	GstVideoInfo vinfo;
 	gboolean update_pool;
+	guint horiz_alignment, vert_alignment;
+	guint downstream_horiz_alignment, downstream_vert_alignment;
+	gboolean export_dmabuf;
 
 	g_assert(blitter_video_transform->blitter != NULL);
 
+	GST_IMX_BLITTER_VIDEO_TRANSFORM_LOCK(blitter_video_transform);
+	export_dmabuf = blitter_video_transform->export_dmabuf;
+	GST_IMX_BLITTER_VIDEO_TRANSFORM_UNLOCK(blitter_video_transform);
+
+	/* The caps may have changed, so a pool acquired earlier may not fit anymore */
+	gst_imx_blitter_video_transform_release_output_pool(blitter_video_transform);
+
 	gst_query_parse_allocation(query, &outcaps, NULL);
 	gst_video_info_init(&vinfo);
 	gst_video_info_from_caps(&vinfo, outcaps);
 
+	/* The output frames must satisfy the alignment requirements of the blitter
+	 * (which writes them) and of all downstream elements (which read them) */
+	horiz_alignment = GST_IMX_BASE_BLITTER_GET_CLASS(blitter_video_transform->blitter)->horiz_alignment;
+	vert_alignment = GST_IMX_BASE_BLITTER_GET_CLASS(blitter_video_transform->blitter)->vert_alignment;
+	if (gst_imx_phys_mem_buffer_pool_query_get_alignment(query, &downstream_horiz_alignment, &downstream_vert_alignment))
+	{
+		GST_DEBUG_OBJECT(blitter_video_transform, "downstream requires horiz/vert alignment %u/%u", downstream_horiz_alignment, downstream_vert_alignment);
+		gst_imx_phys_mem_buffer_pool_merge_alignment(&horiz_alignment, &vert_alignment, downstream_horiz_alignment, downstream_vert_alignment);
+	}
+
 	GST_DEBUG_OBJECT(blitter_video_transform, "num allocation pools: %d", gst_query_get_n_allocation_pools(query));
 
 	/* Look for an allocator which can allocate physical memory buffers */
@@ -1068,6 +1477,16 @@ static gboolean gst_imx_blitter_video_transform_decide_allocation(GstBaseTransfo
 		update_pool = FALSE;
 	}
 
+#if GST_CHECK_VERSION(1, 6, 0)
+	/* Output buffers whose blits are still in flight are held by this element,
+	 * in addition to the buffers downstream holds */
+	GST_IMX_BLITTER_VIDEO_TRANSFORM_LOCK(blitter_video_transform);
+	min += blitter_video_transform->max_frames_in_flight - 1;
+	GST_IMX_BLITTER_VIDEO_TRANSFORM_UNLOCK(blitter_video_transform);
+	if ((max != 0) && (max < min))
+		max = min;
+#endif
+
 	/* Either no pool or no pool with the ability to allocate physical memory buffers
 	 * has been found -> create a new pool */
 	if ((pool == NULL) || !gst_buffer_pool_has_option(pool, GST_BUFFER_POOL_OPTION_IMX_PHYS_MEM))
@@ -1076,7 +1495,36 @@ static gboolean gst_imx_blitter_video_transform_decide_allocation(GstBaseTransfo
 			GST_DEBUG_OBJECT(blitter_video_transform, "no pool present; creating new pool");
 		else
 			GST_DEBUG_OBJECT(blitter_video_transform, "no pool supports physical memory buffers; creating new pool");
-		pool = gst_imx_base_blitter_create_bufferpool(blitter_video_transform->blitter, outcaps, size, min, max, NULL, NULL);
+
+		/* Draw the output frames from a shared pool of the registry if possible.
+		 * Frames which are exported as DMA-BUFs need blocks of their own, so
+		 * these always come from a private pool. */
+		if (!export_dmabuf && ((blitter_video_transform->output_pool = gst_imx_blitter_video_transform_acquire_output_pool(blitter_video_transform, outcaps, size, min, horiz_alignment, vert_alignment)) != NULL))
+		{
+			GST_DEBUG_OBJECT(blitter_video_transform, "using shared pool %" GST_PTR_FORMAT " from the registry", (gpointer)(blitter_video_transform->output_pool));
+
+			/* Keep the pool away from the base class (see the output_pool
+			 * description in the header); without a pool in the query, it
+			 * leaves the frame allocation to prepare_output_buffer */
+			while (gst_query_get_n_allocation_pools(query) > 0)
+				gst_query_remove_nth_allocation_pool(query, 0);
+
+			if (pool != NULL)
+				gst_object_unref(pool);
+
+			return TRUE;
+		}
+
+		if (pool != NULL)
+			gst_object_unref(pool);
+		pool = gst_imx_base_blitter_create_bufferpool(blitter_video_transform->blitter, outcaps, size, min, max, NULL, NULL, GST_IMX_PHYS_MEM_CACHE_POLICY_CACHED);
+		if (pool != NULL)
+		{
+			config = gst_buffer_pool_get_config(pool);
+			gst_imx_phys_mem_buffer_pool_config_set_alignment(config, horiz_alignment, vert_alignment);
+			gst_imx_phys_mem_buffer_pool_config_set_dmabuf_export(config, export_dmabuf);
+			gst_buffer_pool_set_config(pool, config);
+		}
 	}
 	else
 	{
@@ -1084,16 +1532,21 @@ static gboolean gst_imx_blitter_video_transform_decide_allocation(GstBaseTransfo
 		gst_buffer_pool_config_set_params(config, outcaps, size, min, max);
 		gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_IMX_PHYS_MEM);
 		gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+		gst_imx_phys_mem_buffer_pool_config_set_alignment(config, horiz_alignment, vert_alignment);
+		gst_imx_phys_mem_buffer_pool_config_set_dmabuf_export(config, export_dmabuf);
 		gst_buffer_pool_set_config(pool, config);
 	}
 
 	GST_DEBUG_OBJECT(
 		blitter_video_transform,
-		"pool config:  outcaps: %" GST_PTR_FORMAT "  size: %u  min buffers: %u  max buffers: %u",
+		"pool config:  outcaps: %" GST_PTR_FORMAT "  size: %u  min buffers: %u  max buffers: %u  horiz/vert alignment: %u/%u  DMA-BUF export: %d",
 		(gpointer)outcaps,
 		size,
 		min,
-		max
+		max,
+		horiz_alignment,
+		vert_alignment,
+		export_dmabuf
 	);
 
 	if (update_pool)
@@ -1108,6 +1561,55 @@ static gboolean gst_imx_blitter_video_transform_decide_allocation(GstBaseTransfo
 }
 
 
+static GstBufferPool* gst_imx_blitter_video_transform_acquire_output_pool(GstImxBlitterVideoTransform *blitter_video_transform, GstCaps *caps, guint size, guint min_buffers, guint horiz_alignment, guint vert_alignment)
+{
+	GstImxPhysMemPoolRegistry *pool_registry;
+	GstAllocator *allocator;
+	GstBufferPool *pool;
+
+	GST_OBJECT_LOCK(blitter_video_transform);
+	pool_registry = (blitter_video_transform->pool_registry != NULL) ? GST_IMX_PHYS_MEM_POOL_REGISTRY(gst_object_ref(GST_OBJECT(blitter_video_transform->pool_registry))) : NULL;
+	GST_OBJECT_UNLOCK(blitter_video_transform);
+
+	if (pool_registry == NULL)
+		return NULL;
+
+	allocator = gst_imx_base_blitter_get_phys_mem_allocator(blitter_video_transform->blitter);
+	if (allocator == NULL)
+	{
+		GST_ERROR_OBJECT(blitter_video_transform, "could not create physical memory bufferpool allocator");
+		gst_object_unref(GST_OBJECT(pool_registry));
+		return NULL;
+	}
+
+	pool = gst_imx_phys_mem_pool_registry_acquire_pool(pool_registry, allocator, caps, size, min_buffers, horiz_alignment, vert_alignment, GST_IMX_PHYS_MEM_CACHE_POLICY_CACHED);
+	gst_object_unref(GST_OBJECT(allocator));
+
+	/* The pool must be released to the registry it was acquired
+	 * from, even if a new registry is set in the meantime */
+	if (pool != NULL)
+		blitter_video_transform->output_pool_registry = pool_registry;
+	else
+		gst_object_unref(GST_OBJECT(pool_registry));
+
+	return pool;
+}
+
+
+static void gst_imx_blitter_video_transform_release_output_pool(GstImxBlitterVideoTransform *blitter_video_transform)
+{
+	if (blitter_video_transform->output_pool == NULL)
+		return;
+
+	/* Output frames which are still in use keep a
+	 * reference to the pool, so they stay valid */
+	gst_imx_phys_mem_pool_registry_release_pool(blitter_video_transform->output_pool_registry, blitter_video_transform->output_pool);
+	gst_object_unref(GST_OBJECT(blitter_video_transform->output_pool_registry));
+	blitter_video_transform->output_pool = NULL;
+	blitter_video_transform->output_pool_registry = NULL;
+}
+
+
 
 
 /* frame output */
@@ -1146,6 +1648,19 @@ static GstFlowReturn gst_imx_blitter_video_transform_prepare_output_buffer(GstBa
 		*outbuf = input;
 		return GST_FLOW_OK;
 	}
+	else if (blitter_video_transform->output_pool != NULL)
+	{
+		/* Same as what the base class does with frames from its own pool */
+		GstBaseTransformClass *base_transform_class = GST_BASE_TRANSFORM_GET_CLASS(transform);
+		GstFlowReturn flow_ret = gst_buffer_pool_acquire_buffer(blitter_video_transform->output_pool, outbuf, NULL);
+		if (flow_ret != GST_FLOW_OK)
+			return flow_ret;
+
+		if ((input != NULL) && (base_transform_class->copy_metadata != NULL) && !base_transform_class->copy_metadata(transform, input, *outbuf))
+			GST_ELEMENT_WARNING(transform, STREAM, NOT_IMPLEMENTED, ("could not copy metadata"), (NULL));
+
+		return GST_FLOW_OK;
+	}
 	else
 		return GST_BASE_TRANSFORM_CLASS(gst_imx_blitter_video_transform_parent_class)->prepare_output_buffer(transform, input, outbuf);
 }
@@ -1175,7 +1690,22 @@ static GstFlowReturn gst_imx_blitter_video_transform_transform_frame(GstBaseTran
 	ret = TRUE;
 	ret = ret && gst_imx_base_blitter_set_input_buffer(blitter_video_transform->blitter, in);
 	ret = ret && gst_imx_base_blitter_set_output_buffer(blitter_video_transform->blitter, out);
-	ret = ret && gst_imx_base_blitter_blit(blitter_video_transform->blitter);
+
+#if GST_CHECK_VERSION(1, 6, 0)
+	if (blitter_video_transform->max_frames_in_flight > 1)
+	{
+		/* Only start the blit here; gst_imx_blitter_video_transform_generate_output()
+		 * queues the output buffer, and waits for the blit to finish before the
+		 * buffer is handed to the base class for pushing */
+		GstImxBaseBlitterFence *fence = NULL;
+		ret = ret && ((fence = gst_imx_base_blitter_submit(blitter_video_transform->blitter)) != NULL);
+		blitter_video_transform->submitted_fence = fence;
+	}
+	else
+#endif
+	{
+		ret = ret && gst_imx_base_blitter_blit(blitter_video_transform->blitter);
+	}
 
 	GST_IMX_BLITTER_VIDEO_TRANSFORM_UNLOCK(blitter_video_transform);
 
@@ -1183,6 +1713,146 @@ static GstFlowReturn gst_imx_blitter_video_transform_transform_frame(GstBaseTran
 }
 
 
+#if GST_CHECK_VERSION(1, 6, 0)
+static GstFlowReturn gst_imx_blitter_video_transform_generate_output(GstBaseTransform *transform, GstBuffer **outbuf)
+{
+	GstFlowReturn flow_ret;
+	GstBuffer *buffer = NULL;
+	guint max_frames_in_flight;
+	GstImxBlitterVideoTransform *blitter_video_transform = GST_IMX_BLITTER_VIDEO_TRANSFORM(transform);
+
+	*outbuf = NULL;
+
+	/* Let the base class process the queued input buffer, if there is one.
+	 * If the blit was only submitted, transform_frame() stored its fence
+	 * in submitted_fence. */
+	blitter_video_transform->submitted_fence = NULL;
+	flow_ret = GST_BASE_TRANSFORM_CLASS(gst_imx_blitter_video_transform_parent_class)->generate_output(transform, &buffer);
+
+	if (buffer != NULL)
+	{
+		GstImxBlitterVideoTransformPendingFrame *pending_frame;
+
+		if (flow_ret != GST_FLOW_OK)
+		{
+			gst_buffer_unref(buffer);
+			return flow_ret;
+		}
+
+		pending_frame = g_slice_alloc(sizeof(GstImxBlitterVideoTransformPendingFrame));
+		pending_frame->output_buffer = buffer;
+		pending_frame->fence = blitter_video_transform->submitted_fence;
+		g_queue_push_tail(&(blitter_video_transform->pending_frames), pending_frame);
+
+		/* Buffers without a fence (passed through or blitted synchronously)
+		 * are finished already; output all frames up to them right away */
+		if (pending_frame->fence == NULL)
+			blitter_video_transform->drain_pending_frames = TRUE;
+
+		blitter_video_transform->submitted_fence = NULL;
+	}
+	else if (flow_ret != GST_FLOW_OK)
+		return flow_ret;
+
+	GST_IMX_BLITTER_VIDEO_TRANSFORM_LOCK(blitter_video_transform);
+	max_frames_in_flight = blitter_video_transform->max_frames_in_flight;
+	GST_IMX_BLITTER_VIDEO_TRANSFORM_UNLOCK(blitter_video_transform);
+
+	/* The base class calls this function again after a buffer was pushed,
+	 * until no more buffer is returned, so only one frame is finished per call.
+	 * Returning no buffer while the pipeline fills is not counted as a drop. */
+	if (blitter_video_transform->drain_pending_frames || (g_queue_get_length(&(blitter_video_transform->pending_frames)) >= max_frames_in_flight))
+		flow_ret = gst_imx_blitter_video_transform_finish_oldest_pending_frame(blitter_video_transform, outbuf);
+
+	if (g_queue_is_empty(&(blitter_video_transform->pending_frames)))
+		blitter_video_transform->drain_pending_frames = FALSE;
+
+	return flow_ret;
+}
+#endif
+
+
+static GstFlowReturn gst_imx_blitter_video_transform_finish_oldest_pending_frame(GstImxBlitterVideoTransform *blitter_video_transform, GstBuffer **outbuf)
+{
+	gboolean ret = TRUE;
+	GstImxBlitterVideoTransformPendingFrame *pending_frame;
+	GstBuffer *output_buffer, *exported_buffer;
+	gboolean export_dmabuf;
+
+	*outbuf = NULL;
+
+	pending_frame = g_queue_pop_head(&(blitter_video_transform->pending_frames));
+	if (pending_frame == NULL)
+		return GST_FLOW_OK;
+
+	output_buffer = pending_frame->output_buffer;
+
+	GST_IMX_BLITTER_VIDEO_TRANSFORM_LOCK(blitter_video_transform);
+	if (pending_frame->fence != NULL)
+		ret = gst_imx_base_blitter_wait(blitter_video_transform->blitter, pending_frame->fence);
+	export_dmabuf = blitter_video_transform->export_dmabuf;
+	GST_IMX_BLITTER_VIDEO_TRANSFORM_UNLOCK(blitter_video_transform);
+
+	g_slice_free1(sizeof(GstImxBlitterVideoTransformPendingFrame), pending_frame);
+
+	if (!ret)
+	{
+		GST_ERROR_OBJECT(blitter_video_transform, "blit of pending frame failed");
+		gst_buffer_unref(output_buffer);
+		return GST_FLOW_ERROR;
+	}
+
+	/* The exported buffer keeps a reference to the output buffer,
+	 * so the frame returns to its pool once downstream is done with it */
+	if (export_dmabuf && ((exported_buffer = gst_imx_dmabuf_export_buffer(output_buffer)) != NULL))
+	{
+		gst_buffer_unref(output_buffer);
+		output_buffer = exported_buffer;
+	}
+	else if (export_dmabuf)
+		GST_LOG_OBJECT(blitter_video_transform, "could not export output buffer %" GST_PTR_FORMAT " as DMA-BUF; pushing it as it is", (gpointer)output_buffer);
+
+	*outbuf = output_buffer;
+
+	return GST_FLOW_OK;
+}
+
+
+static GstFlowReturn gst_imx_blitter_video_transform_finish_pending_frames(GstImxBlitterVideoTransform *blitter_video_transform, gboolean push)
+{
+	GstFlowReturn flow_ret = GST_FLOW_OK;
+
+	/* Only used for draining before serialized events and when
+	 * stopping; during streaming, the base class pushes the frames
+	 * returned by gst_imx_blitter_video_transform_generate_output().
+	 * If pushing fails, the remaining frames are still waited for,
+	 * but not pushed anymore */
+	while (!g_queue_is_empty(&(blitter_video_transform->pending_frames)))
+	{
+		GstBuffer *output_buffer;
+		GstFlowReturn cur_flow_ret = gst_imx_blitter_video_transform_finish_oldest_pending_frame(blitter_video_transform, &output_buffer);
+
+		if (output_buffer != NULL)
+		{
+			if (push && (flow_ret == GST_FLOW_OK))
+			{
+				GST_LOG_OBJECT(blitter_video_transform, "pushing finished frame %" GST_PTR_FORMAT, (gpointer)output_buffer);
+				cur_flow_ret = gst_pad_push(GST_BASE_TRANSFORM_SRC_PAD(blitter_video_transform), output_buffer);
+			}
+			else
+				gst_buffer_unref(output_buffer);
+		}
+
+		if (flow_ret == GST_FLOW_OK)
+			flow_ret = cur_flow_ret;
+	}
+
+	blitter_video_transform->drain_pending_frames = FALSE;
+
+	return flow_ret;
+}
+
+
 static gboolean gst_imx_blitter_video_transform_transform_size(G_GNUC_UNUSED GstBaseTransform *transform, G_GNUC_UNUSED GstPadDirection direction, G_GNUC_UNUSED GstCaps *caps, gsize size, GstCaps *othercaps, gsize *othersize)
 {
 	gboolean ret = TRUE;
@@ -1272,5 +1942,30 @@ gboolean gst_imx_blitter_video_transform_set_blitter(GstImxBlitterVideoTransform
 
 	gst_object_ref(GST_OBJECT(blitter_video_transform->blitter));
 
+	{
+		GstImxPhysMemPoolRegistry *pool_registry;
+
+		GST_OBJECT_LOCK(blitter_video_transform);
+		pool_registry = (blitter_video_transform->pool_registry != NULL) ? GST_IMX_PHYS_MEM_POOL_REGISTRY(gst_object_ref(GST_OBJECT(blitter_video_transform->pool_registry))) : NULL;
+		GST_OBJECT_UNLOCK(blitter_video_transform);
+
+		if (pool_registry != NULL)
+		{
+			gst_imx_base_blitter_set_pool_registry(blitter, pool_registry);
+			gst_object_unref(GST_OBJECT(pool_registry));
+		}
+	}
+
 	return TRUE;
 }
+
+
+void gst_imx_blitter_video_transform_set_engine_exclusive(GstImxBlitterVideoTransform *blitter_video_transform, gboolean exclusive)
+{
+	g_assert(blitter_video_transform != NULL);
+
+	blitter_video_transform->engine_exclusive = exclusive;
+
+	if (blitter_video_transform->dispatch_blitter != NULL)
+		gst_imx_dispatch_blitter_set_exclusive_backend(blitter_video_transform->dispatch_blitter, exclusive ? blitter_video_transform->engine_blitter : NULL);
+}
@@ -25,6 +25,7 @@
 #include <gst/video/video.h>
 
 #include "base_blitter.h"
+#include "dispatch_blitter.h"
 
 
 G_BEGIN_DECLS
@@ -72,6 +73,20 @@ struct _GstImxBlitterVideoTransform
 	/* The blitter to be used; is unref'd in the READY->NULL state change */
 	GstImxBaseBlitter *blitter;
 
+	/* Registry for sharing the blitter's internal buffer pools with other
+	 * elements; obtained in the NULL->READY state change. Protected by
+	 * the object lock. */
+	GstImxPhysMemPoolRegistry *pool_registry;
+
+	/* Output frame pool acquired from the registry in decide_allocation if
+	 * downstream did not offer a physical memory pool, together with the
+	 * registry it came from. Output frames are acquired from it directly in
+	 * prepare_output_buffer; it is not handed to the base class, since the
+	 * base class deactivates its pool when the allocation changes, and
+	 * shared pools must only be deactivated by the registry. */
+	GstBufferPool *output_pool;
+	GstImxPhysMemPoolRegistry *output_pool_registry;
+
 	/* Flag to indicate initialization status; FALSE if
 	 * the transform element is in the NULL state, TRUE otherwise */
 	gboolean initialized;
@@ -87,6 +102,39 @@ struct _GstImxBlitterVideoTransform
 
 	/* Flag to indicate if the videocrop meta metadata shall be applied */
 	gboolean input_crop;
+
+	/* Maximum number of frames whose blit operations may be in flight at
+	 * the same time. If this is 1, frames are blitted synchronously. Otherwise,
+	 * blits are started with @gst_imx_base_blitter_submit , and the output
+	 * buffers are handed to the base class for pushing in order once their
+	 * blits are finished (this uses the generate_output vfunc, so with
+	 * GStreamer versions older than 1.6, frames are always blitted synchronously). */
+	guint max_frames_in_flight;
+	/* Output buffers which were not yet handed to the base class; oldest first */
+	GQueue pending_frames;
+	/* If TRUE, the pending frames are output without waiting for
+	 * the queue to fill up */
+	gboolean drain_pending_frames;
+	/* Fence of the blit submitted by the last transform call */
+	GstImxBaseBlitterFence *submitted_fence;
+
+	/* If TRUE, the output pool allocates frames which can be exported as
+	 * DMA-BUFs, and the frames are pushed as DMA-BUF memory (see dmabuf.h).
+	 * Frames which cannot be exported are pushed as they are. Like the
+	 * frames in flight, this requires GStreamer 1.6 or newer. */
+	gboolean export_dmabuf;
+
+	/* Comma separated list of the elements whose engines share the load
+	 * with the element's own engine (see @engine_name in the class) */
+	gchar *load_balance_engines;
+	/* Dispatch blitter wrapping the blitter set in @start if
+	 * load_balance_engines is set, and the wrapped blitter;
+	 * both NULL otherwise. Neither of them is ref'd. */
+	GstImxDispatchBlitter *dispatch_blitter;
+	GstImxBaseBlitter *engine_blitter;
+	/* If TRUE, all frames are routed to engine_blitter
+	 * (see @gst_imx_blitter_video_transform_set_engine_exclusive) */
+	gboolean engine_exclusive;
 };
 
 
@@ -109,6 +157,23 @@ struct _GstImxBlitterVideoTransform
  *                            Returns TRUE if the frame shall always be copied by blitting,
  *                            FALSE if the frame copy shall be done only if the in- and
  *                            output formats are different.
+ * @set_video_infos:          Optional.
+ *                            Called when new caps are set, before the input video info is
+ *                            passed on to the blitter. Derived classes which can choose
+ *                            between several blitters can pick one suitable for the new
+ *                            input and output video infos here, by calling
+ *                            @gst_imx_blitter_video_transform_set_blitter. This is called
+ *                            with the mutex locked.
+ *                            Returns TRUE if it successfully completed, FALSE otherwise.
+ * @engine_name:              Optional.
+ *                            Name of the engine the blitter set in @start uses (for example,
+ *                            "IPU"). If this is set, the blitting work can be shared with
+ *                            other engines by setting the load-balance-engines property: the
+ *                            blitter is then wrapped in a dispatch blitter right after @start,
+ *                            together with the blitters of the listed elements. NULL if the
+ *                            element does not support load balancing (the default).
+ * @engine_capabilities:      Operations the blitter set in @start is capable of. Only used
+ *                            if @engine_name is set.
  *
  * The blitter video transform is an abstract base class for defining blitter-based video transform
  * elements (for colorspace conversion, rotation, deinterlacing etc.)
@@ -130,6 +195,11 @@ struct _GstImxBlitterVideoTransformClass
 	gboolean (*are_video_infos_equal)(GstImxBlitterVideoTransform *blitter_video_transform, GstVideoInfo const *in_info, GstVideoInfo const *out_info);
 
 	gboolean (*are_transforms_necessary)(GstImxBlitterVideoTransform *blitter_video_transform, GstBuffer *input);
+
+	gboolean (*set_video_infos)(GstImxBlitterVideoTransform *blitter_video_transform, GstVideoInfo const *in_info, GstVideoInfo const *out_info);
+
+	gchar const *engine_name;
+	GstImxDispatchBlitterCapabilities engine_capabilities;
 };
 
 
@@ -148,6 +218,17 @@ GType gst_imx_blitter_video_transform_get_type(void);
  */
 gboolean gst_imx_blitter_video_transform_set_blitter(GstImxBlitterVideoTransform *blitter_video_transform, GstImxBaseBlitter *blitter);
 
+/* Routes all frames to the blitter set in @start if exclusive is TRUE, or
+ * re-enables load balancing otherwise. The blitters of the other engines use
+ * their default configuration, so derived classes must call this whenever
+ * a configuration only their own blitter has (rotation, deinterlacing etc.)
+ * is turned on or off. This can be called anytime; the setting is kept
+ * until the next call. Does nothing if load balancing is not in use.
+ * NOTE: This function must be called with a mutex lock. Surround this call
+ * with GST_IS_IMX_BLITTER_VIDEO_TRANSFORM_LOCK/UNLOCK calls.
+ */
+void gst_imx_blitter_video_transform_set_engine_exclusive(GstImxBlitterVideoTransform *blitter_video_transform, gboolean exclusive);
+
 
 G_END_DECLS
 
@@ -0,0 +1,721 @@
+/* i.MX blitter which dispatches blit operations to multiple other blitters
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include "dispatch_blitter.h"
+#include "blitter_video_transform.h"
+
+
+
+GST_DEBUG_CATEGORY_STATIC(imx_dispatch_blitter_debug);
+#define GST_CAT_DEFAULT imx_dispatch_blitter_debug
+
+
+G_DEFINE_TYPE(GstImxDispatchBlitter, gst_imx_dispatch_blitter, GST_TYPE_IMX_BASE_BLITTER)
+
+
+typedef struct
+{
+	GstImxBaseBlitter *blitter;
+	GstCaps *input_caps, *output_caps;
+	GstImxDispatchBlitterCapabilities capabilities;
+
+	/* Video transform element the blitter belongs to if the backend was added
+	 * with @gst_imx_dispatch_blitter_add_backend_elements ; NULL otherwise */
+	GstElement *element;
+
+	/* FALSE if the current input video info has not been passed to the backend yet */
+	gboolean input_video_info_set;
+	/* FALSE if the current output regions have not been passed to the backend yet */
+	gboolean output_regions_set;
+	/* Results of the caps checks for the current input video info
+	 * and output frame format & size */
+	gboolean input_supported, output_supported;
+
+	guint64 num_dispatched_frames;
+}
+GstImxDispatchBlitterBackend;
+
+
+typedef struct
+{
+	GstImxDispatchBlitterBackend *backend;
+	GstImxBaseBlitterFence *fence;
+}
+GstImxDispatchBlitterPendingBlit;
+
+
+/* Private structure storing dispatch blitter specific data */
+struct _GstImxDispatchBlitterPrivate
+{
+	/* Array of GstImxDispatchBlitterBackend pointers, in the order they were added */
+	GPtrArray *backends;
+
+	/* Backend that all frames are routed to, regardless of load;
+	 * NULL if there is none (see @gst_imx_dispatch_blitter_set_exclusive_backend) */
+	GstImxDispatchBlitterBackend *exclusive_backend;
+	GstImxDispatchBlitterBackend *last_backend;
+
+	/* Currently set input and output frames; not ref'd */
+	GstBuffer *input_frame, *output_frame;
+
+	/* Format and size of the current output frame; the backends'
+	 * output_supported flags are only updated if these change */
+	GstVideoFormat output_format;
+	guint output_width, output_height;
+
+	/* Regions from the last @set_output_regions call; only valid if regions_set is TRUE.
+	 * Like with any other blitter, they stay valid until the next call, so they
+	 * are passed to each backend once, and again after they changed. */
+	GstImxBaseBlitterRegion video_region, output_region;
+	gboolean regions_set;
+};
+
+
+/* Number of blits which are running or pending in each engine, across all
+ * dispatch blitters in the process. Engines are identified by the GType of
+ * their blitters, so for example all G2D blitters share one counter. This
+ * way, a dispatch blitter also sees the load caused by other elements. */
+static GMutex engine_loads_mutex;
+static GHashTable *engine_loads = NULL;
+
+
+static void gst_imx_dispatch_blitter_finalize(GObject *object);
+
+static gboolean gst_imx_dispatch_blitter_set_input_video_info(GstImxBaseBlitter *base_blitter, GstVideoInfo *input_video_info);
+static gboolean gst_imx_dispatch_blitter_set_input_frame(GstImxBaseBlitter *base_blitter, GstBuffer *input_frame);
+static gboolean gst_imx_dispatch_blitter_set_output_frame(GstImxBaseBlitter *base_blitter, GstBuffer *output_frame);
+static gboolean gst_imx_dispatch_blitter_set_output_regions(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *video_region, GstImxBaseBlitterRegion const *output_region);
+static GstAllocator* gst_imx_dispatch_blitter_get_phys_mem_allocator(GstImxBaseBlitter *base_blitter);
+static gboolean gst_imx_dispatch_blitter_blit_frame(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *input_region);
+static gboolean gst_imx_dispatch_blitter_flush(GstImxBaseBlitter *base_blitter);
+static gboolean gst_imx_dispatch_blitter_submit_blit(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *input_region, gpointer *handle);
+static gboolean gst_imx_dispatch_blitter_wait_blit(GstImxBaseBlitter *base_blitter, gpointer handle);
+
+static void gst_imx_dispatch_blitter_free_backend(gpointer data);
+static GstImxDispatchBlitterBackend* gst_imx_dispatch_blitter_find_backend(GstImxDispatchBlitter *dispatch_blitter, GstImxBaseBlitter *blitter);
+static gboolean gst_imx_dispatch_blitter_is_backend_usable(GstImxDispatchBlitterBackend *backend, GstImxDispatchBlitterCapabilities required_capabilities);
+static GstImxDispatchBlitterBackend* gst_imx_dispatch_blitter_choose_backend(GstImxDispatchBlitter *dispatch_blitter, GstImxBaseBlitterRegion const *input_region);
+static gboolean gst_imx_dispatch_blitter_prepare_backend(GstImxDispatchBlitter *dispatch_blitter, GstImxDispatchBlitterBackend *backend);
+static GstImxDispatchBlitterBackend* gst_imx_dispatch_blitter_create_backend(GstImxBaseBlitter *blitter, GstCaps *input_caps, GstCaps *output_caps, GstImxDispatchBlitterCapabilities capabilities);
+static guint gst_imx_dispatch_blitter_get_engine_load(GstImxDispatchBlitterBackend *backend);
+static void gst_imx_dispatch_blitter_change_engine_load(GstImxDispatchBlitterBackend *backend, gint delta);
+
+
+
+
+void gst_imx_dispatch_blitter_class_init(GstImxDispatchBlitterClass *klass)
+{
+	GObjectClass *object_class;
+	GstImxBaseBlitterClass *base_class;
+
+	object_class = G_OBJECT_CLASS(klass);
+	base_class = GST_IMX_BASE_BLITTER_CLASS(klass);
+
+	object_class->finalize             = GST_DEBUG_FUNCPTR(gst_imx_dispatch_blitter_finalize);
+	base_class->set_input_video_info   = GST_DEBUG_FUNCPTR(gst_imx_dispatch_blitter_set_input_video_info);
+	base_class->set_input_frame        = GST_DEBUG_FUNCPTR(gst_imx_dispatch_blitter_set_input_frame);
+	base_class->set_output_frame       = GST_DEBUG_FUNCPTR(gst_imx_dispatch_blitter_set_output_frame);
+	base_class->set_output_regions     = GST_DEBUG_FUNCPTR(gst_imx_dispatch_blitter_set_output_regions);
+	base_class->get_phys_mem_allocator = GST_DEBUG_FUNCPTR(gst_imx_dispatch_blitter_get_phys_mem_allocator);
+	base_class->blit_frame             = GST_DEBUG_FUNCPTR(gst_imx_dispatch_blitter_blit_frame);
+	base_class->flush                  = GST_DEBUG_FUNCPTR(gst_imx_dispatch_blitter_flush);
+	base_class->submit_blit            = GST_DEBUG_FUNCPTR(gst_imx_dispatch_blitter_submit_blit);
+	base_class->wait_blit              = GST_DEBUG_FUNCPTR(gst_imx_dispatch_blitter_wait_blit);
+
+	/* Input buffers are passed on to the backends unmodified; the backends
+	 * copy them to physically contiguous memory if they need to. This also
+	 * makes sure the backends see the crop metadata of the input buffers. */
+	base_class->accepts_system_memory = TRUE;
+
+	GST_DEBUG_CATEGORY_INIT(imx_dispatch_blitter_debug, "imxdispatchblitter", 0, "Freescale i.MX dispatch blitter class");
+}
+
+
+void gst_imx_dispatch_blitter_init(GstImxDispatchBlitter *dispatch_blitter)
+{
+	GstImxDispatchBlitterPrivate *priv;
+
+	priv = dispatch_blitter->priv = g_slice_alloc0(sizeof(GstImxDispatchBlitterPrivate));
+
+	priv->backends = g_ptr_array_new_with_free_func(gst_imx_dispatch_blitter_free_backend);
+	priv->exclusive_backend = NULL;
+	priv->last_backend = NULL;
+	priv->output_format = GST_VIDEO_FORMAT_UNKNOWN;
+	priv->regions_set = FALSE;
+
+	dispatch_blitter->required_capabilities = 0;
+}
+
+
+GstImxDispatchBlitter* gst_imx_dispatch_blitter_new(void)
+{
+	GstImxDispatchBlitter* dispatch_blitter = (GstImxDispatchBlitter *)g_object_new(gst_imx_dispatch_blitter_get_type(), NULL);
+
+	return dispatch_blitter;
+}
+
+
+void gst_imx_dispatch_blitter_add_backend(GstImxDispatchBlitter *dispatch_blitter, GstImxBaseBlitter *backend, GstCaps *input_caps, GstCaps *output_caps, GstImxDispatchBlitterCapabilities capabilities)
+{
+	g_assert(backend != NULL);
+	g_assert(input_caps != NULL);
+	g_assert(output_caps != NULL);
+
+	g_ptr_array_add(dispatch_blitter->priv->backends, gst_imx_dispatch_blitter_create_backend(backend, input_caps, output_caps, capabilities));
+
+	/* Make sure the new backend's output support is checked with the next output frame */
+	dispatch_blitter->priv->output_format = GST_VIDEO_FORMAT_UNKNOWN;
+
+	GST_DEBUG_OBJECT(dispatch_blitter, "added backend %" GST_PTR_FORMAT, (gpointer)backend);
+}
+
+
+guint gst_imx_dispatch_blitter_add_backend_elements(GstImxDispatchBlitter *dispatch_blitter, gchar const *factory_names, GstImxDispatchBlitterCapabilities capabilities)
+{
+	gchar **names;
+	guint i, num_added = 0;
+
+	g_assert(factory_names != NULL);
+
+	names = g_strsplit(factory_names, ",", -1);
+
+	for (i = 0; names[i] != NULL; ++i)
+	{
+		gchar const *name = g_strstrip(names[i]);
+		GstElement *element;
+		GstPad *sinkpad, *srcpad;
+		GstCaps *input_caps, *output_caps;
+		GstImxDispatchBlitterBackend *entry;
+
+		if (name[0] == '\0')
+			continue;
+
+		element = gst_element_factory_make(name, NULL);
+		if (element == NULL)
+		{
+			GST_WARNING_OBJECT(dispatch_blitter, "cannot add backend: element %s not found", name);
+			continue;
+		}
+
+		if (!GST_IS_IMX_BLITTER_VIDEO_TRANSFORM(element))
+		{
+			GST_WARNING_OBJECT(dispatch_blitter, "cannot add backend: element %s is not a blitter video transform", name);
+			gst_object_unref(GST_OBJECT(element));
+			continue;
+		}
+
+		/* Switching to READY creates the element's blitter and opens its engine */
+		if (gst_element_set_state(element, GST_STATE_READY) == GST_STATE_CHANGE_FAILURE)
+		{
+			GST_WARNING_OBJECT(dispatch_blitter, "cannot add backend: element %s could not be started", name);
+			gst_object_unref(GST_OBJECT(element));
+			continue;
+		}
+
+		sinkpad = gst_element_get_static_pad(element, "sink");
+		srcpad = gst_element_get_static_pad(element, "src");
+		input_caps = gst_pad_get_pad_template_caps(sinkpad);
+		output_caps = gst_pad_get_pad_template_caps(srcpad);
+
+		entry = gst_imx_dispatch_blitter_create_backend(GST_IMX_BLITTER_VIDEO_TRANSFORM(element)->blitter, input_caps, output_caps, capabilities);
+		entry->element = element;
+		g_ptr_array_add(dispatch_blitter->priv->backends, entry);
+
+		gst_caps_unref(input_caps);
+		gst_caps_unref(output_caps);
+		gst_object_unref(GST_OBJECT(sinkpad));
+		gst_object_unref(GST_OBJECT(srcpad));
+
+		GST_DEBUG_OBJECT(dispatch_blitter, "added backend %" GST_PTR_FORMAT " of element %s", (gpointer)(entry->blitter), name);
+
+		num_added++;
+	}
+
+	g_strfreev(names);
+
+	dispatch_blitter->priv->output_format = GST_VIDEO_FORMAT_UNKNOWN;
+
+	return num_added;
+}
+
+
+void gst_imx_dispatch_blitter_set_exclusive_backend(GstImxDispatchBlitter *dispatch_blitter, GstImxBaseBlitter *backend)
+{
+	GstImxDispatchBlitterBackend *entry = NULL;
+
+	if (backend != NULL)
+	{
+		entry = gst_imx_dispatch_blitter_find_backend(dispatch_blitter, backend);
+		g_assert(entry != NULL);
+	}
+
+	dispatch_blitter->priv->exclusive_backend = entry;
+}
+
+
+void gst_imx_dispatch_blitter_set_required_capabilities(GstImxDispatchBlitter *dispatch_blitter, GstImxDispatchBlitterCapabilities capabilities)
+{
+	dispatch_blitter->required_capabilities = capabilities;
+}
+
+
+GstImxBaseBlitter* gst_imx_dispatch_blitter_get_last_backend(GstImxDispatchBlitter *dispatch_blitter)
+{
+	return (dispatch_blitter->priv->last_backend != NULL) ? dispatch_blitter->priv->last_backend->blitter : NULL;
+}
+
+
+static void gst_imx_dispatch_blitter_finalize(GObject *object)
+{
+	guint i;
+	GstImxDispatchBlitter *dispatch_blitter = GST_IMX_DISPATCH_BLITTER(object);
+	GstImxDispatchBlitterPrivate *priv = dispatch_blitter->priv;
+
+	for (i = 0; i < priv->backends->len; ++i)
+	{
+		GstImxDispatchBlitterBackend *backend = g_ptr_array_index(priv->backends, i);
+		GST_DEBUG_OBJECT(dispatch_blitter, "backend %" GST_PTR_FORMAT ": %" G_GUINT64_FORMAT " frame(s) dispatched", (gpointer)(backend->blitter), backend->num_dispatched_frames);
+	}
+
+	g_ptr_array_free(priv->backends, TRUE);
+	g_slice_free1(sizeof(GstImxDispatchBlitterPrivate), priv);
+
+	G_OBJECT_CLASS(gst_imx_dispatch_blitter_parent_class)->finalize(object);
+}
+
+
+static gboolean gst_imx_dispatch_blitter_set_input_video_info(GstImxBaseBlitter *base_blitter, GstVideoInfo *input_video_info)
+{
+	guint i;
+	gboolean any_supported = FALSE;
+	GstImxDispatchBlitter *dispatch_blitter = GST_IMX_DISPATCH_BLITTER(base_blitter);
+	GstImxDispatchBlitterPrivate *priv = dispatch_blitter->priv;
+	GstCaps *caps;
+
+	caps = gst_video_info_to_caps(input_video_info);
+
+	/* The video info is passed to each backend when it is
+	 * chosen for the first time after this call */
+	for (i = 0; i < priv->backends->len; ++i)
+	{
+		GstImxDispatchBlitterBackend *backend = g_ptr_array_index(priv->backends, i);
+		backend->input_video_info_set = FALSE;
+		backend->input_supported = gst_caps_can_intersect(caps, backend->input_caps);
+		any_supported = any_supported || backend->input_supported;
+
+		GST_DEBUG_OBJECT(dispatch_blitter, "backend %" GST_PTR_FORMAT " supports input caps: %d", (gpointer)(backend->blitter), backend->input_supported);
+	}
+
+	gst_caps_unref(caps);
+
+	if (!any_supported)
+	{
+		GST_ERROR_OBJECT(dispatch_blitter, "none of the backends supports the input video info");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+static gboolean gst_imx_dispatch_blitter_set_input_frame(GstImxBaseBlitter *base_blitter, GstBuffer *input_frame)
+{
+	GST_IMX_DISPATCH_BLITTER(base_blitter)->priv->input_frame = input_frame;
+	return TRUE;
+}
+
+
+static gboolean gst_imx_dispatch_blitter_set_output_frame(GstImxBaseBlitter *base_blitter, GstBuffer *output_frame)
+{
+	GstImxDispatchBlitter *dispatch_blitter = GST_IMX_DISPATCH_BLITTER(base_blitter);
+	GstImxDispatchBlitterPrivate *priv = dispatch_blitter->priv;
+	GstVideoMeta *video_meta;
+
+	video_meta = gst_buffer_get_video_meta(output_frame);
+	g_assert(video_meta != NULL);
+
+	priv->output_frame = output_frame;
+
+	if ((video_meta->format != priv->output_format) || (video_meta->width != priv->output_width) || (video_meta->height != priv->output_height))
+	{
+		guint i;
+		GstCaps *caps = gst_caps_new_simple(
+			"video/x-raw",
+			"format", G_TYPE_STRING, gst_video_format_to_string(video_meta->format),
+			"width", G_TYPE_INT, (gint)(video_meta->width),
+			"height", G_TYPE_INT, (gint)(video_meta->height),
+			NULL
+		);
+
+		for (i = 0; i < priv->backends->len; ++i)
+		{
+			GstImxDispatchBlitterBackend *backend = g_ptr_array_index(priv->backends, i);
+			backend->output_supported = gst_caps_can_intersect(caps, backend->output_caps);
+			/* The backends clip the regions against the output frame size */
+			backend->output_regions_set = FALSE;
+
+			GST_DEBUG_OBJECT(dispatch_blitter, "backend %" GST_PTR_FORMAT " supports output caps %" GST_PTR_FORMAT ": %d", (gpointer)(backend->blitter), (gpointer)caps, backend->output_supported);
+		}
+
+		gst_caps_unref(caps);
+
+		priv->output_format = video_meta->format;
+		priv->output_width = video_meta->width;
+		priv->output_height = video_meta->height;
+	}
+
+	return TRUE;
+}
+
+
+static gboolean gst_imx_dispatch_blitter_set_output_regions(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *video_region, GstImxBaseBlitterRegion const *output_region)
+{
+	guint i;
+	GstImxDispatchBlitterPrivate *priv = GST_IMX_DISPATCH_BLITTER(base_blitter)->priv;
+
+	priv->video_region = *video_region;
+	priv->output_region = *output_region;
+	priv->regions_set = TRUE;
+
+	/* The regions are passed on to each backend when it is chosen next */
+	for (i = 0; i < priv->backends->len; ++i)
+		((GstImxDispatchBlitterBackend *)g_ptr_array_index(priv->backends, i))->output_regions_set = FALSE;
+
+	return TRUE;
+}
+
+
+static GstAllocator* gst_imx_dispatch_blitter_get_phys_mem_allocator(GstImxBaseBlitter *base_blitter)
+{
+	guint i;
+	GstImxDispatchBlitterPrivate *priv = GST_IMX_DISPATCH_BLITTER(base_blitter)->priv;
+	GstImxBaseBlitter *chosen = NULL;
+
+	/* Prefer a backend which needs physically contiguous memory, since
+	 * memory from its allocator can be used by all the other backends */
+	for (i = 0; i < priv->backends->len; ++i)
+	{
+		GstImxDispatchBlitterBackend *backend = g_ptr_array_index(priv->backends, i);
+		if (!(GST_IMX_BASE_BLITTER_GET_CLASS(backend->blitter)->accepts_system_memory))
+		{
+			chosen = backend->blitter;
+			break;
+		}
+	}
+
+	if ((chosen == NULL) && (priv->backends->len > 0))
+		chosen = ((GstImxDispatchBlitterBackend *)g_ptr_array_index(priv->backends, 0))->blitter;
+
+	if (chosen == NULL)
+	{
+		GST_ERROR_OBJECT(base_blitter, "no backends added - cannot get allocator");
+		return NULL;
+	}
+
+	return gst_imx_base_blitter_get_phys_mem_allocator(chosen);
+}
+
+
+static gboolean gst_imx_dispatch_blitter_blit_frame(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *input_region)
+{
+	gboolean ret;
+	GstImxDispatchBlitter *dispatch_blitter = GST_IMX_DISPATCH_BLITTER(base_blitter);
+	GstImxDispatchBlitterBackend *backend;
+
+	backend = gst_imx_dispatch_blitter_choose_backend(dispatch_blitter, input_region);
+	if (backend == NULL)
+		return FALSE;
+
+	if (!gst_imx_dispatch_blitter_prepare_backend(dispatch_blitter, backend))
+		return FALSE;
+
+	/* Synchronous blits count as load while they run, so that
+	 * dispatch blitters in other threads can avoid the engine */
+	gst_imx_dispatch_blitter_change_engine_load(backend, 1);
+	ret = gst_imx_base_blitter_blit(backend->blitter);
+	gst_imx_dispatch_blitter_change_engine_load(backend, -1);
+
+	return ret;
+}
+
+
+static gboolean gst_imx_dispatch_blitter_flush(GstImxBaseBlitter *base_blitter)
+{
+	guint i;
+	gboolean ret = TRUE;
+	GstImxDispatchBlitterPrivate *priv = GST_IMX_DISPATCH_BLITTER(base_blitter)->priv;
+
+	for (i = 0; i < priv->backends->len; ++i)
+	{
+		GstImxDispatchBlitterBackend *backend = g_ptr_array_index(priv->backends, i);
+		ret = gst_imx_base_blitter_flush(backend->blitter) && ret;
+	}
+
+	return ret;
+}
+
+
+static gboolean gst_imx_dispatch_blitter_submit_blit(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *input_region, gpointer *handle)
+{
+	GstImxDispatchBlitter *dispatch_blitter = GST_IMX_DISPATCH_BLITTER(base_blitter);
+	GstImxDispatchBlitterBackend *backend;
+	GstImxDispatchBlitterPendingBlit *pending_blit;
+	GstImxBaseBlitterFence *fence;
+
+	backend = gst_imx_dispatch_blitter_choose_backend(dispatch_blitter, input_region);
+	if (backend == NULL)
+		return FALSE;
+
+	if (!gst_imx_dispatch_blitter_prepare_backend(dispatch_blitter, backend))
+		return FALSE;
+
+	fence = gst_imx_base_blitter_submit(backend->blitter);
+	if (fence == NULL)
+		return FALSE;
+
+	gst_imx_dispatch_blitter_change_engine_load(backend, 1);
+
+	pending_blit = g_slice_alloc(sizeof(GstImxDispatchBlitterPendingBlit));
+	pending_blit->backend = backend;
+	pending_blit->fence = fence;
+	*handle = pending_blit;
+
+	return TRUE;
+}
+
+
+static gboolean gst_imx_dispatch_blitter_wait_blit(G_GNUC_UNUSED GstImxBaseBlitter *base_blitter, gpointer handle)
+{
+	gboolean ret;
+	GstImxDispatchBlitterPendingBlit *pending_blit = (GstImxDispatchBlitterPendingBlit *)handle;
+	GstImxDispatchBlitterBackend *backend = pending_blit->backend;
+
+	/* Fences are waited for in submission order, and the fences of
+	 * each backend are a subsequence of them, so the backends also
+	 * get their fences in the right order */
+	ret = gst_imx_base_blitter_wait(backend->blitter, pending_blit->fence);
+
+	gst_imx_dispatch_blitter_change_engine_load(backend, -1);
+
+	g_slice_free1(sizeof(GstImxDispatchBlitterPendingBlit), pending_blit);
+
+	return ret;
+}
+
+
+static void gst_imx_dispatch_blitter_free_backend(gpointer data)
+{
+	GstImxDispatchBlitterBackend *backend = (GstImxDispatchBlitterBackend *)data;
+
+	gst_caps_unref(backend->input_caps);
+	gst_caps_unref(backend->output_caps);
+	gst_object_unref(GST_OBJECT(backend->blitter));
+
+	if (backend->element != NULL)
+	{
+		gst_element_set_state(backend->element, GST_STATE_NULL);
+		gst_object_unref(GST_OBJECT(backend->element));
+	}
+
+	g_slice_free1(sizeof(GstImxDispatchBlitterBackend), backend);
+}
+
+
+static GstImxDispatchBlitterBackend* gst_imx_dispatch_blitter_find_backend(GstImxDispatchBlitter *dispatch_blitter, GstImxBaseBlitter *blitter)
+{
+	guint i;
+	GstImxDispatchBlitterPrivate *priv = dispatch_blitter->priv;
+
+	for (i = 0; i < priv->backends->len; ++i)
+	{
+		GstImxDispatchBlitterBackend *backend = g_ptr_array_index(priv->backends, i);
+		if (backend->blitter == blitter)
+			return backend;
+	}
+
+	return NULL;
+}
+
+
+static gboolean gst_imx_dispatch_blitter_is_backend_usable(GstImxDispatchBlitterBackend *backend, GstImxDispatchBlitterCapabilities required_capabilities)
+{
+	return
+		backend->input_supported &&
+		backend->output_supported &&
+		((backend->capabilities & required_capabilities) == required_capabilities)
+		;
+}
+
+
+static GstImxDispatchBlitterBackend* gst_imx_dispatch_blitter_choose_backend(GstImxDispatchBlitter *dispatch_blitter, GstImxBaseBlitterRegion const *input_region)
+{
+	guint i;
+	gint in_width, in_height, vid_width, vid_height;
+	guint chosen_load = 0;
+	GstImxDispatchBlitterPrivate *priv = dispatch_blitter->priv;
+	GstImxDispatchBlitterCapabilities required_capabilities = dispatch_blitter->required_capabilities;
+	GstImxDispatchBlitterBackend *chosen = NULL;
+
+	/* Scaling is necessary if the input region does not fit the video region
+	 * (taking 90 degree rotations into account, which swap width and height) */
+	in_width = input_region->x2 - input_region->x1;
+	in_height = input_region->y2 - input_region->y1;
+	if (priv->regions_set)
+	{
+		vid_width = priv->video_region.x2 - priv->video_region.x1;
+		vid_height = priv->video_region.y2 - priv->video_region.y1;
+	}
+	else
+	{
+		vid_width = priv->output_width;
+		vid_height = priv->output_height;
+	}
+
+	if (!(((in_width == vid_width) && (in_height == vid_height)) || ((in_width == vid_height) && (in_height == vid_width))))
+		required_capabilities |= GST_IMX_DISPATCH_BLITTER_CAPABILITY_SCALING;
+
+	if (priv->exclusive_backend != NULL)
+	{
+		chosen = priv->exclusive_backend;
+		if (!gst_imx_dispatch_blitter_is_backend_usable(chosen, required_capabilities))
+		{
+			GST_ERROR_OBJECT(dispatch_blitter, "exclusive backend %" GST_PTR_FORMAT " does not support the current input/output formats and the required capabilities 0x%x", (gpointer)(chosen->blitter), (guint)required_capabilities);
+			return NULL;
+		}
+	}
+	else
+	{
+		/* Pick the backend whose engine is least loaded; with
+		 * equal loads, the one added first wins */
+		for (i = 0; i < priv->backends->len; ++i)
+		{
+			guint load;
+			GstImxDispatchBlitterBackend *backend = g_ptr_array_index(priv->backends, i);
+
+			if (!gst_imx_dispatch_blitter_is_backend_usable(backend, required_capabilities))
+				continue;
+
+			load = gst_imx_dispatch_blitter_get_engine_load(backend);
+			if ((chosen == NULL) || (load < chosen_load))
+			{
+				chosen = backend;
+				chosen_load = load;
+			}
+		}
+
+		if (chosen == NULL)
+		{
+			GST_ERROR_OBJECT(dispatch_blitter, "no backend supports the current input/output formats and the required capabilities 0x%x", (guint)required_capabilities);
+			return NULL;
+		}
+	}
+
+	if (chosen != priv->last_backend)
+		GST_DEBUG_OBJECT(dispatch_blitter, "switching to backend %" GST_PTR_FORMAT " (engine load: %u)", (gpointer)(chosen->blitter), gst_imx_dispatch_blitter_get_engine_load(chosen));
+
+	priv->last_backend = chosen;
+	chosen->num_dispatched_frames++;
+
+	return chosen;
+}
+
+
+static gboolean gst_imx_dispatch_blitter_prepare_backend(GstImxDispatchBlitter *dispatch_blitter, GstImxDispatchBlitterBackend *backend)
+{
+	GstImxBaseBlitter *base_blitter = GST_IMX_BASE_BLITTER(dispatch_blitter);
+	GstImxDispatchBlitterPrivate *priv = dispatch_blitter->priv;
+
+	if (!(backend->input_video_info_set))
+	{
+		if (!gst_imx_base_blitter_set_input_video_info(backend->blitter, &(base_blitter->input_video_info)))
+		{
+			GST_ERROR_OBJECT(dispatch_blitter, "could not set input video info of backend %" GST_PTR_FORMAT, (gpointer)(backend->blitter));
+			return FALSE;
+		}
+		backend->input_video_info_set = TRUE;
+	}
+
+	gst_imx_base_blitter_enable_crop(backend->blitter, gst_imx_base_blitter_is_crop_enabled(base_blitter));
+
+	if (!gst_imx_base_blitter_set_input_buffer(backend->blitter, priv->input_frame))
+		return FALSE;
+	if (!gst_imx_base_blitter_set_output_buffer(backend->blitter, priv->output_frame))
+		return FALSE;
+
+	/* The regions are set after the output buffer, since the backend
+	 * clips them against the output buffer's size */
+	if (priv->regions_set && !(backend->output_regions_set))
+	{
+		if (!gst_imx_base_blitter_set_output_regions(backend->blitter, &(priv->video_region), &(priv->output_region)))
+			return FALSE;
+		backend->output_regions_set = TRUE;
+	}
+
+	return TRUE;
+}
+
+
+static GstImxDispatchBlitterBackend* gst_imx_dispatch_blitter_create_backend(GstImxBaseBlitter *blitter, GstCaps *input_caps, GstCaps *output_caps, GstImxDispatchBlitterCapabilities capabilities)
+{
+	GstImxDispatchBlitterBackend *backend;
+
+	backend = g_slice_alloc0(sizeof(GstImxDispatchBlitterBackend));
+	backend->blitter = gst_object_ref(blitter);
+	backend->input_caps = gst_caps_ref(input_caps);
+	backend->output_caps = gst_caps_ref(output_caps);
+	backend->capabilities = capabilities;
+	backend->element = NULL;
+	backend->input_video_info_set = FALSE;
+	backend->output_regions_set = FALSE;
+	backend->input_supported = FALSE;
+	backend->output_supported = FALSE;
+
+	return backend;
+}
+
+
+static guint gst_imx_dispatch_blitter_get_engine_load(GstImxDispatchBlitterBackend *backend)
+{
+	guint load = 0;
+
+	g_mutex_lock(&engine_loads_mutex);
+	if (engine_loads != NULL)
+		load = GPOINTER_TO_UINT(g_hash_table_lookup(engine_loads, GSIZE_TO_POINTER(G_OBJECT_TYPE(backend->blitter))));
+	g_mutex_unlock(&engine_loads_mutex);
+
+	return load;
+}
+
+
+static void gst_imx_dispatch_blitter_change_engine_load(GstImxDispatchBlitterBackend *backend, gint delta)
+{
+	gpointer key = GSIZE_TO_POINTER(G_OBJECT_TYPE(backend->blitter));
+	guint load;
+
+	g_mutex_lock(&engine_loads_mutex);
+
+	if (engine_loads == NULL)
+		engine_loads = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	load = GPOINTER_TO_UINT(g_hash_table_lookup(engine_loads, key));
+	g_assert((delta > 0) || (load >= (guint)(-delta)));
+	g_hash_table_insert(engine_loads, key, GUINT_TO_POINTER(load + delta));
+
+	g_mutex_unlock(&engine_loads_mutex);
+}
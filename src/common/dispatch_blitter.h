@@ -0,0 +1,146 @@
+/* i.MX blitter which dispatches blit operations to multiple other blitters
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#ifndef GST_IMX_COMMON_DISPATCH_BLITTER_H
+#define GST_IMX_COMMON_DISPATCH_BLITTER_H
+
+#include "base_blitter.h"
+
+
+G_BEGIN_DECLS
+
+
+typedef struct _GstImxDispatchBlitter GstImxDispatchBlitter;
+typedef struct _GstImxDispatchBlitterClass GstImxDispatchBlitterClass;
+typedef struct _GstImxDispatchBlitterPrivate GstImxDispatchBlitterPrivate;
+
+
+#define GST_TYPE_IMX_DISPATCH_BLITTER             (gst_imx_dispatch_blitter_get_type())
+#define GST_IMX_DISPATCH_BLITTER(obj)             (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_IMX_DISPATCH_BLITTER, GstImxDispatchBlitter))
+#define GST_IMX_DISPATCH_BLITTER_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_IMX_DISPATCH_BLITTER, GstImxDispatchBlitterClass))
+#define GST_IMX_DISPATCH_BLITTER_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS((obj), GST_TYPE_IMX_DISPATCH_BLITTER, GstImxDispatchBlitterClass))
+#define GST_IS_IMX_DISPATCH_BLITTER(obj)          (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_IMX_DISPATCH_BLITTER))
+#define GST_IS_IMX_DISPATCH_BLITTER_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_IMX_DISPATCH_BLITTER))
+
+
+/**
+ * The dispatch blitter wraps several other blitters (the "backends", for
+ * example one blitter for each of the IPU, G2D, and PxP engines), and
+ * routes each frame to one of them. It is itself a GstImxBaseBlitter, so
+ * it can be passed to @gst_imx_blitter_video_transform_set_blitter and
+ * @gst_imx_blitter_video_sink_set_blitter like any other blitter.
+ *
+ * Out of the backends which support the current input and output formats
+ * and sizes and the required capabilities, the one whose engine has the
+ * least blit operations in flight is chosen. The load of an engine is counted
+ * across all dispatch blitters in the process, and includes asynchronously
+ * submitted blits (see @gst_imx_base_blitter_submit) as well as synchronous
+ * blits that are currently running. With equal loads, the backend added
+ * first wins, so the order in which backends are added defines their priority.
+ *
+ * Backends which need to see every frame (for example, an IPU blitter which
+ * deinterlaces) must be made exclusive with
+ * @gst_imx_dispatch_blitter_set_exclusive_backend while they do so.
+ */
+
+
+/**
+ * GstImxDispatchBlitterCapabilities:
+ *
+ * Operations a backend is capable of. Scaling is required automatically
+ * if the input region size differs from the video region size. Other
+ * capabilities are required by calling
+ * @gst_imx_dispatch_blitter_set_required_capabilities.
+ */
+typedef enum
+{
+	GST_IMX_DISPATCH_BLITTER_CAPABILITY_SCALING       = (1 << 0),
+	GST_IMX_DISPATCH_BLITTER_CAPABILITY_ROTATION      = (1 << 1),
+	GST_IMX_DISPATCH_BLITTER_CAPABILITY_DEINTERLACING = (1 << 2)
+}
+GstImxDispatchBlitterCapabilities;
+
+
+struct _GstImxDispatchBlitter
+{
+	GstImxBaseBlitter parent;
+	GstImxDispatchBlitterPrivate *priv;
+
+	GstImxDispatchBlitterCapabilities required_capabilities;
+};
+
+
+struct _GstImxDispatchBlitterClass
+{
+	GstImxBaseBlitterClass parent_class;
+};
+
+
+GType gst_imx_dispatch_blitter_get_type(void);
+
+GstImxDispatchBlitter* gst_imx_dispatch_blitter_new(void);
+
+/* Adds a backend blitter.
+ *
+ * The dispatch blitter refs the backend. input_caps and output_caps describe
+ * the formats and sizes the backend can handle (typically, these are the caps
+ * of the pad templates of the corresponding video transform element). They
+ * are ref'd as well. capabilities are the operations supported by the backend.
+ * Backends must be configured (rotation etc.) by the caller; the dispatch
+ * blitter only forwards frames and regions to them.
+ *
+ * Physically contiguous memory is allocated with the allocator of the first
+ * added backend which cannot access system memory, so that all backends can
+ * access the output buffers. Add hardware backends before software ones.
+ */
+void gst_imx_dispatch_blitter_add_backend(GstImxDispatchBlitter *dispatch_blitter, GstImxBaseBlitter *backend, GstCaps *input_caps, GstCaps *output_caps, GstImxDispatchBlitterCapabilities capabilities);
+
+/* Adds the blitters of other engines' video transform elements as backends.
+ *
+ * factory_names is a comma separated list of element factory names, for example
+ * "imxpxpvideotransform,imxipuvideotransform". Each element is created and switched
+ * to the READY state, which creates its blitter and opens its engine; the element
+ * is kept in the READY state until the dispatch blitter is finalized. The pad
+ * template caps of the element are used as input and output caps. The blitters
+ * are used with their default configuration (no rotation etc.).
+ *
+ * Elements which do not exist or cannot be started are skipped with a warning.
+ * Returns the number of added backends.
+ */
+guint gst_imx_dispatch_blitter_add_backend_elements(GstImxDispatchBlitter *dispatch_blitter, gchar const *factory_names, GstImxDispatchBlitterCapabilities capabilities);
+
+/* Routes all frames to the given backend, regardless of the load, until this
+ * is called again. Useful while a configuration is active which only this
+ * backend has (for example, a rotation that was set only in this backend, or
+ * deinterlacing, which needs all frames).
+ * NULL re-enables load balancing. */
+void gst_imx_dispatch_blitter_set_exclusive_backend(GstImxDispatchBlitter *dispatch_blitter, GstImxBaseBlitter *backend);
+
+/* Sets the capabilities a backend must have to be chosen. */
+void gst_imx_dispatch_blitter_set_required_capabilities(GstImxDispatchBlitter *dispatch_blitter, GstImxDispatchBlitterCapabilities capabilities);
+
+/* Returns the backend which was chosen for the most recent frame, or NULL
+ * if no frame was dispatched yet. The backend is not ref'd. */
+GstImxBaseBlitter* gst_imx_dispatch_blitter_get_last_backend(GstImxDispatchBlitter *dispatch_blitter);
+
+
+G_END_DECLS
+
+
+#endif
@@ -0,0 +1,353 @@
+/* Allocator for DMA-BUF backed physical memory from a DMA heap
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include <config.h>
+
+#ifdef HAVE_IMX_DMA_HEAP
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/dma-heap.h>
+#include <linux/dma-buf.h>
+#include "dma_heap_allocator.h"
+
+
+GST_DEBUG_CATEGORY_STATIC(imx_dma_heap_allocator_debug);
+#define GST_CAT_DEFAULT imx_dma_heap_allocator_debug
+
+
+static void gst_imx_dma_heap_allocator_finalize(GObject *object);
+
+static gboolean gst_imx_dma_heap_alloc_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, gssize size);
+static gboolean gst_imx_dma_heap_free_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory);
+static gpointer gst_imx_dma_heap_map_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *phys_mem, gssize size, GstMapFlags flags);
+static void gst_imx_dma_heap_unmap_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *phys_mem);
+
+
+G_DEFINE_TYPE(GstImxDmaHeapAllocator, gst_imx_dma_heap_allocator, GST_TYPE_IMX_PHYS_MEM_ALLOCATOR)
+
+
+
+
+static void gst_imx_dma_heap_init_debug(void)
+{
+	static gsize initialized = 0;
+
+	if (g_once_init_enter(&initialized))
+	{
+		GST_DEBUG_CATEGORY_INIT(imx_dma_heap_allocator_debug, "imxdmaheapallocator", 0, "DMA heap physical memory allocator");
+		g_once_init_leave(&initialized, 1);
+	}
+}
+
+
+static int gst_imx_dma_heap_open_device(void)
+{
+	int heap_fd;
+	gchar const *device;
+
+	device = g_getenv("GST_IMX_DMA_HEAP_DEVICE");
+	if (device == NULL)
+		device = GST_IMX_DMA_HEAP_ALLOCATOR_DEFAULT_DEVICE;
+
+	heap_fd = open(device, O_RDWR | O_CLOEXEC);
+	if (heap_fd < 0)
+		GST_ERROR("could not open DMA heap device %s: %s", device, strerror(errno));
+	else
+		GST_INFO("opened DMA heap device %s", device);
+
+	return heap_fd;
+}
+
+
+GstAllocator* gst_imx_dma_heap_allocator_new(void)
+{
+	int heap_fd;
+	GstImxDmaHeapAllocator *allocator;
+
+	gst_imx_dma_heap_init_debug();
+
+	heap_fd = gst_imx_dma_heap_open_device();
+	if (heap_fd < 0)
+		return NULL;
+
+	allocator = g_object_new(gst_imx_dma_heap_allocator_get_type(), NULL);
+	allocator->heap_fd = heap_fd;
+
+	return GST_ALLOCATOR_CAST(allocator);
+}
+
+
+static void gst_imx_dma_heap_sync(GstImxPhysMemory *memory, guint64 flags)
+{
+	struct dma_buf_sync sync;
+
+	sync.flags = flags;
+	if (ioctl(memory->dmabuf_fd, DMA_BUF_IOCTL_SYNC, &sync) < 0)
+		GST_ERROR("syncing DMA-BUF with paddr %" GST_IMX_PHYS_ADDR_FORMAT " failed: %s", memory->phys_addr, strerror(errno));
+}
+
+
+static gboolean gst_imx_dma_heap_alloc_dmabuf(int heap_fd, GstImxPhysMemory *memory, gsize size)
+{
+	struct dma_heap_allocation_data alloc_data;
+	unsigned long phys_addr;
+
+	memset(&alloc_data, 0, sizeof(alloc_data));
+	alloc_data.len = size;
+	alloc_data.fd_flags = O_RDWR | O_CLOEXEC;
+
+	if (ioctl(heap_fd, DMA_HEAP_IOCTL_ALLOC, &alloc_data) < 0)
+	{
+		GST_ERROR("could not allocate %" G_GSIZE_FORMAT " bytes from the DMA heap: %s", size, strerror(errno));
+		return FALSE;
+	}
+
+	if (ioctl(alloc_data.fd, DMA_BUF_IOCTL_PHYS, &phys_addr) < 0)
+	{
+		GST_ERROR("could not get physical address of DMA-BUF: %s", strerror(errno));
+		close(alloc_data.fd);
+		return FALSE;
+	}
+
+	/* DMA heap memory is mapped cached; the kernel performs
+	 * the cache maintenance when it is mapped and unmapped */
+	memory->phys_addr = (gst_imx_phys_addr_t)phys_addr;
+	memory->dmabuf_fd = alloc_data.fd;
+	memory->cache_policy = GST_IMX_PHYS_MEM_CACHE_POLICY_CACHED;
+
+	GST_DEBUG("allocated %" G_GSIZE_FORMAT " bytes from the DMA heap, fd %d paddr %" GST_IMX_PHYS_ADDR_FORMAT, size, alloc_data.fd, memory->phys_addr);
+
+	return TRUE;
+}
+
+
+static void gst_imx_dma_heap_free_dmabuf(GstImxPhysMemory *memory)
+{
+	GST_DEBUG("freeing DMA-BUF fd %d paddr %" GST_IMX_PHYS_ADDR_FORMAT, memory->dmabuf_fd, memory->phys_addr);
+
+	/* The kernel frees the memory once the DMA-BUF is no longer referenced,
+	 * so exported file descriptors remain valid */
+	close(memory->dmabuf_fd);
+	memory->dmabuf_fd = -1;
+}
+
+
+static gpointer gst_imx_dma_heap_map_dmabuf(GstImxPhysMemory *memory, gsize size, GstMapFlags flags)
+{
+	int prot = 0;
+	guint64 sync_flags = 0;
+
+	g_assert(memory->mapped_virt_addr == NULL);
+
+	if (flags & GST_MAP_READ)
+	{
+		prot |= PROT_READ;
+		sync_flags |= DMA_BUF_SYNC_READ;
+	}
+	if (flags & GST_MAP_WRITE)
+	{
+		prot |= PROT_WRITE;
+		sync_flags |= DMA_BUF_SYNC_WRITE;
+	}
+
+	memory->mapped_virt_addr = mmap(0, size, prot, MAP_SHARED, memory->dmabuf_fd, 0);
+	if (memory->mapped_virt_addr == MAP_FAILED)
+	{
+		memory->mapped_virt_addr = NULL;
+		GST_ERROR("memory-mapping the DMA-BUF failed: %s", strerror(errno));
+		return NULL;
+	}
+
+	/* let the kernel perform the cache maintenance */
+	gst_imx_dma_heap_sync(memory, DMA_BUF_SYNC_START | sync_flags);
+
+	GST_LOG("mapped DMA-BUF:  virt addr %p  phys addr %" GST_IMX_PHYS_ADDR_FORMAT, memory->mapped_virt_addr, memory->phys_addr);
+
+	return memory->mapped_virt_addr;
+}
+
+
+static void gst_imx_dma_heap_unmap_dmabuf(GstImxPhysMemory *memory, GstMapFlags flags)
+{
+	if (memory->mapped_virt_addr != NULL)
+	{
+		guint64 sync_flags = 0;
+
+		if (flags & GST_MAP_READ)
+			sync_flags |= DMA_BUF_SYNC_READ;
+		if (flags & GST_MAP_WRITE)
+			sync_flags |= DMA_BUF_SYNC_WRITE;
+
+		gst_imx_dma_heap_sync(memory, DMA_BUF_SYNC_END | sync_flags);
+
+		if (munmap(memory->mapped_virt_addr, memory->mem.maxsize) == -1)
+			GST_ERROR("unmapping memory-mapped DMA-BUF failed: %s", strerror(errno));
+		GST_LOG("unmapped DMA-BUF:  virt addr %p  phys addr %" GST_IMX_PHYS_ADDR_FORMAT, memory->mapped_virt_addr, memory->phys_addr);
+		memory->mapped_virt_addr = NULL;
+	}
+}
+
+
+static gboolean gst_imx_dma_heap_alloc_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, gssize size)
+{
+	return gst_imx_dma_heap_alloc_dmabuf(GST_IMX_DMA_HEAP_ALLOCATOR(allocator)->heap_fd, memory, size);
+}
+
+
+static gboolean gst_imx_dma_heap_free_phys_mem(G_GNUC_UNUSED GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory)
+{
+	gst_imx_dma_heap_free_dmabuf(memory);
+	return TRUE;
+}
+
+
+static gpointer gst_imx_dma_heap_map_phys_mem(G_GNUC_UNUSED GstImxPhysMemAllocator *allocator, GstImxPhysMemory *phys_mem, gssize size, GstMapFlags flags)
+{
+	return gst_imx_dma_heap_map_dmabuf(phys_mem, size, flags);
+}
+
+
+static void gst_imx_dma_heap_unmap_phys_mem(G_GNUC_UNUSED GstImxPhysMemAllocator *allocator, GstImxPhysMemory *phys_mem)
+{
+	gst_imx_dma_heap_unmap_dmabuf(phys_mem, phys_mem->mapping_flags);
+}
+
+
+
+
+/* DMA heap backing; the device is opened on first use, and stays open */
+
+static int gst_imx_dma_heap_get_backing_fd(void)
+{
+	/* g_once_init_leave() needs a nonzero value, so the
+	 * descriptor is stored plus 2 (-1 means no device) */
+	static gsize stored_heap_fd = 0;
+
+	if (g_once_init_enter(&stored_heap_fd))
+	{
+		int heap_fd = gst_imx_dma_heap_open_device();
+		g_once_init_leave(&stored_heap_fd, (gsize)(heap_fd + 2));
+	}
+
+	return (int)stored_heap_fd - 2;
+}
+
+
+gboolean gst_imx_dma_heap_backing_alloc(GstImxPhysMemory *memory, gsize size)
+{
+	int heap_fd;
+
+	gst_imx_dma_heap_init_debug();
+
+	heap_fd = gst_imx_dma_heap_get_backing_fd();
+	return (heap_fd >= 0) && gst_imx_dma_heap_alloc_dmabuf(heap_fd, memory, size);
+}
+
+
+void gst_imx_dma_heap_backing_free(GstImxPhysMemory *memory)
+{
+	gst_imx_dma_heap_free_dmabuf(memory);
+}
+
+
+gpointer gst_imx_dma_heap_backing_map(GstImxPhysMemory *memory, gsize size, GstMapFlags flags)
+{
+	return gst_imx_dma_heap_map_dmabuf(memory, size, flags);
+}
+
+
+void gst_imx_dma_heap_backing_unmap(GstImxPhysMemory *memory, GstMapFlags flags)
+{
+	gst_imx_dma_heap_unmap_dmabuf(memory, flags);
+}
+
+
+
+
+static void gst_imx_dma_heap_allocator_class_init(GstImxDmaHeapAllocatorClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS(klass);
+	GstImxPhysMemAllocatorClass *parent_class = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(klass);
+
+	object_class->finalize       = GST_DEBUG_FUNCPTR(gst_imx_dma_heap_allocator_finalize);
+	parent_class->alloc_phys_mem = GST_DEBUG_FUNCPTR(gst_imx_dma_heap_alloc_phys_mem);
+	parent_class->free_phys_mem  = GST_DEBUG_FUNCPTR(gst_imx_dma_heap_free_phys_mem);
+	parent_class->map_phys_mem   = GST_DEBUG_FUNCPTR(gst_imx_dma_heap_map_phys_mem);
+	parent_class->unmap_phys_mem = GST_DEBUG_FUNCPTR(gst_imx_dma_heap_unmap_phys_mem);
+	/* export_dmabuf is not needed, since all blocks are DMA-BUFs already */
+
+	gst_imx_dma_heap_init_debug();
+}
+
+
+static void gst_imx_dma_heap_allocator_init(GstImxDmaHeapAllocator *allocator)
+{
+	GstAllocator *base = GST_ALLOCATOR(allocator);
+	base->mem_type = GST_IMX_DMA_HEAP_ALLOCATOR_MEM_TYPE;
+	allocator->heap_fd = -1;
+}
+
+
+static void gst_imx_dma_heap_allocator_finalize(GObject *object)
+{
+	GstImxDmaHeapAllocator *allocator = GST_IMX_DMA_HEAP_ALLOCATOR(object);
+
+	GST_DEBUG_OBJECT(object, "shutting down IMX DMA heap allocator");
+
+	if (allocator->heap_fd >= 0)
+		close(allocator->heap_fd);
+
+	G_OBJECT_CLASS(gst_imx_dma_heap_allocator_parent_class)->finalize(object);
+}
+
+
+#else
+
+
+#include "dma_heap_allocator.h"
+
+
+gboolean gst_imx_dma_heap_backing_alloc(G_GNUC_UNUSED GstImxPhysMemory *memory, G_GNUC_UNUSED gsize size)
+{
+	return FALSE;
+}
+
+
+void gst_imx_dma_heap_backing_free(G_GNUC_UNUSED GstImxPhysMemory *memory)
+{
+}
+
+
+gpointer gst_imx_dma_heap_backing_map(G_GNUC_UNUSED GstImxPhysMemory *memory, G_GNUC_UNUSED gsize size, G_GNUC_UNUSED GstMapFlags flags)
+{
+	return NULL;
+}
+
+
+void gst_imx_dma_heap_backing_unmap(G_GNUC_UNUSED GstImxPhysMemory *memory, G_GNUC_UNUSED GstMapFlags flags)
+{
+}
+
+
+#endif
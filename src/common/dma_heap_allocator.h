@@ -0,0 +1,93 @@
+/* Allocator for DMA-BUF backed physical memory from a DMA heap
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#ifndef GST_IMX_COMMON_DMA_HEAP_ALLOCATOR_H
+#define GST_IMX_COMMON_DMA_HEAP_ALLOCATOR_H
+
+#include <gst/gst.h>
+#include "phys_mem_allocator.h"
+
+
+G_BEGIN_DECLS
+
+
+typedef struct _GstImxDmaHeapAllocator GstImxDmaHeapAllocator;
+typedef struct _GstImxDmaHeapAllocatorClass GstImxDmaHeapAllocatorClass;
+
+
+#define GST_TYPE_IMX_DMA_HEAP_ALLOCATOR             (gst_imx_dma_heap_allocator_get_type())
+#define GST_IMX_DMA_HEAP_ALLOCATOR(obj)             (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_IMX_DMA_HEAP_ALLOCATOR, GstImxDmaHeapAllocator))
+#define GST_IMX_DMA_HEAP_ALLOCATOR_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_IMX_DMA_HEAP_ALLOCATOR, GstImxDmaHeapAllocatorClass))
+#define GST_IS_IMX_DMA_HEAP_ALLOCATOR(obj)          (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_IMX_DMA_HEAP_ALLOCATOR))
+#define GST_IS_IMX_DMA_HEAP_ALLOCATOR_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_IMX_DMA_HEAP_ALLOCATOR))
+
+#define GST_IMX_DMA_HEAP_ALLOCATOR_MEM_TYPE "ImxDmaHeapMemory"
+
+/* Device node of the DMA heap used if the GST_IMX_DMA_HEAP_DEVICE
+ * environment variable is not set */
+#define GST_IMX_DMA_HEAP_ALLOCATOR_DEFAULT_DEVICE "/dev/dma_heap/linux,cma"
+
+
+/* This allocator allocates physically contiguous memory blocks from a
+ * DMA heap. Every block is a DMA-BUF, so it can be exported to other
+ * DMA-BUF capable elements (see dmabuf.h). The physical address is
+ * queried with the DMA_BUF_IOCTL_PHYS ioctl, which is present in the
+ * Freescale/NXP kernels. This allocator is only available if both the
+ * DMA heap header and this ioctl were found when configuring the build
+ * (HAVE_IMX_DMA_HEAP is defined then). */
+struct _GstImxDmaHeapAllocator
+{
+	GstImxPhysMemAllocator parent;
+
+	/* File descriptor of the DMA heap device node */
+	int heap_fd;
+};
+
+
+struct _GstImxDmaHeapAllocatorClass
+{
+	GstImxPhysMemAllocatorClass parent_class;
+};
+
+
+GType gst_imx_dma_heap_allocator_get_type(void);
+/* Opens the DMA heap device and creates a new allocator.
+ * Returns NULL if the device cannot be opened. */
+GstAllocator* gst_imx_dma_heap_allocator_new(void);
+
+
+/* DMA heap backing for other allocators
+ *
+ * These functions are used by the GstImxPhysMemAllocator base class for
+ * blocks which must be exportable as DMA-BUFs, but whose allocator cannot
+ * export its own memory (see dmabuf_heap_backing in phys_mem_allocator.h).
+ * They allocate from a DMA heap device which is opened once per process,
+ * and set phys_addr and dmabuf_fd in the memory block. Mapping and
+ * unmapping perform the cache maintenance with the DMA_BUF_IOCTL_SYNC
+ * ioctl. Without HAVE_IMX_DMA_HEAP, allocating always fails. */
+gboolean gst_imx_dma_heap_backing_alloc(GstImxPhysMemory *memory, gsize size);
+void gst_imx_dma_heap_backing_free(GstImxPhysMemory *memory);
+gpointer gst_imx_dma_heap_backing_map(GstImxPhysMemory *memory, gsize size, GstMapFlags flags);
+void gst_imx_dma_heap_backing_unmap(GstImxPhysMemory *memory, GstMapFlags flags);
+
+
+G_END_DECLS
+
+
+#endif
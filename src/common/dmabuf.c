@@ -0,0 +1,174 @@
+/* DMA-BUF import and export for physical memory buffers
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include <config.h>
+#include "dmabuf.h"
+
+#ifdef HAVE_IMX_DMABUF
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <gst/allocators/gstdmabuf.h>
+#ifdef HAVE_DMA_BUF_IOCTL_PHYS
+#include <linux/dma-buf.h>
+#endif
+#include "phys_mem_allocator.h"
+#include "phys_mem_meta.h"
+
+
+GST_DEBUG_CATEGORY_STATIC(imx_dmabuf_debug);
+#define GST_CAT_DEFAULT imx_dmabuf_debug
+
+
+static void gst_imx_dmabuf_init_debug(void)
+{
+	static gsize initialized = 0;
+
+	if (g_once_init_enter(&initialized))
+	{
+		GST_DEBUG_CATEGORY_INIT(imx_dmabuf_debug, "imxdmabuf", 0, "DMA-BUF import and export");
+		g_once_init_leave(&initialized, 1);
+	}
+}
+
+
+static GstAllocator* gst_imx_dmabuf_get_allocator(void)
+{
+	/* The DMA-BUF allocator has no state, so one instance is enough */
+	static GstAllocator *dmabuf_allocator = NULL;
+
+	if (g_once_init_enter(&dmabuf_allocator))
+		g_once_init_leave(&dmabuf_allocator, gst_dmabuf_allocator_new());
+
+	return dmabuf_allocator;
+}
+
+
+GstBuffer* gst_imx_dmabuf_export_buffer(GstBuffer *buffer)
+{
+	GstMemory *mem, *dmabuf_mem;
+	GstBuffer *exported;
+	GstImxPhysMemMeta *phys_mem_meta, *exported_phys_mem_meta;
+	gint fd;
+	gsize offset;
+
+	gst_imx_dmabuf_init_debug();
+
+	if (gst_buffer_n_memory(buffer) != 1)
+		return NULL;
+
+	mem = gst_buffer_peek_memory(buffer, 0);
+	if (!gst_imx_is_phys_memory(mem))
+		return NULL;
+
+	fd = gst_imx_phys_memory_export_dmabuf(mem, &offset);
+	if (fd < 0)
+	{
+		GST_LOG("memory block %p cannot be exported as DMA-BUF", (gpointer)mem);
+		return NULL;
+	}
+
+	/* The DMA-BUF memory takes ownership over the fd */
+	dmabuf_mem = gst_dmabuf_allocator_alloc(gst_imx_dmabuf_get_allocator(), fd, offset + mem->maxsize);
+	gst_memory_resize(dmabuf_mem, offset + mem->offset, mem->size);
+
+	exported = gst_buffer_new();
+	gst_buffer_append_memory(exported, dmabuf_mem);
+	gst_buffer_copy_into(exported, buffer, GST_BUFFER_COPY_METADATA, 0, -1);
+
+	phys_mem_meta = GST_IMX_PHYS_MEM_META_GET(buffer);
+	exported_phys_mem_meta = GST_IMX_PHYS_MEM_META_GET(exported);
+	if (exported_phys_mem_meta == NULL)
+		exported_phys_mem_meta = GST_IMX_PHYS_MEM_META_ADD(exported);
+
+	/* Like in gst_imx_dmabuf_import_buffer(), the address
+	 * refers to the start of the memory's visible region */
+	exported_phys_mem_meta->phys_addr = gst_imx_phys_memory_get_phys_addr(mem) + mem->offset;
+	if (phys_mem_meta != NULL)
+	{
+		exported_phys_mem_meta->x_padding = phys_mem_meta->x_padding;
+		exported_phys_mem_meta->y_padding = phys_mem_meta->y_padding;
+	}
+	gst_buffer_replace(&(exported_phys_mem_meta->parent), buffer);
+
+	GST_LOG("exported buffer %p with phys addr %" GST_IMX_PHYS_ADDR_FORMAT " as DMA-BUF fd %d (offset %" G_GSIZE_FORMAT ")", (gpointer)buffer, exported_phys_mem_meta->phys_addr, fd, offset + mem->offset);
+
+	return exported;
+}
+
+
+GstBuffer* gst_imx_dmabuf_import_buffer(GstBuffer *buffer)
+{
+#ifdef HAVE_DMA_BUF_IOCTL_PHYS
+	GstMemory *mem;
+	GstBuffer *imported;
+	GstImxPhysMemMeta *phys_mem_meta;
+	unsigned long phys_addr;
+	gint fd;
+
+	gst_imx_dmabuf_init_debug();
+
+	if (gst_buffer_n_memory(buffer) != 1)
+		return NULL;
+
+	mem = gst_buffer_peek_memory(buffer, 0);
+	if (!gst_is_dmabuf_memory(mem))
+		return NULL;
+
+	fd = gst_dmabuf_memory_get_fd(mem);
+	if (ioctl(fd, DMA_BUF_IOCTL_PHYS, &phys_addr) < 0)
+	{
+		GST_LOG("could not resolve physical address of DMA-BUF fd %d: %s", fd, strerror(errno));
+		return NULL;
+	}
+
+	/* A shallow copy; the memory block is shared, not copied */
+	imported = gst_buffer_copy(buffer);
+
+	phys_mem_meta = GST_IMX_PHYS_MEM_META_ADD(imported);
+	phys_mem_meta->phys_addr = (gst_imx_phys_addr_t)(phys_addr + mem->offset);
+
+	GST_LOG("imported DMA-BUF fd %d with phys addr %" GST_IMX_PHYS_ADDR_FORMAT, fd, phys_mem_meta->phys_addr);
+
+	return imported;
+#else
+	(void)buffer;
+	return NULL;
+#endif
+}
+
+
+#else
+
+
+GstBuffer* gst_imx_dmabuf_export_buffer(G_GNUC_UNUSED GstBuffer *buffer)
+{
+	return NULL;
+}
+
+
+GstBuffer* gst_imx_dmabuf_import_buffer(G_GNUC_UNUSED GstBuffer *buffer)
+{
+	return NULL;
+}
+
+
+#endif
@@ -0,0 +1,63 @@
+/* DMA-BUF import and export for physical memory buffers
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#ifndef GST_IMX_COMMON_DMABUF_H
+#define GST_IMX_COMMON_DMABUF_H
+
+#include <gst/gst.h>
+
+
+G_BEGIN_DECLS
+
+
+/* These functions convert between buffers with physical memory (that is,
+ * buffers with a GstImxPhysMemMeta) and buffers with DMA-BUF memory, as
+ * used by kmssink, the v4l2 elements and other DMA-BUF capable elements.
+ * The DMA-BUF memory is created by the GStreamer DMA-BUF allocator, and
+ * is therefore also usable as fd memory. Neither function copies pixels.
+ *
+ * If gstreamer-allocators-1.0 was not found when configuring the build,
+ * both functions always return NULL. */
+
+
+/* Creates a new buffer whose only memory block is a DMA-BUF referring to
+ * the physical memory of the given buffer. All metadata is copied; the new
+ * buffer also gets a GstImxPhysMemMeta, whose parent is the given buffer,
+ * so the physical memory stays allocated while the new buffer exists.
+ * Returns NULL if the buffer does not consist of exactly one physical memory
+ * block, or if the block cannot be exported (see "DMA-BUF export" in
+ * phys_mem_allocator.h). In both functions, the physical address in the
+ * GstImxPhysMemMeta refers to the start of the memory's visible region
+ * (that is, it includes the GstMemory offset). */
+GstBuffer* gst_imx_dmabuf_export_buffer(GstBuffer *buffer);
+
+/* Resolves the physical address of a buffer whose only memory block is a
+ * DMA-BUF, and returns a shallow copy of the buffer with a GstImxPhysMemMeta
+ * added, which the blitters and the VPU can use directly. Returns NULL if
+ * the buffer is not a DMA-BUF buffer, or if the physical address cannot be
+ * resolved. Resolving requires the DMA_BUF_IOCTL_PHYS ioctl, which is present
+ * in the Freescale/NXP kernels, and must refer to physically contiguous memory.
+ * The given buffer is not modified. */
+GstBuffer* gst_imx_dmabuf_import_buffer(GstBuffer *buffer);
+
+
+G_END_DECLS
+
+
+#endif
@@ -18,13 +18,81 @@
 
 
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 #include "phys_mem_allocator.h"
+#include "dma_heap_allocator.h"
 
 
 GST_DEBUG_CATEGORY_STATIC(imx_phys_mem_allocator_debug);
 #define GST_CAT_DEFAULT imx_phys_mem_allocator_debug
 
 
+/* Block offsets and sizes inside arenas are multiples of the page size */
+#define GST_IMX_PHYS_MEM_ARENA_PAGE_SIZE 4096
+/* Blocks up to this size are only rounded up to the page size; larger
+ * blocks are rounded up to one of four size classes per power of two */
+#define GST_IMX_PHYS_MEM_ARENA_SMALL_BLOCK_LIMIT (64 * 1024)
+
+#define GST_IMX_PHYS_MEM_ARENA_ALIGN_UP(VAL, ALIGN) (((VAL) + ((ALIGN) - 1)) & ~((ALIGN) - 1))
+
+/* Copies smaller than this are always done by the CPU, since setting
+ * up a device copy costs more than copying a few pages */
+#define GST_IMX_PHYS_MEM_MIN_DEVICE_COPY_SIZE (16 * 1024)
+
+
+typedef struct
+{
+	gsize offset, size;
+}
+GstImxPhysMemArenaChunk;
+
+
+struct _GstImxPhysMemArena
+{
+	/* The memory block reserved with alloc_phys_mem; not a real GstMemory,
+	 * since it must not hold a reference to the allocator */
+	GstImxPhysMemory backing;
+	gsize size;
+
+	/* List of GstImxPhysMemArenaChunk instances describing the free
+	 * ranges in the arena, sorted by offset; adjacent ranges are merged */
+	GList *free_chunks;
+
+	gsize used_size, requested_size;
+	guint num_blocks;
+
+	/* Cache policy that was requested for the arena; only blocks
+	 * requesting the same policy are carved out of it */
+	GstImxPhysMemCachePolicy requested_cache_policy;
+
+	/* TRUE if the backend mapped the memory already in alloc_phys_mem */
+	gboolean persistent_mapping;
+	/* Number of mapped blocks; only used if persistent_mapping is FALSE */
+	glong mapping_refcount;
+};
+
+
+/* Default arena and mapping cache sizes for new allocators, read from the
+ * GST_IMX_PHYS_MEM_ARENA_SIZE and GST_IMX_PHYS_MEM_MAPPING_CACHE_SIZE
+ * environment variables */
+static gsize gst_imx_phys_mem_allocator_default_arena_size = 0;
+static gsize gst_imx_phys_mem_allocator_default_mapping_cache_size = 128 * 1024 * 1024;
+
+
+/* Protects the allocation statistics of all allocators, the global
+ * statistics, the list of allocators, and the statistics hook */
+static GMutex gst_imx_phys_mem_allocator_stats_mutex;
+static GstImxPhysMemAllocationStats gst_imx_phys_mem_allocator_global_stats;
+static GSList *gst_imx_phys_mem_allocator_list = NULL;
+static GstImxPhysMemAllocationStatsHook gst_imx_phys_mem_allocator_stats_hook = NULL;
+static gpointer gst_imx_phys_mem_allocator_stats_hook_user_data = NULL;
+
+
+static void gst_imx_phys_mem_allocator_dispose(GObject *object);
 static void gst_imx_phys_mem_allocator_finalize(GObject *object);
 static GstMemory* gst_imx_phys_mem_allocator_alloc(GstAllocator *allocator, gsize size, GstAllocationParams *params);
 static void gst_imx_phys_mem_allocator_free(GstAllocator *allocator, GstMemory *memory);
@@ -38,6 +106,31 @@ static gboolean gst_imx_phys_mem_allocator_is_span(GstMemory *mem1, GstMemory *m
 G_DEFINE_ABSTRACT_TYPE(GstImxPhysMemAllocator, gst_imx_phys_mem_allocator, GST_TYPE_ALLOCATOR)
 
 
+/* Reads a size in bytes from an environment variable; the suffixes
+ * k and M are supported. If the variable is not set, default_size
+ * is returned. */
+static gsize gst_imx_phys_mem_allocator_get_size_from_env(gchar const *name, gsize default_size)
+{
+	gchar *end;
+	guint64 size;
+	gchar const *str = g_getenv(name);
+
+	if (str == NULL)
+		return default_size;
+
+	size = g_ascii_strtoull(str, &end, 10);
+
+	switch (*end)
+	{
+		case 'k': case 'K': size *= 1024; break;
+		case 'm': case 'M': size *= 1024 * 1024; break;
+		default: break;
+	}
+
+	return (gsize)size;
+}
+
+
 void gst_imx_phys_mem_allocator_class_init(GstImxPhysMemAllocatorClass *klass)
 {
 	GObjectClass *object_class = G_OBJECT_CLASS(klass);
@@ -45,12 +138,23 @@ void gst_imx_phys_mem_allocator_class_init(GstImxPhysMemAllocatorClass *klass)
 
 	GST_DEBUG_CATEGORY_INIT(imx_phys_mem_allocator_debug, "imxphysmemallocator", 0, "Allocator for physically contiguous memory blocks");
 
+	gst_imx_phys_mem_allocator_default_arena_size = GST_IMX_PHYS_MEM_ARENA_ALIGN_UP(gst_imx_phys_mem_allocator_get_size_from_env("GST_IMX_PHYS_MEM_ARENA_SIZE", 0), GST_IMX_PHYS_MEM_ARENA_PAGE_SIZE);
+	gst_imx_phys_mem_allocator_default_mapping_cache_size = gst_imx_phys_mem_allocator_get_size_from_env("GST_IMX_PHYS_MEM_MAPPING_CACHE_SIZE", gst_imx_phys_mem_allocator_default_mapping_cache_size);
+	GST_INFO("default arena size: %u bytes, default mapping cache size: %u bytes", gst_imx_phys_mem_allocator_default_arena_size, gst_imx_phys_mem_allocator_default_mapping_cache_size);
+
 	klass->alloc_phys_mem  = NULL;
 	klass->free_phys_mem   = NULL;
 	klass->map_phys_mem    = NULL;
 	klass->unmap_phys_mem  = NULL;
+	klass->cache_mappings  = FALSE;
+	klass->dmabuf_heap_backing = FALSE;
+	klass->system_memory   = FALSE;
+	klass->cache_op        = NULL;
+	klass->export_dmabuf   = NULL;
+	klass->copy_phys_mem   = NULL;
 	parent_class->alloc    = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_allocator_alloc);
 	parent_class->free     = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_allocator_free);
+	object_class->dispose  = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_allocator_dispose);
 	object_class->finalize = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_allocator_finalize);
 }
 
@@ -67,16 +171,782 @@ void gst_imx_phys_mem_allocator_init(GstImxPhysMemAllocator *allocator)
 	parent->mem_copy    = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_allocator_copy);
 	parent->mem_share   = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_allocator_share);
 	parent->mem_is_span = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_allocator_is_span);
+
+	g_mutex_init(&(allocator->arena_mutex));
+	allocator->arena_size = gst_imx_phys_mem_allocator_default_arena_size;
+	allocator->arenas = NULL;
+	allocator->num_direct_allocations = 0;
+
+	g_mutex_init(&(allocator->mapping_cache_mutex));
+	g_queue_init(&(allocator->cached_mappings));
+	allocator->cached_mappings_size = 0;
+	allocator->mapping_cache_size = gst_imx_phys_mem_allocator_default_mapping_cache_size;
+	allocator->num_mapping_cache_hits = 0;
+	allocator->num_mapping_cache_misses = 0;
+
+	memset(&(allocator->allocation_stats), 0, sizeof(GstImxPhysMemAllocationStats));
+
+	g_mutex_lock(&gst_imx_phys_mem_allocator_stats_mutex);
+	gst_imx_phys_mem_allocator_list = g_slist_prepend(gst_imx_phys_mem_allocator_list, allocator);
+	g_mutex_unlock(&gst_imx_phys_mem_allocator_stats_mutex);
+}
+
+
+static void gst_imx_phys_mem_allocation_stats_apply(GstImxPhysMemAllocationStats *stats, gssize size_delta, gint num_blocks_delta, gint num_mappings_delta, guint num_failed_allocations)
+{
+	stats->allocated_size += size_delta;
+	stats->num_blocks += num_blocks_delta;
+	stats->num_mappings += num_mappings_delta;
+	stats->num_failed_allocations += num_failed_allocations;
+
+	stats->max_allocated_size = MAX(stats->max_allocated_size, stats->allocated_size);
+	stats->max_num_blocks = MAX(stats->max_num_blocks, stats->num_blocks);
+	stats->max_num_mappings = MAX(stats->max_num_mappings, stats->num_mappings);
+}
+
+
+/* Updates the allocator's and the global allocation statistics. The hook is
+ * only called if notify is TRUE. */
+static void gst_imx_phys_mem_allocator_update_stats(GstImxPhysMemAllocator *phys_mem_alloc, gssize size_delta, gint num_blocks_delta, gint num_mappings_delta, guint num_failed_allocations, gboolean notify)
+{
+	GstImxPhysMemAllocationStats stats, global_stats;
+	GstImxPhysMemAllocationStatsHook hook;
+	gpointer hook_user_data;
+
+	g_mutex_lock(&gst_imx_phys_mem_allocator_stats_mutex);
+
+	gst_imx_phys_mem_allocation_stats_apply(&(phys_mem_alloc->allocation_stats), size_delta, num_blocks_delta, num_mappings_delta, num_failed_allocations);
+	gst_imx_phys_mem_allocation_stats_apply(&gst_imx_phys_mem_allocator_global_stats, size_delta, num_blocks_delta, num_mappings_delta, num_failed_allocations);
+
+	stats = phys_mem_alloc->allocation_stats;
+	global_stats = gst_imx_phys_mem_allocator_global_stats;
+	hook = notify ? gst_imx_phys_mem_allocator_stats_hook : NULL;
+	hook_user_data = gst_imx_phys_mem_allocator_stats_hook_user_data;
+
+	g_mutex_unlock(&gst_imx_phys_mem_allocator_stats_mutex);
+
+	if (hook != NULL)
+		hook(phys_mem_alloc, &stats, &global_stats, hook_user_data);
+}
+
+
+static void gst_imx_phys_mem_allocator_log_allocation_stats(GstImxPhysMemAllocator *allocator, GstDebugLevel level)
+{
+	GstImxPhysMemAllocationStats stats, global_stats;
+
+	gst_imx_phys_mem_allocator_get_allocation_stats(allocator, &stats);
+	gst_imx_phys_mem_get_global_allocation_stats(&global_stats);
+
+	GST_CAT_LEVEL_LOG(
+		GST_CAT_DEFAULT, level, allocator,
+		"allocated: %u bytes (max %u) in %u blocks (max %u); mapped blocks: %u (max %u); failed allocations: %" G_GUINT64_FORMAT "; all allocators: %u bytes (max %u) in %u blocks (max %u)",
+		stats.allocated_size, stats.max_allocated_size,
+		stats.num_blocks, stats.max_num_blocks,
+		stats.num_mappings, stats.max_num_mappings,
+		stats.num_failed_allocations,
+		global_stats.allocated_size, global_stats.max_allocated_size,
+		global_stats.num_blocks, global_stats.max_num_blocks
+	);
+}
+
+
+/* Returns TRUE if the block was allocated from the DMA heap instead of
+ * with the backend (see dmabuf_heap_backing in phys_mem_allocator.h) */
+static gboolean gst_imx_phys_mem_allocator_is_heap_backed(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem)
+{
+	GstImxPhysMemAllocatorClass *klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(phys_mem_alloc));
+	return klass->dmabuf_heap_backing && (phys_mem->dmabuf_fd >= 0);
+}
+
+
+/* Returns TRUE if the block has to be allocated from the DMA heap */
+static gboolean gst_imx_phys_mem_allocator_needs_heap_backing(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem)
+{
+	GstImxPhysMemAllocatorClass *klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(phys_mem_alloc));
+	return klass->dmabuf_heap_backing && GST_MEMORY_FLAG_IS_SET(GST_MEMORY_CAST(phys_mem), GST_IMX_PHYS_MEMORY_FLAG_DMABUF);
+}
+
+
+/* Allocates memory with the backend and accounts for it */
+static gboolean gst_imx_phys_mem_allocator_alloc_backend(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem, gsize size)
+{
+	GstImxPhysMemAllocatorClass *klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(phys_mem_alloc));
+
+	if (gst_imx_phys_mem_allocator_needs_heap_backing(phys_mem_alloc, phys_mem))
+	{
+		if (gst_imx_dma_heap_backing_alloc(phys_mem, size))
+		{
+			gst_imx_phys_mem_allocator_update_stats(phys_mem_alloc, size, 0, 0, 0, FALSE);
+			return TRUE;
+		}
+
+		GST_WARNING_OBJECT(phys_mem_alloc, "could not allocate %" G_GSIZE_FORMAT " bytes from the DMA heap; allocating memory block which cannot be exported as DMA-BUF", size);
+	}
+
+	if (!klass->alloc_phys_mem(phys_mem_alloc, phys_mem, size))
+		return FALSE;
+
+	gst_imx_phys_mem_allocator_update_stats(phys_mem_alloc, size, 0, 0, 0, FALSE);
+	return TRUE;
+}
+
+
+/* Counterpart of gst_imx_phys_mem_allocator_alloc_backend; size must
+ * be the size the memory was allocated with */
+static void gst_imx_phys_mem_allocator_free_backend(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem, gsize size)
+{
+	GstImxPhysMemAllocatorClass *klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(phys_mem_alloc));
+
+	if (gst_imx_phys_mem_allocator_is_heap_backed(phys_mem_alloc, phys_mem))
+		gst_imx_dma_heap_backing_free(phys_mem);
+	else
+		klass->free_phys_mem(phys_mem_alloc, phys_mem);
+	gst_imx_phys_mem_allocator_update_stats(phys_mem_alloc, -(gssize)size, 0, 0, 0, FALSE);
+}
+
+
+static void gst_imx_phys_mem_allocator_get_arena_stats_unlocked(GstImxPhysMemAllocator *allocator, GstImxPhysMemArenaStats *stats)
+{
+	GSList *arena_node;
+
+	memset(stats, 0, sizeof(GstImxPhysMemArenaStats));
+
+	for (arena_node = allocator->arenas; arena_node != NULL; arena_node = arena_node->next)
+	{
+		GList *chunk_node;
+		GstImxPhysMemArena *arena = (GstImxPhysMemArena *)(arena_node->data);
+
+		stats->num_arenas++;
+		stats->total_size += arena->size;
+		stats->used_size += arena->used_size;
+		stats->requested_size += arena->requested_size;
+		stats->num_blocks += arena->num_blocks;
+
+		for (chunk_node = arena->free_chunks; chunk_node != NULL; chunk_node = chunk_node->next)
+		{
+			GstImxPhysMemArenaChunk *chunk = (GstImxPhysMemArenaChunk *)(chunk_node->data);
+			stats->free_size += chunk->size;
+			stats->largest_free_chunk = MAX(stats->largest_free_chunk, chunk->size);
+			stats->num_free_chunks++;
+		}
+	}
+
+	stats->num_direct_allocations = allocator->num_direct_allocations;
+}
+
+
+static void gst_imx_phys_mem_allocator_log_arena_stats_unlocked(GstImxPhysMemAllocator *allocator, GstDebugLevel level)
+{
+	GstImxPhysMemArenaStats stats;
+	guint fragmentation;
+
+	gst_imx_phys_mem_allocator_get_arena_stats_unlocked(allocator, &stats);
+
+	/* Fragmentation in percent: 0 if all free space is in one chunk */
+	fragmentation = (stats.free_size > 0) ? (guint)(100 - (guint64)(stats.largest_free_chunk) * 100 / stats.free_size) : 0;
+
+	GST_CAT_LEVEL_LOG(
+		GST_CAT_DEFAULT, level, allocator,
+		"arenas: %u with %u bytes total; %u blocks using %u bytes (%u bytes requested); %u bytes free in %u chunks, largest free chunk: %u bytes, fragmentation: %u%%; direct allocations: %" G_GUINT64_FORMAT,
+		stats.num_arenas, stats.total_size,
+		stats.num_blocks, stats.used_size, stats.requested_size,
+		stats.free_size, stats.num_free_chunks, stats.largest_free_chunk, fragmentation,
+		stats.num_direct_allocations
+	);
+}
+
+
+static void gst_imx_phys_mem_allocator_dispose(GObject *object)
+{
+	GSList *arena_node;
+	GstImxPhysMemAllocator *phys_mem_alloc = GST_IMX_PHYS_MEM_ALLOCATOR(object);
+	GstImxPhysMemAllocatorClass *klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(object));
+
+	/* The arenas are released here and not in finalize, since derived
+	 * allocators may shut down their backend in their finalize function */
+
+	g_mutex_lock(&(phys_mem_alloc->arena_mutex));
+
+	if (phys_mem_alloc->arenas != NULL)
+		gst_imx_phys_mem_allocator_log_arena_stats_unlocked(phys_mem_alloc, GST_LEVEL_INFO);
+
+	for (arena_node = phys_mem_alloc->arenas; arena_node != NULL; arena_node = arena_node->next)
+	{
+		GstImxPhysMemArena *arena = (GstImxPhysMemArena *)(arena_node->data);
+
+		if (arena->num_blocks > 0)
+			GST_WARNING_OBJECT(object, "arena at phys addr %" GST_IMX_PHYS_ADDR_FORMAT " still has %u blocks", arena->backing.phys_addr, arena->num_blocks);
+
+		if (!(arena->persistent_mapping) && (arena->backing.mapped_virt_addr != NULL))
+			klass->unmap_phys_mem(phys_mem_alloc, &(arena->backing));
+
+		gst_imx_phys_mem_allocator_free_backend(phys_mem_alloc, &(arena->backing), arena->size);
+
+		g_list_free_full(arena->free_chunks, (GDestroyNotify)g_free);
+		g_slice_free1(sizeof(GstImxPhysMemArena), arena);
+	}
+
+	g_slist_free(phys_mem_alloc->arenas);
+	phys_mem_alloc->arenas = NULL;
+
+	g_mutex_unlock(&(phys_mem_alloc->arena_mutex));
+
+	if (klass->cache_mappings)
+		GST_INFO_OBJECT(object, "mapping cache hits: %" G_GUINT64_FORMAT " misses: %" G_GUINT64_FORMAT, phys_mem_alloc->num_mapping_cache_hits, phys_mem_alloc->num_mapping_cache_misses);
+
+	gst_imx_phys_mem_allocator_log_allocation_stats(phys_mem_alloc, GST_LEVEL_INFO);
+
+	G_OBJECT_CLASS(gst_imx_phys_mem_allocator_parent_class)->dispose(object);
 }
 
 
 static void gst_imx_phys_mem_allocator_finalize(GObject *object)
 {
 	GST_INFO_OBJECT(object, "shutting down physical memory allocator");
+
+	g_mutex_lock(&gst_imx_phys_mem_allocator_stats_mutex);
+	gst_imx_phys_mem_allocator_list = g_slist_remove(gst_imx_phys_mem_allocator_list, object);
+	g_mutex_unlock(&gst_imx_phys_mem_allocator_stats_mutex);
+
+	g_mutex_clear(&(GST_IMX_PHYS_MEM_ALLOCATOR(object)->arena_mutex));
+	g_mutex_clear(&(GST_IMX_PHYS_MEM_ALLOCATOR(object)->mapping_cache_mutex));
 	G_OBJECT_CLASS (gst_imx_phys_mem_allocator_parent_class)->finalize(object);
 }
 
 
+static gsize gst_imx_phys_mem_arena_get_block_size(gsize size)
+{
+	gsize spacing;
+
+	size = GST_IMX_PHYS_MEM_ARENA_ALIGN_UP(size, GST_IMX_PHYS_MEM_ARENA_PAGE_SIZE);
+	if (size <= GST_IMX_PHYS_MEM_ARENA_SMALL_BLOCK_LIMIT)
+		return size;
+
+	/* Four size classes per power of two, for example 80, 96, 112, 128 kB
+	 * for sizes between 64 and 128 kB. This limits the waste to 25%, and
+	 * makes it more likely that freed blocks can be reused for other sizes. */
+	spacing = ((gsize)1) << (g_bit_storage(size - 1) - 3);
+	return GST_IMX_PHYS_MEM_ARENA_ALIGN_UP(size, spacing);
+}
+
+
+static GstImxPhysMemArena* gst_imx_phys_mem_arena_new(GstImxPhysMemAllocator *phys_mem_alloc, gsize size, GstImxPhysMemCachePolicy cache_policy)
+{
+	GstImxPhysMemArena *arena;
+	GstImxPhysMemArenaChunk *chunk;
+
+	arena = g_slice_alloc0(sizeof(GstImxPhysMemArena));
+	arena->size = size;
+	arena->backing.mem.allocator = GST_ALLOCATOR_CAST(phys_mem_alloc);
+	arena->backing.mem.maxsize = size;
+	arena->backing.mem.size = size;
+	arena->backing.cache_policy = cache_policy;
+	arena->backing.dmabuf_fd = -1;
+	arena->requested_cache_policy = cache_policy;
+
+	if (!gst_imx_phys_mem_allocator_alloc_backend(phys_mem_alloc, &(arena->backing), size))
+	{
+		GST_WARNING_OBJECT(phys_mem_alloc, "could not reserve arena with %u bytes", size);
+		g_slice_free1(sizeof(GstImxPhysMemArena), arena);
+		return NULL;
+	}
+
+	if (arena->backing.phys_addr == 0)
+	{
+		GST_INFO_OBJECT(phys_mem_alloc, "allocator does not provide physical addresses; disabling arenas");
+		gst_imx_phys_mem_allocator_free_backend(phys_mem_alloc, &(arena->backing), size);
+		g_slice_free1(sizeof(GstImxPhysMemArena), arena);
+		phys_mem_alloc->arena_size = 0;
+		return NULL;
+	}
+
+	arena->persistent_mapping = (arena->backing.mapped_virt_addr != NULL);
+
+	chunk = g_new(GstImxPhysMemArenaChunk, 1);
+	chunk->offset = 0;
+	chunk->size = size;
+	arena->free_chunks = g_list_append(NULL, chunk);
+
+	phys_mem_alloc->arenas = g_slist_prepend(phys_mem_alloc->arenas, arena);
+
+	GST_DEBUG_OBJECT(phys_mem_alloc, "reserved arena with %u bytes at phys addr %" GST_IMX_PHYS_ADDR_FORMAT ", persistent mapping: %d", size, arena->backing.phys_addr, arena->persistent_mapping);
+	gst_imx_phys_mem_allocator_log_arena_stats_unlocked(phys_mem_alloc, GST_LEVEL_DEBUG);
+
+	return arena;
+}
+
+
+static gsize gst_imx_phys_mem_arena_get_aligned_offset(GstImxPhysMemArena *arena, GstImxPhysMemArenaChunk *chunk, gsize alignment)
+{
+	/* The alignment applies to the physical address, not the offset */
+	guintptr phys_addr = (guintptr)(arena->backing.phys_addr) + chunk->offset;
+	return chunk->offset + (GST_IMX_PHYS_MEM_ARENA_ALIGN_UP(phys_addr, alignment) - phys_addr);
+}
+
+
+static gboolean gst_imx_phys_mem_allocator_alloc_from_arena(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem, gsize size, gsize align)
+{
+	GSList *arena_node;
+	GList *best_chunk_node = NULL;
+	GstImxPhysMemArena *best_arena = NULL;
+	GstImxPhysMemArenaChunk *chunk;
+	gsize block_size, alignment, offset, chunk_end;
+
+	block_size = gst_imx_phys_mem_arena_get_block_size(size);
+	/* align is a bitmask (alignment - 1), like in GstAllocationParams */
+	alignment = MAX(align + 1, GST_IMX_PHYS_MEM_ARENA_PAGE_SIZE);
+
+	g_mutex_lock(&(phys_mem_alloc->arena_mutex));
+
+	if ((phys_mem_alloc->arena_size == 0) || ((block_size + alignment - GST_IMX_PHYS_MEM_ARENA_PAGE_SIZE) > phys_mem_alloc->arena_size))
+	{
+		if (phys_mem_alloc->arena_size != 0)
+			phys_mem_alloc->num_direct_allocations++;
+		g_mutex_unlock(&(phys_mem_alloc->arena_mutex));
+		return FALSE;
+	}
+
+	/* Best fit: use the smallest free chunk the block fits in */
+	for (arena_node = phys_mem_alloc->arenas; arena_node != NULL; arena_node = arena_node->next)
+	{
+		GList *chunk_node;
+		GstImxPhysMemArena *arena = (GstImxPhysMemArena *)(arena_node->data);
+
+		if (arena->requested_cache_policy != phys_mem->cache_policy)
+			continue;
+
+		for (chunk_node = arena->free_chunks; chunk_node != NULL; chunk_node = chunk_node->next)
+		{
+			chunk = (GstImxPhysMemArenaChunk *)(chunk_node->data);
+			offset = gst_imx_phys_mem_arena_get_aligned_offset(arena, chunk, alignment);
+
+			if ((offset + block_size) > (chunk->offset + chunk->size))
+				continue;
+
+			if ((best_chunk_node == NULL) || (chunk->size < ((GstImxPhysMemArenaChunk *)(best_chunk_node->data))->size))
+			{
+				best_chunk_node = chunk_node;
+				best_arena = arena;
+			}
+		}
+	}
+
+	if (best_chunk_node == NULL)
+	{
+		best_arena = gst_imx_phys_mem_arena_new(phys_mem_alloc, phys_mem_alloc->arena_size, phys_mem->cache_policy);
+		if (best_arena == NULL)
+		{
+			if (phys_mem_alloc->arena_size != 0)
+				phys_mem_alloc->num_direct_allocations++;
+			g_mutex_unlock(&(phys_mem_alloc->arena_mutex));
+			return FALSE;
+		}
+
+		best_chunk_node = best_arena->free_chunks;
+	}
+
+	/* Carve the block out of the chunk; the ranges before (caused by the
+	 * alignment) and after the block remain free */
+	chunk = (GstImxPhysMemArenaChunk *)(best_chunk_node->data);
+	offset = gst_imx_phys_mem_arena_get_aligned_offset(best_arena, chunk, alignment);
+	chunk_end = chunk->offset + chunk->size;
+
+	if (offset > chunk->offset)
+	{
+		chunk->size = offset - chunk->offset;
+		if ((offset + block_size) < chunk_end)
+		{
+			GstImxPhysMemArenaChunk *tail = g_new(GstImxPhysMemArenaChunk, 1);
+			tail->offset = offset + block_size;
+			tail->size = chunk_end - tail->offset;
+			best_arena->free_chunks = g_list_insert_before(best_arena->free_chunks, best_chunk_node->next, tail);
+		}
+	}
+	else if ((offset + block_size) < chunk_end)
+	{
+		chunk->offset = offset + block_size;
+		chunk->size = chunk_end - chunk->offset;
+	}
+	else
+	{
+		best_arena->free_chunks = g_list_delete_link(best_arena->free_chunks, best_chunk_node);
+		g_free(chunk);
+	}
+
+	best_arena->used_size += block_size;
+	best_arena->requested_size += size;
+	best_arena->num_blocks++;
+
+	phys_mem->arena = best_arena;
+	phys_mem->arena_offset = offset;
+	phys_mem->arena_block_size = block_size;
+	phys_mem->phys_addr = best_arena->backing.phys_addr + offset;
+	phys_mem->internal = NULL;
+	phys_mem->cache_policy = best_arena->backing.cache_policy;
+	if (best_arena->persistent_mapping)
+		phys_mem->mapped_virt_addr = (guint8 *)(best_arena->backing.mapped_virt_addr) + offset;
+
+	g_mutex_unlock(&(phys_mem_alloc->arena_mutex));
+
+	GST_LOG_OBJECT(phys_mem_alloc, "allocated %u bytes (block size %u) at offset %u in arena at phys addr %" GST_IMX_PHYS_ADDR_FORMAT, size, block_size, offset, best_arena->backing.phys_addr);
+
+	return TRUE;
+}
+
+
+static void gst_imx_phys_mem_allocator_free_to_arena(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem)
+{
+	GList *node, *prev_node = NULL;
+	GstImxPhysMemArenaChunk *chunk, *prev_chunk, *next_chunk;
+	GstImxPhysMemArena *arena = phys_mem->arena;
+	gsize offset = phys_mem->arena_offset, size = phys_mem->arena_block_size;
+
+	g_mutex_lock(&(phys_mem_alloc->arena_mutex));
+
+	/* Find the free chunks before and after the block */
+	for (node = arena->free_chunks; node != NULL; node = node->next)
+	{
+		if (((GstImxPhysMemArenaChunk *)(node->data))->offset > offset)
+			break;
+		prev_node = node;
+	}
+
+	prev_chunk = (prev_node != NULL) ? (GstImxPhysMemArenaChunk *)(prev_node->data) : NULL;
+	next_chunk = (node != NULL) ? (GstImxPhysMemArenaChunk *)(node->data) : NULL;
+
+	/* Coalesce with the neighbouring free chunks if they are adjacent */
+	if ((prev_chunk != NULL) && ((prev_chunk->offset + prev_chunk->size) == offset))
+	{
+		prev_chunk->size += size;
+		if ((next_chunk != NULL) && ((offset + size) == next_chunk->offset))
+		{
+			prev_chunk->size += next_chunk->size;
+			arena->free_chunks = g_list_delete_link(arena->free_chunks, node);
+			g_free(next_chunk);
+		}
+	}
+	else if ((next_chunk != NULL) && ((offset + size) == next_chunk->offset))
+	{
+		next_chunk->offset = offset;
+		next_chunk->size += size;
+	}
+	else
+	{
+		chunk = g_new(GstImxPhysMemArenaChunk, 1);
+		chunk->offset = offset;
+		chunk->size = size;
+		arena->free_chunks = g_list_insert_before(arena->free_chunks, node, chunk);
+	}
+
+	arena->used_size -= size;
+	arena->requested_size -= phys_mem->mem.maxsize;
+	arena->num_blocks--;
+
+	g_mutex_unlock(&(phys_mem_alloc->arena_mutex));
+
+	GST_LOG_OBJECT(phys_mem_alloc, "returned block with %u bytes at offset %u to arena at phys addr %" GST_IMX_PHYS_ADDR_FORMAT, size, offset, arena->backing.phys_addr);
+}
+
+
+/* Returns the block which holds the ownership state for the given block */
+static GstImxPhysMemory* gst_imx_phys_memory_get_root(GstImxPhysMemory *phys_mem)
+{
+	return (phys_mem->mem.parent != NULL) ? (GstImxPhysMemory *)(phys_mem->mem.parent) : phys_mem;
+}
+
+
+static void gst_imx_phys_mem_allocator_cache_op(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem, GstImxPhysMemCacheOp op)
+{
+	GstImxPhysMemAllocatorClass *klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(phys_mem_alloc));
+
+	/* The kernel performs the cache maintenance of DMA heap blocks
+	 * when they are mapped and unmapped */
+	if ((klass->cache_op == NULL) || (phys_mem->cache_policy != GST_IMX_PHYS_MEM_CACHE_POLICY_CACHED) || gst_imx_phys_mem_allocator_is_heap_backed(phys_mem_alloc, phys_mem))
+		return;
+
+	GST_LOG_OBJECT(phys_mem_alloc, "%s caches for memory block %p (phys addr %" GST_IMX_PHYS_ADDR_FORMAT ")", (op == GST_IMX_PHYS_MEM_CACHE_OP_CLEAN) ? "cleaning" : "invalidating", (gpointer)phys_mem, phys_mem->phys_addr);
+
+	/* Blocks from arenas only cover a part of the arena's memory; restrict
+	 * the operation to it, instead of flushing the entire arena every time */
+	if (phys_mem->arena != NULL)
+		klass->cache_op(phys_mem_alloc, &(phys_mem->arena->backing), op, phys_mem->arena_offset, phys_mem->arena_block_size);
+	else
+		klass->cache_op(phys_mem_alloc, phys_mem, op, 0, phys_mem->mem.maxsize);
+}
+
+
+/* Maps a memory block, taking arenas into account. Unlike the
+ * GstAllocator map function, this does no refcounting, and
+ * does not set phys_mem->mapping_flags. */
+static gpointer gst_imx_phys_mem_allocator_map_phys_mem(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem, gsize maxsize, GstMapFlags flags)
+{
+	gpointer base;
+	GstImxPhysMemArena *arena = phys_mem->arena;
+	GstImxPhysMemAllocatorClass *klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(phys_mem_alloc));
+
+	if (arena == NULL)
+	{
+		if (gst_imx_phys_mem_allocator_is_heap_backed(phys_mem_alloc, phys_mem))
+			return gst_imx_dma_heap_backing_map(phys_mem, maxsize, flags);
+		else
+			return klass->map_phys_mem(phys_mem_alloc, phys_mem, maxsize, flags);
+	}
+
+	g_mutex_lock(&(phys_mem_alloc->arena_mutex));
+
+	if (arena->persistent_mapping)
+	{
+		/* Let the backend perform its cache maintenance for every mapping */
+		arena->backing.mapping_flags = flags;
+		base = klass->map_phys_mem(phys_mem_alloc, &(arena->backing), arena->size, flags);
+	}
+	else if (arena->backing.mapped_virt_addr == NULL)
+	{
+		/* Other blocks may be mapped with different flags
+		 * while this mapping exists, so map for reading and writing */
+		arena->backing.mapping_flags = GST_MAP_READWRITE;
+		base = klass->map_phys_mem(phys_mem_alloc, &(arena->backing), arena->size, GST_MAP_READWRITE);
+		if (base != NULL)
+			arena->mapping_refcount = 1;
+	}
+	else
+	{
+		/* The arena is mapped, either by other blocks, or because
+		 * the mapping is kept alive (see the mapping cache) */
+		base = arena->backing.mapped_virt_addr;
+		arena->mapping_refcount++;
+	}
+
+	g_mutex_unlock(&(phys_mem_alloc->arena_mutex));
+
+	return (base != NULL) ? ((guint8 *)base + phys_mem->arena_offset) : NULL;
+}
+
+
+/* Counterpart of gst_imx_phys_mem_allocator_map_phys_mem. flags must
+ * be the flags the block was mapped with. */
+static void gst_imx_phys_mem_allocator_unmap_phys_mem(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem, GstMapFlags flags)
+{
+	GstImxPhysMemArena *arena = phys_mem->arena;
+	GstImxPhysMemAllocatorClass *klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(phys_mem_alloc));
+
+	if (arena == NULL)
+	{
+		if (gst_imx_phys_mem_allocator_is_heap_backed(phys_mem_alloc, phys_mem))
+			gst_imx_dma_heap_backing_unmap(phys_mem, flags);
+		else
+			klass->unmap_phys_mem(phys_mem_alloc, phys_mem);
+		return;
+	}
+
+	g_mutex_lock(&(phys_mem_alloc->arena_mutex));
+
+	if (arena->persistent_mapping)
+	{
+		arena->backing.mapping_flags = flags;
+		klass->unmap_phys_mem(phys_mem_alloc, &(arena->backing));
+	}
+	else if (arena->mapping_refcount > 0)
+	{
+		arena->mapping_refcount--;
+		if ((arena->mapping_refcount == 0) && !(klass->cache_mappings))
+			klass->unmap_phys_mem(phys_mem_alloc, &(arena->backing));
+	}
+
+	g_mutex_unlock(&(phys_mem_alloc->arena_mutex));
+}
+
+
+/* Destroys the least recently used cached mappings until the total size of
+ * the cached mappings is within the limit. Must be called with the mapping
+ * cache mutex locked. */
+static void gst_imx_phys_mem_allocator_trim_mapping_cache_unlocked(GstImxPhysMemAllocator *phys_mem_alloc)
+{
+	GstImxPhysMemAllocatorClass *klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(phys_mem_alloc));
+
+	while (phys_mem_alloc->cached_mappings_size > phys_mem_alloc->mapping_cache_size)
+	{
+		GstImxPhysMemory *phys_mem = (GstImxPhysMemory *)g_queue_pop_tail(&(phys_mem_alloc->cached_mappings));
+
+		GST_LOG_OBJECT(phys_mem_alloc, "evicting mapping of memory block %p (phys addr %" GST_IMX_PHYS_ADDR_FORMAT ") from mapping cache", (gpointer)phys_mem, phys_mem->phys_addr);
+
+		phys_mem->mapping_cache_link = NULL;
+		phys_mem_alloc->cached_mappings_size -= phys_mem->mem.maxsize;
+		klass->unmap_phys_mem(phys_mem_alloc, phys_mem);
+	}
+}
+
+
+/* Maps a block which is not part of an arena, reusing its cached mapping
+ * if it covers the requested access flags */
+static gpointer gst_imx_phys_mem_allocator_map_cached(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem, gsize maxsize, GstMapFlags flags)
+{
+	gpointer ptr;
+	GstMapFlags access_flags = flags & GST_MAP_READWRITE;
+	GstImxPhysMemAllocatorClass *klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(phys_mem_alloc));
+
+	g_mutex_lock(&(phys_mem_alloc->mapping_cache_mutex));
+
+	if (phys_mem->mapping_cache_link != NULL)
+	{
+		/* The block is in use again, so its mapping must not be evicted */
+		g_queue_delete_link(&(phys_mem_alloc->cached_mappings), phys_mem->mapping_cache_link);
+		phys_mem->mapping_cache_link = NULL;
+		phys_mem_alloc->cached_mappings_size -= phys_mem->mem.maxsize;
+
+		if ((phys_mem->cached_mapping_flags & access_flags) == access_flags)
+		{
+			phys_mem_alloc->num_mapping_cache_hits++;
+			g_mutex_unlock(&(phys_mem_alloc->mapping_cache_mutex));
+			return phys_mem->mapped_virt_addr;
+		}
+
+		/* The cached mapping does not allow the requested access; remap
+		 * with the flags of both, so the new mapping can be reused for
+		 * either kind of access */
+		access_flags |= phys_mem->cached_mapping_flags;
+		klass->unmap_phys_mem(phys_mem_alloc, phys_mem);
+	}
+
+	phys_mem_alloc->num_mapping_cache_misses++;
+
+	g_mutex_unlock(&(phys_mem_alloc->mapping_cache_mutex));
+
+	ptr = klass->map_phys_mem(phys_mem_alloc, phys_mem, maxsize, (flags & ~GST_MAP_READWRITE) | access_flags);
+	phys_mem->cached_mapping_flags = access_flags;
+
+	return ptr;
+}
+
+
+/* Puts the mapping of a block which is no longer mapped by anybody
+ * into the mapping cache instead of destroying it */
+static void gst_imx_phys_mem_allocator_unmap_cached(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem)
+{
+	if (phys_mem->mapped_virt_addr == NULL)
+		return;
+
+	g_mutex_lock(&(phys_mem_alloc->mapping_cache_mutex));
+
+	g_queue_push_head(&(phys_mem_alloc->cached_mappings), phys_mem);
+	phys_mem->mapping_cache_link = g_queue_peek_head_link(&(phys_mem_alloc->cached_mappings));
+	phys_mem_alloc->cached_mappings_size += phys_mem->mem.maxsize;
+
+	gst_imx_phys_mem_allocator_trim_mapping_cache_unlocked(phys_mem_alloc);
+
+	g_mutex_unlock(&(phys_mem_alloc->mapping_cache_mutex));
+}
+
+
+/* Destroys the cached mapping of a block that is about to be freed */
+static void gst_imx_phys_mem_allocator_uncache_mapping(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem)
+{
+	GstImxPhysMemAllocatorClass *klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(phys_mem_alloc));
+
+	g_mutex_lock(&(phys_mem_alloc->mapping_cache_mutex));
+
+	if (phys_mem->mapping_cache_link != NULL)
+	{
+		g_queue_delete_link(&(phys_mem_alloc->cached_mappings), phys_mem->mapping_cache_link);
+		phys_mem->mapping_cache_link = NULL;
+		phys_mem_alloc->cached_mappings_size -= phys_mem->mem.maxsize;
+		klass->unmap_phys_mem(phys_mem_alloc, phys_mem);
+	}
+
+	g_mutex_unlock(&(phys_mem_alloc->mapping_cache_mutex));
+}
+
+
+static gboolean gst_imx_phys_mem_allocator_uses_mapping_cache(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem)
+{
+	GstImxPhysMemAllocatorClass *klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(phys_mem_alloc));
+	/* Arena blocks are not cached individually, since their arena is kept mapped instead.
+	 * DMA heap blocks are synced with the kernel whenever they are mapped and unmapped.
+	 * If the cache size is 0, mappings are evicted right away when they are unmapped. */
+	return klass->cache_mappings && (phys_mem->arena == NULL) && !gst_imx_phys_mem_allocator_is_heap_backed(phys_mem_alloc, phys_mem);
+}
+
+
+void gst_imx_phys_mem_allocator_set_mapping_cache_size(GstImxPhysMemAllocator *allocator, gsize mapping_cache_size)
+{
+	g_mutex_lock(&(allocator->mapping_cache_mutex));
+	allocator->mapping_cache_size = mapping_cache_size;
+	gst_imx_phys_mem_allocator_trim_mapping_cache_unlocked(allocator);
+	g_mutex_unlock(&(allocator->mapping_cache_mutex));
+}
+
+
+gboolean gst_imx_phys_mem_allocator_is_contiguous(GstAllocator *allocator)
+{
+	return GST_IS_IMX_PHYS_MEM_ALLOCATOR(allocator) && !(GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(allocator))->system_memory);
+}
+
+
+void gst_imx_phys_mem_allocator_set_arena_size(GstImxPhysMemAllocator *allocator, gsize arena_size)
+{
+	g_mutex_lock(&(allocator->arena_mutex));
+	allocator->arena_size = GST_IMX_PHYS_MEM_ARENA_ALIGN_UP(arena_size, GST_IMX_PHYS_MEM_ARENA_PAGE_SIZE);
+	g_mutex_unlock(&(allocator->arena_mutex));
+}
+
+
+gsize gst_imx_phys_mem_allocator_get_arena_size(GstImxPhysMemAllocator *allocator)
+{
+	gsize arena_size;
+	g_mutex_lock(&(allocator->arena_mutex));
+	arena_size = allocator->arena_size;
+	g_mutex_unlock(&(allocator->arena_mutex));
+	return arena_size;
+}
+
+
+void gst_imx_phys_mem_allocator_get_arena_stats(GstImxPhysMemAllocator *allocator, GstImxPhysMemArenaStats *stats)
+{
+	g_mutex_lock(&(allocator->arena_mutex));
+	gst_imx_phys_mem_allocator_get_arena_stats_unlocked(allocator, stats);
+	g_mutex_unlock(&(allocator->arena_mutex));
+}
+
+
+void gst_imx_phys_mem_allocator_get_allocation_stats(GstImxPhysMemAllocator *allocator, GstImxPhysMemAllocationStats *stats)
+{
+	g_mutex_lock(&gst_imx_phys_mem_allocator_stats_mutex);
+	*stats = allocator->allocation_stats;
+	g_mutex_unlock(&gst_imx_phys_mem_allocator_stats_mutex);
+}
+
+
+void gst_imx_phys_mem_get_global_allocation_stats(GstImxPhysMemAllocationStats *stats)
+{
+	g_mutex_lock(&gst_imx_phys_mem_allocator_stats_mutex);
+	*stats = gst_imx_phys_mem_allocator_global_stats;
+	g_mutex_unlock(&gst_imx_phys_mem_allocator_stats_mutex);
+}
+
+
+void gst_imx_phys_mem_foreach_allocation_stats(GstImxPhysMemAllocationStatsFunc func, gpointer user_data)
+{
+	GSList *node;
+
+	g_mutex_lock(&gst_imx_phys_mem_allocator_stats_mutex);
+	for (node = gst_imx_phys_mem_allocator_list; node != NULL; node = node->next)
+	{
+		GstImxPhysMemAllocator *allocator = (GstImxPhysMemAllocator *)(node->data);
+		func(allocator, &(allocator->allocation_stats), user_data);
+	}
+	g_mutex_unlock(&gst_imx_phys_mem_allocator_stats_mutex);
+}
+
+
+void gst_imx_phys_mem_set_allocation_stats_hook(GstImxPhysMemAllocationStatsHook hook, gpointer user_data)
+{
+	g_mutex_lock(&gst_imx_phys_mem_allocator_stats_mutex);
+	gst_imx_phys_mem_allocator_stats_hook = hook;
+	gst_imx_phys_mem_allocator_stats_hook_user_data = user_data;
+	g_mutex_unlock(&gst_imx_phys_mem_allocator_stats_mutex);
+}
+
+
 static GstImxPhysMemory* gst_imx_phys_mem_new_internal(GstImxPhysMemAllocator *phys_mem_alloc, GstMemory *parent, gsize maxsize, GstMemoryFlags flags, gsize align, gsize offset, gsize size)
 {
 	GstImxPhysMemory *phys_mem;
@@ -89,8 +959,23 @@ static GstImxPhysMemory* gst_imx_phys_mem_new_internal(GstImxPhysMemAllocator *p
 
 	phys_mem->mapped_virt_addr = NULL;
 	phys_mem->phys_addr = 0;
+	phys_mem->mapping_flags = 0;
 	phys_mem->mapping_refcount = 0;
 	phys_mem->internal = NULL;
+	phys_mem->arena = NULL;
+	phys_mem->arena_offset = 0;
+	phys_mem->arena_block_size = 0;
+	phys_mem->mapping_cache_link = NULL;
+	phys_mem->cached_mapping_flags = 0;
+	if (flags & GST_IMX_PHYS_MEMORY_FLAG_UNCACHED)
+		phys_mem->cache_policy = GST_IMX_PHYS_MEM_CACHE_POLICY_UNCACHED;
+	else if (flags & GST_IMX_PHYS_MEMORY_FLAG_WRITE_COMBINED)
+		phys_mem->cache_policy = GST_IMX_PHYS_MEM_CACHE_POLICY_WRITE_COMBINED;
+	else
+		phys_mem->cache_policy = GST_IMX_PHYS_MEM_CACHE_POLICY_CACHED;
+	phys_mem->cpu_dirty = FALSE;
+	phys_mem->device_dirty = FALSE;
+	phys_mem->dmabuf_fd = -1;
 
 	gst_memory_init(GST_MEMORY_CAST(phys_mem), flags, GST_ALLOCATOR_CAST(phys_mem_alloc), parent, maxsize, align, offset, size);
 
@@ -101,11 +986,9 @@ static GstImxPhysMemory* gst_imx_phys_mem_new_internal(GstImxPhysMemAllocator *p
 static GstImxPhysMemory* gst_imx_phys_mem_allocator_alloc_internal(GstAllocator *allocator, GstMemory *parent, gsize maxsize, GstMemoryFlags flags, gsize align, gsize offset, gsize size)
 {
 	GstImxPhysMemAllocator *phys_mem_alloc;
-	GstImxPhysMemAllocatorClass *klass;
 	GstImxPhysMemory *phys_mem;
 
 	phys_mem_alloc = GST_IMX_PHYS_MEM_ALLOCATOR(allocator);
-	klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(allocator));
 
 	GST_DEBUG_OBJECT(
 		allocator,
@@ -123,17 +1006,23 @@ static GstImxPhysMemory* gst_imx_phys_mem_allocator_alloc_internal(GstAllocator
 		return NULL;
 	}
 
-	if (!klass->alloc_phys_mem(phys_mem_alloc, phys_mem, maxsize))
+	/* Blocks which have to be DMA-BUFs of their own are never carved out of arenas */
+	if ((gst_imx_phys_mem_allocator_needs_heap_backing(phys_mem_alloc, phys_mem) || !gst_imx_phys_mem_allocator_alloc_from_arena(phys_mem_alloc, phys_mem, maxsize, align)) && !gst_imx_phys_mem_allocator_alloc_backend(phys_mem_alloc, phys_mem, maxsize))
 	{
 		g_slice_free1(sizeof(GstImxPhysMemory), phys_mem);
+		gst_imx_phys_mem_allocator_update_stats(phys_mem_alloc, 0, 0, 0, 1, TRUE);
+		gst_imx_phys_mem_allocator_log_allocation_stats(phys_mem_alloc, GST_LEVEL_WARNING);
 		return NULL;
 	}
 
+	gst_imx_phys_mem_allocator_update_stats(phys_mem_alloc, 0, 1, 0, 0, TRUE);
+
 	if ((offset > 0) && (flags & GST_MEMORY_FLAG_ZERO_PREFIXED))
 	{
-		gpointer ptr = klass->map_phys_mem(phys_mem_alloc, phys_mem, maxsize, GST_MAP_WRITE);
+		gpointer ptr = gst_imx_phys_mem_allocator_map_phys_mem(phys_mem_alloc, phys_mem, maxsize, GST_MAP_WRITE);
 		memset(ptr, 0, offset);
-		klass->unmap_phys_mem(phys_mem_alloc, phys_mem);
+		gst_imx_phys_mem_allocator_unmap_phys_mem(phys_mem_alloc, phys_mem, GST_MAP_WRITE);
+		phys_mem->cpu_dirty = TRUE;
 	}
 
 	return phys_mem;
@@ -161,9 +1050,20 @@ static void gst_imx_phys_mem_allocator_free(GstAllocator *allocator, GstMemory *
 {
 	GstImxPhysMemory *phys_mem = (GstImxPhysMemory *)memory;
 	GstImxPhysMemAllocator *phys_mem_alloc = GST_IMX_PHYS_MEM_ALLOCATOR(allocator);
-	GstImxPhysMemAllocatorClass *klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(allocator));
 
-	klass->free_phys_mem(phys_mem_alloc, phys_mem);
+	gst_imx_phys_mem_allocator_uncache_mapping(phys_mem_alloc, phys_mem);
+
+	/* Shared sub-blocks do not own their memory; it is freed
+	 * together with the parent block they keep a reference to */
+	if (memory->parent == NULL)
+	{
+		if (phys_mem->arena != NULL)
+			gst_imx_phys_mem_allocator_free_to_arena(phys_mem_alloc, phys_mem);
+		else
+			gst_imx_phys_mem_allocator_free_backend(phys_mem_alloc, phys_mem, memory->maxsize);
+
+		gst_imx_phys_mem_allocator_update_stats(phys_mem_alloc, 0, -1, 0, 0, TRUE);
+	}
 
 	GST_INFO_OBJECT(allocator, "freed block %p at phys addr %" GST_IMX_PHYS_ADDR_FORMAT " with size: %u", (gpointer)memory, phys_mem->phys_addr, memory->size);
 }
@@ -173,20 +1073,43 @@ static gpointer gst_imx_phys_mem_allocator_map(GstMemory *mem, gsize maxsize, Gs
 {
 	GstImxPhysMemory *phys_mem = (GstImxPhysMemory *)mem;
 	GstImxPhysMemAllocator *phys_mem_alloc = GST_IMX_PHYS_MEM_ALLOCATOR(mem->allocator);
-	GstImxPhysMemAllocatorClass *klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(mem->allocator));
 
 	GST_LOG_OBJECT(phys_mem_alloc, "mapping %u bytes from memory block %p (phys addr %" GST_IMX_PHYS_ADDR_FORMAT "), current mapping refcount = %ld -> %ld", maxsize, (gpointer)mem, phys_mem->phys_addr, phys_mem->mapping_refcount, phys_mem->mapping_refcount + 1);
 
 	phys_mem->mapping_refcount++;
 
+	/* If a device wrote to the block, the CPU caches may contain stale data */
+	{
+		GstImxPhysMemory *root = gst_imx_phys_memory_get_root(phys_mem);
+		if ((flags & GST_MAP_READ) && root->device_dirty)
+		{
+			if (root->cpu_dirty)
+				gst_imx_phys_mem_allocator_cache_op(phys_mem_alloc, root, GST_IMX_PHYS_MEM_CACHE_OP_CLEAN);
+			gst_imx_phys_mem_allocator_cache_op(phys_mem_alloc, root, GST_IMX_PHYS_MEM_CACHE_OP_INVALIDATE);
+			root->cpu_dirty = FALSE;
+			root->device_dirty = FALSE;
+		}
+	}
+
 	/* In GStreamer, it is not possible to map the same buffer several times
 	 * with different flags. Therefore, it is safe to use refcounting here,
 	 * since the value of "flags" will be the same with multiple map calls. */
 
 	if (phys_mem->mapping_refcount == 1)
 	{
+		gpointer ptr;
+
 		phys_mem->mapping_flags = flags;
-		return klass->map_phys_mem(phys_mem_alloc, phys_mem, maxsize, flags);
+		gst_imx_phys_mem_allocator_update_stats(phys_mem_alloc, 0, 0, 1, 0, FALSE);
+
+		if (gst_imx_phys_mem_allocator_uses_mapping_cache(phys_mem_alloc, phys_mem))
+			return gst_imx_phys_mem_allocator_map_cached(phys_mem_alloc, phys_mem, maxsize, flags);
+
+		ptr = gst_imx_phys_mem_allocator_map_phys_mem(phys_mem_alloc, phys_mem, maxsize, flags);
+		if (phys_mem->arena != NULL)
+			phys_mem->mapped_virt_addr = ptr;
+
+		return ptr;
 	}
 	else
 	{
@@ -200,7 +1123,6 @@ static void gst_imx_phys_mem_allocator_unmap(GstMemory *mem)
 {
 	GstImxPhysMemory *phys_mem = (GstImxPhysMemory *)mem;
 	GstImxPhysMemAllocator *phys_mem_alloc = GST_IMX_PHYS_MEM_ALLOCATOR(mem->allocator);
-	GstImxPhysMemAllocatorClass *klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(mem->allocator));
 
 	GST_LOG_OBJECT(phys_mem_alloc, "unmapping memory block %p (phys addr %" GST_IMX_PHYS_ADDR_FORMAT "), current mapping refcount = %ld -> %ld", (gpointer)mem, phys_mem->phys_addr, phys_mem->mapping_refcount, (phys_mem->mapping_refcount > 0) ? (phys_mem->mapping_refcount - 1) : 0);
 
@@ -208,43 +1130,116 @@ static void gst_imx_phys_mem_allocator_unmap(GstMemory *mem)
 	{
 		phys_mem->mapping_refcount--;
 		if (phys_mem->mapping_refcount == 0)
-			klass->unmap_phys_mem(phys_mem_alloc, phys_mem);
+		{
+			gst_imx_phys_mem_allocator_update_stats(phys_mem_alloc, 0, 0, -1, 0, FALSE);
+
+			/* The caches are cleaned once a device accesses the block */
+			if (phys_mem->mapping_flags & GST_MAP_WRITE)
+				gst_imx_phys_memory_get_root(phys_mem)->cpu_dirty = TRUE;
+
+			if (gst_imx_phys_mem_allocator_uses_mapping_cache(phys_mem_alloc, phys_mem))
+			{
+				gst_imx_phys_mem_allocator_unmap_cached(phys_mem_alloc, phys_mem);
+				return;
+			}
+
+			gst_imx_phys_mem_allocator_unmap_phys_mem(phys_mem_alloc, phys_mem, phys_mem->mapping_flags);
+			if ((phys_mem->arena != NULL) && !(phys_mem->arena->persistent_mapping))
+				phys_mem->mapped_virt_addr = NULL;
+		}
+	}
+}
+
+
+static void gst_imx_phys_mem_allocator_copy_cpu(guint8 *dest, guint8 const *src, gsize size)
+{
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+	/* Physical memory is usually mapped uncached or write-combined. Reading
+	 * such memory is slow unless it is done with wide loads that fill whole
+	 * bus bursts, so copy 64 bytes per iteration with NEON loads and stores,
+	 * and prefetch ahead for cached source blocks. */
+	while (size >= 64)
+	{
+		uint8x16_t v0, v1, v2, v3;
+
+		__builtin_prefetch(src + 256, 0, 0);
+
+		v0 = vld1q_u8(src);
+		v1 = vld1q_u8(src + 16);
+		v2 = vld1q_u8(src + 32);
+		v3 = vld1q_u8(src + 48);
+		vst1q_u8(dest, v0);
+		vst1q_u8(dest + 16, v1);
+		vst1q_u8(dest + 32, v2);
+		vst1q_u8(dest + 48, v3);
+
+		src += 64;
+		dest += 64;
+		size -= 64;
 	}
+#endif
+
+	memcpy(dest, src, size);
 }
 
 
 static GstMemory* gst_imx_phys_mem_allocator_copy(GstMemory *mem, gssize offset, gssize size)
 {
 	GstImxPhysMemory *copy;
+	GstImxPhysMemory *phys_mem = (GstImxPhysMemory *)mem;
 	GstImxPhysMemAllocator *phys_mem_alloc = (GstImxPhysMemAllocator*)(mem->allocator);
+	GstImxPhysMemAllocatorClass *klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(phys_mem_alloc));
+	gsize block_offset;
+	gboolean copied = FALSE;
 
 	if (size == -1)
 		size = ((gssize)(mem->size) > offset) ? (mem->size - offset) : 0;
 
-	copy = gst_imx_phys_mem_allocator_alloc_internal(mem->allocator, NULL, mem->maxsize, 0, mem->align, mem->offset + offset, size);
+	copy = gst_imx_phys_mem_allocator_alloc_internal(mem->allocator, NULL, mem->maxsize, gst_imx_phys_mem_cache_policy_to_memory_flags(phys_mem->cache_policy) | (GST_MINI_OBJECT_FLAGS(mem) & GST_IMX_PHYS_MEMORY_FLAG_DMABUF), mem->align, mem->offset + offset, size);
 	if (copy == NULL)
 	{
 		GST_ERROR_OBJECT(phys_mem_alloc, "could not copy memory block - allocation failed");
 		return NULL;
 	}
 
+	/* The copy has the same layout as the source block, but only the
+	 * requested region contains meaningful data, so only copy that */
+	block_offset = mem->offset + offset;
+
+	/* Let the device copy the memory if possible. This is not done if the
+	 * source block is currently mapped for writing, since the CPU may not
+	 * be done writing to it yet. */
+	if ((klass->copy_phys_mem != NULL) && (size >= GST_IMX_PHYS_MEM_MIN_DEVICE_COPY_SIZE) && !((phys_mem->mapping_refcount > 0) && (phys_mem->mapping_flags & GST_MAP_WRITE)))
 	{
-		gpointer srcptr, destptr;
-		GstImxPhysMemAllocatorClass *klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(mem->allocator));
+		gst_imx_phys_memory_begin_device_access(mem, GST_MAP_READ);
+		gst_imx_phys_memory_begin_device_access((GstMemory *)copy, GST_MAP_WRITE);
+
+		copied = klass->copy_phys_mem(phys_mem_alloc, copy, phys_mem, block_offset, size);
+		if (!copied)
+			GST_DEBUG_OBJECT(phys_mem_alloc, "device copy of block %p failed; copying with the CPU instead", (gpointer)mem);
+	}
 
-		srcptr = klass->map_phys_mem(phys_mem_alloc, (GstImxPhysMemory *)mem, mem->maxsize, GST_MAP_READ);
-		destptr = klass->map_phys_mem(phys_mem_alloc, copy, mem->maxsize, GST_MAP_WRITE);
+	if (!copied)
+	{
+		guint8 *srcptr, *destptr;
 
-		memcpy(destptr, srcptr, mem->maxsize);
+		/* Map through the refcounted functions, since the source block
+		 * may already be mapped, or have a cached mapping */
+		srcptr = gst_imx_phys_mem_allocator_map(mem, mem->maxsize, GST_MAP_READ);
+		destptr = gst_imx_phys_mem_allocator_map((GstMemory *)copy, mem->maxsize, GST_MAP_WRITE);
 
-		klass->unmap_phys_mem(phys_mem_alloc, copy);
-		klass->unmap_phys_mem(phys_mem_alloc, (GstImxPhysMemory *)mem);
+		gst_imx_phys_mem_allocator_copy_cpu(destptr + block_offset, srcptr + block_offset, size);
+
+		gst_imx_phys_mem_allocator_unmap((GstMemory *)copy);
+		gst_imx_phys_mem_allocator_unmap(mem);
 	}
 
 	GST_INFO_OBJECT(
 		mem->allocator,
-		"copied block %p, new copied block %p; offset: %d, size: %d; source block maxsize: %u, align: %u, offset: %u, size: %u",
-		(gpointer)mem, (gpointer)copy,
+		"copied block %p with the %s, new copied block %p; offset: %d, size: %d; source block maxsize: %u, align: %u, offset: %u, size: %u",
+		(gpointer)mem,
+		copied ? "device" : "CPU",
+		(gpointer)copy,
 		offset,
 		size,
 		mem->maxsize,
@@ -290,6 +1285,14 @@ static GstMemory* gst_imx_phys_mem_allocator_share(GstMemory *mem, gssize offset
 	 * mapping is individual to all buffers */
 	sub->phys_addr = phys_mem->phys_addr;
 	sub->internal = phys_mem->internal;
+	sub->arena = phys_mem->arena;
+	sub->arena_offset = phys_mem->arena_offset;
+	sub->arena_block_size = phys_mem->arena_block_size;
+	sub->cache_policy = phys_mem->cache_policy;
+	sub->dmabuf_fd = phys_mem->dmabuf_fd;
+	/* blocks in persistently mapped arenas are always mapped, like the arena itself */
+	if ((sub->arena != NULL) && sub->arena->persistent_mapping)
+		sub->mapped_virt_addr = phys_mem->mapped_virt_addr;
 
 	GST_INFO_OBJECT(
 		mem->allocator,
@@ -319,9 +1322,94 @@ guintptr gst_imx_phys_memory_get_phys_addr(GstMemory *mem)
 }
 
 
+gint gst_imx_phys_memory_export_dmabuf(GstMemory *mem, gsize *offset)
+{
+	GstImxPhysMemory *phys_mem = (GstImxPhysMemory *)mem;
+	GstImxPhysMemory *backing;
+	GstImxPhysMemAllocator *phys_mem_alloc = GST_IMX_PHYS_MEM_ALLOCATOR(mem->allocator);
+	GstImxPhysMemAllocatorClass *klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(mem->allocator));
+	gint fd;
+
+	if (phys_mem->arena != NULL)
+	{
+		*offset = phys_mem->arena_offset;
+		backing = &(phys_mem->arena->backing);
+	}
+	else
+	{
+		*offset = 0;
+		backing = phys_mem;
+	}
+
+	if (backing->dmabuf_fd >= 0)
+	{
+		fd = dup(backing->dmabuf_fd);
+		if (fd < 0)
+			GST_ERROR_OBJECT(phys_mem_alloc, "could not duplicate DMA-BUF fd %d: %s", backing->dmabuf_fd, strerror(errno));
+		return fd;
+	}
+	else if (klass->export_dmabuf != NULL)
+		return klass->export_dmabuf(phys_mem_alloc, backing);
+	else
+		return -1;
+}
+
+
 gboolean gst_imx_is_phys_memory(GstMemory *mem)
 {
 	return GST_IS_IMX_PHYS_MEM_ALLOCATOR(mem->allocator);
 }
 
 
+GstMemoryFlags gst_imx_phys_mem_cache_policy_to_memory_flags(GstImxPhysMemCachePolicy cache_policy)
+{
+	switch (cache_policy)
+	{
+		case GST_IMX_PHYS_MEM_CACHE_POLICY_WRITE_COMBINED: return GST_IMX_PHYS_MEMORY_FLAG_WRITE_COMBINED;
+		case GST_IMX_PHYS_MEM_CACHE_POLICY_UNCACHED: return GST_IMX_PHYS_MEMORY_FLAG_UNCACHED;
+		default: return 0;
+	}
+}
+
+
+gchar const * gst_imx_phys_mem_cache_policy_get_name(GstImxPhysMemCachePolicy cache_policy)
+{
+	switch (cache_policy)
+	{
+		case GST_IMX_PHYS_MEM_CACHE_POLICY_CACHED: return "cached";
+		case GST_IMX_PHYS_MEM_CACHE_POLICY_WRITE_COMBINED: return "write-combined";
+		case GST_IMX_PHYS_MEM_CACHE_POLICY_UNCACHED: return "uncached";
+		default: return "<unknown>";
+	}
+}
+
+
+void gst_imx_phys_memory_begin_device_access(GstMemory *mem, GstMapFlags flags)
+{
+	GstImxPhysMemory *root;
+
+	if (!gst_imx_is_phys_memory(mem))
+		return;
+
+	root = gst_imx_phys_memory_get_root((GstImxPhysMemory *)mem);
+
+	if (root->cpu_dirty)
+	{
+		gst_imx_phys_mem_allocator_cache_op(GST_IMX_PHYS_MEM_ALLOCATOR(mem->allocator), root, GST_IMX_PHYS_MEM_CACHE_OP_CLEAN);
+		root->cpu_dirty = FALSE;
+	}
+
+	if (flags & GST_MAP_WRITE)
+		root->device_dirty = TRUE;
+}
+
+
+void gst_imx_phys_mem_buffer_begin_device_access(GstBuffer *buffer, GstMapFlags flags)
+{
+	guint i, num_memory = gst_buffer_n_memory(buffer);
+
+	for (i = 0; i < num_memory; ++i)
+		gst_imx_phys_memory_begin_device_access(gst_buffer_peek_memory(buffer, i), flags);
+}
+
+
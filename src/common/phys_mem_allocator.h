@@ -32,6 +32,9 @@ G_BEGIN_DECLS
 typedef struct _GstImxPhysMemAllocator GstImxPhysMemAllocator;
 typedef struct _GstImxPhysMemAllocatorClass GstImxPhysMemAllocatorClass;
 typedef struct _GstImxPhysMemory GstImxPhysMemory;
+typedef struct _GstImxPhysMemArena GstImxPhysMemArena;
+typedef struct _GstImxPhysMemArenaStats GstImxPhysMemArenaStats;
+typedef struct _GstImxPhysMemAllocationStats GstImxPhysMemAllocationStats;
 
 
 #define GST_TYPE_IMX_PHYS_MEM_ALLOCATOR             (gst_imx_phys_mem_allocator_get_type())
@@ -41,9 +44,206 @@ typedef struct _GstImxPhysMemory GstImxPhysMemory;
 #define GST_IS_IMX_PHYS_MEM_ALLOCATOR_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_IMX_PHYS_MEM_ALLOCATOR))
 
 
+/* Cache policies
+ *
+ * Memory blocks can be allocated with different CPU cache policies. Cached
+ * memory is fastest for CPU reads and random access, but requires cache
+ * maintenance whenever the block changes hands between the CPU and a device
+ * (the IPU, G2D, PxP, VPU etc). Write-combined memory is fast for sequential
+ * CPU writes and needs no cache maintenance, but CPU reads from it are slow.
+ * Uncached memory is slow for any CPU access; it is meant for blocks which
+ * are only accessed by devices.
+ *
+ * The policy is requested with the GST_IMX_PHYS_MEMORY_FLAG_WRITE_COMBINED or
+ * GST_IMX_PHYS_MEMORY_FLAG_UNCACHED memory flags in the allocation params
+ * (no flag means cached). Buffer pools set these according to their cache
+ * policy config value (see phys_mem_buffer_pool.h). Backends which can choose
+ * the memory type set cache_policy in the GstImxPhysMemory to the policy
+ * they actually used; the base class sets it to the requested one before
+ * calling @alloc_phys_mem .
+ *
+ * Cache maintenance is done by the base class, with the backend's @cache_op
+ * function, and only for cached memory. It is done when ownership changes:
+ * caches are invalidated when the CPU maps a block for reading after a device
+ * wrote to it, and cleaned before a device accesses a block the CPU wrote to.
+ * For this, code which passes blocks to devices calls
+ * @gst_imx_phys_memory_begin_device_access (or the buffer variant).
+ */
+typedef enum
+{
+	GST_IMX_PHYS_MEM_CACHE_POLICY_CACHED,
+	GST_IMX_PHYS_MEM_CACHE_POLICY_WRITE_COMBINED,
+	GST_IMX_PHYS_MEM_CACHE_POLICY_UNCACHED
+}
+GstImxPhysMemCachePolicy;
+
+
+typedef enum
+{
+	/* Write dirty cache lines back to memory, so devices see the CPU's writes */
+	GST_IMX_PHYS_MEM_CACHE_OP_CLEAN,
+	/* Discard cache lines, so the CPU sees the devices' writes */
+	GST_IMX_PHYS_MEM_CACHE_OP_INVALIDATE
+}
+GstImxPhysMemCacheOp;
+
+
+#define GST_IMX_PHYS_MEMORY_FLAG_WRITE_COMBINED (GST_MEMORY_FLAG_LAST << 0)
+#define GST_IMX_PHYS_MEMORY_FLAG_UNCACHED       (GST_MEMORY_FLAG_LAST << 1)
+/* Requests a block which can be exported as a DMA-BUF; see below */
+#define GST_IMX_PHYS_MEMORY_FLAG_DMABUF         (GST_MEMORY_FLAG_LAST << 2)
+
+
+/* DMA-BUF export
+ *
+ * Memory blocks can be exported as DMA-BUFs with
+ * @gst_imx_phys_memory_export_dmabuf , so that DMA-BUF capable elements
+ * (kmssink, the v4l2 elements etc.) can use them without copying. Blocks
+ * which already are DMA-BUFs (dmabuf_fd is set) are exported by duplicating
+ * their file descriptor. Otherwise, the backend's @export_dmabuf function is
+ * used, if there is one.
+ *
+ * The drivers of several devices (IPU, PxP, VPU) cannot export their memory
+ * blocks. Since these devices can use any physically contiguous memory,
+ * their allocators set dmabuf_heap_backing to TRUE. Blocks requested with
+ * the GST_IMX_PHYS_MEMORY_FLAG_DMABUF flag are then allocated from the DMA
+ * heap instead of with @alloc_phys_mem (see dma_heap_allocator.h). The base
+ * class maps, unmaps and frees such blocks itself, and the kernel performs
+ * their cache maintenance when they are mapped and unmapped, so @cache_op is
+ * not called for them, and their mappings are not cached. They are also
+ * never carved out of arenas. If the DMA heap is not available, the blocks
+ * are allocated as usual, and cannot be exported. Buffer pools request such
+ * blocks if their config enables it (see phys_mem_buffer_pool.h).
+ */
+
+
+/* Arenas
+ *
+ * Allocating every memory block with its own kernel call fragments the
+ * contiguous memory area over time, until large allocations fail. To avoid
+ * this, the allocator can reserve large contiguous regions ("arenas") with
+ * @alloc_phys_mem once, and carve the memory blocks out of them. Block sizes
+ * are rounded up to size classes, so freed blocks can be reused for blocks
+ * of similar sizes, and adjacent free ranges are coalesced when blocks are
+ * freed. Blocks larger than the arena size are allocated directly, as are
+ * blocks which do not fit in any arena if reserving a new arena fails.
+ * Arenas are released when the allocator is disposed.
+ *
+ * Arenas are disabled by default. They are enabled by setting an arena size
+ * with @gst_imx_phys_mem_allocator_set_arena_size , or for all allocators
+ * with the GST_IMX_PHYS_MEM_ARENA_SIZE environment variable (in bytes; the
+ * suffixes k and M are supported).
+ *
+ * Blocks from arenas are mapped by mapping their arena. If the backend maps
+ * memory already in @alloc_phys_mem (mapped_virt_addr is set afterwards),
+ * @map_phys_mem and @unmap_phys_mem are called for the arena with every
+ * block mapping. Otherwise, the arena is mapped while at least one of its
+ * blocks is mapped. Cache maintenance (see above) only covers the block's
+ * range inside the arena (if the backend supports ranges).
+ * Only blocks requesting the same cache policy share an arena. Allocators
+ * for memory without physical addresses (phys_addr 0) never use arenas.
+ */
+
+
+/* Mapping cache
+ *
+ * Backends like the IPU one create a new virtual mapping (with mmap) in
+ * @map_phys_mem and destroy it in @unmap_phys_mem . If the class sets
+ * cache_mappings to TRUE, these mappings are not destroyed when the last
+ * user unmaps the memory block. Instead, they are kept in a cache, and
+ * reused when the block is mapped again, as long as the cached mapping's
+ * access flags cover the requested ones. (If they do not, the block is
+ * remapped with both the old and the new flags.) The cache is bounded by
+ * the total size of the unused mappings; if it is exceeded, the least
+ * recently used mappings are destroyed. Mappings are also destroyed when
+ * their memory block is freed.
+ *
+ * Backends must only set cache_mappings if skipping @map_phys_mem and
+ * @unmap_phys_mem calls is safe, that is, if these only create and destroy
+ * the mapping. (Cache maintenance belongs in @cache_op .)
+ *
+ * The bound is set with @gst_imx_phys_mem_allocator_set_mapping_cache_size ,
+ * or for all allocators with the GST_IMX_PHYS_MEM_MAPPING_CACHE_SIZE
+ * environment variable (same format as GST_IMX_PHYS_MEM_ARENA_SIZE). The
+ * default is 128 MB; 0 disables the cache. Non-persistently mapped arenas
+ * stay mapped until the allocator is disposed if the class caches mappings.
+ */
+
+
+/* Allocation statistics
+ *
+ * Every allocator keeps live counters of the memory it holds, together with
+ * their high-water marks (see GstImxPhysMemAllocationStats). The counters of
+ * all allocators are also summed up in global statistics. They are retrieved
+ * with @gst_imx_phys_mem_allocator_get_allocation_stats ,
+ * @gst_imx_phys_mem_get_global_allocation_stats and
+ * @gst_imx_phys_mem_foreach_allocation_stats . A hook can be installed with
+ * @gst_imx_phys_mem_set_allocation_stats_hook ; it is called whenever memory
+ * is allocated or freed, or an allocation fails. (It is not called for
+ * mapping changes, since these happen for every frame.) The imxphysmem
+ * tracer (see phys_mem_tracer.h) uses it to log the statistics, and
+ * phys_mem_stats.h exposes them to applications through a query and a
+ * message.
+ */
+
+
+/**
+ * GstImxPhysMemAllocationStats:
+ *
+ * Live allocation counters and their high-water marks. allocated_size is the
+ * amount of memory held from the backend, including arenas and their free
+ * space, since this is what is taken from the contiguous memory area.
+ * num_blocks counts the memory blocks handed out (shared sub-blocks are not
+ * counted), num_mappings the blocks currently mapped by their users (cached
+ * mappings are not counted), and num_failed_allocations the allocation
+ * requests that could not be fulfilled.
+ */
+struct _GstImxPhysMemAllocationStats
+{
+	gsize allocated_size, max_allocated_size;
+	guint num_blocks, max_num_blocks;
+	guint num_mappings, max_num_mappings;
+	guint64 num_failed_allocations;
+};
+
+
+/* Called with the statistics of the allocator whose statistics changed,
+ * and the global statistics. Must not allocate physical memory. */
+typedef void (*GstImxPhysMemAllocationStatsHook)(GstImxPhysMemAllocator *allocator, GstImxPhysMemAllocationStats const *stats, GstImxPhysMemAllocationStats const *global_stats, gpointer user_data);
+/* Called for each allocator by @gst_imx_phys_mem_foreach_allocation_stats */
+typedef void (*GstImxPhysMemAllocationStatsFunc)(GstImxPhysMemAllocator *allocator, GstImxPhysMemAllocationStats const *stats, gpointer user_data);
+
+
 struct _GstImxPhysMemAllocator
 {
 	GstAllocator parent;
+
+	/*< private >*/
+
+	/* Mutex protecting the arenas and the statistics */
+	GMutex arena_mutex;
+
+	/* Size of new arenas; 0 disables arenas */
+	gsize arena_size;
+	/* List of GstImxPhysMemArena instances; the most recently reserved arena comes first */
+	GSList *arenas;
+
+	/* Number of blocks allocated directly with @alloc_phys_mem although arenas
+	 * are enabled, because they are too large or reserving an arena failed */
+	guint64 num_direct_allocations;
+
+	/* Mutex protecting the mapping cache */
+	GMutex mapping_cache_mutex;
+	/* Memory blocks which are not mapped by anybody, but whose mappings are
+	 * kept alive; the most recently used block comes first */
+	GQueue cached_mappings;
+	/* Total size of the mappings in cached_mappings, and the maximum for it */
+	gsize cached_mappings_size, mapping_cache_size;
+	guint64 num_mapping_cache_hits, num_mapping_cache_misses;
+
+	/* Allocation statistics; protected by a global mutex, since the global
+	 * statistics are updated together with them */
+	GstImxPhysMemAllocationStats allocation_stats;
 };
 
 
@@ -55,6 +255,39 @@ struct _GstImxPhysMemAllocatorClass
 	gboolean (*free_phys_mem)(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory);
 	gpointer (*map_phys_mem)(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, gssize size, GstMapFlags flags);
 	void (*unmap_phys_mem)(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory);
+
+	/* If TRUE, mappings are kept alive in the mapping cache; FALSE by default */
+	gboolean cache_mappings;
+
+	/* If TRUE, blocks requested with GST_IMX_PHYS_MEMORY_FLAG_DMABUF are
+	 * allocated from the DMA heap (see above); FALSE by default */
+	gboolean dmabuf_heap_backing;
+
+	/* If TRUE, the blocks are plain system memory, and their phys_addr is
+	 * always 0; FALSE by default */
+	gboolean system_memory;
+
+	/* Optional. Performs cache maintenance for size bytes of the memory block,
+	 * starting at byte offset (relative to the block's physical address). Only
+	 * called for cached memory. For blocks from arenas, it is called with the
+	 * arena's memory block, and the range of the block inside the arena.
+	 * Backends which cannot restrict the operation to a range may perform it
+	 * for the whole memory block instead. */
+	void (*cache_op)(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, GstImxPhysMemCacheOp op, gsize offset, gsize size);
+
+	/* Optional. Returns a new file descriptor of a DMA-BUF referring to the
+	 * memory block (the caller closes it), or -1 if that is not possible.
+	 * Called with the arena's memory block for blocks from arenas. Not called
+	 * for blocks which are DMA-BUFs already. */
+	gint (*export_dmabuf)(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory);
+
+	/* Optional. Copies size bytes, starting at byte offset into the blocks,
+	 * from src to dest with a DMA-capable device, and returns once the copy
+	 * is finished. offset is relative to the blocks' physical addresses, not
+	 * to their GstMemory offsets. The base class performs the necessary cache
+	 * maintenance. If this is NULL or returns FALSE, the memory is copied by
+	 * the CPU instead. */
+	gboolean (*copy_phys_mem)(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *dest, GstImxPhysMemory *src, gsize offset, gsize size);
 };
 
 
@@ -74,14 +307,106 @@ struct _GstImxPhysMemory
 	/* pointer for any additional internal data an allocator may define
 	 * not for outside use; allocators do not have to use it */
 	gpointer internal;
+
+	/* Arena the block was carved out of, the block's offset inside the arena,
+	 * and its size (rounded up to its size class). arena is NULL if the block
+	 * was allocated directly. internal is always NULL for arena blocks. */
+	GstImxPhysMemArena *arena;
+	gsize arena_offset, arena_block_size;
+
+	/* If the block's mapping is in the mapping cache, this is its node in the
+	 * cached_mappings queue, and cached_mapping_flags are the flags the block
+	 * was mapped with; otherwise, mapping_cache_link is NULL */
+	GList *mapping_cache_link;
+	GstMapFlags cached_mapping_flags;
+
+	/* Cache policy of the block, and its ownership state: cpu_dirty is set if
+	 * the CPU wrote to the block since the caches were last cleaned, and
+	 * device_dirty if a device may have written to it since the caches were
+	 * last invalidated. Shared sub-blocks use the state of their parent. */
+	GstImxPhysMemCachePolicy cache_policy;
+	gboolean cpu_dirty, device_dirty;
+
+	/* File descriptor of the DMA-BUF the block was allocated as, or -1 if
+	 * it is none; owned by the block (shared sub-blocks use their parent's) */
+	gint dmabuf_fd;
+};
+
+
+/**
+ * GstImxPhysMemArenaStats:
+ *
+ * Occupancy and fragmentation of an allocator's arenas. used_size is the
+ * sum of the block sizes after rounding them up to their size classes,
+ * requested_size the sum of the sizes that were actually requested; the
+ * difference is lost to size class rounding. If largest_free_chunk is much
+ * smaller than free_size, the free space is fragmented.
+ */
+struct _GstImxPhysMemArenaStats
+{
+	guint num_arenas;
+	gsize total_size;
+	gsize used_size, requested_size, free_size;
+	gsize largest_free_chunk;
+	guint num_free_chunks;
+	guint num_blocks;
+	guint64 num_direct_allocations;
 };
 
 
 GType gst_imx_phys_mem_allocator_get_type(void);
 
+/* Returns TRUE if the allocator is a physical memory allocator whose
+ * blocks are physically contiguous (see system_memory above) */
+gboolean gst_imx_phys_mem_allocator_is_contiguous(GstAllocator *allocator);
+
+/* Sets the size of arenas reserved from now on; 0 disables arenas for new
+ * allocations. Existing arenas are not affected. See the explanation above. */
+void gst_imx_phys_mem_allocator_set_arena_size(GstImxPhysMemAllocator *allocator, gsize arena_size);
+gsize gst_imx_phys_mem_allocator_get_arena_size(GstImxPhysMemAllocator *allocator);
+/* Fills stats with the current arena statistics. */
+void gst_imx_phys_mem_allocator_get_arena_stats(GstImxPhysMemAllocator *allocator, GstImxPhysMemArenaStats *stats);
+
+/* Sets the maximum total size of unused mappings kept in the mapping cache;
+ * 0 disables the cache. See the explanation above. */
+void gst_imx_phys_mem_allocator_set_mapping_cache_size(GstImxPhysMemAllocator *allocator, gsize mapping_cache_size);
+
+/* Fills stats with the allocator's current allocation statistics. */
+void gst_imx_phys_mem_allocator_get_allocation_stats(GstImxPhysMemAllocator *allocator, GstImxPhysMemAllocationStats *stats);
+/* Fills stats with the allocation statistics summed up over all allocators,
+ * including ones which no longer exist. The high-water marks are those of
+ * the sums, not sums of the allocators' high-water marks. */
+void gst_imx_phys_mem_get_global_allocation_stats(GstImxPhysMemAllocationStats *stats);
+/* Calls func for every existing allocator. func is called with a global
+ * mutex locked, so it must not allocate or free physical memory. */
+void gst_imx_phys_mem_foreach_allocation_stats(GstImxPhysMemAllocationStatsFunc func, gpointer user_data);
+/* Installs the hook described above; NULL removes it. Only one hook can be
+ * installed at a time. */
+void gst_imx_phys_mem_set_allocation_stats_hook(GstImxPhysMemAllocationStatsHook hook, gpointer user_data);
+
 guintptr gst_imx_phys_memory_get_phys_addr(GstMemory *mem);
+/* Returns a new DMA-BUF file descriptor for the memory block, or -1 if the
+ * block cannot be exported (see above). The caller closes the descriptor.
+ * The block's physical address (as returned by
+ * @gst_imx_phys_memory_get_phys_addr ) corresponds to the returned offset
+ * inside the DMA-BUF, which is nonzero for blocks from arenas. Like the
+ * physical address, it does not include mem->offset. */
+gint gst_imx_phys_memory_export_dmabuf(GstMemory *mem, gsize *offset);
 gboolean gst_imx_is_phys_memory(GstMemory *mem);
 
+/* Returns the memory flags requesting the given cache policy. */
+GstMemoryFlags gst_imx_phys_mem_cache_policy_to_memory_flags(GstImxPhysMemCachePolicy cache_policy);
+gchar const * gst_imx_phys_mem_cache_policy_get_name(GstImxPhysMemCachePolicy cache_policy);
+
+/* Must be called before a device reads (flags contain GST_MAP_READ) or writes
+ * (GST_MAP_WRITE) the memory block. Cleans the caches if the CPU wrote to the
+ * block, and remembers that the device may write to it, so that the caches are
+ * invalidated once the CPU maps the block for reading the next time.
+ * Does nothing for memory which is not physical memory. */
+void gst_imx_phys_memory_begin_device_access(GstMemory *mem, GstMapFlags flags);
+/* Calls @gst_imx_phys_memory_begin_device_access for all memory blocks of the buffer. */
+void gst_imx_phys_mem_buffer_begin_device_access(GstBuffer *buffer, GstMapFlags flags);
+
 
 G_END_DECLS
 
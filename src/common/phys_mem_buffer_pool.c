@@ -27,13 +27,23 @@ GST_DEBUG_CATEGORY_STATIC(imx_phys_mem_bufferpool_debug);
 #define GST_CAT_DEFAULT imx_phys_mem_bufferpool_debug
 
 
-#define DEFAULT_HORIZ_ALIGNMENT 16
-#define DEFAULT_VERT_ALIGNMENT 8
+#define DEFAULT_HORIZ_ALIGNMENT GST_IMX_PHYS_MEM_BUFFER_POOL_DEFAULT_HORIZ_ALIGNMENT
+#define DEFAULT_VERT_ALIGNMENT GST_IMX_PHYS_MEM_BUFFER_POOL_DEFAULT_VERT_ALIGNMENT
+
+#define ALIGNMENT_PARAMS_NAME "imx-phys-mem-alignment"
+#define DEFAULT_CACHE_POLICY GST_IMX_PHYS_MEM_CACHE_POLICY_CACHED
 
 
 static const gchar ** gst_imx_phys_mem_buffer_pool_get_options(GstBufferPool *pool);
 static gboolean gst_imx_phys_mem_buffer_pool_set_config(GstBufferPool *pool, GstStructure *config);
+static gboolean gst_imx_phys_mem_buffer_pool_start(GstBufferPool *pool);
+static gboolean gst_imx_phys_mem_buffer_pool_stop(GstBufferPool *pool);
+static GstFlowReturn gst_imx_phys_mem_buffer_pool_acquire_buffer(GstBufferPool *pool, GstBuffer **buffer, GstBufferPoolAcquireParams *params);
 static GstFlowReturn gst_imx_phys_mem_buffer_pool_alloc_buffer(GstBufferPool *pool, GstBuffer **buffer, GstBufferPoolAcquireParams *params);
+static void gst_imx_phys_mem_buffer_pool_release_buffer(GstBufferPool *pool, GstBuffer *buffer);
+static void gst_imx_phys_mem_buffer_pool_free_buffer(GstBufferPool *pool, GstBuffer *buffer);
+static void gst_imx_phys_mem_buffer_pool_trim_idle_buffers(GstImxPhysMemBufferPool *imx_phys_mem_pool);
+static gboolean gst_imx_phys_mem_buffer_pool_trim_timer_cb(GstClock *clock, GstClockTime time, GstClockID id, gpointer user_data);
 static void gst_imx_phys_mem_buffer_pool_finalize(GObject *object);
 
 
@@ -45,6 +55,17 @@ G_DEFINE_TYPE(GstImxPhysMemBufferPool, gst_imx_phys_mem_buffer_pool, GST_TYPE_BU
  * but does not inherit from GstVideoBufferPool. This is because it would
  * reuse little of GstVideoBufferPool, and in fact do many parts slightly
  * differently.
+ *
+ * The buffers themselves are managed by the GstBufferPool base class. The
+ * elastic mode does not need its own free list: if a number of buffers stayed
+ * free during an entire idle period, that many buffers were not needed, no
+ * matter which ones. These are then acquired and released again with the
+ * GST_BUFFER_FLAG_TAG_MEMORY flag set, which makes the base class free them
+ * instead of putting them back into its queue. Idle periods are checked
+ * whenever a buffer is released, and by a periodic timer on the system
+ * clock, so that a pool which goes quiet after a burst still frees its idle
+ * buffers. GST_BUFFER_FLAG_TAG_MEMORY exists since GStreamer 1.3.1; with
+ * older versions, trimming is disabled.
  */
 
 
@@ -74,12 +95,191 @@ void gst_imx_phys_mem_buffer_pool_config_get_alignment(GstStructure *config, gui
 }
 
 
+void gst_imx_phys_mem_buffer_pool_compute_video_alignment(GstVideoInfo const *info, guint horiz_alignment, guint vert_alignment, GstVideoAlignment *align)
+{
+	guint width, height;
+
+	g_return_if_fail(info != NULL);
+	g_return_if_fail(align != NULL);
+
+	width = GST_VIDEO_INFO_WIDTH(info);
+	height = GST_VIDEO_INFO_HEIGHT(info);
+
+	gst_video_alignment_reset(align);
+	align->padding_right = (horiz_alignment - (width & (horiz_alignment - 1))) & (horiz_alignment - 1);
+	align->padding_bottom = (vert_alignment - (height & (vert_alignment - 1))) & (vert_alignment - 1);
+}
+
+
+GType gst_imx_phys_mem_alignment_meta_api_get_type(void)
+{
+	static volatile GType type;
+	static gchar const *tags[] = { "memory", NULL };
+
+	if (g_once_init_enter(&type))
+	{
+		GType _type = gst_meta_api_type_register("GstImxPhysMemAlignmentMetaAPI", tags);
+		g_once_init_leave(&type, _type);
+	}
+
+	return type;
+}
+
+
+void gst_imx_phys_mem_buffer_pool_merge_alignment(guint *horiz_alignment, guint *vert_alignment, guint other_horiz_alignment, guint other_vert_alignment)
+{
+	g_return_if_fail(horiz_alignment != NULL);
+	g_return_if_fail(vert_alignment != NULL);
+
+	*horiz_alignment = MAX(*horiz_alignment, other_horiz_alignment);
+	*vert_alignment = MAX(*vert_alignment, other_vert_alignment);
+}
+
+
+void gst_imx_phys_mem_buffer_pool_query_add_alignment(GstQuery *query, guint horiz_alignment, guint vert_alignment)
+{
+	guint index;
+	GstStructure *params;
+
+	g_return_if_fail(query != NULL);
+	g_return_if_fail(horiz_alignment > 0);
+	g_return_if_fail(vert_alignment > 0);
+
+	if (gst_query_find_allocation_meta(query, GST_IMX_PHYS_MEM_ALIGNMENT_META_API_TYPE, &index))
+	{
+		/* Replace the existing entry with the union of both */
+		gst_imx_phys_mem_buffer_pool_query_get_alignment(query, &horiz_alignment, &vert_alignment);
+		gst_query_remove_nth_allocation_meta(query, index);
+	}
+
+	params = gst_structure_new(
+		ALIGNMENT_PARAMS_NAME,
+		"horiz-alignment", G_TYPE_UINT, horiz_alignment,
+		"vert-alignment", G_TYPE_UINT, vert_alignment,
+		NULL
+	);
+	gst_query_add_allocation_meta(query, GST_IMX_PHYS_MEM_ALIGNMENT_META_API_TYPE, params);
+	gst_structure_free(params);
+}
+
+
+gboolean gst_imx_phys_mem_buffer_pool_query_get_alignment(GstQuery *query, guint *horiz_alignment, guint *vert_alignment)
+{
+	guint i, n;
+	guint h = 1, v = 1;
+	gboolean found = FALSE;
+
+	g_return_val_if_fail(query != NULL, FALSE);
+
+	n = gst_query_get_n_allocation_metas(query);
+	for (i = 0; i < n; ++i)
+	{
+		GstStructure const *params;
+		guint meta_h = 1, meta_v = 1;
+
+		if (gst_query_parse_nth_allocation_meta(query, i, &params) != GST_IMX_PHYS_MEM_ALIGNMENT_META_API_TYPE)
+			continue;
+		if (params == NULL)
+			continue;
+
+		gst_structure_get_uint(params, "horiz-alignment", &meta_h);
+		gst_structure_get_uint(params, "vert-alignment", &meta_v);
+		gst_imx_phys_mem_buffer_pool_merge_alignment(&h, &v, meta_h, meta_v);
+		found = TRUE;
+	}
+
+	if (found)
+	{
+		if (horiz_alignment != NULL)
+			*horiz_alignment = h;
+		if (vert_alignment != NULL)
+			*vert_alignment = v;
+	}
+
+	return found;
+}
+
+
+void gst_imx_phys_mem_buffer_pool_config_set_cache_policy(GstStructure *config, GstImxPhysMemCachePolicy cache_policy)
+{
+	g_return_if_fail(config != NULL);
+
+	gst_structure_set(config, "cache-policy", G_TYPE_UINT, (guint)cache_policy, NULL);
+}
+
+
+void gst_imx_phys_mem_buffer_pool_config_get_cache_policy(GstStructure *config, GstImxPhysMemCachePolicy *cache_policy)
+{
+	guint value;
+
+	g_return_if_fail(config != NULL);
+
+	if ((cache_policy != NULL) && gst_structure_get_uint(config, "cache-policy", &value))
+		*cache_policy = (GstImxPhysMemCachePolicy)value;
+}
+
+
+void gst_imx_phys_mem_buffer_pool_config_set_dmabuf_export(GstStructure *config, gboolean dmabuf_export)
+{
+	g_return_if_fail(config != NULL);
+
+	gst_structure_set(config, "dmabuf-export", G_TYPE_BOOLEAN, dmabuf_export, NULL);
+}
+
+
+gboolean gst_imx_phys_mem_buffer_pool_config_get_dmabuf_export(GstStructure *config)
+{
+	gboolean value;
+
+	g_return_val_if_fail(config != NULL, FALSE);
+
+	return gst_structure_get_boolean(config, "dmabuf-export", &value) && value;
+}
+
+
+void gst_imx_phys_mem_buffer_pool_config_set_elastic(GstStructure *config, guint max_buffers, GstClockTime idle_timeout)
+{
+	g_return_if_fail(config != NULL);
+
+	gst_structure_set(config,
+		"elastic-max-buffers", G_TYPE_UINT, max_buffers,
+		"elastic-idle-timeout", G_TYPE_UINT64, (guint64)idle_timeout,
+		NULL
+	);
+}
+
+
+void gst_imx_phys_mem_buffer_pool_config_get_elastic(GstStructure *config, guint *max_buffers, GstClockTime *idle_timeout)
+{
+	guint64 value;
+
+	g_return_if_fail(config != NULL);
+
+	if (max_buffers != NULL)
+		gst_structure_get_uint(config, "elastic-max-buffers", max_buffers);
+	if ((idle_timeout != NULL) && gst_structure_get_uint64(config, "elastic-idle-timeout", &value))
+		*idle_timeout = (GstClockTime)value;
+}
+
+
+void gst_imx_phys_mem_buffer_pool_get_stats(GstImxPhysMemBufferPool *imx_phys_mem_pool, GstImxPhysMemBufferPoolStats *stats)
+{
+	g_return_if_fail(imx_phys_mem_pool != NULL);
+	g_return_if_fail(stats != NULL);
+
+	g_mutex_lock(&(imx_phys_mem_pool->stats_mutex));
+	*stats = imx_phys_mem_pool->stats;
+	g_mutex_unlock(&(imx_phys_mem_pool->stats_mutex));
+}
+
+
 
 static const gchar ** gst_imx_phys_mem_buffer_pool_get_options(G_GNUC_UNUSED GstBufferPool *pool)
 {
 	static const gchar *options[] =
 	{
 		GST_BUFFER_POOL_OPTION_VIDEO_META,
+		GST_BUFFER_POOL_OPTION_VIDEO_ALIGNMENT,
 		GST_BUFFER_POOL_OPTION_IMX_PHYS_MEM,
 		NULL
 	};
@@ -98,6 +298,9 @@ static gboolean gst_imx_phys_mem_buffer_pool_set_config(GstBufferPool *pool, Gst
 	gsize size;
 	guint min_buffers, max_buffers;
 	guint horiz_alignment, vert_alignment;
+	GstImxPhysMemCachePolicy cache_policy;
+	guint elastic_max_buffers;
+	GstClockTime idle_timeout;
 	GstAllocator *allocator;
 
 	{
@@ -150,16 +353,60 @@ static gboolean gst_imx_phys_mem_buffer_pool_set_config(GstBufferPool *pool, Gst
 	imx_phys_mem_pool->vert_alignment = vert_alignment;
 	GST_INFO_OBJECT(pool, "using horiz/vert alignment: %u/%u", horiz_alignment, vert_alignment);
 
+	cache_policy = DEFAULT_CACHE_POLICY;
+	gst_imx_phys_mem_buffer_pool_config_get_cache_policy(config, &cache_policy);
+	imx_phys_mem_pool->cache_policy = cache_policy;
+	GST_INFO_OBJECT(pool, "using %s memory", gst_imx_phys_mem_cache_policy_get_name(cache_policy));
+
+	imx_phys_mem_pool->dmabuf_export = gst_imx_phys_mem_buffer_pool_config_get_dmabuf_export(config);
+	GST_INFO_OBJECT(pool, "DMA-BUF export: %s", imx_phys_mem_pool->dmabuf_export ? "yes" : "no");
+
+	elastic_max_buffers = 0;
+	idle_timeout = 0;
+	gst_imx_phys_mem_buffer_pool_config_get_elastic(config, &elastic_max_buffers, &idle_timeout);
+	if ((max_buffers == 0) && (elastic_max_buffers != 0))
+		max_buffers = MAX(elastic_max_buffers, min_buffers);
+#if !GST_CHECK_VERSION(1, 3, 1)
+	if (idle_timeout != 0)
+	{
+		GST_INFO_OBJECT(pool, "idle buffer trimming requires GStreamer 1.3.1 or newer; disabling it");
+		idle_timeout = 0;
+	}
+#endif
+	imx_phys_mem_pool->min_buffers = min_buffers;
+	imx_phys_mem_pool->idle_timeout = idle_timeout;
+	if ((elastic_max_buffers != 0) || (idle_timeout != 0))
+		GST_INFO_OBJECT(pool, "elastic mode enabled: min/max buffers: %u/%u  idle timeout: %" GST_TIME_FORMAT, min_buffers, max_buffers, GST_TIME_ARGS(idle_timeout));
+
 	/* Alignment does *not* modify width/height values, since these describe
 	 * the actual width/height of the frame, and do not contain padding pixels.
 	 * What *is* modified are the padding and stride values inside the video info. */
 
-	gst_video_alignment_reset(&align);
 	width = GST_VIDEO_INFO_WIDTH(&(imx_phys_mem_pool->video_info));
 	height = GST_VIDEO_INFO_HEIGHT(&(imx_phys_mem_pool->video_info));
-	align.padding_right = (horiz_alignment - (width & (horiz_alignment - 1))) & (horiz_alignment - 1);
-	align.padding_bottom = (vert_alignment - (height & (vert_alignment - 1))) & (vert_alignment - 1);
+	gst_imx_phys_mem_buffer_pool_compute_video_alignment(&(imx_phys_mem_pool->video_info), horiz_alignment, vert_alignment, &align);
+
+	/* A GstVideoAlignment in the config is a requirement as well; pad the
+	 * frames enough to satisfy both. Top and left padding are not supported,
+	 * since devices expect frames to begin at the start of the memory block. */
+	if (gst_buffer_pool_config_has_option(config, GST_BUFFER_POOL_OPTION_VIDEO_ALIGNMENT))
+	{
+		GstVideoAlignment config_align;
+		guint i;
+
+		gst_video_alignment_reset(&config_align);
+		gst_buffer_pool_config_get_video_alignment(config, &config_align);
+
+		align.padding_right = MAX(align.padding_right, config_align.padding_right);
+		align.padding_bottom = MAX(align.padding_bottom, config_align.padding_bottom);
+		for (i = 0; i < GST_VIDEO_MAX_PLANES; ++i)
+			align.stride_align[i] |= config_align.stride_align[i];
+
+		GST_INFO_OBJECT(pool, "merged with video alignment from config");
+	}
+
 	gst_video_info_align(&(imx_phys_mem_pool->video_info), &align);
+	imx_phys_mem_pool->video_alignment = align;
 
 	/* After alignment, the size of the video info changed. The pool config needs to be
 	 * updated to contain the new size. Otherwise, the buffer pool class will constantly
@@ -181,6 +428,94 @@ static gboolean gst_imx_phys_mem_buffer_pool_set_config(GstBufferPool *pool, Gst
 }
 
 
+static gboolean gst_imx_phys_mem_buffer_pool_start(GstBufferPool *pool)
+{
+	gboolean ret;
+	GstImxPhysMemBufferPool *imx_phys_mem_pool = GST_IMX_PHYS_MEM_BUFFER_POOL(pool);
+
+	/* The base class preallocates the minimum number of buffers here, and
+	 * puts them into its queue with release_buffer(), even though they were
+	 * never acquired, so these calls must not be counted */
+	g_mutex_lock(&(imx_phys_mem_pool->stats_mutex));
+	imx_phys_mem_pool->preallocating = TRUE;
+	g_mutex_unlock(&(imx_phys_mem_pool->stats_mutex));
+
+	ret = GST_BUFFER_POOL_CLASS(gst_imx_phys_mem_buffer_pool_parent_class)->start(pool);
+
+	g_mutex_lock(&(imx_phys_mem_pool->stats_mutex));
+	imx_phys_mem_pool->preallocating = FALSE;
+	imx_phys_mem_pool->num_outstanding = 0;
+	imx_phys_mem_pool->stats.max_num_buffers = imx_phys_mem_pool->stats.num_buffers;
+	imx_phys_mem_pool->idle_period_start = g_get_monotonic_time();
+	imx_phys_mem_pool->min_free_buffers = imx_phys_mem_pool->stats.num_buffers;
+	g_mutex_unlock(&(imx_phys_mem_pool->stats_mutex));
+
+	/* Without acquisitions and releases, idle periods would never be checked,
+	 * so check them periodically as well. The timer holds a reference to the
+	 * pool, which is dropped when stop() unschedules it. */
+	if (ret && (imx_phys_mem_pool->idle_timeout != 0))
+	{
+		GstClock *clock = gst_system_clock_obtain();
+		imx_phys_mem_pool->trim_timer_id = gst_clock_new_periodic_id(clock, gst_clock_get_time(clock) + imx_phys_mem_pool->idle_timeout, imx_phys_mem_pool->idle_timeout);
+		gst_object_unref(GST_OBJECT(clock));
+
+		if (gst_clock_id_wait_async(imx_phys_mem_pool->trim_timer_id, gst_imx_phys_mem_buffer_pool_trim_timer_cb, gst_object_ref(GST_OBJECT(pool)), (GDestroyNotify)gst_object_unref) != GST_CLOCK_OK)
+		{
+			GST_WARNING_OBJECT(pool, "could not start idle buffer trimming timer; idle buffers are only trimmed when buffers are released");
+			gst_clock_id_unref(imx_phys_mem_pool->trim_timer_id);
+			imx_phys_mem_pool->trim_timer_id = NULL;
+		}
+	}
+
+	return ret;
+}
+
+
+static gboolean gst_imx_phys_mem_buffer_pool_stop(GstBufferPool *pool)
+{
+	GstImxPhysMemBufferPool *imx_phys_mem_pool = GST_IMX_PHYS_MEM_BUFFER_POOL(pool);
+
+	if (imx_phys_mem_pool->trim_timer_id != NULL)
+	{
+		gst_clock_id_unschedule(imx_phys_mem_pool->trim_timer_id);
+		gst_clock_id_unref(imx_phys_mem_pool->trim_timer_id);
+		imx_phys_mem_pool->trim_timer_id = NULL;
+	}
+
+	return GST_BUFFER_POOL_CLASS(gst_imx_phys_mem_buffer_pool_parent_class)->stop(pool);
+}
+
+
+static GstFlowReturn gst_imx_phys_mem_buffer_pool_acquire_buffer(GstBufferPool *pool, GstBuffer **buffer, GstBufferPoolAcquireParams *params)
+{
+	GstFlowReturn flow_ret;
+	guint64 num_misses;
+	GstImxPhysMemBufferPool *imx_phys_mem_pool = GST_IMX_PHYS_MEM_BUFFER_POOL(pool);
+
+	g_mutex_lock(&(imx_phys_mem_pool->stats_mutex));
+	num_misses = imx_phys_mem_pool->stats.num_misses;
+	g_mutex_unlock(&(imx_phys_mem_pool->stats_mutex));
+
+	flow_ret = GST_BUFFER_POOL_CLASS(gst_imx_phys_mem_buffer_pool_parent_class)->acquire_buffer(pool, buffer, params);
+	if (flow_ret != GST_FLOW_OK)
+		return flow_ret;
+
+	g_mutex_lock(&(imx_phys_mem_pool->stats_mutex));
+
+	imx_phys_mem_pool->num_outstanding++;
+	/* If alloc_buffer() was called meanwhile, the miss was already counted.
+	 * With concurrent acquisitions, this is an approximation. */
+	if (imx_phys_mem_pool->stats.num_misses == num_misses)
+		imx_phys_mem_pool->stats.num_hits++;
+
+	imx_phys_mem_pool->min_free_buffers = MIN(imx_phys_mem_pool->min_free_buffers, imx_phys_mem_pool->stats.num_buffers - imx_phys_mem_pool->num_outstanding);
+
+	g_mutex_unlock(&(imx_phys_mem_pool->stats_mutex));
+
+	return GST_FLOW_OK;
+}
+
+
 static GstFlowReturn gst_imx_phys_mem_buffer_pool_alloc_buffer(GstBufferPool *pool, GstBuffer **buffer, G_GNUC_UNUSED GstBufferPoolAcquireParams *params)
 {
 	GstImxPhysMemBufferPool *imx_phys_mem_pool;
@@ -193,6 +528,9 @@ static GstFlowReturn gst_imx_phys_mem_buffer_pool_alloc_buffer(GstBufferPool *po
 
 	memset(&alloc_params, 0, sizeof(GstAllocationParams));
 	alloc_params.flags = imx_phys_mem_pool->read_only ? GST_MEMORY_FLAG_READONLY : 0;
+	alloc_params.flags |= gst_imx_phys_mem_cache_policy_to_memory_flags(imx_phys_mem_pool->cache_policy);
+	if (imx_phys_mem_pool->dmabuf_export)
+		alloc_params.flags |= GST_IMX_PHYS_MEMORY_FLAG_DMABUF;
 	alloc_params.align = 0;
 
 	info = &imx_phys_mem_pool->video_info;
@@ -248,29 +586,152 @@ static GstFlowReturn gst_imx_phys_mem_buffer_pool_alloc_buffer(GstBufferPool *po
 
 		phys_mem_meta->phys_addr = imx_phys_mem_mem->phys_addr;
 
-		phys_mem_meta->x_padding = (horiz_alignment - (GST_VIDEO_INFO_WIDTH(&(imx_phys_mem_pool->video_info)) & (horiz_alignment - 1))) & (horiz_alignment - 1);
-		phys_mem_meta->y_padding = (vert_alignment - (GST_VIDEO_INFO_HEIGHT(&(imx_phys_mem_pool->video_info)) & (vert_alignment - 1))) & (vert_alignment - 1);
+		phys_mem_meta->x_padding = imx_phys_mem_pool->video_alignment.padding_right;
+		phys_mem_meta->y_padding = imx_phys_mem_pool->video_alignment.padding_bottom;
 
 		GST_DEBUG_OBJECT(pool, "phys mem meta padding: x/y %" G_GSIZE_FORMAT "/%" G_GSIZE_FORMAT " using horiz/vert alignment: %u/%u", phys_mem_meta->x_padding, phys_mem_meta->y_padding, horiz_alignment, vert_alignment);
 	}
 
 	*buffer = buf;
 
+	g_mutex_lock(&(imx_phys_mem_pool->stats_mutex));
+	imx_phys_mem_pool->stats.num_buffers++;
+	imx_phys_mem_pool->stats.max_num_buffers = MAX(imx_phys_mem_pool->stats.max_num_buffers, imx_phys_mem_pool->stats.num_buffers);
+	if (!(imx_phys_mem_pool->preallocating))
+		imx_phys_mem_pool->stats.num_misses++;
+	g_mutex_unlock(&(imx_phys_mem_pool->stats_mutex));
+
 	return GST_FLOW_OK;
 }
 
 
+static void gst_imx_phys_mem_buffer_pool_release_buffer(GstBufferPool *pool, GstBuffer *buffer)
+{
+	GstImxPhysMemBufferPool *imx_phys_mem_pool = GST_IMX_PHYS_MEM_BUFFER_POOL(pool);
+
+	g_mutex_lock(&(imx_phys_mem_pool->stats_mutex));
+	if (!(imx_phys_mem_pool->preallocating) && (imx_phys_mem_pool->num_outstanding > 0))
+		imx_phys_mem_pool->num_outstanding--;
+	g_mutex_unlock(&(imx_phys_mem_pool->stats_mutex));
+
+	GST_BUFFER_POOL_CLASS(gst_imx_phys_mem_buffer_pool_parent_class)->release_buffer(pool, buffer);
+
+	if (imx_phys_mem_pool->idle_timeout != 0)
+		gst_imx_phys_mem_buffer_pool_trim_idle_buffers(imx_phys_mem_pool);
+}
+
+
+static void gst_imx_phys_mem_buffer_pool_free_buffer(GstBufferPool *pool, GstBuffer *buffer)
+{
+	GstImxPhysMemBufferPool *imx_phys_mem_pool = GST_IMX_PHYS_MEM_BUFFER_POOL(pool);
+
+	GST_BUFFER_POOL_CLASS(gst_imx_phys_mem_buffer_pool_parent_class)->free_buffer(pool, buffer);
+
+	g_mutex_lock(&(imx_phys_mem_pool->stats_mutex));
+	if (imx_phys_mem_pool->stats.num_buffers > 0)
+		imx_phys_mem_pool->stats.num_buffers--;
+	g_mutex_unlock(&(imx_phys_mem_pool->stats_mutex));
+}
+
+
+static void gst_imx_phys_mem_buffer_pool_trim_idle_buffers(GstImxPhysMemBufferPool *imx_phys_mem_pool)
+{
+	guint i, num_free, num_to_trim = 0;
+	gint64 now;
+	GstBufferPool *pool = GST_BUFFER_POOL_CAST(imx_phys_mem_pool);
+
+	g_mutex_lock(&(imx_phys_mem_pool->stats_mutex));
+
+	/* Releasing trimmed buffers ends up here again; also, the
+	 * buffers preallocated by start() are not idle */
+	if (imx_phys_mem_pool->trimming || imx_phys_mem_pool->preallocating)
+	{
+		g_mutex_unlock(&(imx_phys_mem_pool->stats_mutex));
+		return;
+	}
+
+	num_free = imx_phys_mem_pool->stats.num_buffers - MIN(imx_phys_mem_pool->num_outstanding, imx_phys_mem_pool->stats.num_buffers);
+	imx_phys_mem_pool->min_free_buffers = MIN(imx_phys_mem_pool->min_free_buffers, num_free);
+
+	now = g_get_monotonic_time();
+	if ((now - imx_phys_mem_pool->idle_period_start) >= (gint64)(GST_TIME_AS_USECONDS(imx_phys_mem_pool->idle_timeout)))
+	{
+		/* min_free_buffers buffers were free during the entire idle period */
+		num_to_trim = imx_phys_mem_pool->min_free_buffers;
+		if (imx_phys_mem_pool->stats.num_buffers > imx_phys_mem_pool->min_buffers)
+			num_to_trim = MIN(num_to_trim, imx_phys_mem_pool->stats.num_buffers - imx_phys_mem_pool->min_buffers);
+		else
+			num_to_trim = 0;
+
+		imx_phys_mem_pool->idle_period_start = now;
+		imx_phys_mem_pool->min_free_buffers = num_free - num_to_trim;
+		imx_phys_mem_pool->trimming = (num_to_trim > 0);
+	}
+
+	g_mutex_unlock(&(imx_phys_mem_pool->stats_mutex));
+
+	if (num_to_trim == 0)
+		return;
+
+	GST_DEBUG_OBJECT(pool, "freeing %u idle buffers", num_to_trim);
+
+	for (i = 0; i < num_to_trim; ++i)
+	{
+		GstBuffer *buffer;
+		GstBufferPoolAcquireParams params;
+
+		memset(&params, 0, sizeof(params));
+		params.flags = GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT;
+
+		if (gst_buffer_pool_acquire_buffer(pool, &buffer, &params) != GST_FLOW_OK)
+			break;
+
+#if GST_CHECK_VERSION(1, 3, 1)
+		/* Buffers with this flag are freed by the base class
+		 * instead of being put back into its queue */
+		GST_BUFFER_FLAG_SET(buffer, GST_BUFFER_FLAG_TAG_MEMORY);
+#endif
+		gst_buffer_unref(buffer);
+	}
+
+	g_mutex_lock(&(imx_phys_mem_pool->stats_mutex));
+	/* The acquisitions above are not actual uses of the buffers */
+	imx_phys_mem_pool->stats.num_hits -= MIN(imx_phys_mem_pool->stats.num_hits, i);
+	imx_phys_mem_pool->stats.num_trimmed += i;
+	imx_phys_mem_pool->trimming = FALSE;
+	g_mutex_unlock(&(imx_phys_mem_pool->stats_mutex));
+}
+
+
+static gboolean gst_imx_phys_mem_buffer_pool_trim_timer_cb(G_GNUC_UNUSED GstClock *clock, G_GNUC_UNUSED GstClockTime time, G_GNUC_UNUSED GstClockID id, gpointer user_data)
+{
+	/* Acquisitions fail with GST_FLOW_FLUSHING if the pool is
+	 * being deactivated meanwhile, so nothing is trimmed then */
+	gst_imx_phys_mem_buffer_pool_trim_idle_buffers(GST_IMX_PHYS_MEM_BUFFER_POOL(user_data));
+	return TRUE;
+}
+
+
 static void gst_imx_phys_mem_buffer_pool_finalize(GObject *object)
 {
 	GstImxPhysMemBufferPool *imx_phys_mem_pool = GST_IMX_PHYS_MEM_BUFFER_POOL(object);
 
-	GST_INFO_OBJECT(object, "shutting down physical memory buffer pool");
+	GST_INFO_OBJECT(
+		object,
+		"shutting down physical memory buffer pool; hits: %" G_GUINT64_FORMAT "  misses: %" G_GUINT64_FORMAT "  trimmed: %" G_GUINT64_FORMAT "  max buffers: %u",
+		imx_phys_mem_pool->stats.num_hits,
+		imx_phys_mem_pool->stats.num_misses,
+		imx_phys_mem_pool->stats.num_trimmed,
+		imx_phys_mem_pool->stats.max_num_buffers
+	);
 	G_OBJECT_CLASS (gst_imx_phys_mem_buffer_pool_parent_class)->finalize(object);
 
 	/* unref'ing AFTER calling the parent class' finalize function, since the parent
 	 * class will shut down the allocated memory blocks, for which the allocator must
 	 * exist */
 	gst_object_unref(imx_phys_mem_pool->allocator);
+
+	g_mutex_clear(&(imx_phys_mem_pool->stats_mutex));
 }
 
 
@@ -281,16 +742,34 @@ static void gst_imx_phys_mem_buffer_pool_class_init(GstImxPhysMemBufferPoolClass
 
 	GST_DEBUG_CATEGORY_INIT(imx_phys_mem_bufferpool_debug, "imxphysmembufferpool", 0, "Physical memory buffer pool");
 
-	object_class->finalize     = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_buffer_pool_finalize);
-	parent_class->get_options  = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_buffer_pool_get_options);
-	parent_class->set_config   = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_buffer_pool_set_config);
-	parent_class->alloc_buffer = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_buffer_pool_alloc_buffer);
+	object_class->finalize       = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_buffer_pool_finalize);
+	parent_class->get_options    = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_buffer_pool_get_options);
+	parent_class->set_config     = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_buffer_pool_set_config);
+	parent_class->start          = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_buffer_pool_start);
+	parent_class->stop           = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_buffer_pool_stop);
+	parent_class->acquire_buffer = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_buffer_pool_acquire_buffer);
+	parent_class->alloc_buffer   = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_buffer_pool_alloc_buffer);
+	parent_class->release_buffer = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_buffer_pool_release_buffer);
+	parent_class->free_buffer    = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_buffer_pool_free_buffer);
 }
 
 
 static void gst_imx_phys_mem_buffer_pool_init(GstImxPhysMemBufferPool *pool)
 {
 	pool->add_video_meta = FALSE;
+	pool->cache_policy = DEFAULT_CACHE_POLICY;
+	pool->dmabuf_export = FALSE;
+	gst_video_alignment_reset(&(pool->video_alignment));
+	pool->min_buffers = 0;
+	pool->idle_timeout = 0;
+	g_mutex_init(&(pool->stats_mutex));
+	memset(&(pool->stats), 0, sizeof(pool->stats));
+	pool->num_outstanding = 0;
+	pool->preallocating = FALSE;
+	pool->trimming = FALSE;
+	pool->idle_period_start = 0;
+	pool->min_free_buffers = 0;
+	pool->trim_timer_id = NULL;
 	GST_INFO_OBJECT(pool, "initializing physical memory buffer pool");
 }
 
@@ -25,6 +25,7 @@
 #include <gst/video/video.h>
 #include <gst/video/gstvideometa.h>
 #include <gst/video/gstvideopool.h>
+#include "phys_mem_allocator.h"
 
 
 G_BEGIN_DECLS
@@ -39,6 +40,35 @@ typedef struct _GstImxPhysMemBufferPoolClass GstImxPhysMemBufferPoolClass;
 #define GST_IMX_PHYS_MEM_BUFFER_POOL_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_IMX_PHYS_MEM_BUFFER_POOL, GstImxPhysMemBufferPoolClass))
 
 
+/* Alignment used by pools whose config does not set one */
+#define GST_IMX_PHYS_MEM_BUFFER_POOL_DEFAULT_HORIZ_ALIGNMENT 16
+#define GST_IMX_PHYS_MEM_BUFFER_POOL_DEFAULT_VERT_ALIGNMENT 8
+
+/* Meta API used in allocation queries to publish the alignment an element
+ * needs its input frames to have; see
+ * @gst_imx_phys_mem_buffer_pool_query_add_alignment . It is not attached
+ * to buffers. */
+#define GST_IMX_PHYS_MEM_ALIGNMENT_META_API_TYPE (gst_imx_phys_mem_alignment_meta_api_get_type())
+
+
+typedef struct _GstImxPhysMemBufferPoolStats GstImxPhysMemBufferPoolStats;
+
+
+/* Buffer statistics of a pool.
+ *
+ * num_hits counts acquired buffers which the pool had available, num_misses
+ * those which had to be allocated after the pool was started, and num_trimmed
+ * the idle buffers which were released back to the allocator. num_buffers is
+ * the number of buffers which currently exist, max_num_buffers its high-water
+ * mark since the pool was started.
+ */
+struct _GstImxPhysMemBufferPoolStats
+{
+	guint64 num_hits, num_misses, num_trimmed;
+	guint num_buffers, max_num_buffers;
+};
+
+
 struct _GstImxPhysMemBufferPool
 {
 	GstBufferPool bufferpool;
@@ -48,6 +78,35 @@ struct _GstImxPhysMemBufferPool
 	gboolean add_video_meta;
 	gboolean read_only;
 	guint horiz_alignment, vert_alignment;
+	GstImxPhysMemCachePolicy cache_policy;
+	gboolean dmabuf_export;
+
+	/*< private >*/
+
+	/* Alignment applied to video_info; combines horiz_alignment,
+	 * vert_alignment and the GstVideoAlignment from the config, if any */
+	GstVideoAlignment video_alignment;
+
+	/* Elastic mode settings; an idle timeout of 0 disables trimming */
+	guint min_buffers;
+	GstClockTime idle_timeout;
+
+	/* Mutex protecting the fields below */
+	GMutex stats_mutex;
+	GstImxPhysMemBufferPoolStats stats;
+	guint num_outstanding;
+	/* TRUE while start() preallocates the minimum number of buffers */
+	gboolean preallocating;
+	/* TRUE while a thread releases idle buffers */
+	gboolean trimming;
+	/* Start of the current idle period (in microseconds, monotonic clock),
+	 * and the smallest number of free buffers seen during it */
+	gint64 idle_period_start;
+	guint min_free_buffers;
+
+	/* Periodic system clock entry which checks for idle buffers while
+	 * the pool is active and has an idle timeout; NULL otherwise */
+	GstClockID trim_timer_id;
 };
 
 
@@ -58,10 +117,69 @@ struct _GstImxPhysMemBufferPoolClass
 
 
 GType gst_imx_phys_mem_buffer_pool_get_type(void);
+GType gst_imx_phys_mem_alignment_meta_api_get_type(void);
 
+/* Sets the horizontal and vertical alignment (in pixels and rows, both
+ * powers of two) the frames of the pool are padded to. If the config also
+ * contains a GstVideoAlignment (GST_BUFFER_POOL_OPTION_VIDEO_ALIGNMENT), the
+ * pool pads the frames enough to satisfy both. */
 void gst_imx_phys_mem_buffer_pool_config_set_alignment(GstStructure *config, guint horiz_alignment, guint vert_alignment);
 void gst_imx_phys_mem_buffer_pool_config_get_alignment(GstStructure *config, guint *horiz_alignment, guint *vert_alignment);
 
+/* Fills align with the padding the pool would add to frames described by info
+ * with the given horizontal and vertical alignment. Consumers which propose
+ * pools other than physical memory pools use this to set the
+ * GstVideoAlignment in their config. */
+void gst_imx_phys_mem_buffer_pool_compute_video_alignment(GstVideoInfo const *info, guint horiz_alignment, guint vert_alignment, GstVideoAlignment *align);
+
+/* Alignment negotiation through allocation queries.
+ *
+ * Consumers publish the alignment they need their input frames to have with
+ * @gst_imx_phys_mem_buffer_pool_query_add_alignment in their propose_allocation
+ * function. If the query already contains an alignment (for example, because
+ * an element in passthrough mode forwarded it downstream first), the union of
+ * both is stored. Producers get the union of all published requirements with
+ * @gst_imx_phys_mem_buffer_pool_query_get_alignment in decide_allocation,
+ * combine it with their own with @gst_imx_phys_mem_buffer_pool_merge_alignment ,
+ * and configure their pool with it. This way, one allocation satisfies every
+ * element along the path, and no element has to copy frames because of their
+ * padding. Alignments are powers of two, so the union is the maximum. */
+void gst_imx_phys_mem_buffer_pool_query_add_alignment(GstQuery *query, guint horiz_alignment, guint vert_alignment);
+/* Returns TRUE and the union of the published alignments if the query
+ * contains any. horiz_alignment and vert_alignment are left unchanged otherwise. */
+gboolean gst_imx_phys_mem_buffer_pool_query_get_alignment(GstQuery *query, guint *horiz_alignment, guint *vert_alignment);
+/* Merges the second alignment into the first one. */
+void gst_imx_phys_mem_buffer_pool_merge_alignment(guint *horiz_alignment, guint *vert_alignment, guint other_horiz_alignment, guint other_vert_alignment);
+
+/* Sets the CPU cache policy of the pool's memory blocks. Pools which get no
+ * cache policy in their config allocate cached memory. Elements should pick
+ * the policy matching how the CPU accesses the buffers: cached if the CPU reads
+ * from them, write-combined if it only writes to them sequentially (for
+ * example, when copying frames into them), and uncached if only devices access
+ * them. See phys_mem_allocator.h for details. */
+void gst_imx_phys_mem_buffer_pool_config_set_cache_policy(GstStructure *config, GstImxPhysMemCachePolicy cache_policy);
+void gst_imx_phys_mem_buffer_pool_config_get_cache_policy(GstStructure *config, GstImxPhysMemCachePolicy *cache_policy);
+
+/* If dmabuf_export is TRUE, the pool allocates memory blocks which can be
+ * exported as DMA-BUFs (see "DMA-BUF export" in phys_mem_allocator.h and
+ * @gst_imx_dmabuf_export_buffer ). Disabled by default, since such blocks
+ * may come from a different memory area, and are never carved out of arenas. */
+void gst_imx_phys_mem_buffer_pool_config_set_dmabuf_export(GstStructure *config, gboolean dmabuf_export);
+gboolean gst_imx_phys_mem_buffer_pool_config_get_dmabuf_export(GstStructure *config);
+
+/* Enables the elastic mode of the pool. In this mode, the pool still
+ * preallocates min_buffers buffers and grows on demand, but if the config's
+ * maximum is 0 (= unlimited), max_buffers is used as a hard cap instead. In
+ * addition, buffers which stayed unused for at least idle_timeout are freed,
+ * as long as more than min_buffers exist. Idle buffers are detected when
+ * buffers are acquired or released, so a pool which is not used at all keeps
+ * its buffers. An idle_timeout of 0 disables trimming. */
+void gst_imx_phys_mem_buffer_pool_config_set_elastic(GstStructure *config, guint max_buffers, GstClockTime idle_timeout);
+void gst_imx_phys_mem_buffer_pool_config_get_elastic(GstStructure *config, guint *max_buffers, GstClockTime *idle_timeout);
+
+/* Retrieves the current buffer statistics of the pool. */
+void gst_imx_phys_mem_buffer_pool_get_stats(GstImxPhysMemBufferPool *imx_phys_mem_pool, GstImxPhysMemBufferPoolStats *stats);
+
 /* Note that this function returns a floating reference. See gst_object_ref_sink() for details. */
 GstBufferPool *gst_imx_phys_mem_buffer_pool_new(gboolean read_only);
 
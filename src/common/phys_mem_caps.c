@@ -0,0 +1,154 @@
+/* Caps feature for physically contiguous memory
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include "phys_mem_caps.h"
+
+
+GST_DEBUG_CATEGORY_STATIC(imx_phys_mem_caps_debug);
+#define GST_CAT_DEFAULT imx_phys_mem_caps_debug
+
+
+G_LOCK_DEFINE_STATIC(fallback_copies);
+static guint64 num_fallback_copies = 0;
+
+
+static void gst_imx_phys_mem_caps_init_debug(void)
+{
+	static gsize initialized = 0;
+
+	if (g_once_init_enter(&initialized))
+	{
+		GST_DEBUG_CATEGORY_INIT(imx_phys_mem_caps_debug, "imxphysmemcaps", 0, "Physical memory caps feature");
+		g_once_init_leave(&initialized, 1);
+	}
+}
+
+
+gboolean gst_imx_phys_mem_caps_has_feature(GstCaps const *caps, guint index)
+{
+	GstCapsFeatures *features = gst_caps_get_features(caps, index);
+	return (features != NULL) && gst_caps_features_contains(features, GST_CAPS_FEATURE_MEMORY_IMX_PHYS_MEM);
+}
+
+
+GstCaps* gst_imx_phys_mem_caps_add_feature_variants(GstCaps const *caps)
+{
+	GstCaps *phys_mem_caps, *system_memory_caps;
+	guint i, n;
+
+	phys_mem_caps = gst_caps_new_empty();
+	system_memory_caps = gst_caps_new_empty();
+
+	n = gst_caps_get_size(caps);
+	for (i = 0; i < n; ++i)
+	{
+		GstStructure *structure = gst_caps_get_structure(caps, i);
+		GstCapsFeatures *features = gst_caps_get_features(caps, i);
+
+		if ((features != NULL) && !gst_caps_features_is_equal(features, GST_CAPS_FEATURES_MEMORY_SYSTEM_MEMORY) && !gst_caps_features_contains(features, GST_CAPS_FEATURE_MEMORY_IMX_PHYS_MEM))
+		{
+			/* Some other caps feature (for example, GL memory); keep it as it is */
+			gst_caps_append_structure_full(system_memory_caps, gst_structure_copy(structure), gst_caps_features_copy(features));
+			continue;
+		}
+
+		gst_caps_append_structure_full(phys_mem_caps, gst_structure_copy(structure), gst_caps_features_new(GST_CAPS_FEATURE_MEMORY_IMX_PHYS_MEM, NULL));
+		gst_caps_append_structure_full(system_memory_caps, gst_structure_copy(structure), NULL);
+	}
+
+	return gst_caps_merge(phys_mem_caps, system_memory_caps);
+}
+
+
+GstCaps* gst_imx_phys_mem_caps_remove_feature(GstCaps const *caps)
+{
+	GstCaps *system_memory_caps;
+	guint i, n;
+
+	system_memory_caps = gst_caps_new_empty();
+
+	n = gst_caps_get_size(caps);
+	for (i = 0; i < n; ++i)
+	{
+		GstStructure *structure = gst_caps_get_structure(caps, i);
+		GstCapsFeatures *features = gst_caps_get_features(caps, i);
+
+		if ((features != NULL) && !gst_caps_features_is_equal(features, GST_CAPS_FEATURES_MEMORY_SYSTEM_MEMORY) && !gst_caps_features_contains(features, GST_CAPS_FEATURE_MEMORY_IMX_PHYS_MEM))
+		{
+			/* Some other caps feature (for example, GL memory); keep it as it is */
+			system_memory_caps = gst_caps_merge_structure_full(system_memory_caps, gst_structure_copy(structure), gst_caps_features_copy(features));
+			continue;
+		}
+
+		/* Physical memory structures usually are followed by the same
+		 * structures in system memory; merging skips these duplicates */
+		system_memory_caps = gst_caps_merge_structure_full(system_memory_caps, gst_structure_copy(structure), NULL);
+	}
+
+	return system_memory_caps;
+}
+
+
+GstCaps* gst_imx_phys_mem_caps_select_feature(GstPad *srcpad, GstCaps *caps)
+{
+	GstCaps *phys_mem_caps;
+
+	gst_imx_phys_mem_caps_init_debug();
+
+	phys_mem_caps = gst_caps_copy(caps);
+	gst_caps_set_features(phys_mem_caps, 0, gst_caps_features_new(GST_CAPS_FEATURE_MEMORY_IMX_PHYS_MEM, NULL));
+
+	if (gst_pad_peer_query_accept_caps(srcpad, phys_mem_caps))
+	{
+		GST_DEBUG_OBJECT(srcpad, "peer accepts physical memory caps %" GST_PTR_FORMAT, (gpointer)phys_mem_caps);
+		gst_caps_unref(caps);
+		return phys_mem_caps;
+	}
+	else
+	{
+		GST_DEBUG_OBJECT(srcpad, "peer does not accept physical memory caps; using system memory caps %" GST_PTR_FORMAT, (gpointer)caps);
+		gst_caps_unref(phys_mem_caps);
+		return caps;
+	}
+}
+
+
+void gst_imx_phys_mem_caps_count_fallback_copy(GstObject *object, guint64 *num_copies)
+{
+	gst_imx_phys_mem_caps_init_debug();
+
+	if ((*num_copies)++ == 0)
+		GST_WARNING_OBJECT(object, "input frames are not in physically contiguous memory and have to be copied; negotiate " GST_CAPS_FEATURE_MEMORY_IMX_PHYS_MEM " caps upstream to avoid this");
+
+	G_LOCK(fallback_copies);
+	++num_fallback_copies;
+	G_UNLOCK(fallback_copies);
+}
+
+
+guint64 gst_imx_phys_mem_caps_get_num_fallback_copies(void)
+{
+	guint64 num;
+
+	G_LOCK(fallback_copies);
+	num = num_fallback_copies;
+	G_UNLOCK(fallback_copies);
+
+	return num;
+}
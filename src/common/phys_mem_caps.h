@@ -0,0 +1,79 @@
+/* Caps feature for physically contiguous memory
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#ifndef GST_IMX_COMMON_PHYS_MEM_CAPS_H
+#define GST_IMX_COMMON_PHYS_MEM_CAPS_H
+
+#include <gst/gst.h>
+
+
+G_BEGIN_DECLS
+
+
+/* Caps feature for video frames in physically contiguous memory, that is,
+ * in buffers with a GstImxPhysMemMeta (see phys_mem_meta.h).
+ *
+ * Elements advertise caps with this feature ahead of the same caps with
+ * system memory. If both sides of a link support it, the caps with the
+ * feature are negotiated, which guarantees that no frame needs to be copied
+ * into physically contiguous memory. If one side only handles system memory,
+ * the mismatch becomes visible during negotiation, and the system memory
+ * caps are used as a fallback. Frames which then have to be copied are
+ * counted with @gst_imx_phys_mem_caps_count_fallback_copy . */
+#define GST_CAPS_FEATURE_MEMORY_IMX_PHYS_MEM "memory:ImxPhysMem"
+
+/* Expands to a caps string with two video/x-raw structures with the given
+ * fields: the first one with the physical memory caps feature, the second
+ * one with system memory. Intended for static pad templates. The fields
+ * must not end with a semicolon. */
+#define GST_IMX_PHYS_MEM_VIDEO_CAPS_MAKE(fields) \
+	"video/x-raw(" GST_CAPS_FEATURE_MEMORY_IMX_PHYS_MEM "), " fields "; " \
+	"video/x-raw, " fields
+
+
+/* Returns TRUE if the structure at the given index of the caps has the
+ * physical memory caps feature. */
+gboolean gst_imx_phys_mem_caps_has_feature(GstCaps const *caps, guint index);
+/* Returns new caps with all structures of the given caps twice: first with
+ * the physical memory caps feature, then with system memory. Caps features
+ * other than these two are left as they are. */
+GstCaps* gst_imx_phys_mem_caps_add_feature_variants(GstCaps const *caps);
+/* Returns new caps with all structures of the given caps in system memory.
+ * Used for the output side of elements whose output frames are not in
+ * physically contiguous memory. Caps features other than these two are
+ * left as they are. */
+GstCaps* gst_imx_phys_mem_caps_remove_feature(GstCaps const *caps);
+/* Takes ownership of the fixed system memory caps, and returns them with the
+ * physical memory caps feature if the peer of the pad accepts that, or
+ * unchanged otherwise. Used by elements whose output frames always are in
+ * physically contiguous memory. */
+GstCaps* gst_imx_phys_mem_caps_select_feature(GstPad *srcpad, GstCaps *caps);
+
+/* Counts a copy of a frame into physically contiguous memory that had to be
+ * made because the frame was in system memory. The first time the given
+ * counter of the element is increased from 0, a warning is logged. */
+void gst_imx_phys_mem_caps_count_fallback_copy(GstObject *object, guint64 *num_copies);
+/* Returns the number of fallback copies made by all elements so far. */
+guint64 gst_imx_phys_mem_caps_get_num_fallback_copies(void);
+
+
+G_END_DECLS
+
+
+#endif
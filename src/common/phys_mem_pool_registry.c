@@ -0,0 +1,375 @@
+/* Registry for physical memory buffer pools shared between elements
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include "phys_mem_pool_registry.h"
+#include "phys_mem_buffer_pool.h"
+
+
+GST_DEBUG_CATEGORY_STATIC(imx_phys_mem_pool_registry_debug);
+#define GST_CAT_DEFAULT imx_phys_mem_pool_registry_debug
+
+
+/* Buffers of shared pools which were not needed for this long are freed */
+#define GST_IMX_PHYS_MEM_POOL_REGISTRY_IDLE_TIMEOUT (2 * GST_SECOND)
+
+
+typedef struct
+{
+	GstBufferPool *pool;
+	guint num_users;
+
+	/* Lookup key */
+	GType allocator_type;
+	GstCaps *caps;
+	guint size;
+	guint horiz_alignment, vert_alignment;
+	GstImxPhysMemCachePolicy cache_policy;
+}
+GstImxPhysMemPoolRegistryEntry;
+
+
+static void gst_imx_phys_mem_pool_registry_finalize(GObject *object);
+static void gst_imx_phys_mem_pool_registry_free_entry(GstImxPhysMemPoolRegistryEntry *entry);
+static gboolean gst_imx_phys_mem_pool_registry_peer_query(GstElement *element, GstQuery *query, GstPadDirection direction);
+
+
+G_DEFINE_TYPE(GstImxPhysMemPoolRegistry, gst_imx_phys_mem_pool_registry, GST_TYPE_OBJECT)
+
+
+
+
+static void gst_imx_phys_mem_pool_registry_class_init(GstImxPhysMemPoolRegistryClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS(klass);
+
+	GST_DEBUG_CATEGORY_INIT(imx_phys_mem_pool_registry_debug, "imxphysmempoolregistry", 0, "Registry for shared physical memory buffer pools");
+
+	object_class->finalize = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_pool_registry_finalize);
+}
+
+
+static void gst_imx_phys_mem_pool_registry_init(GstImxPhysMemPoolRegistry *registry)
+{
+	registry->entries = NULL;
+}
+
+
+static void gst_imx_phys_mem_pool_registry_finalize(GObject *object)
+{
+	GstImxPhysMemPoolRegistry *registry = GST_IMX_PHYS_MEM_POOL_REGISTRY(object);
+
+	/* All users hold a reference to the registry until they released their
+	 * pools, so entries can only remain here if a user forgot to do that */
+	if (registry->entries != NULL)
+		GST_WARNING_OBJECT(registry, "%u pools were not released", g_slist_length(registry->entries));
+
+	g_slist_free_full(registry->entries, (GDestroyNotify)gst_imx_phys_mem_pool_registry_free_entry);
+
+	G_OBJECT_CLASS(gst_imx_phys_mem_pool_registry_parent_class)->finalize(object);
+}
+
+
+static void gst_imx_phys_mem_pool_registry_free_entry(GstImxPhysMemPoolRegistryEntry *entry)
+{
+	/* Buffers still in use keep the pool alive until they are released */
+	gst_buffer_pool_set_active(entry->pool, FALSE);
+	gst_object_unref(GST_OBJECT(entry->pool));
+	gst_caps_unref(entry->caps);
+	g_slice_free1(sizeof(GstImxPhysMemPoolRegistryEntry), entry);
+}
+
+
+GstImxPhysMemPoolRegistry* gst_imx_phys_mem_pool_registry_new(void)
+{
+	GstImxPhysMemPoolRegistry *registry = g_object_new(gst_imx_phys_mem_pool_registry_get_type(), NULL);
+	return GST_IMX_PHYS_MEM_POOL_REGISTRY(gst_object_ref_sink(registry));
+}
+
+
+GstBufferPool* gst_imx_phys_mem_pool_registry_acquire_pool(GstImxPhysMemPoolRegistry *registry, GstAllocator *allocator, GstCaps *caps, guint size, guint min_buffers, guint horiz_alignment, guint vert_alignment, GstImxPhysMemCachePolicy cache_policy)
+{
+	GSList *list;
+	GstImxPhysMemPoolRegistryEntry *entry = NULL;
+	GstBufferPool *pool;
+	GstStructure *config;
+
+	g_assert(registry != NULL);
+	g_assert(allocator != NULL);
+	g_assert(caps != NULL);
+
+	GST_OBJECT_LOCK(registry);
+
+	for (list = registry->entries; list != NULL; list = list->next)
+	{
+		GstImxPhysMemPoolRegistryEntry *candidate = (GstImxPhysMemPoolRegistryEntry *)(list->data);
+
+		if ((candidate->allocator_type == G_OBJECT_TYPE(allocator))
+		 && (candidate->size == size)
+		 && (candidate->horiz_alignment == horiz_alignment)
+		 && (candidate->vert_alignment == vert_alignment)
+		 && (candidate->cache_policy == cache_policy)
+		 && gst_caps_is_equal(candidate->caps, caps))
+		{
+			entry = candidate;
+			break;
+		}
+	}
+
+	if (entry != NULL)
+	{
+		guint num_users = ++(entry->num_users);
+		pool = GST_BUFFER_POOL_CAST(gst_object_ref(GST_OBJECT(entry->pool)));
+		GST_OBJECT_UNLOCK(registry);
+
+		GST_DEBUG_OBJECT(registry, "sharing pool %" GST_PTR_FORMAT " with %u users", (gpointer)pool, num_users);
+
+		return pool;
+	}
+
+	pool = GST_BUFFER_POOL_CAST(gst_object_ref_sink(gst_imx_phys_mem_buffer_pool_new(FALSE)));
+
+	config = gst_buffer_pool_get_config(pool);
+	gst_buffer_pool_config_set_params(config, caps, size, min_buffers, 0);
+	gst_buffer_pool_config_set_allocator(config, allocator, NULL);
+	if ((horiz_alignment != 0) && (vert_alignment != 0))
+		gst_imx_phys_mem_buffer_pool_config_set_alignment(config, horiz_alignment, vert_alignment);
+	gst_imx_phys_mem_buffer_pool_config_set_cache_policy(config, cache_policy);
+	gst_imx_phys_mem_buffer_pool_config_set_elastic(config, 0, GST_IMX_PHYS_MEM_POOL_REGISTRY_IDLE_TIMEOUT);
+	gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_IMX_PHYS_MEM);
+	gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+
+	/* The pool unrefs its allocator when it is finalized */
+	gst_object_ref(GST_OBJECT(allocator));
+
+	if (!gst_buffer_pool_set_config(pool, config) || !gst_buffer_pool_set_active(pool, TRUE))
+	{
+		GST_OBJECT_UNLOCK(registry);
+		GST_ERROR_OBJECT(registry, "could not create shared pool for caps %" GST_PTR_FORMAT, (gpointer)caps);
+		gst_object_unref(GST_OBJECT(pool));
+		return NULL;
+	}
+
+	entry = g_slice_alloc(sizeof(GstImxPhysMemPoolRegistryEntry));
+	entry->pool = pool;
+	entry->num_users = 1;
+	entry->allocator_type = G_OBJECT_TYPE(allocator);
+	entry->caps = gst_caps_ref(caps);
+	entry->size = size;
+	entry->horiz_alignment = horiz_alignment;
+	entry->vert_alignment = vert_alignment;
+	entry->cache_policy = cache_policy;
+
+	registry->entries = g_slist_prepend(registry->entries, entry);
+
+	GST_OBJECT_UNLOCK(registry);
+
+	GST_DEBUG_OBJECT(registry, "created shared %s pool %" GST_PTR_FORMAT " with buffer size %u for caps %" GST_PTR_FORMAT, gst_imx_phys_mem_cache_policy_get_name(cache_policy), (gpointer)pool, size, (gpointer)caps);
+
+	return GST_BUFFER_POOL_CAST(gst_object_ref(GST_OBJECT(pool)));
+}
+
+
+void gst_imx_phys_mem_pool_registry_release_pool(GstImxPhysMemPoolRegistry *registry, GstBufferPool *pool)
+{
+	GSList *list;
+	GstImxPhysMemPoolRegistryEntry *entry = NULL;
+	guint num_users;
+
+	g_assert(registry != NULL);
+	g_assert(pool != NULL);
+
+	GST_OBJECT_LOCK(registry);
+
+	for (list = registry->entries; list != NULL; list = list->next)
+	{
+		if (((GstImxPhysMemPoolRegistryEntry *)(list->data))->pool == pool)
+		{
+			entry = (GstImxPhysMemPoolRegistryEntry *)(list->data);
+			break;
+		}
+	}
+
+	if (entry == NULL)
+	{
+		GST_OBJECT_UNLOCK(registry);
+		GST_ERROR_OBJECT(registry, "pool %" GST_PTR_FORMAT " is not in the registry", (gpointer)pool);
+		return;
+	}
+
+	num_users = --(entry->num_users);
+	if (num_users == 0)
+		registry->entries = g_slist_remove(registry->entries, entry);
+
+	GST_OBJECT_UNLOCK(registry);
+
+	GST_DEBUG_OBJECT(registry, "released pool %" GST_PTR_FORMAT ", %u users left", (gpointer)pool, num_users);
+
+	if (num_users == 0)
+		gst_imx_phys_mem_pool_registry_free_entry(entry);
+
+	gst_object_unref(GST_OBJECT(pool));
+}
+
+
+GstContext* gst_imx_phys_mem_pool_registry_context_new(GstImxPhysMemPoolRegistry *registry)
+{
+	GstContext *context = gst_context_new(GST_IMX_PHYS_MEM_POOL_REGISTRY_CONTEXT_TYPE, TRUE);
+	GstStructure *structure = gst_context_writable_structure(context);
+	gst_structure_set(structure, "registry", GST_TYPE_IMX_PHYS_MEM_POOL_REGISTRY, registry, NULL);
+	return context;
+}
+
+
+static gboolean gst_imx_phys_mem_pool_registry_peer_query(GstElement *element, GstQuery *query, GstPadDirection direction)
+{
+	GstIterator *it;
+	GValue item = G_VALUE_INIT;
+	gboolean answered = FALSE, done = FALSE;
+
+	it = (direction == GST_PAD_SRC) ? gst_element_iterate_src_pads(element) : gst_element_iterate_sink_pads(element);
+
+	while (!answered && !done)
+	{
+		switch (gst_iterator_next(it, &item))
+		{
+			case GST_ITERATOR_OK:
+				answered = gst_pad_peer_query(GST_PAD(g_value_get_object(&item)), query);
+				g_value_reset(&item);
+				break;
+
+			case GST_ITERATOR_RESYNC:
+				gst_iterator_resync(it);
+				break;
+
+			default:
+				done = TRUE;
+				break;
+		}
+	}
+
+	g_value_unset(&item);
+	gst_iterator_free(it);
+
+	return answered;
+}
+
+
+void gst_imx_phys_mem_pool_registry_ensure(GstElement *element, GstImxPhysMemPoolRegistry **registry)
+{
+	GstQuery *query;
+	GstContext *context;
+	GstImxPhysMemPoolRegistry *new_registry;
+	gboolean found;
+
+	GST_OBJECT_LOCK(element);
+	found = (*registry != NULL);
+	GST_OBJECT_UNLOCK(element);
+	if (found)
+		return;
+
+	/* First, ask the neighbours; the context they answer with
+	 * is stored by the element's set_context function */
+	query = gst_query_new_context(GST_IMX_PHYS_MEM_POOL_REGISTRY_CONTEXT_TYPE);
+	if (gst_imx_phys_mem_pool_registry_peer_query(element, query, GST_PAD_SRC) || gst_imx_phys_mem_pool_registry_peer_query(element, query, GST_PAD_SINK))
+	{
+		context = NULL;
+		gst_query_parse_context(query, &context);
+		if (context != NULL)
+		{
+			GST_DEBUG_OBJECT(element, "got pool registry from peer");
+			gst_element_set_context(element, context);
+		}
+	}
+	gst_query_unref(query);
+
+	/* Next, ask the application and the bin, which may
+	 * set the context synchronously from the bus handler */
+	GST_OBJECT_LOCK(element);
+	found = (*registry != NULL);
+	GST_OBJECT_UNLOCK(element);
+	if (!found)
+		gst_element_post_message(element, gst_message_new_need_context(GST_OBJECT(element), GST_IMX_PHYS_MEM_POOL_REGISTRY_CONTEXT_TYPE));
+
+	/* Finally, create a new registry and announce it */
+	GST_OBJECT_LOCK(element);
+	found = (*registry != NULL);
+	GST_OBJECT_UNLOCK(element);
+	if (!found)
+	{
+		GST_DEBUG_OBJECT(element, "creating new pool registry");
+
+		new_registry = gst_imx_phys_mem_pool_registry_new();
+		context = gst_imx_phys_mem_pool_registry_context_new(new_registry);
+		gst_object_unref(GST_OBJECT(new_registry));
+
+		gst_element_set_context(element, context);
+		gst_element_post_message(element, gst_message_new_have_context(GST_OBJECT(element), context));
+	}
+}
+
+
+void gst_imx_phys_mem_pool_registry_handle_set_context(GstElement *element, GstContext *context, GstImxPhysMemPoolRegistry **registry)
+{
+	GstImxPhysMemPoolRegistry *new_registry = NULL, *old_registry;
+
+	if (g_strcmp0(gst_context_get_context_type(context), GST_IMX_PHYS_MEM_POOL_REGISTRY_CONTEXT_TYPE) != 0)
+		return;
+
+	if (!gst_structure_get(gst_context_get_structure(context), "registry", GST_TYPE_IMX_PHYS_MEM_POOL_REGISTRY, &new_registry, NULL) || (new_registry == NULL))
+	{
+		GST_WARNING_OBJECT(element, "context does not contain a pool registry");
+		return;
+	}
+
+	GST_OBJECT_LOCK(element);
+	old_registry = *registry;
+	*registry = new_registry;
+	GST_OBJECT_UNLOCK(element);
+
+	/* Users of the old registry keep their own references to it,
+	 * and release their pools there */
+	if (old_registry != NULL)
+		gst_object_unref(GST_OBJECT(old_registry));
+}
+
+
+gboolean gst_imx_phys_mem_pool_registry_handle_context_query(GstElement *element, GstQuery *query, GstImxPhysMemPoolRegistry **registry)
+{
+	gchar const *context_type;
+	GstContext *context;
+
+	if (GST_QUERY_TYPE(query) != GST_QUERY_CONTEXT)
+		return FALSE;
+
+	gst_query_parse_context_type(query, &context_type);
+	if (g_strcmp0(context_type, GST_IMX_PHYS_MEM_POOL_REGISTRY_CONTEXT_TYPE) != 0)
+		return FALSE;
+
+	GST_OBJECT_LOCK(element);
+	context = (*registry != NULL) ? gst_imx_phys_mem_pool_registry_context_new(*registry) : NULL;
+	GST_OBJECT_UNLOCK(element);
+
+	if (context == NULL)
+		return FALSE;
+
+	gst_query_set_context(query, context);
+	gst_context_unref(context);
+
+	return TRUE;
+}
@@ -0,0 +1,116 @@
+/* Registry for physical memory buffer pools shared between elements
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#ifndef GST_IMX_COMMON_PHYS_MEM_POOL_REGISTRY_H
+#define GST_IMX_COMMON_PHYS_MEM_POOL_REGISTRY_H
+
+#include <gst/gst.h>
+#include "phys_mem_allocator.h"
+
+
+G_BEGIN_DECLS
+
+
+typedef struct _GstImxPhysMemPoolRegistry GstImxPhysMemPoolRegistry;
+typedef struct _GstImxPhysMemPoolRegistryClass GstImxPhysMemPoolRegistryClass;
+
+
+#define GST_TYPE_IMX_PHYS_MEM_POOL_REGISTRY             (gst_imx_phys_mem_pool_registry_get_type())
+#define GST_IMX_PHYS_MEM_POOL_REGISTRY(obj)             (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_IMX_PHYS_MEM_POOL_REGISTRY, GstImxPhysMemPoolRegistry))
+#define GST_IMX_PHYS_MEM_POOL_REGISTRY_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_IMX_PHYS_MEM_POOL_REGISTRY, GstImxPhysMemPoolRegistryClass))
+#define GST_IS_IMX_PHYS_MEM_POOL_REGISTRY(obj)          (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_IMX_PHYS_MEM_POOL_REGISTRY))
+#define GST_IS_IMX_PHYS_MEM_POOL_REGISTRY_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_IMX_PHYS_MEM_POOL_REGISTRY))
+
+/* GstContext type used for distributing the registry in a pipeline */
+#define GST_IMX_PHYS_MEM_POOL_REGISTRY_CONTEXT_TYPE "gst.imx.phys-mem-pool-registry"
+
+
+/* The pool registry lets elements in a pipeline draw buffers from common
+ * physical memory buffer pools instead of each element allocating its own
+ * set of identical buffers.
+ *
+ * Pools are looked up by allocator type, caps, buffer size, alignment and
+ * cache policy. The caps are part of the key, since the pools attach video
+ * metas describing the frame layout to their buffers. The registry owns the
+ * pools: it configures and activates them when the first user acquires them,
+ * and deactivates them once the last user released them. Users must therefore
+ * neither change the configuration of a shared pool nor deactivate it. Since
+ * acquired buffers keep a reference to their pool, buffers which are still in
+ * use by another element stay valid after their pool was deactivated.
+ *
+ * Shared pools are elastic (see phys_mem_buffer_pool.h). They preallocate the
+ * minimum number of buffers requested by their first user, and grow on demand
+ * without a cap, since several elements hold buffers at the same time.
+ *
+ * The registry is distributed through GstContext. Elements call
+ * gst_imx_phys_mem_pool_registry_ensure() in the NULL->READY state change,
+ * handle context queries with gst_imx_phys_mem_pool_registry_handle_context_query(),
+ * and handle contexts set by the application or by other elements with
+ * gst_imx_phys_mem_pool_registry_handle_set_context(). */
+struct _GstImxPhysMemPoolRegistry
+{
+	GstObject parent;
+
+	/*< private >*/
+
+	/* List of pool entries; protected by the object lock */
+	GSList *entries;
+};
+
+
+struct _GstImxPhysMemPoolRegistryClass
+{
+	GstObjectClass parent_class;
+};
+
+
+GType gst_imx_phys_mem_pool_registry_get_type(void);
+
+GstImxPhysMemPoolRegistry* gst_imx_phys_mem_pool_registry_new(void);
+
+/* Returns a referenced, active buffer pool matching the given parameters. If
+ * the registry does not have one yet, a new pool with buffers from the given
+ * allocator is created. Every successful call must be paired with a
+ * gst_imx_phys_mem_pool_registry_release_pool() call.
+ * Returns NULL if the pool could not be created or activated. */
+GstBufferPool* gst_imx_phys_mem_pool_registry_acquire_pool(GstImxPhysMemPoolRegistry *registry, GstAllocator *allocator, GstCaps *caps, guint size, guint min_buffers, guint horiz_alignment, guint vert_alignment, GstImxPhysMemCachePolicy cache_policy);
+/* Releases a pool acquired with gst_imx_phys_mem_pool_registry_acquire_pool(),
+ * and unrefs it. The pool is deactivated once its last user released it. */
+void gst_imx_phys_mem_pool_registry_release_pool(GstImxPhysMemPoolRegistry *registry, GstBufferPool *pool);
+
+/* Creates a new context containing the registry. */
+GstContext* gst_imx_phys_mem_pool_registry_context_new(GstImxPhysMemPoolRegistry *registry);
+/* Makes sure *registry is set. If it is NULL, the registry is first looked
+ * for with context queries to the element's peers, and then by posting a
+ * need-context message. If none exists yet, a new registry is created, and
+ * announced with a have-context message. *registry is protected by the
+ * element's object lock. */
+void gst_imx_phys_mem_pool_registry_ensure(GstElement *element, GstImxPhysMemPoolRegistry **registry);
+/* Sets *registry to the registry from the context if the context has the
+ * registry context type. Call this from the element's set_context function. */
+void gst_imx_phys_mem_pool_registry_handle_set_context(GstElement *element, GstContext *context, GstImxPhysMemPoolRegistry **registry);
+/* Answers context queries for the registry context type if the registry is
+ * set. Returns TRUE if the query was answered. */
+gboolean gst_imx_phys_mem_pool_registry_handle_context_query(GstElement *element, GstQuery *query, GstImxPhysMemPoolRegistry **registry);
+
+
+G_END_DECLS
+
+
+#endif
@@ -0,0 +1,102 @@
+/* Physical memory allocation statistics queries and messages
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include "phys_mem_stats.h"
+#include "phys_mem_allocator.h"
+#include "phys_mem_caps.h"
+
+
+static void gst_imx_phys_mem_stats_set_fields(GstStructure *structure, GstImxPhysMemAllocationStats const *stats)
+{
+	gst_structure_set(
+		structure,
+		"allocated-size", G_TYPE_UINT64, (guint64)(stats->allocated_size),
+		"max-allocated-size", G_TYPE_UINT64, (guint64)(stats->max_allocated_size),
+		"num-blocks", G_TYPE_UINT, stats->num_blocks,
+		"max-num-blocks", G_TYPE_UINT, stats->max_num_blocks,
+		"num-mappings", G_TYPE_UINT, stats->num_mappings,
+		"max-num-mappings", G_TYPE_UINT, stats->max_num_mappings,
+		"num-failed-allocations", G_TYPE_UINT64, stats->num_failed_allocations,
+		NULL
+	);
+}
+
+
+static void gst_imx_phys_mem_stats_add_allocator(GstImxPhysMemAllocator *allocator, GstImxPhysMemAllocationStats const *stats, gpointer user_data)
+{
+	GstStructure *allocators = (GstStructure *)user_data;
+	GstStructure *allocator_structure = gst_structure_new_empty(GST_OBJECT_NAME(allocator));
+
+	gst_imx_phys_mem_stats_set_fields(allocator_structure, stats);
+	gst_structure_set(allocators, GST_OBJECT_NAME(allocator), GST_TYPE_STRUCTURE, allocator_structure, NULL);
+	gst_structure_free(allocator_structure);
+}
+
+
+static void gst_imx_phys_mem_stats_fill_structure(GstStructure *structure)
+{
+	GstImxPhysMemAllocationStats global_stats;
+	GstStructure *allocators;
+
+	gst_imx_phys_mem_get_global_allocation_stats(&global_stats);
+	gst_imx_phys_mem_stats_set_fields(structure, &global_stats);
+	gst_structure_set(structure, "num-fallback-copies", G_TYPE_UINT64, gst_imx_phys_mem_caps_get_num_fallback_copies(), NULL);
+
+	allocators = gst_structure_new_empty("allocators");
+	gst_imx_phys_mem_foreach_allocation_stats(gst_imx_phys_mem_stats_add_allocator, allocators);
+	gst_structure_set(structure, "allocators", GST_TYPE_STRUCTURE, allocators, NULL);
+	gst_structure_free(allocators);
+}
+
+
+GstStructure* gst_imx_phys_mem_stats_new_structure(void)
+{
+	GstStructure *structure = gst_structure_new_empty(GST_IMX_PHYS_MEM_STATS_STRUCTURE_NAME);
+	gst_imx_phys_mem_stats_fill_structure(structure);
+	return structure;
+}
+
+
+GstQuery* gst_imx_phys_mem_stats_query_new(void)
+{
+	return gst_query_new_custom(GST_QUERY_CUSTOM, gst_structure_new_empty(GST_IMX_PHYS_MEM_STATS_STRUCTURE_NAME));
+}
+
+
+gboolean gst_imx_phys_mem_stats_handle_query(GstQuery *query)
+{
+	GstStructure const *structure;
+
+	if (GST_QUERY_TYPE(query) != GST_QUERY_CUSTOM)
+		return FALSE;
+
+	structure = gst_query_get_structure(query);
+	if ((structure == NULL) || !gst_structure_has_name(structure, GST_IMX_PHYS_MEM_STATS_STRUCTURE_NAME))
+		return FALSE;
+
+	gst_imx_phys_mem_stats_fill_structure(gst_query_writable_structure(query));
+
+	return TRUE;
+}
+
+
+GstMessage* gst_imx_phys_mem_stats_message_new(GstObject *src)
+{
+	return gst_message_new_element(src, gst_imx_phys_mem_stats_new_structure());
+}
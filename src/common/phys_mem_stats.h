@@ -0,0 +1,68 @@
+/* Physical memory allocation statistics queries and messages
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#ifndef GST_IMX_COMMON_PHYS_MEM_STATS_H
+#define GST_IMX_COMMON_PHYS_MEM_STATS_H
+
+#include <gst/gst.h>
+
+
+G_BEGIN_DECLS
+
+
+/* These functions expose the allocation statistics of the physical memory
+ * allocators (see phys_mem_allocator.h) to applications.
+ *
+ * The statistics are stored in a structure named "imx-phys-mem-stats". It
+ * contains the global statistics in the fields allocated-size,
+ * max-allocated-size, num-failed-allocations (all guint64), num-blocks,
+ * max-num-blocks, num-mappings, max-num-mappings (all guint), and an
+ * "allocators" structure field, which contains one structure with the same
+ * fields per existing allocator, named after the allocator. The global
+ * num-fallback-copies field (guint64) counts the frames elements had to copy
+ * into physical memory (see phys_mem_caps.h).
+ *
+ * Applications can get the structure by sending a custom query created with
+ * @gst_imx_phys_mem_stats_query_new to the pipeline; the i.MX video sinks
+ * and video transform elements answer it. These elements also post an
+ * element message with the structure when they are stopped, so the
+ * high-water marks of a pipeline run can be logged. */
+
+
+#define GST_IMX_PHYS_MEM_STATS_STRUCTURE_NAME "imx-phys-mem-stats"
+
+
+/* Creates a new structure with the current statistics. */
+GstStructure* gst_imx_phys_mem_stats_new_structure(void);
+
+/* Creates a new statistics query. After it was answered, the statistics
+ * can be read from the query's structure (see gst_query_get_structure()). */
+GstQuery* gst_imx_phys_mem_stats_query_new(void);
+/* Fills the query with the current statistics if it is a statistics query.
+ * Returns TRUE if it is one. Elements call this in their query handlers. */
+gboolean gst_imx_phys_mem_stats_handle_query(GstQuery *query);
+
+/* Creates a new element message with the current statistics. */
+GstMessage* gst_imx_phys_mem_stats_message_new(GstObject *src);
+
+
+G_END_DECLS
+
+
+#endif
@@ -0,0 +1,146 @@
+/* Tracer for physical memory allocation statistics
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include "phys_mem_tracer.h"
+
+#if GST_CHECK_VERSION(1, 8, 0)
+
+#include <gst/gsttracer.h>
+#include <gst/gsttracerrecord.h>
+#include "phys_mem_allocator.h"
+
+
+GST_DEBUG_CATEGORY_STATIC(imx_phys_mem_tracer_debug);
+#define GST_CAT_DEFAULT imx_phys_mem_tracer_debug
+
+
+typedef struct _GstImxPhysMemTracer GstImxPhysMemTracer;
+typedef struct _GstImxPhysMemTracerClass GstImxPhysMemTracerClass;
+
+
+struct _GstImxPhysMemTracer
+{
+	GstTracer parent;
+};
+
+
+struct _GstImxPhysMemTracerClass
+{
+	GstTracerClass parent_class;
+};
+
+
+static void gst_imx_phys_mem_tracer_finalize(GObject *object);
+
+
+G_DEFINE_TYPE(GstImxPhysMemTracer, gst_imx_phys_mem_tracer, GST_TYPE_TRACER)
+
+
+static GstTracerRecord *tr_stats = NULL;
+
+
+static GstStructure* gst_imx_phys_mem_tracer_new_value_description(GType type, gchar const *description)
+{
+	return gst_structure_new(
+		"value",
+		"type", G_TYPE_GTYPE, type,
+		"description", G_TYPE_STRING, description,
+		NULL
+	);
+}
+
+
+static void gst_imx_phys_mem_tracer_log(gchar const *allocator_name, GstImxPhysMemAllocationStats const *stats)
+{
+	gst_tracer_record_log(
+		tr_stats,
+		allocator_name,
+		(guint64)(stats->allocated_size), (guint64)(stats->max_allocated_size),
+		stats->num_blocks, stats->max_num_blocks,
+		stats->num_mappings, stats->max_num_mappings,
+		stats->num_failed_allocations
+	);
+}
+
+
+static void gst_imx_phys_mem_tracer_stats_changed(GstImxPhysMemAllocator *allocator, GstImxPhysMemAllocationStats const *stats, GstImxPhysMemAllocationStats const *global_stats, G_GNUC_UNUSED gpointer user_data)
+{
+	gst_imx_phys_mem_tracer_log(GST_OBJECT_NAME(allocator), stats);
+	gst_imx_phys_mem_tracer_log("all", global_stats);
+}
+
+
+static void gst_imx_phys_mem_tracer_class_init(GstImxPhysMemTracerClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS(klass);
+
+	GST_DEBUG_CATEGORY_INIT(imx_phys_mem_tracer_debug, "imxphysmemtracer", 0, "Physical memory allocation statistics tracer");
+
+	object_class->finalize = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_tracer_finalize);
+
+	tr_stats = gst_tracer_record_new(
+		"imx-phys-mem-stats.class",
+		"allocator", GST_TYPE_STRUCTURE, gst_structure_new(
+			"scope",
+			"type", G_TYPE_GTYPE, G_TYPE_STRING,
+			"related-to", GST_TYPE_TRACER_VALUE_SCOPE, GST_TRACER_VALUE_SCOPE_PROCESS,
+			NULL
+		),
+		"allocated-size", GST_TYPE_STRUCTURE, gst_imx_phys_mem_tracer_new_value_description(G_TYPE_UINT64, "bytes of physical memory held by the allocator"),
+		"max-allocated-size", GST_TYPE_STRUCTURE, gst_imx_phys_mem_tracer_new_value_description(G_TYPE_UINT64, "high-water mark of allocated-size"),
+		"num-blocks", GST_TYPE_STRUCTURE, gst_imx_phys_mem_tracer_new_value_description(G_TYPE_UINT, "number of allocated memory blocks"),
+		"max-num-blocks", GST_TYPE_STRUCTURE, gst_imx_phys_mem_tracer_new_value_description(G_TYPE_UINT, "high-water mark of num-blocks"),
+		"num-mappings", GST_TYPE_STRUCTURE, gst_imx_phys_mem_tracer_new_value_description(G_TYPE_UINT, "number of mapped memory blocks"),
+		"max-num-mappings", GST_TYPE_STRUCTURE, gst_imx_phys_mem_tracer_new_value_description(G_TYPE_UINT, "high-water mark of num-mappings"),
+		"num-failed-allocations", GST_TYPE_STRUCTURE, gst_imx_phys_mem_tracer_new_value_description(G_TYPE_UINT64, "number of failed allocations"),
+		NULL
+	);
+}
+
+
+static void gst_imx_phys_mem_tracer_init(GstImxPhysMemTracer *tracer)
+{
+	GST_INFO_OBJECT(tracer, "installing physical memory allocation statistics hook");
+	gst_imx_phys_mem_set_allocation_stats_hook(gst_imx_phys_mem_tracer_stats_changed, tracer);
+}
+
+
+static void gst_imx_phys_mem_tracer_finalize(GObject *object)
+{
+	gst_imx_phys_mem_set_allocation_stats_hook(NULL, NULL);
+	G_OBJECT_CLASS(gst_imx_phys_mem_tracer_parent_class)->finalize(object);
+}
+
+
+gboolean gst_imx_phys_mem_tracer_register(GstPlugin *plugin)
+{
+	return gst_tracer_register(plugin, "imxphysmem", gst_imx_phys_mem_tracer_get_type());
+}
+
+
+#else
+
+
+gboolean gst_imx_phys_mem_tracer_register(G_GNUC_UNUSED GstPlugin *plugin)
+{
+	return TRUE;
+}
+
+
+#endif
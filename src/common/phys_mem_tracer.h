@@ -0,0 +1,49 @@
+/* Tracer for physical memory allocation statistics
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#ifndef GST_IMX_COMMON_PHYS_MEM_TRACER_H
+#define GST_IMX_COMMON_PHYS_MEM_TRACER_H
+
+#include <gst/gst.h>
+
+
+G_BEGIN_DECLS
+
+
+/* The imxphysmem tracer logs the allocation statistics of the physical
+ * memory allocators (see phys_mem_allocator.h) as "imx-phys-mem-stats"
+ * tracer records whenever memory is allocated or freed, or an allocation
+ * fails. One record is logged for the allocator in question, and one for
+ * the global statistics (with the allocator name "all"). Enable it with:
+ *
+ *   GST_TRACERS=imxphysmem GST_DEBUG=GST_TRACER:7
+ *
+ * Tracers require GStreamer 1.8 or newer; with older versions, registering
+ * the tracer does nothing. */
+
+
+/* Registers the imxphysmem tracer. Plugins containing physical memory
+ * allocators call this in their plugin_init function. */
+gboolean gst_imx_phys_mem_tracer_register(GstPlugin *plugin);
+
+
+G_END_DECLS
+
+
+#endif
@@ -21,6 +21,7 @@
 #include "viv_upload_meta.h"
 #include "viv_upload.h"
 #include "phys_mem_meta.h"
+#include "phys_mem_allocator.h"
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 
@@ -74,6 +75,9 @@ static gboolean gst_imx_vivante_gl_texture_upload(GstVideoGLTextureUploadMeta *m
 	if (gl_has_error("glBindTexture"))
 		return FALSE;
 
+	/* The GPU reads the frame through its physical address */
+	gst_imx_phys_mem_buffer_begin_device_access(meta->buffer, GST_MAP_READ);
+
 	glTexDirectVIVMap(GL_TEXTURE_2D, meta->width, meta->height, gl_format,
 			&virtual_addr, &physical_addr);
 	if (gl_has_error("glTexDirectVIVMap"))
@@ -28,6 +28,8 @@
 #include <gst/video/videooverlay.h>
 
 #include "eglvivsink.h"
+#include "../common/phys_mem_caps.h"
+#include "../common/phys_mem_buffer_pool.h"
 
 
 
@@ -97,19 +99,30 @@ enum
 #endif
 
 
+/* NV12 comes first, since upstream elements pick the first format they
+ * support; the VPU decoder, for example, outputs NV12 only if downstream
+ * lists it ahead of I420 (see gst_imx_vpu_dec_downstream_prefers_nv12()) */
+#define CAPS_VIV_FORMATS \
+	"{ " \
+	CAPS_VIV_NV12 \
+	CAPS_VIV_I420 \
+	CAPS_VIV_YV12 \
+	CAPS_VIV_YV21 \
+	CAPS_VIV_NV21 \
+	CAPS_VIV_UYVY \
+	"RGB16, RGBA, BGRA, RGBx, BGRx, BGR, ARGB, ABGR, xRGB, xBGR" \
+	" }"
+
+/* Frames in physical memory are preferred, since they can be
+ * rendered without copying (see gles2_renderer.c) */
 static GstStaticPadTemplate static_sink_template = GST_STATIC_PAD_TEMPLATE(
 	"sink",
 	GST_PAD_SINK,
 	GST_PAD_ALWAYS,
-	GST_STATIC_CAPS(GST_VIDEO_CAPS_MAKE("{ "
-		CAPS_VIV_I420
-		CAPS_VIV_YV12
-		CAPS_VIV_YV21
-		CAPS_VIV_NV12
-		CAPS_VIV_NV21
-		CAPS_VIV_UYVY
-		"RGB16, RGBA, BGRA, RGBx, BGRx, BGR, ARGB, ABGR, xRGB, xBGR"
-	" }"))
+	GST_STATIC_CAPS(
+		GST_VIDEO_CAPS_MAKE_WITH_FEATURES(GST_CAPS_FEATURE_MEMORY_IMX_PHYS_MEM, CAPS_VIV_FORMATS) "; "
+		GST_VIDEO_CAPS_MAKE(CAPS_VIV_FORMATS)
+	)
 );
 
 
@@ -680,8 +693,12 @@ static gboolean gst_imx_egl_viv_propose_allocation(GstBaseSink *sink, GstQuery *
 {
 	GstCaps *caps;
 	GstVideoInfo info;
+	GstVideoAlignment align;
 	GstBufferPool *pool;
 	guint size;
+	/* Vivante direct textures need a stride which is a multiple of
+	 * 16 pixels; the extra rows are passed on as y_padding */
+	guint horiz_alignment = 16, vert_alignment = 1;
 
 	gst_query_parse_allocation(query, &caps, NULL);
 
@@ -701,6 +718,7 @@ static gboolean gst_imx_egl_viv_propose_allocation(GstBaseSink *sink, GstQuery *
 		GstStructure *structure;
 		GstAllocationParams params;
 		GstAllocator *allocator = NULL;
+		guint min_buffers;
 
 		memset(&params, 0, sizeof(params));
 		params.flags = 0;
@@ -713,12 +731,23 @@ static gboolean gst_imx_egl_viv_propose_allocation(GstBaseSink *sink, GstQuery *
 		else
 			gst_query_add_allocation_param(query, allocator, &params);
 
+		/* The renderer keeps the current frame for redrawing it, and the base
+		 * class keeps the last sample if enabled; during the handover to the
+		 * next frame, these are two different frames */
+		min_buffers = 1 + (gst_base_sink_is_last_sample_enabled(sink) ? 1 : 0);
+
 		pool = gst_video_buffer_pool_new();
 
 		structure = gst_buffer_pool_get_config(pool);
-		gst_buffer_pool_config_set_params(structure, caps, size, 0, 0);
+		gst_buffer_pool_config_set_params(structure, caps, size, min_buffers, 0);
 		gst_buffer_pool_config_set_allocator(structure, allocator, &params);
 
+		/* Pad the frames of the proposed pool like a physical memory pool would */
+		gst_imx_phys_mem_buffer_pool_compute_video_alignment(&info, horiz_alignment, vert_alignment, &align);
+		gst_buffer_pool_config_add_option(structure, GST_BUFFER_POOL_OPTION_VIDEO_META);
+		gst_buffer_pool_config_add_option(structure, GST_BUFFER_POOL_OPTION_VIDEO_ALIGNMENT);
+		gst_buffer_pool_config_set_video_alignment(structure, &align);
+
 		if (allocator)
 			gst_object_unref(allocator);
 
@@ -729,11 +758,18 @@ static gboolean gst_imx_egl_viv_propose_allocation(GstBaseSink *sink, GstQuery *
 			return FALSE;
 		}
 
-		gst_query_add_allocation_pool(query, pool, size, 0, 0);
+		/* The pool updated the size to include the padding */
+		structure = gst_buffer_pool_get_config(pool);
+		gst_buffer_pool_config_get_params(structure, NULL, &size, NULL, NULL);
+		gst_structure_free(structure);
+
+		gst_query_add_allocation_pool(query, pool, size, min_buffers, 0);
 		gst_object_unref(pool);
 		gst_query_add_allocation_meta(query, GST_VIDEO_META_API_TYPE, NULL);
 	}
 
+	gst_imx_phys_mem_buffer_pool_query_add_alignment(query, horiz_alignment, vert_alignment);
+
 	return TRUE;
 }
 
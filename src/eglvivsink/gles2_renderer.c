@@ -5,6 +5,7 @@
 #include "gles2_renderer.h"
 #include "egl_platform.h"
 #include "../common/phys_mem_meta.h"
+#include "../common/phys_mem_allocator.h"
 #include "../common/viv_upload.h"
 
 
@@ -671,6 +672,10 @@ static gboolean gst_imx_egl_viv_sink_gles2_renderer_fill_texture(GstImxEglVivSin
 			/* Just set to make sure the == NULL check above is false */
 			renderer->viv_planes[0] = virt_addr;
 
+			/* The GPU reads the frame through its physical address, so
+			 * CPU writes must be flushed out of the caches first */
+			gst_imx_phys_mem_buffer_begin_device_access(buffer, GST_MAP_READ);
+
 			glTexDirectVIVMap(
 				GL_TEXTURE_2D,
 				total_w, total_h,
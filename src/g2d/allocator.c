@@ -17,6 +17,8 @@
  */
 
 
+#include <config.h>
+#include <string.h>
 #include <g2d.h>
 #include "allocator.h"
 
@@ -30,9 +32,13 @@ static void gst_imx_g2d_allocator_finalize(GObject *object);
 
 static gboolean gst_imx_g2d_alloc_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, gssize size);
 static gboolean gst_imx_g2d_free_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory);
-static void gst_imx_g2d_cache_op(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, enum g2d_cache_mode cache_mode);
+static void gst_imx_g2d_cache_op(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, GstImxPhysMemCacheOp op, gsize offset, gsize size);
 static gpointer gst_imx_g2d_map_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, gssize size, GstMapFlags flags);
 static void gst_imx_g2d_unmap_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory);
+static gboolean gst_imx_g2d_copy_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *dest, GstImxPhysMemory *src, gsize offset, gsize size);
+#ifdef HAVE_G2D_BUF_EXPORT_FD
+static gint gst_imx_g2d_export_dmabuf(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory);
+#endif
 
 
 G_DEFINE_TYPE(GstImxG2DAllocator, gst_imx_g2d_allocator, GST_TYPE_IMX_PHYS_MEM_ALLOCATOR)
@@ -51,8 +57,9 @@ GstAllocator* gst_imx_g2d_allocator_new(void)
 
 static gboolean gst_imx_g2d_alloc_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, gssize size)
 {
-	/* allocate cacheable physically contiguous memory block */
-	struct g2d_buf *buf = g2d_alloc(size, 1);
+	/* allocate physically contiguous memory block; the G2D driver maps
+	 * non-cacheable blocks with write combining */
+	struct g2d_buf *buf = g2d_alloc(size, (memory->cache_policy == GST_IMX_PHYS_MEM_CACHE_POLICY_CACHED) ? 1 : 0);
 
 	if (buf == NULL)
 	{
@@ -64,8 +71,10 @@ static gboolean gst_imx_g2d_alloc_phys_mem(GstImxPhysMemAllocator *allocator, Gs
 		memory->mapped_virt_addr = buf->buf_vaddr;
 		memory->phys_addr = (gst_imx_phys_addr_t)(buf->buf_paddr);
 		memory->internal = buf;
+		if (memory->cache_policy == GST_IMX_PHYS_MEM_CACHE_POLICY_UNCACHED)
+			memory->cache_policy = GST_IMX_PHYS_MEM_CACHE_POLICY_WRITE_COMBINED;
 
-		GST_INFO_OBJECT(allocator, "allocated %u bytes of physical memory, vaddr %p paddr %" GST_IMX_PHYS_ADDR_FORMAT, size, memory->mapped_virt_addr, memory->phys_addr);
+		GST_INFO_OBJECT(allocator, "allocated %u bytes of %s physical memory, vaddr %p paddr %" GST_IMX_PHYS_ADDR_FORMAT, size, gst_imx_phys_mem_cache_policy_get_name(memory->cache_policy), memory->mapped_virt_addr, memory->phys_addr);
 
 		return TRUE;
 	}
@@ -93,48 +102,102 @@ static gboolean gst_imx_g2d_free_phys_mem(GstImxPhysMemAllocator *allocator, Gst
 }
 
 
-static void gst_imx_g2d_cache_op(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, enum g2d_cache_mode cache_mode)
+static void gst_imx_g2d_cache_op(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, GstImxPhysMemCacheOp op, gsize offset, gsize size)
 {
 	gchar const *desc;
-	struct g2d_buf *buf = (struct g2d_buf *)(memory->internal);
-
-	switch (cache_mode)
+	enum g2d_cache_mode cache_mode;
+	struct g2d_buf range_buf;
+
+	/* g2d_cache_op() operates on the address range the buffer structure
+	 * describes, so a copy which describes the requested range restricts
+	 * the operation to it (the handle still refers to the whole block) */
+	range_buf = *((struct g2d_buf *)(memory->internal));
+	range_buf.buf_vaddr = (guint8 *)(range_buf.buf_vaddr) + offset;
+	range_buf.buf_paddr += (int)offset;
+	range_buf.buf_size = (int)size;
+
+	switch (op)
 	{
-		case G2D_CACHE_CLEAN:      desc = "cleaning"; break;
-		case G2D_CACHE_FLUSH:      desc = "flushing"; break;
-		case G2D_CACHE_INVALIDATE: desc = "invalidating"; break;
+		case GST_IMX_PHYS_MEM_CACHE_OP_CLEAN:      cache_mode = G2D_CACHE_CLEAN;      desc = "cleaning"; break;
+		case GST_IMX_PHYS_MEM_CACHE_OP_INVALIDATE: cache_mode = G2D_CACHE_INVALIDATE; desc = "invalidating"; break;
+		default: g_assert_not_reached();
 	}
 
-	if (g2d_cache_op(buf, cache_mode) == 0)
+	if (g2d_cache_op(&range_buf, cache_mode) == 0)
 	{
-		GST_LOG_OBJECT(allocator, "%s cacheable memory, vaddr %p paddr %" GST_IMX_PHYS_ADDR_FORMAT, desc, memory->mapped_virt_addr, memory->phys_addr);
+		GST_LOG_OBJECT(allocator, "%s %" G_GSIZE_FORMAT " bytes of cacheable memory at offset %" G_GSIZE_FORMAT ", vaddr %p paddr %" GST_IMX_PHYS_ADDR_FORMAT, desc, size, offset, memory->mapped_virt_addr, memory->phys_addr);
 	}
 	else
 	{
-		GST_ERROR_OBJECT(allocator, "%s cacheable memory failed, vaddr %p paddr %" GST_IMX_PHYS_ADDR_FORMAT, desc, memory->mapped_virt_addr, memory->phys_addr);
+		GST_ERROR_OBJECT(allocator, "%s %" G_GSIZE_FORMAT " bytes of cacheable memory at offset %" G_GSIZE_FORMAT " failed, vaddr %p paddr %" GST_IMX_PHYS_ADDR_FORMAT, desc, size, offset, memory->mapped_virt_addr, memory->phys_addr);
 	}
 }
 
 
-static gpointer gst_imx_g2d_map_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, G_GNUC_UNUSED gssize size, GstMapFlags flags)
+static gpointer gst_imx_g2d_map_phys_mem(G_GNUC_UNUSED GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, G_GNUC_UNUSED gssize size, G_GNUC_UNUSED GstMapFlags flags)
 {
-	/* invalidate cache in map() if the MAP_READ flag is set
-	 * to ensure any data that is read from the mapped memory
-	 * is up to date */
-	if (flags & GST_MAP_READ)
-		gst_imx_g2d_cache_op(allocator, memory, G2D_CACHE_INVALIDATE);
-
+	/* G2D memory is always mapped; the base class takes care
+	 * of cache maintenance with gst_imx_g2d_cache_op() */
 	return memory->mapped_virt_addr;
 }
 
 
-static void gst_imx_g2d_unmap_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory)
+static void gst_imx_g2d_unmap_phys_mem(G_GNUC_UNUSED GstImxPhysMemAllocator *allocator, G_GNUC_UNUSED GstImxPhysMemory *memory)
+{
+}
+
+
+static gboolean gst_imx_g2d_copy_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *dest, GstImxPhysMemory *src, gsize offset, gsize size)
+{
+	struct g2d_buf src_buf, dest_buf;
+	gboolean ret = TRUE;
+	GstImxG2DAllocator *g2d_allocator = GST_IMX_G2D_ALLOCATOR(allocator);
+
+	/* g2d_copy() only uses the physical addresses and the size, so the
+	 * buffer structures can describe regions inside the blocks (and
+	 * blocks carved out of arenas, which have no g2d_buf of their own) */
+	memset(&src_buf, 0, sizeof(src_buf));
+	src_buf.buf_paddr = (int)(src->phys_addr + offset);
+	src_buf.buf_size = (int)size;
+
+	memset(&dest_buf, 0, sizeof(dest_buf));
+	dest_buf.buf_paddr = (int)(dest->phys_addr + offset);
+	dest_buf.buf_size = (int)size;
+
+	g_mutex_lock(&(g2d_allocator->copy_mutex));
+
+	/* The G2D handle is opened on demand, since most allocators never copy */
+	if ((g2d_allocator->copy_handle == NULL) && (g2d_open(&(g2d_allocator->copy_handle)) != 0))
+	{
+		GST_ERROR_OBJECT(allocator, "opening g2d device for copying failed");
+		g2d_allocator->copy_handle = NULL;
+		ret = FALSE;
+	}
+	else if ((g2d_copy(g2d_allocator->copy_handle, &dest_buf, &src_buf, (int)size) != 0) || (g2d_finish(g2d_allocator->copy_handle) != 0))
+	{
+		GST_ERROR_OBJECT(allocator, "copying %u bytes from paddr %" GST_IMX_PHYS_ADDR_FORMAT " to paddr %" GST_IMX_PHYS_ADDR_FORMAT " failed", size, src->phys_addr, dest->phys_addr);
+		ret = FALSE;
+	}
+	else
+		GST_LOG_OBJECT(allocator, "copied %u bytes from paddr %" GST_IMX_PHYS_ADDR_FORMAT " to paddr %" GST_IMX_PHYS_ADDR_FORMAT, size, src->phys_addr, dest->phys_addr);
+
+	g_mutex_unlock(&(g2d_allocator->copy_mutex));
+
+	return ret;
+}
+
+
+
+
+#ifdef HAVE_G2D_BUF_EXPORT_FD
+static gint gst_imx_g2d_export_dmabuf(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory)
 {
-	/* clean cache in map() if the MAP_WRITE flag is set
-	 * to ensure the cache gets filled with up to date data */
-	if (memory->mapping_flags & GST_MAP_WRITE)
-		gst_imx_g2d_cache_op(allocator, memory, G2D_CACHE_CLEAN);
+	int fd = g2d_buf_export_fd((struct g2d_buf *)(memory->internal));
+	if (fd < 0)
+		GST_ERROR_OBJECT(allocator, "could not export G2D memory with paddr %" GST_IMX_PHYS_ADDR_FORMAT " as DMA-BUF", memory->phys_addr);
+	return fd;
 }
+#endif
 
 
 
@@ -149,6 +212,14 @@ static void gst_imx_g2d_allocator_class_init(GstImxG2DAllocatorClass *klass)
 	parent_class->free_phys_mem  = GST_DEBUG_FUNCPTR(gst_imx_g2d_free_phys_mem);
 	parent_class->map_phys_mem   = GST_DEBUG_FUNCPTR(gst_imx_g2d_map_phys_mem);
 	parent_class->unmap_phys_mem = GST_DEBUG_FUNCPTR(gst_imx_g2d_unmap_phys_mem);
+	parent_class->cache_op       = GST_DEBUG_FUNCPTR(gst_imx_g2d_cache_op);
+	parent_class->copy_phys_mem  = GST_DEBUG_FUNCPTR(gst_imx_g2d_copy_phys_mem);
+#ifdef HAVE_G2D_BUF_EXPORT_FD
+	parent_class->export_dmabuf  = GST_DEBUG_FUNCPTR(gst_imx_g2d_export_dmabuf);
+#else
+	/* older G2D libraries cannot export their memory */
+	parent_class->dmabuf_heap_backing = TRUE;
+#endif
 
 	GST_DEBUG_CATEGORY_INIT(imx_g2d_allocator_debug, "imxg2dallocator", 0, "Freescale i.MX G2D physical memory/allocator");
 }
@@ -158,12 +229,21 @@ static void gst_imx_g2d_allocator_init(GstImxG2DAllocator *allocator)
 {
 	GstAllocator *base = GST_ALLOCATOR(allocator);
 	base->mem_type = GST_IMX_G2D_ALLOCATOR_MEM_TYPE;
+
+	g_mutex_init(&(allocator->copy_mutex));
+	allocator->copy_handle = NULL;
 }
 
 
 static void gst_imx_g2d_allocator_finalize(GObject *object)
 {
+	GstImxG2DAllocator *g2d_allocator = GST_IMX_G2D_ALLOCATOR(object);
+
 	GST_DEBUG_OBJECT(object, "shutting down IMX G2D allocator");
 
+	if (g2d_allocator->copy_handle != NULL)
+		g2d_close(g2d_allocator->copy_handle);
+	g_mutex_clear(&(g2d_allocator->copy_mutex));
+
 	G_OBJECT_CLASS(gst_imx_g2d_allocator_parent_class)->finalize(object);
 }
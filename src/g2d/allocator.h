@@ -43,6 +43,10 @@ typedef struct _GstImxG2DAllocatorClass GstImxG2DAllocatorClass;
 struct _GstImxG2DAllocator
 {
 	GstImxPhysMemAllocator parent;
+
+	/* G2D handle used for copying memory blocks; opened on demand */
+	GMutex copy_mutex;
+	void *copy_handle;
 };
 
 
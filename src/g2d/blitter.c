@@ -48,10 +48,21 @@ static gboolean gst_imx_g2d_blitter_set_output_frame(GstImxBaseBlitter *base_bli
 static gboolean gst_imx_g2d_blitter_set_output_regions(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *video_region, GstImxBaseBlitterRegion const *output_region);
 static GstAllocator* gst_imx_g2d_blitter_get_phys_mem_allocator(GstImxBaseBlitter *base_blitter);
 static gboolean gst_imx_g2d_blitter_blit_frame(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *input_region);
-
+static gboolean gst_imx_g2d_blitter_flush(GstImxBaseBlitter *base_blitter);
+static gboolean gst_imx_g2d_blitter_submit_blit(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *input_region, gpointer *handle);
+static gboolean gst_imx_g2d_blitter_wait_blit(GstImxBaseBlitter *base_blitter, gpointer handle);
+static gboolean gst_imx_g2d_blitter_set_input_alpha(GstImxBaseBlitter *base_blitter, guint8 alpha);
+static gboolean gst_imx_g2d_blitter_fill_region(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *region, guint32 color);
+static gboolean gst_imx_g2d_blitter_blit_batch(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterBatchEntry const *entries, guint num_entries);
+
+static gboolean gst_imx_g2d_blitter_do_blit(GstImxG2DBlitter *g2d_blitter, GstImxBaseBlitterRegion const *input_region, gboolean wait);
+static gboolean gst_imx_g2d_blitter_open_device(GstImxG2DBlitter *g2d_blitter);
+static void gst_imx_g2d_blitter_close_device(GstImxG2DBlitter *g2d_blitter);
+static void gst_imx_g2d_blitter_release_pending_input_frames(GstImxG2DBlitter *g2d_blitter);
 static gboolean gst_imx_g2d_blitter_set_surface_params(GstImxG2DBlitter *g2d_blitter, GstBuffer *input_frame, struct g2d_surface *surface);
 static GstImxG2DFormatDetails const * gst_imx_g2d_blitter_get_format_details(GstVideoFormat gst_format);
 static void gst_imx_g2d_blitter_region_to_surface(struct g2d_surface *surf, GstImxBaseBlitterRegion const *region);
+static void gst_imx_g2d_blitter_set_surface_rotations(struct g2d_surface *source_surface, struct g2d_surface *dest_surface, GstImxBaseBlitterRotationMode rotation);
 
 
 
@@ -100,6 +111,12 @@ void gst_imx_g2d_blitter_class_init(GstImxG2DBlitterClass *klass)
 	base_class->set_output_regions     = GST_DEBUG_FUNCPTR(gst_imx_g2d_blitter_set_output_regions);
 	base_class->get_phys_mem_allocator = GST_DEBUG_FUNCPTR(gst_imx_g2d_blitter_get_phys_mem_allocator);
 	base_class->blit_frame             = GST_DEBUG_FUNCPTR(gst_imx_g2d_blitter_blit_frame);
+	base_class->flush                  = GST_DEBUG_FUNCPTR(gst_imx_g2d_blitter_flush);
+	base_class->submit_blit            = GST_DEBUG_FUNCPTR(gst_imx_g2d_blitter_submit_blit);
+	base_class->wait_blit              = GST_DEBUG_FUNCPTR(gst_imx_g2d_blitter_wait_blit);
+	base_class->set_input_alpha        = GST_DEBUG_FUNCPTR(gst_imx_g2d_blitter_set_input_alpha);
+	base_class->fill_region            = GST_DEBUG_FUNCPTR(gst_imx_g2d_blitter_fill_region);
+	base_class->blit_batch             = GST_DEBUG_FUNCPTR(gst_imx_g2d_blitter_blit_batch);
 
 	GST_DEBUG_CATEGORY_INIT(imx_g2d_blitter_debug, "imxg2dblitter", 0, "Freescale i.MX G2D blitter class");
 }
@@ -113,6 +130,19 @@ void gst_imx_g2d_blitter_init(GstImxG2DBlitter *g2d_blitter)
 	g2d_blitter->num_empty_dest_surfaces = 0;
 	g2d_blitter->output_region_uptodate = FALSE;
 
+	g2d_blitter->num_device_opens = 0;
+	g2d_blitter->num_blitted_frames = 0;
+	g2d_blitter->total_blit_duration = 0;
+	g2d_blitter->max_blit_duration = 0;
+
+	g2d_blitter->max_pending_blits = GST_IMX_G2D_BLITTER_MAX_PENDING_BLITS_DEFAULT;
+	g2d_blitter->num_pending_blits = 0;
+	g2d_blitter->current_input_frame = NULL;
+	g2d_blitter->pending_input_frames = NULL;
+	g2d_blitter->submitted_seqnum = 0;
+	g2d_blitter->finished_seqnum = 0;
+	g2d_blitter->input_alpha = 255;
+
 	gst_imx_g2d_blitter_set_output_rotation(g2d_blitter, GST_IMX_G2D_BLITTER_OUTPUT_ROTATION_DEFAULT);
 }
 
@@ -121,6 +151,16 @@ GstImxG2DBlitter* gst_imx_g2d_blitter_new(void)
 {
 	GstImxG2DBlitter* g2d_blitter = (GstImxG2DBlitter *)g_object_new(gst_imx_g2d_blitter_get_type(), NULL);
 
+	/* Open the device right away instead of once per frame; the blitter is
+	 * created by the elements during the NULL->READY state change, and
+	 * destroyed during READY->NULL, so the device stays open for as long
+	 * as the element is at least in the READY state */
+	if (!gst_imx_g2d_blitter_open_device(g2d_blitter))
+	{
+		gst_object_unref(GST_OBJECT(g2d_blitter));
+		return NULL;
+	}
+
 	return g2d_blitter;
 }
 
@@ -184,12 +224,67 @@ void gst_imx_g2d_blitter_set_output_rotation(GstImxG2DBlitter *g2d_blitter, GstI
 }
 
 
+void gst_imx_g2d_blitter_set_max_pending_blits(GstImxG2DBlitter *g2d_blitter, guint max_pending_blits)
+{
+	/* Finish pending blits first, to make sure the new limit holds */
+	gst_imx_g2d_blitter_finish(g2d_blitter);
+	g2d_blitter->max_pending_blits = MIN(max_pending_blits, GST_IMX_G2D_BLITTER_MAX_PENDING_BLITS_MAX);
+}
+
+
+guint gst_imx_g2d_blitter_get_max_pending_blits(GstImxG2DBlitter *g2d_blitter)
+{
+	return g2d_blitter->max_pending_blits;
+}
+
+
+gboolean gst_imx_g2d_blitter_finish(GstImxG2DBlitter *g2d_blitter)
+{
+	gboolean ret = TRUE;
+
+	if (g2d_blitter->finished_seqnum == g2d_blitter->submitted_seqnum)
+		return TRUE;
+
+	GST_LOG_OBJECT(g2d_blitter, "waiting for pending blit(s) to finish");
+
+	if ((g2d_blitter->handle != NULL) && (g2d_finish(g2d_blitter->handle) != 0))
+	{
+		GST_ERROR_OBJECT(g2d_blitter, "finishing g2d device operations failed");
+		gst_imx_g2d_blitter_close_device(g2d_blitter);
+		g2d_blitter->output_region_uptodate = FALSE;
+		ret = FALSE;
+	}
+
+	/* Even if finishing failed, the engine is no longer using the input
+	 * frames (the device got closed in that case) */
+	gst_imx_g2d_blitter_release_pending_input_frames(g2d_blitter);
+	g2d_blitter->finished_seqnum = g2d_blitter->submitted_seqnum;
+
+	return ret;
+}
+
+
 static void gst_imx_g2d_blitter_finalize(GObject *object)
 {
 	GstImxG2DBlitter *g2d_blitter = GST_IMX_G2D_BLITTER(object);
 
 	g_assert(g2d_blitter != NULL);
 
+	gst_imx_g2d_blitter_finish(g2d_blitter);
+	gst_imx_g2d_blitter_close_device(g2d_blitter);
+
+	if (g2d_blitter->num_blitted_frames > 0)
+	{
+		GST_DEBUG_OBJECT(
+			g2d_blitter,
+			"blitted %" G_GUINT64_FORMAT " frames  device opened %u time(s)  average blit duration: %" G_GINT64_FORMAT " us  max blit duration: %" G_GINT64_FORMAT " us",
+			g2d_blitter->num_blitted_frames,
+			g2d_blitter->num_device_opens,
+			g2d_blitter->total_blit_duration / (gint64)(g2d_blitter->num_blitted_frames),
+			g2d_blitter->max_blit_duration
+		);
+	}
+
 	G_OBJECT_CLASS(gst_imx_g2d_blitter_parent_class)->finalize(object);
 }
 
@@ -207,8 +302,9 @@ static gboolean gst_imx_g2d_blitter_set_input_frame(GstImxBaseBlitter *base_blit
 	g_assert(g2d_blitter != NULL);
 
 	gst_imx_g2d_blitter_set_surface_params(g2d_blitter, input_frame, &(g2d_blitter->source_surface));
+	g2d_blitter->current_input_frame = input_frame;
 	g2d_blitter->source_surface.blendfunc = G2D_ONE;
-	g2d_blitter->source_surface.global_alpha = 255;
+	g2d_blitter->source_surface.global_alpha = g2d_blitter->input_alpha;
 	g2d_blitter->source_surface.clrcolor = 0x00000000;
 	/* g2d_blitter->source_surface.rot is set in gst_imx_g2d_blitter_set_output_rotation */
 
@@ -266,26 +362,219 @@ static GstAllocator* gst_imx_g2d_blitter_get_phys_mem_allocator(G_GNUC_UNUSED Gs
 
 static gboolean gst_imx_g2d_blitter_blit_frame(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *input_region)
 {
-	guint i;
-	gboolean ret;
 	GstImxG2DBlitter *g2d_blitter = GST_IMX_G2D_BLITTER(base_blitter);
 
 	g_assert(g2d_blitter != NULL);
 
-	if (g2d_open(&(g2d_blitter->handle)) != 0)
+	if (g2d_blitter->max_pending_blits == 0)
+		return gst_imx_g2d_blitter_do_blit(g2d_blitter, input_region, TRUE);
+
+	/* If the maximum number of blits is already in flight, wait for them
+	 * before submitting more work to the engine */
+	if ((g2d_blitter->num_pending_blits >= g2d_blitter->max_pending_blits) && !gst_imx_g2d_blitter_finish(g2d_blitter))
+		return FALSE;
+
+	if (!gst_imx_g2d_blitter_do_blit(g2d_blitter, input_region, FALSE))
+		return FALSE;
+
+	/* The input frame is kept alive until the blit is finished */
+	if (g2d_blitter->current_input_frame != NULL)
+		g2d_blitter->pending_input_frames = g_slist_prepend(g2d_blitter->pending_input_frames, gst_buffer_ref(g2d_blitter->current_input_frame));
+	g2d_blitter->num_pending_blits++;
+
+	return TRUE;
+}
+
+
+static gboolean gst_imx_g2d_blitter_submit_blit(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *input_region, gpointer *handle)
+{
+	GstImxG2DBlitter *g2d_blitter = GST_IMX_G2D_BLITTER(base_blitter);
+
+	g_assert(g2d_blitter != NULL);
+
+	if (!gst_imx_g2d_blitter_do_blit(g2d_blitter, input_region, FALSE))
+		return FALSE;
+
+	/* The sequence number is used as handle; 0 is skipped, since
+	 * handles must not be NULL */
+	*handle = GUINT_TO_POINTER(g2d_blitter->submitted_seqnum);
+
+	return TRUE;
+}
+
+
+static gboolean gst_imx_g2d_blitter_wait_blit(GstImxBaseBlitter *base_blitter, gpointer handle)
+{
+	GstImxG2DBlitter *g2d_blitter = GST_IMX_G2D_BLITTER(base_blitter);
+	guint seqnum = GPOINTER_TO_UINT(handle);
+
+	g_assert(g2d_blitter != NULL);
+
+	/* G2D can only wait for all submitted operations at once. Skip the wait
+	 * if the blit with this sequence number was already finished by an
+	 * earlier call. (The signed difference makes this robust against
+	 * sequence number wraparounds.) */
+	if ((gint)(seqnum - g2d_blitter->finished_seqnum) <= 0)
+		return TRUE;
+
+	return gst_imx_g2d_blitter_finish(g2d_blitter);
+}
+
+
+static gboolean gst_imx_g2d_blitter_set_input_alpha(GstImxBaseBlitter *base_blitter, guint8 alpha)
+{
+	GstImxG2DBlitter *g2d_blitter = GST_IMX_G2D_BLITTER(base_blitter);
+
+	g_assert(g2d_blitter != NULL);
+
+	g2d_blitter->input_alpha = alpha;
+	g2d_blitter->source_surface.global_alpha = alpha;
+
+	return TRUE;
+}
+
+
+static gboolean gst_imx_g2d_blitter_fill_region(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *region, guint32 color)
+{
+	struct g2d_surface surface;
+	GstImxG2DBlitter *g2d_blitter = GST_IMX_G2D_BLITTER(base_blitter);
+
+	g_assert(g2d_blitter != NULL);
+
+	if ((g2d_blitter->handle == NULL) && !gst_imx_g2d_blitter_open_device(g2d_blitter))
+		return FALSE;
+
+	/* G2D clear colors are in 0xAABBGGRR format */
+	surface = g2d_blitter->dest_surface;
+	surface.clrcolor = 0xFF000000 | ((color & 0x0000FF) << 16) | (color & 0x00FF00) | ((color & 0xFF0000) >> 16);
+	gst_imx_g2d_blitter_region_to_surface(&surface, region);
+
+	if ((g2d_clear(g2d_blitter->handle, &surface) != 0) || (g2d_finish(g2d_blitter->handle) != 0))
 	{
-		GST_ERROR_OBJECT(g2d_blitter, "opening g2d device failed");
+		GST_ERROR_OBJECT(g2d_blitter, "filling region (%d,%d - %d,%d) failed", region->x1, region->y1, region->x2, region->y2);
+		gst_imx_g2d_blitter_close_device(g2d_blitter);
+		gst_imx_g2d_blitter_release_pending_input_frames(g2d_blitter);
+		g2d_blitter->finished_seqnum = g2d_blitter->submitted_seqnum;
+		g2d_blitter->output_region_uptodate = FALSE;
 		return FALSE;
 	}
 
-	if (g2d_make_current(g2d_blitter->handle, G2D_HARDWARE_2D) != 0)
-	{
-		GST_ERROR_OBJECT(g2d_blitter, "g2d_make_current() failed");
-		if (g2d_close(g2d_blitter->handle) != 0)
-			GST_ERROR_OBJECT(g2d_blitter, "closing g2d device failed");
+	/* g2d_finish() also finished any previously submitted blits */
+	gst_imx_g2d_blitter_release_pending_input_frames(g2d_blitter);
+	g2d_blitter->finished_seqnum = g2d_blitter->submitted_seqnum;
+
+	return TRUE;
+}
+
+
+static gboolean gst_imx_g2d_blitter_blit_batch(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterBatchEntry const *entries, guint num_entries)
+{
+	guint i;
+	gboolean ret = TRUE, blend_enabled = FALSE;
+	gint64 start_time;
+	GstImxG2DBlitter *g2d_blitter = GST_IMX_G2D_BLITTER(base_blitter);
+
+	g_assert(g2d_blitter != NULL);
+
+	if ((g2d_blitter->handle == NULL) && !gst_imx_g2d_blitter_open_device(g2d_blitter))
 		return FALSE;
+
+	start_time = g_get_monotonic_time();
+
+	/* All entries are queued in the G2D command buffer, and then
+	 * submitted to the engine at once with a single g2d_finish() call */
+	for (i = 0; ret && (i < num_entries); ++i)
+	{
+		GstImxBaseBlitterBatchEntry const *entry = &(entries[i]);
+		struct g2d_surface source_surface, dest_surface;
+		gboolean blend = (entry->alpha != 255);
+
+		memset(&source_surface, 0, sizeof(struct g2d_surface));
+		if (!gst_imx_g2d_blitter_set_surface_params(g2d_blitter, entry->input_buffer, &source_surface))
+		{
+			ret = FALSE;
+			break;
+		}
+
+		/* dest_surface was set up by set_output_frame */
+		dest_surface = g2d_blitter->dest_surface;
+
+		gst_imx_g2d_blitter_region_to_surface(&source_surface, &(entry->input_region));
+		gst_imx_g2d_blitter_region_to_surface(&dest_surface, &(entry->output_region));
+		gst_imx_g2d_blitter_set_surface_rotations(&source_surface, &dest_surface, entry->rotation);
+
+		source_surface.global_alpha = entry->alpha;
+		source_surface.blendfunc = blend ? G2D_SRC_ALPHA : G2D_ONE;
+		dest_surface.blendfunc = blend ? G2D_ONE_MINUS_SRC_ALPHA : G2D_ZERO;
+
+		/* Only toggle blending when it changes between entries */
+		if (blend != blend_enabled)
+		{
+			if (blend)
+			{
+				g2d_enable(g2d_blitter->handle, G2D_BLEND);
+				g2d_enable(g2d_blitter->handle, G2D_GLOBAL_ALPHA);
+			}
+			else
+			{
+				g2d_disable(g2d_blitter->handle, G2D_GLOBAL_ALPHA);
+				g2d_disable(g2d_blitter->handle, G2D_BLEND);
+			}
+			blend_enabled = blend;
+		}
+
+		if (g2d_blit(g2d_blitter->handle, &source_surface, &dest_surface) != 0)
+		{
+			GST_ERROR_OBJECT(g2d_blitter, "blitting batch entry #%u failed", i);
+			ret = FALSE;
+		}
 	}
 
+	if (blend_enabled)
+	{
+		g2d_disable(g2d_blitter->handle, G2D_GLOBAL_ALPHA);
+		g2d_disable(g2d_blitter->handle, G2D_BLEND);
+	}
+
+	if (ret && (g2d_finish(g2d_blitter->handle) != 0))
+	{
+		GST_ERROR_OBJECT(g2d_blitter, "finishing g2d device operations failed");
+		ret = FALSE;
+	}
+
+	if (!ret)
+	{
+		/* See do_blit() for why the device is closed */
+		GST_WARNING_OBJECT(g2d_blitter, "closing g2d device after error; it will be reopened for the next frame");
+		gst_imx_g2d_blitter_close_device(g2d_blitter);
+		g2d_blitter->output_region_uptodate = FALSE;
+	}
+
+	/* g2d_finish() also finished any previously submitted blits; if the device
+	 * got closed, these are discarded */
+	gst_imx_g2d_blitter_release_pending_input_frames(g2d_blitter);
+	g2d_blitter->finished_seqnum = g2d_blitter->submitted_seqnum;
+
+	if (ret)
+		GST_LOG_OBJECT(g2d_blitter, "blitting batch with %u entries took %" G_GINT64_FORMAT " us", num_entries, g_get_monotonic_time() - start_time);
+
+	return ret;
+}
+
+
+static gboolean gst_imx_g2d_blitter_do_blit(GstImxG2DBlitter *g2d_blitter, GstImxBaseBlitterRegion const *input_region, gboolean wait)
+{
+	guint i;
+	gboolean ret;
+	gint64 start_time, duration;
+
+	/* The handle is NULL if a previous operation failed and the device
+	 * was closed; try to reopen it to recover */
+	if ((g2d_blitter->handle == NULL) && !gst_imx_g2d_blitter_open_device(g2d_blitter))
+		return FALSE;
+
+	start_time = g_get_monotonic_time();
+
 	ret = TRUE;
 
 	if (!(g2d_blitter->output_region_uptodate))
@@ -313,22 +602,147 @@ static gboolean gst_imx_g2d_blitter_blit_frame(GstImxBaseBlitter *base_blitter,
 
 	if (GST_IMX_BASE_BLITTER_VIDEO_VISIBILITY_TYPE(g2d_blitter) != GST_IMX_BASE_BLITTER_VISIBILITY_NONE)
 	{
+		gboolean blend = (g2d_blitter->input_alpha != 255);
+
 		gst_imx_g2d_blitter_region_to_surface(&(g2d_blitter->source_surface), input_region);
 
+		/* Blend with the global alpha value if the input frame is not opaque */
+		g2d_blitter->source_surface.blendfunc = blend ? G2D_SRC_ALPHA : G2D_ONE;
+		g2d_blitter->dest_surface.blendfunc = blend ? G2D_ONE_MINUS_SRC_ALPHA : G2D_ZERO;
+		if (blend)
+		{
+			g2d_enable(g2d_blitter->handle, G2D_BLEND);
+			g2d_enable(g2d_blitter->handle, G2D_GLOBAL_ALPHA);
+		}
+
 		if (ret && (g2d_blit(g2d_blitter->handle, &(g2d_blitter->source_surface), &(g2d_blitter->dest_surface)) != 0))
 		{
 			GST_ERROR_OBJECT(g2d_blitter, "blitting failed");
 			ret = FALSE;
 		}
+
+		if (blend)
+		{
+			g2d_disable(g2d_blitter->handle, G2D_GLOBAL_ALPHA);
+			g2d_disable(g2d_blitter->handle, G2D_BLEND);
+		}
 	}
 
-	if (g2d_finish(g2d_blitter->handle) != 0)
-		GST_ERROR_OBJECT(g2d_blitter, "finishing g2d device operations failed");
+	if (ret)
+	{
+		if (wait)
+		{
+			if (g2d_finish(g2d_blitter->handle) != 0)
+			{
+				GST_ERROR_OBJECT(g2d_blitter, "finishing g2d device operations failed");
+				ret = FALSE;
+			}
+		}
+		else
+		{
+			/* Only submit the operations, do not wait for them to finish */
+			if (g2d_flush(g2d_blitter->handle) != 0)
+			{
+				GST_ERROR_OBJECT(g2d_blitter, "submitting g2d device operations failed");
+				ret = FALSE;
+			}
+		}
+	}
+
+	if (!ret)
+	{
+		/* The device may be in an undefined state after an error; close it,
+		 * and let the next blit open a fresh handle. Also make sure the empty
+		 * regions are cleared again with the new handle. Closing the device
+		 * also discards any other pending blits. */
+		GST_WARNING_OBJECT(g2d_blitter, "closing g2d device after error; it will be reopened for the next frame");
+		gst_imx_g2d_blitter_close_device(g2d_blitter);
+		gst_imx_g2d_blitter_release_pending_input_frames(g2d_blitter);
+		g2d_blitter->finished_seqnum = g2d_blitter->submitted_seqnum;
+		g2d_blitter->output_region_uptodate = FALSE;
+		return FALSE;
+	}
+
+	g2d_blitter->submitted_seqnum++;
+	if (g2d_blitter->submitted_seqnum == 0)
+		g2d_blitter->submitted_seqnum++;
+
+	if (wait)
+	{
+		/* g2d_finish() also finished any previously submitted blits */
+		gst_imx_g2d_blitter_release_pending_input_frames(g2d_blitter);
+		g2d_blitter->finished_seqnum = g2d_blitter->submitted_seqnum;
+	}
+
+	duration = g_get_monotonic_time() - start_time;
+	g2d_blitter->num_blitted_frames++;
+	g2d_blitter->total_blit_duration += duration;
+	g2d_blitter->max_blit_duration = MAX(g2d_blitter->max_blit_duration, duration);
+
+	GST_LOG_OBJECT(
+		g2d_blitter,
+		"blit %s %" G_GINT64_FORMAT " us  average: %" G_GINT64_FORMAT " us  frames blitted: %" G_GUINT64_FORMAT,
+		wait ? "took" : "submission took",
+		duration,
+		g2d_blitter->total_blit_duration / (gint64)(g2d_blitter->num_blitted_frames),
+		g2d_blitter->num_blitted_frames
+	);
+
+	return TRUE;
+}
+
+
+static gboolean gst_imx_g2d_blitter_flush(GstImxBaseBlitter *base_blitter)
+{
+	return gst_imx_g2d_blitter_finish(GST_IMX_G2D_BLITTER(base_blitter));
+}
+
+
+static gboolean gst_imx_g2d_blitter_open_device(GstImxG2DBlitter *g2d_blitter)
+{
+	g_assert(g2d_blitter->handle == NULL);
+
+	if (g2d_open(&(g2d_blitter->handle)) != 0)
+	{
+		GST_ERROR_OBJECT(g2d_blitter, "opening g2d device failed");
+		g2d_blitter->handle = NULL;
+		return FALSE;
+	}
+
+	if (g2d_make_current(g2d_blitter->handle, G2D_HARDWARE_2D) != 0)
+	{
+		GST_ERROR_OBJECT(g2d_blitter, "g2d_make_current() failed");
+		gst_imx_g2d_blitter_close_device(g2d_blitter);
+		return FALSE;
+	}
+
+	g2d_blitter->num_device_opens++;
+
+	GST_DEBUG_OBJECT(g2d_blitter, "opened g2d device (handle %p)", g2d_blitter->handle);
+
+	return TRUE;
+}
+
+
+static void gst_imx_g2d_blitter_close_device(GstImxG2DBlitter *g2d_blitter)
+{
+	if (g2d_blitter->handle == NULL)
+		return;
 
 	if (g2d_close(g2d_blitter->handle) != 0)
 		GST_ERROR_OBJECT(g2d_blitter, "closing g2d device failed");
+	else
+		GST_DEBUG_OBJECT(g2d_blitter, "closed g2d device (handle %p)", g2d_blitter->handle);
 
-	return ret;
+	g2d_blitter->handle = NULL;
+}
+
+
+static void gst_imx_g2d_blitter_release_pending_input_frames(GstImxG2DBlitter *g2d_blitter)
+{
+	g_slist_free_full(g2d_blitter->pending_input_frames, (GDestroyNotify)gst_buffer_unref);
+	g2d_blitter->pending_input_frames = NULL;
+	g2d_blitter->num_pending_blits = 0;
 }
 
 
@@ -427,3 +841,41 @@ static void gst_imx_g2d_blitter_region_to_surface(struct g2d_surface *surf, GstI
 	surf->right  = region->x2;
 	surf->bottom = region->y2;
 }
+
+
+static void gst_imx_g2d_blitter_set_surface_rotations(struct g2d_surface *source_surface, struct g2d_surface *dest_surface, GstImxBaseBlitterRotationMode rotation)
+{
+	/* Same mapping as in gst_imx_g2d_blitter_set_output_rotation() */
+	switch (rotation)
+	{
+		case GST_IMX_BASE_BLITTER_ROTATION_90:
+			source_surface->rot = G2D_ROTATION_0;
+			dest_surface->rot = G2D_ROTATION_90;
+			break;
+
+		case GST_IMX_BASE_BLITTER_ROTATION_180:
+			source_surface->rot = G2D_ROTATION_0;
+			dest_surface->rot = G2D_ROTATION_180;
+			break;
+
+		case GST_IMX_BASE_BLITTER_ROTATION_270:
+			source_surface->rot = G2D_ROTATION_0;
+			dest_surface->rot = G2D_ROTATION_270;
+			break;
+
+		case GST_IMX_BASE_BLITTER_ROTATION_HFLIP:
+			source_surface->rot = G2D_FLIP_H;
+			dest_surface->rot = G2D_ROTATION_0;
+			break;
+
+		case GST_IMX_BASE_BLITTER_ROTATION_VFLIP:
+			source_surface->rot = G2D_FLIP_V;
+			dest_surface->rot = G2D_ROTATION_0;
+			break;
+
+		default:
+			source_surface->rot = G2D_ROTATION_0;
+			dest_surface->rot = G2D_ROTATION_0;
+			break;
+	}
+}
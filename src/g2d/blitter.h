@@ -22,6 +22,7 @@
 
 #include <g2d.h>
 #include "../common/base_blitter.h"
+#include "../common/phys_mem_caps.h"
 
 
 G_BEGIN_DECLS
@@ -57,11 +58,12 @@ typedef struct _GstImxG2DBlitterPrivate GstImxG2DBlitterPrivate;
 
 #define GST_IMX_G2D_BLITTER_SINK_CAPS \
 	GST_STATIC_CAPS( \
-		"video/x-raw, " \
-		"format = (string) " GST_IMX_G2D_SINK_VIDEO_FORMATS ", " \
-		"width = (int) [ 1, MAX ], " \
-		"height = (int) [ 1, MAX ], " \
-		"framerate = (fraction) [ 0, MAX ]; " \
+		GST_IMX_PHYS_MEM_VIDEO_CAPS_MAKE( \
+			"format = (string) " GST_IMX_G2D_SINK_VIDEO_FORMATS ", " \
+			"width = (int) [ 1, MAX ], " \
+			"height = (int) [ 1, MAX ], " \
+			"framerate = (fraction) [ 0, MAX ]" \
+		) \
 	)
 
 
@@ -76,11 +78,12 @@ typedef struct _GstImxG2DBlitterPrivate GstImxG2DBlitterPrivate;
 
 #define GST_IMX_G2D_BLITTER_SRC_CAPS \
 	GST_STATIC_CAPS( \
-		"video/x-raw, " \
-		"format = (string) " GST_IMX_G2D_SRC_VIDEO_FORMATS ", " \
-		"width = (int) [ 1, MAX ], " \
-		"height = (int) [ 1, MAX ], " \
-		"framerate = (fraction) [ 0, MAX ]; " \
+		GST_IMX_PHYS_MEM_VIDEO_CAPS_MAKE( \
+			"format = (string) " GST_IMX_G2D_SRC_VIDEO_FORMATS ", " \
+			"width = (int) [ 1, MAX ], " \
+			"height = (int) [ 1, MAX ], " \
+			"framerate = (fraction) [ 0, MAX ]" \
+		) \
 	)
 
 
@@ -97,6 +100,8 @@ GstImxG2DBlitterRotationMode;
 
 
 #define GST_IMX_G2D_BLITTER_OUTPUT_ROTATION_DEFAULT  GST_IMX_G2D_BLITTER_ROTATION_NONE
+#define GST_IMX_G2D_BLITTER_MAX_PENDING_BLITS_DEFAULT 0
+#define GST_IMX_G2D_BLITTER_MAX_PENDING_BLITS_MAX     16
 
 
 #define GST_IMX_G2D_BLITTER_MAX_NUM_EMPTY_SURFACES 4
@@ -106,11 +111,40 @@ struct _GstImxG2DBlitter
 {
 	GstImxBaseBlitter parent;
 
+	/* G2D device handle; opened once when the blitter is created and kept
+	 * open until it is finalized. If an operation on the device fails, the
+	 * handle is closed, and reopened by the next blit_frame call. */
 	void* handle;
 	struct g2d_surface source_surface, dest_surface;
 	struct g2d_surface empty_dest_surfaces[GST_IMX_G2D_BLITTER_MAX_NUM_EMPTY_SURFACES];
 	guint num_empty_dest_surfaces;
 	gboolean output_region_uptodate;
+
+	/* Asynchronous mode: if max_pending_blits is nonzero, blit_frame only
+	 * submits the G2D operations (with g2d_flush) instead of waiting for
+	 * them to finish. Up to max_pending_blits blits can be in flight; once
+	 * this limit is reached, the next blit_frame call waits for the pending
+	 * ones first. The input frames of pending blits are ref'd and kept in
+	 * pending_input_frames, since the engine still reads from them.
+	 * current_input_frame is the frame passed to set_input_frame (not ref'd). */
+	guint max_pending_blits, num_pending_blits;
+	GstBuffer *current_input_frame;
+	GSList *pending_input_frames;
+
+	/* Sequence numbers of the last submitted and the last finished blit.
+	 * Used as handles for the submit_blit/wait_blit vfuncs, and for
+	 * checking if there are any unfinished blits. */
+	guint submitted_seqnum, finished_seqnum;
+
+	/* Global alpha value the input frame is blended with; 255 disables blending */
+	guint8 input_alpha;
+
+	/* Statistics for the debug log: number of times the device was opened,
+	 * number of blitted frames, and accumulated/peak blit durations
+	 * (in microseconds, measured from the first G2D call to g2d_finish) */
+	guint num_device_opens;
+	guint64 num_blitted_frames;
+	gint64 total_blit_duration, max_blit_duration;
 };
 
 
@@ -129,6 +163,18 @@ GstImxG2DBlitter* gst_imx_g2d_blitter_new(void);
 GstImxG2DBlitterRotationMode gst_imx_g2d_blitter_get_output_rotation(GstImxG2DBlitter *g2d_blitter);
 void gst_imx_g2d_blitter_set_output_rotation(GstImxG2DBlitter *g2d_blitter, GstImxG2DBlitterRotationMode rotation);
 
+/* Sets the maximum number of blit operations that may be in flight at the same
+ * time. 0 means synchronous mode: each blit is finished before blit_frame returns.
+ * Any currently pending blits are finished before the new value is applied. */
+void gst_imx_g2d_blitter_set_max_pending_blits(GstImxG2DBlitter *g2d_blitter, guint max_pending_blits);
+guint gst_imx_g2d_blitter_get_max_pending_blits(GstImxG2DBlitter *g2d_blitter);
+
+/* Waits until all pending blit operations are finished, and releases their
+ * input frames. Does nothing if no blits are pending. This must be called before
+ * the output frame of an asynchronous blit is accessed by anything else.
+ * Returns FALSE if waiting for the G2D engine failed, TRUE otherwise. */
+gboolean gst_imx_g2d_blitter_finish(GstImxG2DBlitter *g2d_blitter);
+
 
 G_END_DECLS
 
@@ -21,6 +21,8 @@
 #include <gst/gst.h>
 #include "sink.h"
 #include "videotransform.h"
+#include "compositor.h"
+#include "../common/phys_mem_tracer.h"
 
 
 
@@ -30,6 +32,11 @@ static gboolean plugin_init(GstPlugin *plugin)
 
 	ret = ret && gst_element_register(plugin, "imxg2dvideosink", GST_RANK_PRIMARY + 1, gst_imx_g2d_video_sink_get_type());
 	ret = ret && gst_element_register(plugin, "imxg2dvideotransform", GST_RANK_PRIMARY + 1, gst_imx_g2d_video_transform_get_type());
+	ret = ret && gst_element_register(plugin, "imxg2dcompositor", GST_RANK_PRIMARY + 1, gst_imx_g2d_compositor_get_type());
+	/* G2D is the only i.MX blitter which can blend, so the G2D compositor
+	 * is also registered under the engine-independent name */
+	ret = ret && gst_element_register(plugin, "imxcompositor", GST_RANK_PRIMARY + 1, gst_imx_g2d_compositor_get_type());
+	ret = ret && gst_imx_phys_mem_tracer_register(plugin);
 
 	return ret;
 }
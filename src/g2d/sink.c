@@ -30,7 +30,8 @@ GST_DEBUG_CATEGORY_STATIC(imx_g2d_video_sink_debug);
 enum
 {
 	PROP_0,
-	PROP_OUTPUT_ROTATION
+	PROP_OUTPUT_ROTATION,
+	PROP_MAX_PENDING_BLITS
 };
 
 
@@ -96,12 +97,25 @@ void gst_imx_g2d_video_sink_class_init(GstImxG2DVideoSinkClass *klass)
 			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
 		)
 	);
+	g_object_class_install_property(
+		object_class,
+		PROP_MAX_PENDING_BLITS,
+		g_param_spec_uint(
+			"max-pending-blits",
+			"Maximum pending blits",
+			"Maximum number of blits that may be in flight in the G2D engine at the same time (0 = wait for each blit to finish)",
+			0, GST_IMX_G2D_BLITTER_MAX_PENDING_BLITS_MAX,
+			GST_IMX_G2D_BLITTER_MAX_PENDING_BLITS_DEFAULT,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
+		)
+	);
 }
 
 
 void gst_imx_g2d_video_sink_init(GstImxG2DVideoSink *g2d_video_sink)
 {
 	g2d_video_sink->output_rotation = GST_IMX_G2D_BLITTER_OUTPUT_ROTATION_DEFAULT;
+	g2d_video_sink->max_pending_blits = GST_IMX_G2D_BLITTER_MAX_PENDING_BLITS_DEFAULT;
 }
 
 
@@ -125,6 +139,14 @@ static void gst_imx_g2d_video_sink_set_property(GObject *object, guint prop_id,
 			GST_IMX_BLITTER_VIDEO_SINK_UNLOCK(g2d_video_sink);
 			break;
 
+		case PROP_MAX_PENDING_BLITS:
+			GST_IMX_BLITTER_VIDEO_SINK_LOCK(g2d_video_sink);
+			g2d_video_sink->max_pending_blits = g_value_get_uint(value);
+			if (g2d_video_sink->blitter != NULL)
+				gst_imx_g2d_blitter_set_max_pending_blits(g2d_video_sink->blitter, g2d_video_sink->max_pending_blits);
+			GST_IMX_BLITTER_VIDEO_SINK_UNLOCK(g2d_video_sink);
+			break;
+
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 			break;
@@ -144,6 +166,12 @@ static void gst_imx_g2d_video_sink_get_property(GObject *object, guint prop_id,
 			GST_IMX_BLITTER_VIDEO_SINK_UNLOCK(g2d_video_sink);
 			break;
 
+		case PROP_MAX_PENDING_BLITS:
+			GST_IMX_BLITTER_VIDEO_SINK_LOCK(g2d_video_sink);
+			g_value_set_uint(value, g2d_video_sink->max_pending_blits);
+			GST_IMX_BLITTER_VIDEO_SINK_UNLOCK(g2d_video_sink);
+			break;
+
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 			break;
@@ -163,6 +191,7 @@ static gboolean gst_imx_g2d_video_sink_start(GstImxBlitterVideoSink *blitter_vid
 	}
 
 	gst_imx_g2d_blitter_set_output_rotation(blitter, g2d_video_sink->output_rotation);
+	gst_imx_g2d_blitter_set_max_pending_blits(blitter, g2d_video_sink->max_pending_blits);
 	gst_imx_blitter_video_sink_set_blitter(blitter_video_sink, GST_IMX_BASE_BLITTER(blitter));
 	gst_imx_blitter_video_sink_transpose_frames(GST_IMX_BLITTER_VIDEO_SINK(g2d_video_sink), (g2d_video_sink->output_rotation == GST_IMX_G2D_BLITTER_ROTATION_90) || (g2d_video_sink->output_rotation == GST_IMX_G2D_BLITTER_ROTATION_270));
 
@@ -45,6 +45,7 @@ struct _GstImxG2DVideoSink
 	GstImxBlitterVideoSink parent;
 	GstImxG2DBlitter *blitter;
 	GstImxG2DBlitterRotationMode output_rotation;
+	guint max_pending_blits;
 };
 
 
@@ -101,6 +101,9 @@ void gst_imx_g2d_video_transform_class_init(GstImxG2DVideoTransformClass *klass)
 	
 	base_class->are_transforms_necessary = GST_DEBUG_FUNCPTR(gst_imx_g2d_video_transform_are_transforms_necessary);
 
+	base_class->engine_name = "G2D";
+	base_class->engine_capabilities = GST_IMX_DISPATCH_BLITTER_CAPABILITY_SCALING | GST_IMX_DISPATCH_BLITTER_CAPABILITY_ROTATION;
+
 	g_object_class_install_property(
 		object_class,
 		PROP_OUTPUT_ROTATION,
@@ -135,6 +138,7 @@ static void gst_imx_g2d_video_transform_set_property(GObject *object, guint prop
 			g2d_video_transform->output_rotation = g_value_get_enum(value);
 			if (g2d_video_transform->blitter != NULL)
 				gst_imx_g2d_blitter_set_output_rotation(g2d_video_transform->blitter, g2d_video_transform->output_rotation);
+			gst_imx_blitter_video_transform_set_engine_exclusive(GST_IMX_BLITTER_VIDEO_TRANSFORM(g2d_video_transform), g2d_video_transform->output_rotation != GST_IMX_G2D_BLITTER_ROTATION_NONE);
 			GST_IMX_BLITTER_VIDEO_TRANSFORM_UNLOCK(g2d_video_transform);
 			break;
 
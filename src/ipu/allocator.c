@@ -70,6 +70,8 @@ static gboolean gst_imx_ipu_alloc_phys_mem(GstImxPhysMemAllocator *allocator, Gs
 	else
 	{
 		memory->phys_addr = (gst_imx_phys_addr_t)m;
+		/* the IPU driver always maps its memory with write combining */
+		memory->cache_policy = GST_IMX_PHYS_MEM_CACHE_POLICY_WRITE_COMBINED;
 		GST_DEBUG_OBJECT(allocator, "allocated %u bytes of physical memory at address %" GST_IMX_PHYS_ADDR_FORMAT, size, memory->phys_addr);
 		return TRUE;
 	}
@@ -105,7 +107,10 @@ static gpointer gst_imx_ipu_map_phys_mem(GstImxPhysMemAllocator *allocator, GstI
 
 	/* As explained in gst_imx_phys_mem_allocator_map(), the flags are guaranteed to
 	 * be the same when a memory block is mapped multiple times, so the value of
-	 * "flags" will be identical if map() is called two times, for example. */
+	 * "flags" will be identical if map() is called two times, for example.
+	 * Since the mapping cache is enabled for this allocator, the mapping may be
+	 * kept alive after the block is unmapped; the base class remaps the block
+	 * if it is later mapped with flags the existing mapping does not cover. */
 
 	if (flags & GST_MAP_READ)
 		prot |= PROT_READ;
@@ -150,6 +155,13 @@ static void gst_imx_ipu_allocator_class_init(GstImxIpuAllocatorClass *klass)
 	parent_class->free_phys_mem  = GST_DEBUG_FUNCPTR(gst_imx_ipu_free_phys_mem);
 	parent_class->map_phys_mem   = GST_DEBUG_FUNCPTR(gst_imx_ipu_map_phys_mem);
 	parent_class->unmap_phys_mem = GST_DEBUG_FUNCPTR(gst_imx_ipu_unmap_phys_mem);
+	/* mmap() and munmap() calls are costly, and the IPU memory
+	 * mappings need no cache maintenance, so keep them alive */
+	parent_class->cache_mappings = TRUE;
+
+	/* the IPU driver cannot export its memory, but the IPU
+	 * can use any physically contiguous memory */
+	parent_class->dmabuf_heap_backing = TRUE;
 
 	GST_DEBUG_CATEGORY_INIT(imx_ipu_allocator_debug, "imxipuallocator", 0, "Freescale i.MX IPU physical memory/allocator");
 }
@@ -33,6 +33,13 @@ GST_DEBUG_CATEGORY_STATIC(imx_ipu_blitter_debug);
 #define GST_CAT_DEFAULT imx_ipu_blitter_debug
 
 
+/* Largest input and output rectangles a single IPU task can process. The IC
+ * itself is limited to 1024 pixels per dimension, but the kernel driver
+ * already splits larger tasks into up to 2x2 stripes, so only blits beyond
+ * twice that size need to be tiled. */
+#define GST_IMX_IPU_BLITTER_MAX_BLIT_SIZE 2048
+
+
 G_DEFINE_TYPE(GstImxIpuBlitter, gst_imx_ipu_blitter, GST_TYPE_IMX_BASE_BLITTER)
 
 
@@ -54,6 +61,7 @@ static gboolean gst_imx_ipu_blitter_blit_frame(GstImxBaseBlitter *base_blitter,
 static void gst_imx_ipu_blitter_clear_previous_buffer(GstImxIpuBlitter *ipu_blitter);
 static gboolean gst_imx_ipu_blitter_flush(GstImxBaseBlitter *base_blitter);
 static void gst_imx_ipu_blitter_init_dummy_black_buffer(GstImxIpuBlitter *ipu_blitter);
+static void gst_imx_ipu_blitter_update_max_blit_size(GstImxIpuBlitter *ipu_blitter);
 
 static void gst_imx_ipu_blitter_print_ipu_fourcc(u32 format, char buf[5]);
 static guint32 gst_imx_ipu_blitter_get_v4l_format(GstVideoFormat format);
@@ -158,6 +166,8 @@ void gst_imx_ipu_blitter_init(GstImxIpuBlitter *ipu_blitter)
 
 	gst_imx_ipu_blitter_init_dummy_black_buffer(ipu_blitter);
 
+	gst_imx_ipu_blitter_update_max_blit_size(ipu_blitter);
+
 	GST_INFO_OBJECT(ipu_blitter, "initialized blitter");
 }
 
@@ -183,6 +193,8 @@ void gst_imx_ipu_blitter_set_output_rotation_mode(GstImxIpuBlitter *ipu_blitter,
 		case GST_IMX_IPU_BLITTER_ROTATION_90CW_VFLIP: ipu_blitter->priv->task.output.rotate = IPU_ROTATE_90_RIGHT_VFLIP; break;
 		case GST_IMX_IPU_BLITTER_ROTATION_90CCW:      ipu_blitter->priv->task.output.rotate = IPU_ROTATE_90_LEFT; break;
 	}
+
+	gst_imx_ipu_blitter_update_max_blit_size(ipu_blitter);
 }
 
 
@@ -226,6 +238,8 @@ void gst_imx_ipu_blitter_set_deinterlace_mode(GstImxIpuBlitter *ipu_blitter, Gst
 	}
 
 	ipu_blitter->deinterlace_mode = deinterlace_mode;
+
+	gst_imx_ipu_blitter_update_max_blit_size(ipu_blitter);
 }
 
 
@@ -431,11 +445,15 @@ static gboolean gst_imx_ipu_blitter_blit_frame(GstImxBaseBlitter *base_blitter,
 	 * XXX this is necessary because unlike G2D, the IPU has problems with
 	 * pixel perfect positioning, that is, neighbouring regions sometimes
 	 * have a few pixels of space between them
+	 * The output region can be larger than what a single IPU task can
+	 * process (this happens with tiled blits, whose tiles also cover the
+	 * empty regions next to them), so the clear is split into chunks.
 	 */
 	if (!(ipu_blitter->output_region_uptodate))
 	{
 		struct ipu_task task;
 		GstImxBaseBlitterRegion *output_region = &(ipu_blitter->output_region);
+		gint chunk_x, chunk_y;
 
 		GST_LOG_OBJECT(ipu_blitter, "need to clear empty regions");
 
@@ -453,10 +471,6 @@ static gboolean gst_imx_ipu_blitter_blit_frame(GstImxBaseBlitter *base_blitter,
 		task.input.crop.w = task.input.width;
 		task.input.crop.h = task.input.height;
 		task.output.rotate = IPU_ROTATE_NONE;
-		task.output.crop.pos.x = output_region->x1;
-		task.output.crop.pos.y = output_region->y1;
-		task.output.crop.w = output_region->x2 - output_region->x1;
-		task.output.crop.h = output_region->y2 - output_region->y1;
 
 		GST_LOG_OBJECT(
 			ipu_blitter,
@@ -467,19 +481,31 @@ static gboolean gst_imx_ipu_blitter_blit_frame(GstImxBaseBlitter *base_blitter,
 			(gst_imx_phys_addr_t)(task.input.paddr),
 			task.input.deinterlace.enable, task.input.deinterlace.motion
 		);
-		GST_LOG_OBJECT(
-			ipu_blitter,
-			"clear op task output:  width:  %u  height: %u  format: 0x%x  crop: %u,%u %ux%u  paddr %" GST_IMX_PHYS_ADDR_FORMAT "  rotate: %u",
-			task.output.width, task.output.height,
-			task.output.format,
-			task.output.crop.pos.x, task.output.crop.pos.y, task.output.crop.w, task.output.crop.h,
-			(gst_imx_phys_addr_t)(task.output.paddr),
-			task.output.rotate
-		);
 
-		ret = ioctl(gst_imx_ipu_get_fd(), IPU_QUEUE_TASK, &task);
-		if (ret == -1)
-			GST_ERROR_OBJECT(ipu_blitter, "queuing IPU task failed: %s", strerror(errno));
+		for (chunk_y = output_region->y1; chunk_y < output_region->y2; chunk_y += GST_IMX_IPU_BLITTER_MAX_BLIT_SIZE)
+		{
+			for (chunk_x = output_region->x1; chunk_x < output_region->x2; chunk_x += GST_IMX_IPU_BLITTER_MAX_BLIT_SIZE)
+			{
+				task.output.crop.pos.x = chunk_x;
+				task.output.crop.pos.y = chunk_y;
+				task.output.crop.w = MIN(output_region->x2 - chunk_x, GST_IMX_IPU_BLITTER_MAX_BLIT_SIZE);
+				task.output.crop.h = MIN(output_region->y2 - chunk_y, GST_IMX_IPU_BLITTER_MAX_BLIT_SIZE);
+
+				GST_LOG_OBJECT(
+					ipu_blitter,
+					"clear op task output:  width:  %u  height: %u  format: 0x%x  crop: %u,%u %ux%u  paddr %" GST_IMX_PHYS_ADDR_FORMAT "  rotate: %u",
+					task.output.width, task.output.height,
+					task.output.format,
+					task.output.crop.pos.x, task.output.crop.pos.y, task.output.crop.w, task.output.crop.h,
+					(gst_imx_phys_addr_t)(task.output.paddr),
+					task.output.rotate
+				);
+
+				ret = ioctl(gst_imx_ipu_get_fd(), IPU_QUEUE_TASK, &task);
+				if (ret == -1)
+					GST_ERROR_OBJECT(ipu_blitter, "queuing IPU task failed: %s", strerror(errno));
+			}
+		}
 
 		ipu_blitter->output_region_uptodate = TRUE;
 	}
@@ -528,6 +554,20 @@ static gboolean gst_imx_ipu_blitter_flush(GstImxBaseBlitter *base_blitter)
 }
 
 
+static void gst_imx_ipu_blitter_update_max_blit_size(GstImxIpuBlitter *ipu_blitter)
+{
+	/* The base class can only split blits into tiles if tiles end up at the same
+	 * place in the output as in the input, which is not the case with rotation.
+	 * Deinterlacing uses the previous frame, which tiling would not pass on.
+	 * In both cases, disable tiling, and let the IPU handle oversized blits
+	 * on its own. */
+	if ((ipu_blitter->priv->task.output.rotate == IPU_ROTATE_NONE) && (ipu_blitter->deinterlace_mode == GST_IMX_IPU_BLITTER_DEINTERLACE_NONE))
+		gst_imx_base_blitter_set_max_blit_size(GST_IMX_BASE_BLITTER(ipu_blitter), GST_IMX_IPU_BLITTER_MAX_BLIT_SIZE, GST_IMX_IPU_BLITTER_MAX_BLIT_SIZE);
+	else
+		gst_imx_base_blitter_set_max_blit_size(GST_IMX_BASE_BLITTER(ipu_blitter), 0, 0);
+}
+
+
 static void gst_imx_ipu_blitter_init_dummy_black_buffer(GstImxIpuBlitter *ipu_blitter)
 {
 	GstVideoInfo video_info;
@@ -555,6 +595,9 @@ static void gst_imx_ipu_blitter_init_dummy_black_buffer(GstImxIpuBlitter *ipu_bl
 
 		phys_mem_meta->phys_addr = imx_phys_mem_mem->phys_addr;
 	}
+
+	/* The buffer is never written to again, and only read by the IPU */
+	gst_imx_phys_mem_buffer_begin_device_access(ipu_blitter->dummy_black_buffer, GST_MAP_READ);
 }
 
 
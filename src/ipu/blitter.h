@@ -23,6 +23,7 @@
 #include <gst/gst.h>
 #include <gst/video/video.h>
 #include "../common/base_blitter.h"
+#include "../common/phys_mem_caps.h"
 
 
 G_BEGIN_DECLS
@@ -62,12 +63,13 @@ typedef struct _GstImxIpuBlitterPrivate GstImxIpuBlitterPrivate;
 
 #define GST_IMX_IPU_BLITTER_SINK_CAPS \
 	GST_STATIC_CAPS( \
-		"video/x-raw, " \
-		"format = (string) " GST_IMX_IPU_VIDEO_FORMATS ", " \
-		"width = (int) [ 64, MAX ], " \
-		"height = (int) [ 64, MAX ], " \
-		"framerate = (fraction) [ 0, MAX ], " \
-		"interlace-mode = (string) { progressive, mixed, interleaved }; " \
+		GST_IMX_PHYS_MEM_VIDEO_CAPS_MAKE( \
+			"format = (string) " GST_IMX_IPU_VIDEO_FORMATS ", " \
+			"width = (int) [ 64, MAX ], " \
+			"height = (int) [ 64, MAX ], " \
+			"framerate = (fraction) [ 0, MAX ], " \
+			"interlace-mode = (string) { progressive, mixed, interleaved }" \
+		) \
 	)
 
 #define GST_IMX_IPU_BLITTER_SRC_CAPS GST_IMX_IPU_BLITTER_SINK_CAPS
@@ -21,6 +21,7 @@
 #include <gst/gst.h>
 #include "sink.h"
 #include "videotransform.h"
+#include "../common/phys_mem_tracer.h"
 
 
 GST_DEBUG_CATEGORY(imx_ipu_device_debug);
@@ -35,6 +36,7 @@ static gboolean plugin_init(GstPlugin *plugin)
 
 	ret = ret && gst_element_register(plugin, "imxipuvideotransform", GST_RANK_NONE, gst_imx_ipu_video_transform_get_type());
 	ret = ret && gst_element_register(plugin, "imxipuvideosink", GST_RANK_PRIMARY + 1, gst_imx_ipu_video_sink_get_type());
+	ret = ret && gst_imx_phys_mem_tracer_register(plugin);
 
 	return ret;
 }
@@ -108,6 +108,9 @@ void gst_imx_ipu_video_transform_class_init(GstImxIpuVideoTransformClass *klass)
 	
 	base_class->are_transforms_necessary = GST_DEBUG_FUNCPTR(gst_imx_ipu_video_transform_are_transforms_necessary);
 
+	base_class->engine_name = "IPU";
+	base_class->engine_capabilities = GST_IMX_DISPATCH_BLITTER_CAPABILITY_SCALING | GST_IMX_DISPATCH_BLITTER_CAPABILITY_ROTATION | GST_IMX_DISPATCH_BLITTER_CAPABILITY_DEINTERLACING;
+
 	g_object_class_install_property(
 		object_class,
 		PROP_OUTPUT_ROTATION,
@@ -155,6 +158,7 @@ static void gst_imx_ipu_video_transform_set_property(GObject *object, guint prop
 			ipu_video_transform->output_rotation = g_value_get_enum(value);
 			if (ipu_video_transform->blitter != NULL)
 				gst_imx_ipu_blitter_set_output_rotation_mode(ipu_video_transform->blitter, ipu_video_transform->output_rotation);
+			gst_imx_blitter_video_transform_set_engine_exclusive(GST_IMX_BLITTER_VIDEO_TRANSFORM(ipu_video_transform), (ipu_video_transform->output_rotation != GST_IMX_IPU_BLITTER_ROTATION_NONE) || (ipu_video_transform->deinterlace_mode != GST_IMX_IPU_BLITTER_DEINTERLACE_NONE));
 			GST_IMX_BLITTER_VIDEO_TRANSFORM_UNLOCK(ipu_video_transform);
 			break;
 
@@ -163,6 +167,7 @@ static void gst_imx_ipu_video_transform_set_property(GObject *object, guint prop
 			ipu_video_transform->deinterlace_mode = g_value_get_enum(value);
 			if (ipu_video_transform->blitter != NULL)
 				gst_imx_ipu_blitter_set_deinterlace_mode(ipu_video_transform->blitter, ipu_video_transform->deinterlace_mode);
+			gst_imx_blitter_video_transform_set_engine_exclusive(GST_IMX_BLITTER_VIDEO_TRANSFORM(ipu_video_transform), (ipu_video_transform->output_rotation != GST_IMX_IPU_BLITTER_ROTATION_NONE) || (ipu_video_transform->deinterlace_mode != GST_IMX_IPU_BLITTER_DEINTERLACE_NONE));
 			GST_IMX_BLITTER_VIDEO_TRANSFORM_UNLOCK(ipu_video_transform);
 			break;
 
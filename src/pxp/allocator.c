@@ -35,7 +35,7 @@ static void gst_imx_pxp_allocator_finalize(GObject *object);
 
 static gboolean gst_imx_pxp_alloc_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, gssize size);
 static gboolean gst_imx_pxp_free_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory);
-static void gst_imx_pxp_cache_op(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, int cache_mode);
+static void gst_imx_pxp_cache_op(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, GstImxPhysMemCacheOp op, gsize offset, gsize size);
 static gpointer gst_imx_pxp_map_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *phys_mem, gssize size, GstMapFlags flags);
 static void gst_imx_pxp_unmap_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *phys_mem);
 
@@ -56,13 +56,18 @@ GstAllocator* gst_imx_pxp_allocator_new(void)
 
 static gboolean gst_imx_pxp_alloc_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, gssize size)
 {
-	/* allocate cacheable physically contiguous memory block */
+	/* allocate physically contiguous memory block with the requested cache policy */
 
 	int ret;
 	struct pxp_mem_desc *mem_desc = g_slice_alloc0(sizeof(struct pxp_mem_desc));
 
 	mem_desc->size = size;
-	mem_desc->mtype = MEMORY_TYPE_CACHED;
+	switch (memory->cache_policy)
+	{
+		case GST_IMX_PHYS_MEM_CACHE_POLICY_WRITE_COMBINED: mem_desc->mtype = MEMORY_TYPE_WC; break;
+		case GST_IMX_PHYS_MEM_CACHE_POLICY_UNCACHED: mem_desc->mtype = MEMORY_TYPE_UNCACHED; break;
+		default: mem_desc->mtype = MEMORY_TYPE_CACHED;
+	}
 
 	ret = ioctl(gst_imx_pxp_get_fd(), PXP_IOC_GET_PHYMEM, mem_desc);
 
@@ -77,7 +82,7 @@ static gboolean gst_imx_pxp_alloc_phys_mem(GstImxPhysMemAllocator *allocator, Gs
 		memory->phys_addr = (gst_imx_phys_addr_t)(mem_desc->phys_addr);
 		memory->internal = mem_desc;
 
-		GST_INFO_OBJECT(allocator, "allocated %u bytes of physical memory, paddr %" GST_IMX_PHYS_ADDR_FORMAT, size, memory->phys_addr);
+		GST_INFO_OBJECT(allocator, "allocated %u bytes of %s physical memory, paddr %" GST_IMX_PHYS_ADDR_FORMAT, size, gst_imx_phys_mem_cache_policy_get_name(memory->cache_policy), memory->phys_addr);
 
 		return TRUE;
 	}
@@ -105,21 +110,21 @@ static gboolean gst_imx_pxp_free_phys_mem(GstImxPhysMemAllocator *allocator, Gst
 }
 
 
-static void gst_imx_pxp_cache_op(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, int cache_mode)
+static void gst_imx_pxp_cache_op(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, GstImxPhysMemCacheOp op, G_GNUC_UNUSED gsize offset, G_GNUC_UNUSED gsize size)
 {
+	/* PXP_IOC_FLUSH_PHYMEM has no range arguments, so
+	 * the operation always covers the whole block */
 	gchar const *desc;
 	struct pxp_mem_flush flush;
 	struct pxp_mem_desc *mem_desc = (struct pxp_mem_desc *)(memory->internal);
 
-	switch (cache_mode)
+	switch (op)
 	{
-		case CACHE_CLEAN:      desc = "cleaning"; break;
-		case CACHE_FLUSH:      desc = "flushing"; break;
-		case CACHE_INVALIDATE: desc = "invalidating"; break;
+		case GST_IMX_PHYS_MEM_CACHE_OP_CLEAN:      flush.type = CACHE_CLEAN;      desc = "cleaning"; break;
+		case GST_IMX_PHYS_MEM_CACHE_OP_INVALIDATE: flush.type = CACHE_INVALIDATE; desc = "invalidating"; break;
 		default: g_assert(0);
 	}
 
-	flush.type = cache_mode;
 	flush.handle = mem_desc->handle;
 
 	if (ioctl(gst_imx_pxp_get_fd(), PXP_IOC_FLUSH_PHYMEM, &flush) == 0)
@@ -142,19 +147,16 @@ static gpointer gst_imx_pxp_map_phys_mem(GstImxPhysMemAllocator *allocator, GstI
 
 	/* As explained in gst_imx_phys_mem_allocator_map(), the flags are guaranteed to
 	 * be the same when a memory block is mapped multiple times, so the value of
-	 * "flags" will be identical if map() is called two times, for example. */
+	 * "flags" will be identical if map() is called two times, for example.
+	 * Since the mapping cache is enabled for this allocator, the mapping may be
+	 * kept alive after the block is unmapped; the base class remaps the block
+	 * if it is later mapped with flags the existing mapping does not cover. */
 
 	if (flags & GST_MAP_READ)
 		prot |= PROT_READ;
 	if (flags & GST_MAP_WRITE)
 		prot |= PROT_WRITE;
 
-	/* invalidate cache in map() if the MAP_READ flag is set
-	 * to ensure any data that is read from the mapped memory
-	 * is up to date */
-	if (flags & GST_MAP_READ)
-		gst_imx_pxp_cache_op(allocator, phys_mem, CACHE_INVALIDATE);
-
 	phys_mem->mapped_virt_addr = mmap(0, size, prot, MAP_SHARED, gst_imx_pxp_get_fd(), (dma_addr_t)(phys_mem->phys_addr));
 	if (phys_mem->mapped_virt_addr == MAP_FAILED)
 	{
@@ -177,11 +179,6 @@ static void gst_imx_pxp_unmap_phys_mem(GstImxPhysMemAllocator *allocator, GstImx
 			GST_ERROR_OBJECT(allocator, "unmapping memory-mapped PxP framebuffer failed: %s", strerror(errno));
 		GST_LOG_OBJECT(allocator, "unmapped PxP physmem memory:  virt addr %p  phys addr %" GST_IMX_PHYS_ADDR_FORMAT, memory->mapped_virt_addr, memory->phys_addr);
 		memory->mapped_virt_addr = NULL;
-
-		/* clean cache in map() if the MAP_WRITE flag is set
-		 * to ensure the cache gets filled with up to date data */
-		if (memory->mapping_flags & GST_MAP_WRITE)
-			gst_imx_pxp_cache_op(allocator, memory, CACHE_CLEAN);
 	}
 }
 
@@ -198,6 +195,14 @@ static void gst_imx_pxp_allocator_class_init(GstImxPxPAllocatorClass *klass)
 	parent_class->free_phys_mem  = GST_DEBUG_FUNCPTR(gst_imx_pxp_free_phys_mem);
 	parent_class->map_phys_mem   = GST_DEBUG_FUNCPTR(gst_imx_pxp_map_phys_mem);
 	parent_class->unmap_phys_mem = GST_DEBUG_FUNCPTR(gst_imx_pxp_unmap_phys_mem);
+	parent_class->cache_op       = GST_DEBUG_FUNCPTR(gst_imx_pxp_cache_op);
+	/* cache maintenance is done by the base class with gst_imx_pxp_cache_op(),
+	 * so the costly mmap() and munmap() calls can be avoided */
+	parent_class->cache_mappings = TRUE;
+
+	/* the PxP driver cannot export its memory, but the PxP
+	 * can use any physically contiguous memory */
+	parent_class->dmabuf_heap_backing = TRUE;
 
 	GST_DEBUG_CATEGORY_INIT(imx_pxp_allocator_debug, "imxpxpallocator", 0, "Freescale i.MX PxP physical memory/allocator");
 }
@@ -41,6 +41,8 @@ struct _GstImxPxPBlitterPrivate
 	struct pxp_config_data pxp_config;
 	struct pxp_chan_handle pxp_channel;
 	gboolean pxp_channel_requested;
+	/* TRUE if the PxP channel was started, but not waited for yet */
+	gboolean blit_pending;
 };
 
 
@@ -60,6 +62,8 @@ static gboolean gst_imx_pxp_blitter_set_output_frame(GstImxBaseBlitter *base_bli
 static gboolean gst_imx_pxp_blitter_set_output_regions(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *video_region, GstImxBaseBlitterRegion const *output_region);
 static GstAllocator* gst_imx_pxp_blitter_get_phys_mem_allocator(GstImxBaseBlitter *base_blitter);
 static gboolean gst_imx_pxp_blitter_blit_frame(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *input_region);
+static gboolean gst_imx_pxp_blitter_submit_blit(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *input_region, gpointer *handle);
+static gboolean gst_imx_pxp_blitter_wait_blit(GstImxBaseBlitter *base_blitter, gpointer handle);
 
 static GstImxPxPFormatDetails const * gst_imx_pxp_blitter_get_pxp_format_details(GstVideoFormat gstfmt);
 static void gst_imx_pxp_blitter_set_layer_params(GstImxPxPBlitter *pxp_blitter, GstBuffer *video_frame, struct pxp_layer_param *layer_params);
@@ -111,6 +115,8 @@ void gst_imx_pxp_blitter_class_init(GstImxPxPBlitterClass *klass)
 	base_class->set_output_regions     = GST_DEBUG_FUNCPTR(gst_imx_pxp_blitter_set_output_regions);
 	base_class->get_phys_mem_allocator = GST_DEBUG_FUNCPTR(gst_imx_pxp_blitter_get_phys_mem_allocator);
 	base_class->blit_frame             = GST_DEBUG_FUNCPTR(gst_imx_pxp_blitter_blit_frame);
+	base_class->submit_blit            = GST_DEBUG_FUNCPTR(gst_imx_pxp_blitter_submit_blit);
+	base_class->wait_blit              = GST_DEBUG_FUNCPTR(gst_imx_pxp_blitter_wait_blit);
 
 	GST_DEBUG_CATEGORY_INIT(imx_pxp_blitter_debug, "imxpxpblitter", 0, "Freescale i.MX PxP blitter class");
 }
@@ -122,6 +128,7 @@ void gst_imx_pxp_blitter_init(GstImxPxPBlitter *pxp_blitter)
 
 	pxp_blitter->priv = g_slice_alloc(sizeof(GstImxPxPBlitterPrivate));
 	pxp_blitter->priv->pxp_channel_requested = FALSE;
+	pxp_blitter->priv->blit_pending = FALSE;
 
 	struct pxp_proc_data *proc_data = &(pxp_blitter->priv->pxp_config.proc_data);
 	memset(&(pxp_blitter->priv->pxp_config), 0, sizeof(struct pxp_config_data));
@@ -230,6 +237,7 @@ static void gst_imx_pxp_blitter_finalize(GObject *object)
 
 	if (pxp_blitter->priv->pxp_channel_requested)
 	{
+		gst_imx_pxp_blitter_wait_blit(GST_IMX_BASE_BLITTER(pxp_blitter), NULL);
 		ioctl(gst_imx_pxp_get_fd(), PXP_IOC_PUT_CHAN, &(pxp_blitter->priv->pxp_channel.handle));
 		pxp_blitter->priv->pxp_channel_requested = FALSE;
 	}
@@ -324,6 +332,17 @@ static GstAllocator* gst_imx_pxp_blitter_get_phys_mem_allocator(G_GNUC_UNUSED Gs
 
 
 static gboolean gst_imx_pxp_blitter_blit_frame(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *input_region)
+{
+	gpointer handle;
+
+	if (!gst_imx_pxp_blitter_submit_blit(base_blitter, input_region, &handle))
+		return FALSE;
+
+	return gst_imx_pxp_blitter_wait_blit(base_blitter, handle);
+}
+
+
+static gboolean gst_imx_pxp_blitter_submit_blit(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *input_region, gpointer *handle)
 {
 	int ret;
 	GstImxPxPBlitter *pxp_blitter = GST_IMX_PXP_BLITTER(base_blitter);
@@ -336,6 +355,11 @@ static gboolean gst_imx_pxp_blitter_blit_frame(GstImxBaseBlitter *base_blitter,
 		return FALSE;
 	}
 
+	/* The channel can only process one blit at a time, so wait for the
+	 * previous one if it is still running */
+	if (pxp_blitter->priv->blit_pending && !gst_imx_pxp_blitter_wait_blit(base_blitter, NULL))
+		return FALSE;
+
 	pxp_blitter->priv->pxp_config.proc_data.srect.left = input_region->x1;
 	pxp_blitter->priv->pxp_config.proc_data.srect.top = input_region->y1;
 	pxp_blitter->priv->pxp_config.proc_data.srect.width = input_region->x2 - input_region->x1;
@@ -358,6 +382,29 @@ static gboolean gst_imx_pxp_blitter_blit_frame(GstImxBaseBlitter *base_blitter,
 		return FALSE;
 	}
 
+	pxp_blitter->priv->blit_pending = TRUE;
+
+	/* Only one blit can be pending, so the handle only has to be non-NULL */
+	*handle = pxp_blitter;
+
+	return TRUE;
+}
+
+
+static gboolean gst_imx_pxp_blitter_wait_blit(GstImxBaseBlitter *base_blitter, G_GNUC_UNUSED gpointer handle)
+{
+	int ret;
+	GstImxPxPBlitter *pxp_blitter = GST_IMX_PXP_BLITTER(base_blitter);
+
+	g_assert(pxp_blitter != NULL);
+
+	/* If the blit was already waited for (because a newer one
+	 * had to be submitted), there is nothing to do */
+	if (!(pxp_blitter->priv->blit_pending))
+		return TRUE;
+
+	pxp_blitter->priv->blit_pending = FALSE;
+
 	ret = ioctl(gst_imx_pxp_get_fd(), PXP_IOC_WAIT4CMPLT, &(pxp_blitter->priv->pxp_channel));
 	if (ret != 0)
 	{
@@ -21,6 +21,7 @@
 #define GST_IMX_PXP_BLITTER_H
 
 #include "../common/base_blitter.h"
+#include "../common/phys_mem_caps.h"
 
 
 G_BEGIN_DECLS
@@ -114,11 +115,12 @@ typedef struct _GstImxPxPBlitterPrivate GstImxPxPBlitterPrivate;
 
 #define GST_IMX_PXP_BLITTER_SINK_CAPS \
 	GST_STATIC_CAPS( \
-		"video/x-raw, " \
-		"format = (string) " GST_IMX_PXP_SINK_VIDEO_FORMATS ", " \
-		"width = (int) [ 1, MAX ], " \
-		"height = (int) [ 1, MAX ], " \
-		"framerate = (fraction) [ 0, MAX ]; " \
+		GST_IMX_PHYS_MEM_VIDEO_CAPS_MAKE( \
+			"format = (string) " GST_IMX_PXP_SINK_VIDEO_FORMATS ", " \
+			"width = (int) [ 1, MAX ], " \
+			"height = (int) [ 1, MAX ], " \
+			"framerate = (fraction) [ 0, MAX ]" \
+		) \
 	)
 
 #define GST_IMX_PXP_SRC_VIDEO_FORMATS \
@@ -131,11 +133,12 @@ typedef struct _GstImxPxPBlitterPrivate GstImxPxPBlitterPrivate;
 
 #define GST_IMX_PXP_BLITTER_SRC_CAPS \
 	GST_STATIC_CAPS( \
-		"video/x-raw, " \
-		"format = (string) " GST_IMX_PXP_SRC_VIDEO_FORMATS ", " \
-		"width = (int) [ 1, MAX ], " \
-		"height = (int) [ 1, MAX ], " \
-		"framerate = (fraction) [ 0, MAX ]; " \
+		GST_IMX_PHYS_MEM_VIDEO_CAPS_MAKE( \
+			"format = (string) " GST_IMX_PXP_SRC_VIDEO_FORMATS ", " \
+			"width = (int) [ 1, MAX ], " \
+			"height = (int) [ 1, MAX ], " \
+			"framerate = (fraction) [ 0, MAX ]" \
+		) \
 	)
 
 
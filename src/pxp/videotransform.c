@@ -101,6 +101,9 @@ void gst_imx_pxp_video_transform_class_init(GstImxPxPVideoTransformClass *klass)
 	
 	base_class->are_transforms_necessary = GST_DEBUG_FUNCPTR(gst_imx_pxp_video_transform_are_transforms_necessary);
 
+	base_class->engine_name = "PxP";
+	base_class->engine_capabilities = GST_IMX_DISPATCH_BLITTER_CAPABILITY_SCALING | GST_IMX_DISPATCH_BLITTER_CAPABILITY_ROTATION;
+
 	g_object_class_install_property(
 		object_class,
 		PROP_OUTPUT_ROTATION,
@@ -135,6 +138,7 @@ static void gst_imx_pxp_video_transform_set_property(GObject *object, guint prop
 			pxp_video_transform->output_rotation = g_value_get_enum(value);
 			if (pxp_video_transform->blitter != NULL)
 				gst_imx_pxp_blitter_set_output_rotation(pxp_video_transform->blitter, pxp_video_transform->output_rotation);
+			gst_imx_blitter_video_transform_set_engine_exclusive(GST_IMX_BLITTER_VIDEO_TRANSFORM(pxp_video_transform), pxp_video_transform->output_rotation != GST_IMX_PXP_BLITTER_ROTATION_NONE);
 			GST_IMX_BLITTER_VIDEO_TRANSFORM_UNLOCK(pxp_video_transform);
 			break;
 
@@ -0,0 +1,124 @@
+/* Software blitter allocation functions for system memory
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include <stdlib.h>
+#include "allocator.h"
+
+
+GST_DEBUG_CATEGORY_STATIC(imx_sw_allocator_debug);
+#define GST_CAT_DEFAULT imx_sw_allocator_debug
+
+
+/* Alignment of the memory blocks, in bytes; large enough for
+ * vectorized loads and stores on both ARM and x86 */
+#define GST_IMX_SW_ALLOCATOR_ALIGNMENT 16
+
+
+
+static gboolean gst_imx_sw_alloc_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, gssize size);
+static gboolean gst_imx_sw_free_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory);
+static gpointer gst_imx_sw_map_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *phys_mem, gssize size, GstMapFlags flags);
+static void gst_imx_sw_unmap_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *phys_mem);
+
+
+G_DEFINE_TYPE(GstImxSwAllocator, gst_imx_sw_allocator, GST_TYPE_IMX_PHYS_MEM_ALLOCATOR)
+
+
+
+
+GstAllocator* gst_imx_sw_allocator_new(void)
+{
+	GstAllocator *allocator;
+	allocator = g_object_new(gst_imx_sw_allocator_get_type(), NULL);
+
+	return allocator;
+}
+
+
+static gboolean gst_imx_sw_alloc_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, gssize size)
+{
+	gpointer block;
+
+	if (posix_memalign(&block, GST_IMX_SW_ALLOCATOR_ALIGNMENT, size) != 0)
+	{
+		GST_ERROR_OBJECT(allocator, "could not allocate %" G_GSSIZE_FORMAT " bytes of system memory", size);
+		return FALSE;
+	}
+
+	/* phys_addr stays 0, since this is not physically contiguous memory;
+	 * see the explanation in allocator.h */
+	memory->phys_addr = 0;
+	memory->internal = block;
+	/* system memory is always cached; no device accesses it */
+	memory->cache_policy = GST_IMX_PHYS_MEM_CACHE_POLICY_CACHED;
+
+	GST_DEBUG_OBJECT(allocator, "allocated %" G_GSSIZE_FORMAT " bytes of system memory at %p", size, block);
+
+	return TRUE;
+}
+
+
+static gboolean gst_imx_sw_free_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory)
+{
+	g_assert(memory->internal != NULL);
+
+	GST_DEBUG_OBJECT(allocator, "freeing %" G_GSIZE_FORMAT " bytes of system memory at %p", memory->mem.maxsize, memory->internal);
+
+	free(memory->internal);
+	memory->internal = NULL;
+
+	return TRUE;
+}
+
+
+static gpointer gst_imx_sw_map_phys_mem(G_GNUC_UNUSED GstImxPhysMemAllocator *allocator, GstImxPhysMemory *phys_mem, G_GNUC_UNUSED gssize size, G_GNUC_UNUSED GstMapFlags flags)
+{
+	/* System memory is always accessible; no actual mapping is necessary */
+	phys_mem->mapped_virt_addr = phys_mem->internal;
+	return phys_mem->mapped_virt_addr;
+}
+
+
+static void gst_imx_sw_unmap_phys_mem(G_GNUC_UNUSED GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory)
+{
+	memory->mapped_virt_addr = NULL;
+}
+
+
+
+
+static void gst_imx_sw_allocator_class_init(GstImxSwAllocatorClass *klass)
+{
+	GstImxPhysMemAllocatorClass *parent_class = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(klass);
+
+	parent_class->alloc_phys_mem = GST_DEBUG_FUNCPTR(gst_imx_sw_alloc_phys_mem);
+	parent_class->free_phys_mem  = GST_DEBUG_FUNCPTR(gst_imx_sw_free_phys_mem);
+	parent_class->map_phys_mem   = GST_DEBUG_FUNCPTR(gst_imx_sw_map_phys_mem);
+	parent_class->unmap_phys_mem = GST_DEBUG_FUNCPTR(gst_imx_sw_unmap_phys_mem);
+	parent_class->system_memory  = TRUE;
+
+	GST_DEBUG_CATEGORY_INIT(imx_sw_allocator_debug, "imxswallocator", 0, "Freescale i.MX software blitter system memory allocator");
+}
+
+
+static void gst_imx_sw_allocator_init(GstImxSwAllocator *allocator)
+{
+	GstAllocator *base = GST_ALLOCATOR(allocator);
+	base->mem_type = GST_IMX_SW_ALLOCATOR_MEM_TYPE;
+}
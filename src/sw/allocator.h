@@ -0,0 +1,68 @@
+/* Software blitter allocation functions for system memory
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#ifndef GST_IMX_SW_ALLOCATOR_H
+#define GST_IMX_SW_ALLOCATOR_H
+
+#include <gst/gst.h>
+#include "../common/phys_mem_allocator.h"
+
+
+G_BEGIN_DECLS
+
+
+typedef struct _GstImxSwAllocator GstImxSwAllocator;
+typedef struct _GstImxSwAllocatorClass GstImxSwAllocatorClass;
+
+
+#define GST_TYPE_IMX_SW_ALLOCATOR             (gst_imx_sw_allocator_get_type())
+#define GST_IMX_SW_ALLOCATOR(obj)             (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_IMX_SW_ALLOCATOR, GstImxSwAllocator))
+#define GST_IMX_SW_ALLOCATOR_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_IMX_SW_ALLOCATOR, GstImxSwAllocatorClass))
+#define GST_IS_IMX_SW_ALLOCATOR(obj)          (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_IMX_SW_ALLOCATOR))
+#define GST_IS_IMX_SW_ALLOCATOR_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_IMX_SW_ALLOCATOR))
+
+#define GST_IMX_SW_ALLOCATOR_MEM_TYPE "ImxSwMemory"
+
+
+/* The software blitter does not need physically contiguous memory, but the
+ * blitter base classes expect their allocators to be physical memory allocators.
+ * This allocator therefore hands out plain system memory blocks, wrapped as
+ * GstImxPhysMemory instances. Their phys_addr values are always 0, so elements
+ * which require physically contiguous memory never mistake these blocks for
+ * DMA memory, and copy their contents instead. */
+struct _GstImxSwAllocator
+{
+	GstImxPhysMemAllocator parent;
+};
+
+
+struct _GstImxSwAllocatorClass
+{
+	GstImxPhysMemAllocatorClass parent_class;
+};
+
+
+GType gst_imx_sw_allocator_get_type(void);
+GstAllocator* gst_imx_sw_allocator_new(void);
+
+
+G_END_DECLS
+
+
+#endif
@@ -0,0 +1,883 @@
+/* Software (CPU) based i.MX blitter class
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include <string.h>
+#include "blitter.h"
+#include "allocator.h"
+
+
+
+GST_DEBUG_CATEGORY_STATIC(imx_sw_blitter_debug);
+#define GST_CAT_DEFAULT imx_sw_blitter_debug
+
+
+G_DEFINE_TYPE(GstImxSwBlitter, gst_imx_sw_blitter, GST_TYPE_IMX_BASE_BLITTER)
+
+
+/* Row kernels process GST_IMX_SW_BLITTER_VEC_PIXELS pixels at once with GCC
+ * vector extensions, which the compiler maps to NEON or SSE instructions
+ * if these are enabled. Each pixel is split into two 32-bit words with two
+ * 8-bit channels each, so the products of the interpolation fit in 16 bits. */
+#if defined(__GNUC__)
+#define GST_IMX_SW_BLITTER_USE_VECTORS
+#define GST_IMX_SW_BLITTER_VEC_PIXELS 4
+typedef guint32 GstImxSwBlitterVec __attribute__((vector_size(4 * sizeof(guint32))));
+#endif
+
+
+/* Bilinear sampling position of an output column or row: the two
+ * neighbouring input columns/rows, and the weight of the second one
+ * (0-255, in 1/256 units) */
+typedef struct
+{
+	gint src0, src1;
+	guint weight;
+}
+GstImxSwBlitterSample;
+
+
+/* Private structure storing software blitter specific data */
+struct _GstImxSwBlitterPrivate
+{
+	/* Currently set input and output frames; not ref'd
+	 * (see the set_input_frame documentation in base_blitter.h) */
+	GstBuffer *input_frame, *output_frame;
+	GstImxBaseBlitterRegion video_region, output_region;
+
+	/* Worker thread for asynchronous blits; created by the
+	 * first submit_blit call. mutex and cond are used for
+	 * signaling finished jobs. Jobs which were submitted but
+	 * not waited for yet are kept in pending_jobs (protected
+	 * by mutex), so they can be freed when finalizing. */
+	GThreadPool *thread_pool;
+	GMutex mutex;
+	GCond cond;
+	GQueue pending_jobs;
+
+	/* Scratch buffers for unpacked (and rotated) pixels, the vertically
+	 * interpolated row, and the bilinear sampling positions. They are kept
+	 * around to avoid reallocating them for every frame. scratch_mutex is
+	 * held while a frame is processed, since both the worker thread and
+	 * synchronous blits use them. */
+	GMutex scratch_mutex;
+	guint32 *input_pixels, *rotated_pixels, *blended_row, *line_pixels;
+	gsize input_pixels_size, rotated_pixels_size, blended_row_size, line_pixels_size;
+	GstImxSwBlitterSample *column_samples, *row_samples;
+	gsize column_samples_size, row_samples_size;
+};
+
+
+/* All state needed for processing one frame. The frames are mapped
+ * when the job is created, and unmapped when it is destroyed, which
+ * happens in wait_blit in the asynchronous case. */
+typedef struct
+{
+	GstVideoFrame input_frame, output_frame;
+	GstImxBaseBlitterRegion input_region, video_region, output_region;
+	GstImxSwBlitterRotationMode rotation_mode;
+
+	/* Protected by the private mutex */
+	gboolean done, result;
+}
+GstImxSwBlitterJob;
+
+
+static void gst_imx_sw_blitter_finalize(GObject *object);
+
+static gboolean gst_imx_sw_blitter_set_input_video_info(GstImxBaseBlitter *base_blitter, GstVideoInfo *input_video_info);
+static gboolean gst_imx_sw_blitter_set_input_frame(GstImxBaseBlitter *base_blitter, GstBuffer *input_frame);
+static gboolean gst_imx_sw_blitter_set_output_frame(GstImxBaseBlitter *base_blitter, GstBuffer *output_frame);
+static gboolean gst_imx_sw_blitter_set_output_regions(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *video_region, GstImxBaseBlitterRegion const *output_region);
+static GstAllocator* gst_imx_sw_blitter_get_phys_mem_allocator(GstImxBaseBlitter *base_blitter);
+static gboolean gst_imx_sw_blitter_blit_frame(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *input_region);
+static gboolean gst_imx_sw_blitter_flush(GstImxBaseBlitter *base_blitter);
+static gboolean gst_imx_sw_blitter_submit_blit(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *input_region, gpointer *handle);
+static gboolean gst_imx_sw_blitter_wait_blit(GstImxBaseBlitter *base_blitter, gpointer handle);
+
+static gboolean gst_imx_sw_blitter_is_format_supported(GstVideoFormat format);
+static GstImxSwBlitterJob* gst_imx_sw_blitter_create_job(GstImxSwBlitter *sw_blitter, GstImxBaseBlitterRegion const *input_region);
+static void gst_imx_sw_blitter_destroy_job(GstImxSwBlitterJob *job);
+static void gst_imx_sw_blitter_worker_func(gpointer data, gpointer user_data);
+static gboolean gst_imx_sw_blitter_process_job(GstImxSwBlitter *sw_blitter, GstImxSwBlitterJob *job);
+static gpointer gst_imx_sw_blitter_ensure_scratch_buffer(gpointer buffer, gsize *current_size, gsize needed_size);
+static void gst_imx_sw_blitter_calc_samples(GstImxSwBlitterSample *samples, gint num_dest, gint num_src, gboolean flip);
+static void gst_imx_sw_blitter_transpose_pixels(guint32 *dest, guint32 const *src, gint src_width, gint src_height);
+static inline guint32 gst_imx_sw_blitter_interpolate_pixel(guint32 pixel0, guint32 pixel1, guint weight);
+static void gst_imx_sw_blitter_interpolate_rows(guint32 *dest, guint32 const *row0, guint32 const *row1, guint weight, gint num_pixels);
+static void gst_imx_sw_blitter_convert_pixels(guint8 *pixels, gsize num_pixels, gboolean to_rgb);
+
+
+
+
+GType gst_imx_sw_blitter_rotation_mode_get_type(void)
+{
+	static GType gst_imx_sw_blitter_rotation_mode_type = 0;
+
+	if (!gst_imx_sw_blitter_rotation_mode_type)
+	{
+		static GEnumValue rotation_mode_values[] =
+		{
+			{ GST_IMX_SW_BLITTER_ROTATION_NONE, "No rotation", "none" },
+			{ GST_IMX_SW_BLITTER_ROTATION_HFLIP, "Flip horizontally", "horizontal-flip" },
+			{ GST_IMX_SW_BLITTER_ROTATION_VFLIP, "Flip vertically", "vertical-flip" },
+			{ GST_IMX_SW_BLITTER_ROTATION_90, "Rotate clockwise 90 degrees", "rotate-90" },
+			{ GST_IMX_SW_BLITTER_ROTATION_180, "Rotate 180 degrees", "rotate-180" },
+			{ GST_IMX_SW_BLITTER_ROTATION_270, "Rotate clockwise 270 degrees", "rotate-270" },
+			{ 0, NULL, NULL },
+		};
+
+		gst_imx_sw_blitter_rotation_mode_type = g_enum_register_static(
+			"ImxSwBlitterRotationMode",
+			rotation_mode_values
+		);
+	}
+
+	return gst_imx_sw_blitter_rotation_mode_type;
+}
+
+
+
+
+void gst_imx_sw_blitter_class_init(GstImxSwBlitterClass *klass)
+{
+	GObjectClass *object_class;
+	GstImxBaseBlitterClass *base_class;
+
+	object_class = G_OBJECT_CLASS(klass);
+	base_class = GST_IMX_BASE_BLITTER_CLASS(klass);
+
+	object_class->finalize             = GST_DEBUG_FUNCPTR(gst_imx_sw_blitter_finalize);
+	base_class->set_input_video_info   = GST_DEBUG_FUNCPTR(gst_imx_sw_blitter_set_input_video_info);
+	base_class->set_input_frame        = GST_DEBUG_FUNCPTR(gst_imx_sw_blitter_set_input_frame);
+	base_class->set_output_frame       = GST_DEBUG_FUNCPTR(gst_imx_sw_blitter_set_output_frame);
+	base_class->set_output_regions     = GST_DEBUG_FUNCPTR(gst_imx_sw_blitter_set_output_regions);
+	base_class->get_phys_mem_allocator = GST_DEBUG_FUNCPTR(gst_imx_sw_blitter_get_phys_mem_allocator);
+	base_class->blit_frame             = GST_DEBUG_FUNCPTR(gst_imx_sw_blitter_blit_frame);
+	base_class->flush                  = GST_DEBUG_FUNCPTR(gst_imx_sw_blitter_flush);
+	base_class->submit_blit            = GST_DEBUG_FUNCPTR(gst_imx_sw_blitter_submit_blit);
+	base_class->wait_blit              = GST_DEBUG_FUNCPTR(gst_imx_sw_blitter_wait_blit);
+
+	/* Frames are read with the CPU, so there is no need for
+	 * copying frames into physically contiguous memory */
+	base_class->accepts_system_memory = TRUE;
+	/* The CPU can handle any stride */
+	base_class->horiz_alignment = 1;
+	base_class->vert_alignment = 1;
+
+	GST_DEBUG_CATEGORY_INIT(imx_sw_blitter_debug, "imxswblitter", 0, "Freescale i.MX software blitter class");
+}
+
+
+void gst_imx_sw_blitter_init(GstImxSwBlitter *sw_blitter)
+{
+	GstImxSwBlitterPrivate *priv;
+
+	priv = sw_blitter->priv = g_slice_alloc0(sizeof(GstImxSwBlitterPrivate));
+
+	g_mutex_init(&(priv->mutex));
+	g_cond_init(&(priv->cond));
+	g_queue_init(&(priv->pending_jobs));
+	g_mutex_init(&(priv->scratch_mutex));
+
+	sw_blitter->num_blitted_frames = 0;
+	sw_blitter->total_blit_duration = 0;
+	sw_blitter->max_blit_duration = 0;
+
+	gst_imx_sw_blitter_set_output_rotation(sw_blitter, GST_IMX_SW_BLITTER_OUTPUT_ROTATION_DEFAULT);
+}
+
+
+GstImxSwBlitter* gst_imx_sw_blitter_new(void)
+{
+	GstImxSwBlitter* sw_blitter = (GstImxSwBlitter *)g_object_new(gst_imx_sw_blitter_get_type(), NULL);
+
+	return sw_blitter;
+}
+
+
+GstImxSwBlitterRotationMode gst_imx_sw_blitter_get_output_rotation(GstImxSwBlitter *sw_blitter)
+{
+	return sw_blitter->rotation_mode;
+}
+
+
+void gst_imx_sw_blitter_set_output_rotation(GstImxSwBlitter *sw_blitter, GstImxSwBlitterRotationMode rotation)
+{
+	sw_blitter->rotation_mode = rotation;
+}
+
+
+static void gst_imx_sw_blitter_finalize(GObject *object)
+{
+	GstImxSwBlitter *sw_blitter = GST_IMX_SW_BLITTER(object);
+	GstImxSwBlitterPrivate *priv;
+
+	g_assert(sw_blitter != NULL);
+	priv = sw_blitter->priv;
+
+	/* Let the worker finish any jobs that are still queued */
+	if (priv->thread_pool != NULL)
+		g_thread_pool_free(priv->thread_pool, FALSE, TRUE);
+
+	/* Jobs whose blits were never waited for are finished now;
+	 * unmap their frames and free them */
+	if (!g_queue_is_empty(&(priv->pending_jobs)))
+	{
+		GST_DEBUG_OBJECT(sw_blitter, "freeing %u job(s) that were not waited for", g_queue_get_length(&(priv->pending_jobs)));
+		while (!g_queue_is_empty(&(priv->pending_jobs)))
+			gst_imx_sw_blitter_destroy_job((GstImxSwBlitterJob *)g_queue_pop_head(&(priv->pending_jobs)));
+	}
+
+	gst_imx_sw_blitter_flush(GST_IMX_BASE_BLITTER(sw_blitter));
+
+	g_mutex_clear(&(priv->mutex));
+	g_cond_clear(&(priv->cond));
+	g_mutex_clear(&(priv->scratch_mutex));
+
+	if (sw_blitter->num_blitted_frames > 0)
+	{
+		GST_DEBUG_OBJECT(
+			sw_blitter,
+			"blitted %" G_GUINT64_FORMAT " frames  average blit duration: %" G_GINT64_FORMAT " us  max blit duration: %" G_GINT64_FORMAT " us",
+			sw_blitter->num_blitted_frames,
+			sw_blitter->total_blit_duration / (gint64)(sw_blitter->num_blitted_frames),
+			sw_blitter->max_blit_duration
+		);
+	}
+
+	g_slice_free1(sizeof(GstImxSwBlitterPrivate), priv);
+
+	G_OBJECT_CLASS(gst_imx_sw_blitter_parent_class)->finalize(object);
+}
+
+
+static gboolean gst_imx_sw_blitter_set_input_video_info(GstImxBaseBlitter *base_blitter, GstVideoInfo *input_video_info)
+{
+	if (!gst_imx_sw_blitter_is_format_supported(GST_VIDEO_INFO_FORMAT(input_video_info)))
+	{
+		GST_ERROR_OBJECT(base_blitter, "unsupported input format %s", gst_video_format_to_string(GST_VIDEO_INFO_FORMAT(input_video_info)));
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+static gboolean gst_imx_sw_blitter_set_input_frame(GstImxBaseBlitter *base_blitter, GstBuffer *input_frame)
+{
+	GstImxSwBlitter *sw_blitter = GST_IMX_SW_BLITTER(base_blitter);
+
+	g_assert(sw_blitter != NULL);
+
+	sw_blitter->priv->input_frame = input_frame;
+
+	return TRUE;
+}
+
+
+static gboolean gst_imx_sw_blitter_set_output_frame(GstImxBaseBlitter *base_blitter, GstBuffer *output_frame)
+{
+	GstImxSwBlitter *sw_blitter = GST_IMX_SW_BLITTER(base_blitter);
+	GstVideoMeta *video_meta;
+
+	g_assert(sw_blitter != NULL);
+
+	video_meta = gst_buffer_get_video_meta(output_frame);
+	g_assert(video_meta != NULL);
+
+	if (!gst_imx_sw_blitter_is_format_supported(video_meta->format))
+	{
+		GST_ERROR_OBJECT(sw_blitter, "unsupported output format %s", gst_video_format_to_string(video_meta->format));
+		return FALSE;
+	}
+
+	sw_blitter->priv->output_frame = output_frame;
+
+	/* Until set_output_regions is called, the entire frame is the output & video region */
+	sw_blitter->priv->output_region.x1 = 0;
+	sw_blitter->priv->output_region.y1 = 0;
+	sw_blitter->priv->output_region.x2 = video_meta->width;
+	sw_blitter->priv->output_region.y2 = video_meta->height;
+	sw_blitter->priv->video_region = sw_blitter->priv->output_region;
+
+	return TRUE;
+}
+
+
+static gboolean gst_imx_sw_blitter_set_output_regions(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *video_region, GstImxBaseBlitterRegion const *output_region)
+{
+	GstImxSwBlitter *sw_blitter = GST_IMX_SW_BLITTER(base_blitter);
+
+	sw_blitter->priv->video_region = *video_region;
+	sw_blitter->priv->output_region = *output_region;
+
+	return TRUE;
+}
+
+
+static GstAllocator* gst_imx_sw_blitter_get_phys_mem_allocator(G_GNUC_UNUSED GstImxBaseBlitter *base_blitter)
+{
+	return gst_imx_sw_allocator_new();
+}
+
+
+static gboolean gst_imx_sw_blitter_blit_frame(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *input_region)
+{
+	gboolean ret;
+	GstImxSwBlitter *sw_blitter = GST_IMX_SW_BLITTER(base_blitter);
+	GstImxSwBlitterJob *job;
+
+	job = gst_imx_sw_blitter_create_job(sw_blitter, input_region);
+	if (job == NULL)
+		return FALSE;
+
+	ret = gst_imx_sw_blitter_process_job(sw_blitter, job);
+
+	gst_imx_sw_blitter_destroy_job(job);
+
+	return ret;
+}
+
+
+static gboolean gst_imx_sw_blitter_flush(GstImxBaseBlitter *base_blitter)
+{
+	GstImxSwBlitterPrivate *priv = GST_IMX_SW_BLITTER(base_blitter)->priv;
+
+	/* Release the scratch buffers; they are reallocated on demand
+	 * (the frame size may be different after the flush) */
+	g_mutex_lock(&(priv->scratch_mutex));
+
+	g_free(priv->input_pixels);
+	g_free(priv->rotated_pixels);
+	g_free(priv->blended_row);
+	g_free(priv->line_pixels);
+	g_free(priv->column_samples);
+	g_free(priv->row_samples);
+	priv->input_pixels = NULL;
+	priv->rotated_pixels = NULL;
+	priv->blended_row = NULL;
+	priv->line_pixels = NULL;
+	priv->column_samples = NULL;
+	priv->row_samples = NULL;
+	priv->input_pixels_size = priv->rotated_pixels_size = priv->blended_row_size = priv->line_pixels_size = 0;
+	priv->column_samples_size = priv->row_samples_size = 0;
+
+	g_mutex_unlock(&(priv->scratch_mutex));
+
+	return TRUE;
+}
+
+
+static gboolean gst_imx_sw_blitter_submit_blit(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *input_region, gpointer *handle)
+{
+	GstImxSwBlitter *sw_blitter = GST_IMX_SW_BLITTER(base_blitter);
+	GstImxSwBlitterPrivate *priv = sw_blitter->priv;
+	GstImxSwBlitterJob *job;
+	GError *error = NULL;
+
+	if (priv->thread_pool == NULL)
+	{
+		/* A single worker thread is used, since jobs must be finished in
+		 * the order they were submitted, and since the thread pool queue
+		 * is processed in FIFO order, this guarantees that */
+		priv->thread_pool = g_thread_pool_new(gst_imx_sw_blitter_worker_func, sw_blitter, 1, FALSE, &error);
+		if (priv->thread_pool == NULL)
+		{
+			GST_ERROR_OBJECT(sw_blitter, "could not create worker thread: %s", error->message);
+			g_error_free(error);
+			return FALSE;
+		}
+	}
+
+	job = gst_imx_sw_blitter_create_job(sw_blitter, input_region);
+	if (job == NULL)
+		return FALSE;
+
+	g_mutex_lock(&(priv->mutex));
+	g_queue_push_tail(&(priv->pending_jobs), job);
+	g_mutex_unlock(&(priv->mutex));
+
+	if (!g_thread_pool_push(priv->thread_pool, job, &error))
+	{
+		GST_ERROR_OBJECT(sw_blitter, "could not pass job to worker thread: %s", error->message);
+		g_error_free(error);
+		g_mutex_lock(&(priv->mutex));
+		g_queue_remove(&(priv->pending_jobs), job);
+		g_mutex_unlock(&(priv->mutex));
+		gst_imx_sw_blitter_destroy_job(job);
+		return FALSE;
+	}
+
+	*handle = job;
+
+	return TRUE;
+}
+
+
+static gboolean gst_imx_sw_blitter_wait_blit(GstImxBaseBlitter *base_blitter, gpointer handle)
+{
+	gboolean ret;
+	GstImxSwBlitterPrivate *priv = GST_IMX_SW_BLITTER(base_blitter)->priv;
+	GstImxSwBlitterJob *job = (GstImxSwBlitterJob *)handle;
+
+	g_assert(job != NULL);
+
+	g_mutex_lock(&(priv->mutex));
+	while (!(job->done))
+		g_cond_wait(&(priv->cond), &(priv->mutex));
+	ret = job->result;
+	g_queue_remove(&(priv->pending_jobs), job);
+	g_mutex_unlock(&(priv->mutex));
+
+	gst_imx_sw_blitter_destroy_job(job);
+
+	return ret;
+}
+
+
+static gboolean gst_imx_sw_blitter_is_format_supported(GstVideoFormat format)
+{
+	GstVideoFormatInfo const *finfo = gst_video_format_get_info(format);
+
+	/* Pixels are processed in their unpacked form, which must
+	 * be one of the two 8-bit-per-channel unpack formats */
+	return
+		(finfo != NULL) &&
+		(finfo->unpack_func != NULL) &&
+		(finfo->pack_func != NULL) &&
+		((finfo->unpack_format == GST_VIDEO_FORMAT_AYUV) || (finfo->unpack_format == GST_VIDEO_FORMAT_ARGB))
+		;
+}
+
+
+static GstImxSwBlitterJob* gst_imx_sw_blitter_create_job(GstImxSwBlitter *sw_blitter, GstImxBaseBlitterRegion const *input_region)
+{
+	GstImxSwBlitterPrivate *priv = sw_blitter->priv;
+	GstImxBaseBlitter *base_blitter = GST_IMX_BASE_BLITTER(sw_blitter);
+	GstImxSwBlitterJob *job;
+	GstVideoMeta *video_meta;
+	GstVideoInfo output_video_info;
+
+	g_assert(priv->input_frame != NULL);
+	g_assert(priv->output_frame != NULL);
+
+	job = g_slice_alloc0(sizeof(GstImxSwBlitterJob));
+
+	if (!gst_video_frame_map(&(job->input_frame), &(base_blitter->input_video_info), priv->input_frame, GST_MAP_READ))
+	{
+		GST_ERROR_OBJECT(sw_blitter, "could not map input frame");
+		g_slice_free1(sizeof(GstImxSwBlitterJob), job);
+		return NULL;
+	}
+
+	/* The output frame's video meta defines its format and size */
+	video_meta = gst_buffer_get_video_meta(priv->output_frame);
+	gst_video_info_init(&output_video_info);
+	gst_video_info_set_format(&output_video_info, video_meta->format, video_meta->width, video_meta->height);
+
+	if (!gst_video_frame_map(&(job->output_frame), &output_video_info, priv->output_frame, GST_MAP_WRITE))
+	{
+		GST_ERROR_OBJECT(sw_blitter, "could not map output frame");
+		gst_video_frame_unmap(&(job->input_frame));
+		g_slice_free1(sizeof(GstImxSwBlitterJob), job);
+		return NULL;
+	}
+
+	job->input_region = *input_region;
+	job->video_region = priv->video_region;
+	job->output_region = priv->output_region;
+	job->rotation_mode = sw_blitter->rotation_mode;
+	job->done = FALSE;
+	job->result = FALSE;
+
+	return job;
+}
+
+
+static void gst_imx_sw_blitter_destroy_job(GstImxSwBlitterJob *job)
+{
+	gst_video_frame_unmap(&(job->output_frame));
+	gst_video_frame_unmap(&(job->input_frame));
+	g_slice_free1(sizeof(GstImxSwBlitterJob), job);
+}
+
+
+static void gst_imx_sw_blitter_worker_func(gpointer data, gpointer user_data)
+{
+	gboolean ret;
+	GstImxSwBlitterJob *job = (GstImxSwBlitterJob *)data;
+	GstImxSwBlitter *sw_blitter = GST_IMX_SW_BLITTER(user_data);
+
+	ret = gst_imx_sw_blitter_process_job(sw_blitter, job);
+
+	g_mutex_lock(&(sw_blitter->priv->mutex));
+	job->result = ret;
+	job->done = TRUE;
+	g_cond_broadcast(&(sw_blitter->priv->cond));
+	g_mutex_unlock(&(sw_blitter->priv->mutex));
+}
+
+
+static gboolean gst_imx_sw_blitter_process_job(GstImxSwBlitter *sw_blitter, GstImxSwBlitterJob *job)
+{
+	GstImxSwBlitterPrivate *priv = sw_blitter->priv;
+	GstVideoFormatInfo const *in_finfo = job->input_frame.info.finfo;
+	GstVideoFormatInfo const *out_finfo = job->output_frame.info.finfo;
+	gboolean output_is_rgb = (out_finfo->unpack_format == GST_VIDEO_FORMAT_ARGB);
+	gboolean transposed, flip_columns, flip_rows;
+	gint in_x, in_y, in_width, in_height;
+	guint32 const *src_pixels;
+	gint src_width, src_height;
+	gint vid_x1, vid_y1, vid_x2, vid_y2;
+	gint out_x1, out_y1, out_x2, out_y2;
+	gint frame_width, frame_height, pack_lines;
+	gint x, y, line;
+	gboolean full_lines;
+	guint32 black_pixel;
+	gint64 start_time, duration;
+
+	start_time = g_get_monotonic_time();
+
+	in_x = job->input_region.x1;
+	in_y = job->input_region.y1;
+	in_width = job->input_region.x2 - job->input_region.x1;
+	in_height = job->input_region.y2 - job->input_region.y1;
+
+	frame_width = GST_VIDEO_FRAME_WIDTH(&(job->output_frame));
+	frame_height = GST_VIDEO_FRAME_HEIGHT(&(job->output_frame));
+
+	/* Clip the regions against the output frame, just to be safe */
+	out_x1 = CLAMP(job->output_region.x1, 0, frame_width);
+	out_y1 = CLAMP(job->output_region.y1, 0, frame_height);
+	out_x2 = CLAMP(job->output_region.x2, out_x1, frame_width);
+	out_y2 = CLAMP(job->output_region.y2, out_y1, frame_height);
+	vid_x1 = CLAMP(job->video_region.x1, out_x1, out_x2);
+	vid_y1 = CLAMP(job->video_region.y1, out_y1, out_y2);
+	vid_x2 = CLAMP(job->video_region.x2, vid_x1, out_x2);
+	vid_y2 = CLAMP(job->video_region.y2, vid_y1, out_y2);
+
+	if ((in_width <= 0) || (in_height <= 0))
+	{
+		/* Nothing to sample from; only paint the output region black */
+		vid_x2 = vid_x1;
+		vid_y2 = vid_y1;
+	}
+
+	/* The bilinear samples assign two neighbouring input columns or rows to
+	 * each output column and row. With 90/270 degree rotations, the unpacked
+	 * input is transposed first, so output columns map to input rows and vice
+	 * versa; flips are handled by mirroring the samples. */
+	transposed = (job->rotation_mode == GST_IMX_SW_BLITTER_ROTATION_90) || (job->rotation_mode == GST_IMX_SW_BLITTER_ROTATION_270);
+	flip_columns = (job->rotation_mode == GST_IMX_SW_BLITTER_ROTATION_HFLIP) || (job->rotation_mode == GST_IMX_SW_BLITTER_ROTATION_180) || (job->rotation_mode == GST_IMX_SW_BLITTER_ROTATION_90);
+	flip_rows = (job->rotation_mode == GST_IMX_SW_BLITTER_ROTATION_VFLIP) || (job->rotation_mode == GST_IMX_SW_BLITTER_ROTATION_180) || (job->rotation_mode == GST_IMX_SW_BLITTER_ROTATION_270);
+
+	pack_lines = MAX(out_finfo->pack_lines, 1);
+
+	/* If the output region spans entire lines, all of their pixels get
+	 * overwritten, and the existing line contents do not have to be unpacked */
+	full_lines = (out_x1 == 0) && (out_x2 == frame_width);
+
+	if (output_is_rgb)
+		black_pixel = GUINT32_FROM_BE(0xFF000000);
+	else
+		black_pixel = GUINT32_FROM_BE(0xFF108080);
+
+	g_mutex_lock(&(priv->scratch_mutex));
+
+	priv->input_pixels = gst_imx_sw_blitter_ensure_scratch_buffer(priv->input_pixels, &(priv->input_pixels_size), sizeof(guint32) * MAX(in_width, 1) * MAX(in_height, 1));
+	if (transposed)
+		priv->rotated_pixels = gst_imx_sw_blitter_ensure_scratch_buffer(priv->rotated_pixels, &(priv->rotated_pixels_size), sizeof(guint32) * MAX(in_width, 1) * MAX(in_height, 1));
+	priv->blended_row = gst_imx_sw_blitter_ensure_scratch_buffer(priv->blended_row, &(priv->blended_row_size), sizeof(guint32) * MAX(MAX(in_width, in_height), 1));
+	priv->line_pixels = gst_imx_sw_blitter_ensure_scratch_buffer(priv->line_pixels, &(priv->line_pixels_size), sizeof(guint32) * frame_width * pack_lines);
+	priv->column_samples = gst_imx_sw_blitter_ensure_scratch_buffer(priv->column_samples, &(priv->column_samples_size), sizeof(GstImxSwBlitterSample) * MAX(vid_x2 - vid_x1, 1));
+	priv->row_samples = gst_imx_sw_blitter_ensure_scratch_buffer(priv->row_samples, &(priv->row_samples_size), sizeof(GstImxSwBlitterSample) * MAX(vid_y2 - vid_y1, 1));
+
+	src_pixels = priv->input_pixels;
+	src_width = transposed ? in_height : in_width;
+	src_height = transposed ? in_width : in_height;
+
+	if ((vid_x2 > vid_x1) && (vid_y2 > vid_y1))
+	{
+		/* Unpack the input region, and convert it to the output's unpack format */
+		for (y = 0; y < in_height; ++y)
+		{
+			in_finfo->unpack_func(
+				in_finfo, GST_VIDEO_PACK_FLAG_NONE,
+				priv->input_pixels + y * in_width,
+				job->input_frame.data, job->input_frame.info.stride,
+				in_x, in_y + y, in_width
+			);
+		}
+
+		if (in_finfo->unpack_format != out_finfo->unpack_format)
+			gst_imx_sw_blitter_convert_pixels((guint8 *)(priv->input_pixels), (gsize)in_width * in_height, output_is_rgb);
+
+		if (transposed)
+		{
+			gst_imx_sw_blitter_transpose_pixels(priv->rotated_pixels, priv->input_pixels, in_width, in_height);
+			src_pixels = priv->rotated_pixels;
+		}
+
+		gst_imx_sw_blitter_calc_samples(priv->column_samples, vid_x2 - vid_x1, src_width, flip_columns);
+		gst_imx_sw_blitter_calc_samples(priv->row_samples, vid_y2 - vid_y1, src_height, flip_rows);
+	}
+
+	/* Produce the output lines, in groups of pack_lines lines, since
+	 * that is the granularity of the pack function */
+	for (y = out_y1 - (out_y1 % pack_lines); y < out_y2; y += pack_lines)
+	{
+		for (line = 0; line < pack_lines; ++line)
+		{
+			gint out_y = y + line;
+			guint32 *dest = priv->line_pixels + line * frame_width;
+
+			if (out_y >= frame_height)
+				break;
+
+			/* Lines of the first and last group which lie outside of the
+			 * output region are packed again, so they must keep their contents */
+			if (!full_lines || (out_y < out_y1) || (out_y >= out_y2))
+			{
+				out_finfo->unpack_func(
+					out_finfo, GST_VIDEO_PACK_FLAG_NONE,
+					dest,
+					job->output_frame.data, job->output_frame.info.stride,
+					0, out_y, frame_width
+				);
+			}
+
+			if ((out_y < out_y1) || (out_y >= out_y2))
+				continue;
+
+			if ((out_y >= vid_y1) && (out_y < vid_y2))
+			{
+				GstImxSwBlitterSample const *row_sample = &(priv->row_samples[out_y - vid_y1]);
+				guint32 const *src = src_pixels + row_sample->src0 * src_width;
+
+				for (x = out_x1; x < vid_x1; ++x)
+					dest[x] = black_pixel;
+
+				/* Interpolate vertically between the two input rows, then
+				 * horizontally between the two input columns */
+				if (row_sample->weight != 0)
+				{
+					gst_imx_sw_blitter_interpolate_rows(priv->blended_row, src, src_pixels + row_sample->src1 * src_width, row_sample->weight, src_width);
+					src = priv->blended_row;
+				}
+
+				for (x = vid_x1; x < vid_x2; ++x)
+				{
+					GstImxSwBlitterSample const *column_sample = &(priv->column_samples[x - vid_x1]);
+					dest[x] = gst_imx_sw_blitter_interpolate_pixel(src[column_sample->src0], src[column_sample->src1], column_sample->weight);
+				}
+
+				for (x = vid_x2; x < out_x2; ++x)
+					dest[x] = black_pixel;
+			}
+			else
+			{
+				for (x = out_x1; x < out_x2; ++x)
+					dest[x] = black_pixel;
+			}
+		}
+
+		out_finfo->pack_func(
+			out_finfo, GST_VIDEO_PACK_FLAG_NONE,
+			priv->line_pixels, sizeof(guint32) * frame_width,
+			job->output_frame.data, job->output_frame.info.stride,
+			job->output_frame.info.chroma_site,
+			y, frame_width
+		);
+	}
+
+	g_mutex_unlock(&(priv->scratch_mutex));
+
+	duration = g_get_monotonic_time() - start_time;
+
+	g_mutex_lock(&(priv->mutex));
+	sw_blitter->num_blitted_frames++;
+	sw_blitter->total_blit_duration += duration;
+	sw_blitter->max_blit_duration = MAX(sw_blitter->max_blit_duration, duration);
+	g_mutex_unlock(&(priv->mutex));
+
+	GST_LOG_OBJECT(sw_blitter, "blit took %" G_GINT64_FORMAT " us", duration);
+
+	return TRUE;
+}
+
+
+static gpointer gst_imx_sw_blitter_ensure_scratch_buffer(gpointer buffer, gsize *current_size, gsize needed_size)
+{
+	if (needed_size <= *current_size)
+		return buffer;
+
+	/* The old contents are not needed, so there is no point in using g_realloc() */
+	g_free(buffer);
+	*current_size = needed_size;
+	return g_malloc(needed_size);
+}
+
+
+static void gst_imx_sw_blitter_calc_samples(GstImxSwBlitterSample *samples, gint num_dest, gint num_src, gboolean flip)
+{
+	gint i;
+
+	/* The center of each destination pixel is mapped to a position in the
+	 * source, in 1/256 pixel units; the pixels left and right of (or above
+	 * and below) this position are interpolated */
+	for (i = 0; i < num_dest; ++i)
+	{
+		gint64 pos = (((gint64)(2 * i + 1) * num_src * 256) / (2 * (gint64)num_dest)) - 128;
+		gint src0, src1;
+		guint weight;
+
+		pos = MAX(pos, 0);
+		src0 = (gint)(pos >> 8);
+		weight = (guint)(pos & 255);
+
+		if (src0 >= (num_src - 1))
+		{
+			src0 = src1 = num_src - 1;
+			weight = 0;
+		}
+		else
+			src1 = src0 + 1;
+
+		if (flip)
+		{
+			src0 = num_src - 1 - src0;
+			src1 = num_src - 1 - src1;
+		}
+
+		samples[i].src0 = src0;
+		samples[i].src1 = src1;
+		samples[i].weight = weight;
+	}
+}
+
+
+static void gst_imx_sw_blitter_transpose_pixels(guint32 *dest, guint32 const *src, gint src_width, gint src_height)
+{
+	gint x, y, bx, by;
+
+	/* Transposing is done in blocks to keep both the reads
+	 * and the writes within a few cache lines */
+	for (by = 0; by < src_height; by += 16)
+	{
+		for (bx = 0; bx < src_width; bx += 16)
+		{
+			gint y_end = MIN(by + 16, src_height);
+			gint x_end = MIN(bx + 16, src_width);
+
+			for (y = by; y < y_end; ++y)
+			{
+				for (x = bx; x < x_end; ++x)
+					dest[x * src_height + y] = src[y * src_width + x];
+			}
+		}
+	}
+}
+
+
+static inline guint32 gst_imx_sw_blitter_interpolate_pixel(guint32 pixel0, guint32 pixel1, guint weight)
+{
+	guint32 lo, hi;
+
+	if (weight == 0)
+		return pixel0;
+
+	/* Interpolate two channels at once: each 8-bit channel value is
+	 * multiplied with a weight of at most 256, and the sum of the
+	 * two products still fits in the 16 bits the channel has */
+	lo = (((pixel0 & 0x00FF00FF) * (256 - weight) + (pixel1 & 0x00FF00FF) * weight) >> 8) & 0x00FF00FF;
+	hi = (((pixel0 >> 8) & 0x00FF00FF) * (256 - weight) + ((pixel1 >> 8) & 0x00FF00FF) * weight) & 0xFF00FF00;
+
+	return lo | hi;
+}
+
+
+static void gst_imx_sw_blitter_interpolate_rows(guint32 *dest, guint32 const *row0, guint32 const *row1, guint weight, gint num_pixels)
+{
+	gint i = 0;
+
+#ifdef GST_IMX_SW_BLITTER_USE_VECTORS
+	{
+		GstImxSwBlitterVec const mask = { 0x00FF00FF, 0x00FF00FF, 0x00FF00FF, 0x00FF00FF };
+		GstImxSwBlitterVec const shift = { 8, 8, 8, 8 };
+		GstImxSwBlitterVec const w1 = { weight, weight, weight, weight };
+		GstImxSwBlitterVec const w0 = { 256 - weight, 256 - weight, 256 - weight, 256 - weight };
+
+		/* Same computation as in gst_imx_sw_blitter_interpolate_pixel(); the rows
+		 * are not necessarily aligned, so the vectors are copied with memcpy(),
+		 * which the compiler turns into unaligned loads and stores */
+		for (; (i + GST_IMX_SW_BLITTER_VEC_PIXELS) <= num_pixels; i += GST_IMX_SW_BLITTER_VEC_PIXELS)
+		{
+			GstImxSwBlitterVec p0, p1, lo, hi;
+
+			memcpy(&p0, row0 + i, sizeof(p0));
+			memcpy(&p1, row1 + i, sizeof(p1));
+
+			lo = (((p0 & mask) * w0 + (p1 & mask) * w1) >> shift) & mask;
+			hi = (((p0 >> shift) & mask) * w0 + ((p1 >> shift) & mask) * w1) & ~mask;
+			lo |= hi;
+
+			memcpy(dest + i, &lo, sizeof(lo));
+		}
+	}
+#endif
+
+	for (; i < num_pixels; ++i)
+		dest[i] = gst_imx_sw_blitter_interpolate_pixel(row0[i], row1[i], weight);
+}
+
+
+static void gst_imx_sw_blitter_convert_pixels(guint8 *pixels, gsize num_pixels, gboolean to_rgb)
+{
+	gsize i;
+
+	/* ITU-R BT.601 conversion between studio range YUV and full range RGB,
+	 * using 8-bit fixed point coefficients. Both unpack formats store the
+	 * alpha value in the first byte, which is left as it is. */
+	if (to_rgb)
+	{
+		for (i = 0; i < num_pixels; ++i, pixels += 4)
+		{
+			gint c = (gint)(pixels[1]) - 16;
+			gint d = (gint)(pixels[2]) - 128;
+			gint e = (gint)(pixels[3]) - 128;
+
+			pixels[1] = CLAMP((298 * c + 409 * e + 128) >> 8, 0, 255);
+			pixels[2] = CLAMP((298 * c - 100 * d - 208 * e + 128) >> 8, 0, 255);
+			pixels[3] = CLAMP((298 * c + 516 * d + 128) >> 8, 0, 255);
+		}
+	}
+	else
+	{
+		for (i = 0; i < num_pixels; ++i, pixels += 4)
+		{
+			gint r = pixels[1];
+			gint g = pixels[2];
+			gint b = pixels[3];
+
+			pixels[1] = CLAMP(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16, 0, 255);
+			pixels[2] = CLAMP(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128, 0, 255);
+			pixels[3] = CLAMP(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128, 0, 255);
+		}
+	}
+}
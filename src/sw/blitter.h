@@ -0,0 +1,135 @@
+/* Software (CPU) based i.MX blitter class
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#ifndef GST_IMX_SW_BLITTER_H
+#define GST_IMX_SW_BLITTER_H
+
+#include "../common/base_blitter.h"
+
+
+G_BEGIN_DECLS
+
+
+typedef struct _GstImxSwBlitter GstImxSwBlitter;
+typedef struct _GstImxSwBlitterClass GstImxSwBlitterClass;
+typedef struct _GstImxSwBlitterPrivate GstImxSwBlitterPrivate;
+
+
+#define GST_TYPE_IMX_SW_BLITTER             (gst_imx_sw_blitter_get_type())
+#define GST_IMX_SW_BLITTER(obj)             (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_IMX_SW_BLITTER, GstImxSwBlitter))
+#define GST_IMX_SW_BLITTER_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_IMX_SW_BLITTER, GstImxSwBlitterClass))
+#define GST_IMX_SW_BLITTER_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS((obj), GST_TYPE_IMX_SW_BLITTER, GstImxSwBlitterClass))
+#define GST_IS_IMX_SW_BLITTER(obj)          (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_IMX_SW_BLITTER))
+#define GST_IS_IMX_SW_BLITTER_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_IMX_SW_BLITTER))
+
+
+/* The software blitter performs all operations with the CPU. It is much slower
+ * than the IPU, G2D, and PxP blitters, but it runs on any machine, and is
+ * useful as a reference for checking the output of the hardware blitters.
+ * Frames are processed line by line: input pixels are unpacked into 32-bit
+ * AYUV or ARGB pixels with the GstVideoFormatInfo unpack functions, scaled,
+ * rotated, and color converted (ITU-R BT.601), and then packed into the output
+ * format. Scaling uses bilinear interpolation; the row interpolation kernel
+ * is vectorized (see blitter.c).
+ *
+ * The supported formats are the union of the IPU and G2D input formats. */
+#define GST_IMX_SW_VIDEO_FORMATS \
+	" { " \
+	"   RGB16 " \
+	" , BGR " \
+	" , RGB " \
+	" , BGRx " \
+	" , BGRA " \
+	" , RGBx " \
+	" , RGBA " \
+	" , ABGR " \
+	" , UYVY " \
+	" , YUY2 " \
+	" , v308 " \
+	" , NV12 " \
+	" , NV21 " \
+	" , YV12 " \
+	" , I420 " \
+	" , Y42B " \
+	" , Y444 " \
+	" } "
+
+/* The software blitter accesses the frames with the CPU, and its output
+ * frames are not physically contiguous (see allocator.h), so its caps
+ * only have system memory */
+#define GST_IMX_SW_BLITTER_SINK_CAPS \
+	GST_STATIC_CAPS( \
+		"video/x-raw, " \
+		"format = (string) " GST_IMX_SW_VIDEO_FORMATS ", " \
+		"width = (int) [ 1, MAX ], " \
+		"height = (int) [ 1, MAX ], " \
+		"framerate = (fraction) [ 0, MAX ]" \
+	)
+
+#define GST_IMX_SW_BLITTER_SRC_CAPS GST_IMX_SW_BLITTER_SINK_CAPS
+
+
+typedef enum
+{
+	GST_IMX_SW_BLITTER_ROTATION_NONE,
+	GST_IMX_SW_BLITTER_ROTATION_HFLIP,
+	GST_IMX_SW_BLITTER_ROTATION_VFLIP,
+	GST_IMX_SW_BLITTER_ROTATION_90,
+	GST_IMX_SW_BLITTER_ROTATION_180,
+	GST_IMX_SW_BLITTER_ROTATION_270
+}
+GstImxSwBlitterRotationMode;
+
+
+#define GST_IMX_SW_BLITTER_OUTPUT_ROTATION_DEFAULT  GST_IMX_SW_BLITTER_ROTATION_NONE
+
+
+struct _GstImxSwBlitter
+{
+	GstImxBaseBlitter parent;
+	GstImxSwBlitterPrivate *priv;
+
+	GstImxSwBlitterRotationMode rotation_mode;
+
+	/* Statistics, printed when the blitter is finalized */
+	guint64 num_blitted_frames;
+	gint64 total_blit_duration, max_blit_duration;
+};
+
+
+struct _GstImxSwBlitterClass
+{
+	GstImxBaseBlitterClass parent_class;
+};
+
+
+GType gst_imx_sw_blitter_rotation_mode_get_type(void);
+
+GType gst_imx_sw_blitter_get_type(void);
+
+GstImxSwBlitter* gst_imx_sw_blitter_new(void);
+
+GstImxSwBlitterRotationMode gst_imx_sw_blitter_get_output_rotation(GstImxSwBlitter *sw_blitter);
+void gst_imx_sw_blitter_set_output_rotation(GstImxSwBlitter *sw_blitter, GstImxSwBlitterRotationMode rotation);
+
+
+G_END_DECLS
+
+
+#endif
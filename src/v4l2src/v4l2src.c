@@ -31,6 +31,7 @@
 #include <linux/videodev2.h>
 #include "v4l2src.h"
 #include "v4l2_buffer_pool.h"
+#include "../common/phys_mem_caps.h"
 
 #ifdef HAVE_VIV_UPLOAD
 # include "../common/viv_upload_meta.h"
@@ -316,6 +317,9 @@ static gboolean gst_imx_v4l2src_negotiate(GstBaseSrc *src)
 			"pixel-aspect-ratio", GST_TYPE_FRACTION, 1, 1,
 			NULL);
 
+	/* captured frames are in physically contiguous memory */
+	caps = gst_imx_phys_mem_caps_select_feature(GST_BASE_SRC_PAD(src), caps);
+
 	GST_INFO_OBJECT(src, "negotiated caps %" GST_PTR_FORMAT, (gpointer)caps);
 
 	return gst_base_src_set_caps(src, caps);
@@ -324,13 +328,13 @@ static gboolean gst_imx_v4l2src_negotiate(GstBaseSrc *src)
 static GstCaps *gst_imx_v4l2src_get_caps(GstBaseSrc *src, GstCaps *filter)
 {
 	GstImxV4l2VideoSrc *v4l2src = GST_IMX_V4L2SRC(src);
-	GstCaps *caps;
+	GstCaps *caps, *base_caps;
 	const char *pixel_format = "I420";
 	const char *interlace_mode = "progressive";
 
 	GST_INFO_OBJECT(v4l2src, "get caps filter %" GST_PTR_FORMAT, (gpointer)filter);
 
-	caps = gst_caps_new_simple("video/x-raw",
+	base_caps = gst_caps_new_simple("video/x-raw",
 			"format", G_TYPE_STRING, pixel_format,
 			"width", GST_TYPE_INT_RANGE, 16, G_MAXINT,
 			"height", GST_TYPE_INT_RANGE, 16, G_MAXINT,
@@ -338,6 +342,8 @@ static GstCaps *gst_imx_v4l2src_get_caps(GstBaseSrc *src, GstCaps *filter)
 			"framerate", GST_TYPE_FRACTION_RANGE, 0, 1, 100, 1,
 			"pixel-aspect-ratio", GST_TYPE_FRACTION_RANGE, 0, 1, 100, 1,
 			NULL);
+	caps = gst_imx_phys_mem_caps_add_feature_variants(base_caps);
+	gst_caps_unref(base_caps);
 
 	GST_INFO_OBJECT(v4l2src, "get caps %" GST_PTR_FORMAT, (gpointer)caps);
 
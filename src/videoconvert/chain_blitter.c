@@ -0,0 +1,315 @@
+/* i.MX blitter which chains two blitters together
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include "chain_blitter.h"
+
+
+
+GST_DEBUG_CATEGORY_STATIC(imx_chain_blitter_debug);
+#define GST_CAT_DEFAULT imx_chain_blitter_debug
+
+
+G_DEFINE_TYPE(GstImxChainBlitter, gst_imx_chain_blitter, GST_TYPE_IMX_BASE_BLITTER)
+
+
+static void gst_imx_chain_blitter_finalize(GObject *object);
+
+static gboolean gst_imx_chain_blitter_set_input_video_info(GstImxBaseBlitter *base_blitter, GstVideoInfo *input_video_info);
+static gboolean gst_imx_chain_blitter_set_input_frame(GstImxBaseBlitter *base_blitter, GstBuffer *input_frame);
+static gboolean gst_imx_chain_blitter_set_output_frame(GstImxBaseBlitter *base_blitter, GstBuffer *output_frame);
+static gboolean gst_imx_chain_blitter_set_output_regions(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *video_region, GstImxBaseBlitterRegion const *output_region);
+static GstAllocator* gst_imx_chain_blitter_get_phys_mem_allocator(GstImxBaseBlitter *base_blitter);
+static gboolean gst_imx_chain_blitter_blit_frame(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *input_region);
+static gboolean gst_imx_chain_blitter_flush(GstImxBaseBlitter *base_blitter);
+
+static GstImxBaseBlitter* gst_imx_chain_blitter_get_allocating_stage(GstImxBaseBlitter *preferred, GstImxBaseBlitter *other);
+static GstBufferPool* gst_imx_chain_blitter_acquire_intermediate_pool(GstImxChainBlitter *chain_blitter);
+
+
+
+
+void gst_imx_chain_blitter_class_init(GstImxChainBlitterClass *klass)
+{
+	GObjectClass *object_class;
+	GstImxBaseBlitterClass *base_class;
+
+	object_class = G_OBJECT_CLASS(klass);
+	base_class = GST_IMX_BASE_BLITTER_CLASS(klass);
+
+	object_class->finalize             = GST_DEBUG_FUNCPTR(gst_imx_chain_blitter_finalize);
+	base_class->set_input_video_info   = GST_DEBUG_FUNCPTR(gst_imx_chain_blitter_set_input_video_info);
+	base_class->set_input_frame        = GST_DEBUG_FUNCPTR(gst_imx_chain_blitter_set_input_frame);
+	base_class->set_output_frame       = GST_DEBUG_FUNCPTR(gst_imx_chain_blitter_set_output_frame);
+	base_class->set_output_regions     = GST_DEBUG_FUNCPTR(gst_imx_chain_blitter_set_output_regions);
+	base_class->get_phys_mem_allocator = GST_DEBUG_FUNCPTR(gst_imx_chain_blitter_get_phys_mem_allocator);
+	base_class->blit_frame             = GST_DEBUG_FUNCPTR(gst_imx_chain_blitter_blit_frame);
+	base_class->flush                  = GST_DEBUG_FUNCPTR(gst_imx_chain_blitter_flush);
+
+	/* Input buffers are passed on to the first blitter unmodified;
+	 * it copies them to physically contiguous memory if it needs to */
+	base_class->accepts_system_memory = TRUE;
+
+	GST_DEBUG_CATEGORY_INIT(imx_chain_blitter_debug, "imxchainblitter", 0, "Freescale i.MX chain blitter class");
+}
+
+
+void gst_imx_chain_blitter_init(GstImxChainBlitter *chain_blitter)
+{
+	chain_blitter->first = NULL;
+	chain_blitter->second = NULL;
+	gst_video_info_init(&(chain_blitter->intermediate_video_info));
+	chain_blitter->intermediate_pool = NULL;
+	chain_blitter->input_frame = NULL;
+	chain_blitter->output_frame = NULL;
+	chain_blitter->regions_set = FALSE;
+	chain_blitter->first_regions_set = FALSE;
+	chain_blitter->second_regions_set = FALSE;
+}
+
+
+GstImxChainBlitter* gst_imx_chain_blitter_new(GstImxBaseBlitter *first, GstImxBaseBlitter *second, GstVideoInfo const *intermediate_video_info)
+{
+	GstImxChainBlitter* chain_blitter;
+	GstVideoInfo info;
+
+	g_assert(first != NULL);
+	g_assert(second != NULL);
+	g_assert(intermediate_video_info != NULL);
+
+	chain_blitter = (GstImxChainBlitter *)g_object_new(gst_imx_chain_blitter_get_type(), NULL);
+
+	chain_blitter->first = gst_object_ref(first);
+	chain_blitter->second = gst_object_ref(second);
+	chain_blitter->intermediate_video_info = *intermediate_video_info;
+
+	/* The intermediate frames never change their format, so the
+	 * second blitter's input video info can be set right away */
+	info = *intermediate_video_info;
+	if (!gst_imx_base_blitter_set_input_video_info(second, &info))
+	{
+		GST_ERROR_OBJECT(chain_blitter, "second blitter does not accept the intermediate video info");
+		gst_object_unref(GST_OBJECT(chain_blitter));
+		return NULL;
+	}
+
+	return chain_blitter;
+}
+
+
+static void gst_imx_chain_blitter_finalize(GObject *object)
+{
+	GstImxChainBlitter *chain_blitter = GST_IMX_CHAIN_BLITTER(object);
+
+	if (chain_blitter->intermediate_pool != NULL)
+		gst_imx_base_blitter_release_bufferpool(GST_IMX_BASE_BLITTER(chain_blitter), chain_blitter->intermediate_pool);
+
+	if (chain_blitter->first != NULL)
+		gst_object_unref(GST_OBJECT(chain_blitter->first));
+	if (chain_blitter->second != NULL)
+		gst_object_unref(GST_OBJECT(chain_blitter->second));
+
+	G_OBJECT_CLASS(gst_imx_chain_blitter_parent_class)->finalize(object);
+}
+
+
+static gboolean gst_imx_chain_blitter_set_input_video_info(GstImxBaseBlitter *base_blitter, GstVideoInfo *input_video_info)
+{
+	return gst_imx_base_blitter_set_input_video_info(GST_IMX_CHAIN_BLITTER(base_blitter)->first, input_video_info);
+}
+
+
+static gboolean gst_imx_chain_blitter_set_input_frame(GstImxBaseBlitter *base_blitter, GstBuffer *input_frame)
+{
+	GST_IMX_CHAIN_BLITTER(base_blitter)->input_frame = input_frame;
+	return TRUE;
+}
+
+
+static gboolean gst_imx_chain_blitter_set_output_frame(GstImxBaseBlitter *base_blitter, GstBuffer *output_frame)
+{
+	GST_IMX_CHAIN_BLITTER(base_blitter)->output_frame = output_frame;
+	return TRUE;
+}
+
+
+static gboolean gst_imx_chain_blitter_set_output_regions(GstImxBaseBlitter *base_blitter, GstImxBaseBlitterRegion const *video_region, GstImxBaseBlitterRegion const *output_region)
+{
+	GstImxChainBlitter *chain_blitter = GST_IMX_CHAIN_BLITTER(base_blitter);
+
+	chain_blitter->video_region = *video_region;
+	chain_blitter->output_region = *output_region;
+	chain_blitter->regions_set = TRUE;
+	/* The regions are passed on to the second blitter with the next blit */
+	chain_blitter->second_regions_set = FALSE;
+
+	return TRUE;
+}
+
+
+static GstAllocator* gst_imx_chain_blitter_get_phys_mem_allocator(GstImxBaseBlitter *base_blitter)
+{
+	/* Output frames are written to by the second blitter. If it accesses them
+	 * with the CPU, they come from the first blitter's allocator if possible,
+	 * so they are physically contiguous for downstream. */
+	GstImxChainBlitter *chain_blitter = GST_IMX_CHAIN_BLITTER(base_blitter);
+	return gst_imx_base_blitter_get_phys_mem_allocator(gst_imx_chain_blitter_get_allocating_stage(chain_blitter->second, chain_blitter->first));
+}
+
+
+static gboolean gst_imx_chain_blitter_blit_frame(GstImxBaseBlitter *base_blitter, G_GNUC_UNUSED GstImxBaseBlitterRegion const *input_region)
+{
+	gboolean ret;
+	GstFlowReturn flow_ret;
+	GstBuffer *intermediate_frame;
+	GstImxChainBlitter *chain_blitter = GST_IMX_CHAIN_BLITTER(base_blitter);
+
+	if (chain_blitter->intermediate_pool == NULL)
+	{
+		chain_blitter->intermediate_pool = gst_imx_chain_blitter_acquire_intermediate_pool(chain_blitter);
+		if (chain_blitter->intermediate_pool == NULL)
+		{
+			GST_ERROR_OBJECT(chain_blitter, "could not create intermediate buffer pool");
+			return FALSE;
+		}
+	}
+
+	flow_ret = gst_buffer_pool_acquire_buffer(chain_blitter->intermediate_pool, &intermediate_frame, NULL);
+	if (flow_ret != GST_FLOW_OK)
+	{
+		GST_ERROR_OBJECT(chain_blitter, "could not acquire intermediate frame: %s", gst_flow_get_name(flow_ret));
+		return FALSE;
+	}
+
+	/* First stage: input frame -> intermediate frame. The first blitter
+	 * handles cropping, since it is the one that sees the input frame. */
+	gst_imx_base_blitter_enable_crop(chain_blitter->first, gst_imx_base_blitter_is_crop_enabled(base_blitter));
+	ret =
+		gst_imx_base_blitter_set_input_buffer(chain_blitter->first, chain_blitter->input_frame) &&
+		gst_imx_base_blitter_set_output_buffer(chain_blitter->first, intermediate_frame);
+
+	/* The first blitter always fills the entire intermediate frame. Its regions
+	 * are set explicitly, since the blitter may have been used with other regions
+	 * before (the video convert element also uses the blitters on their own). */
+	if (ret && !(chain_blitter->first_regions_set))
+	{
+		ret = gst_imx_base_blitter_set_output_regions(chain_blitter->first, NULL, NULL);
+		chain_blitter->first_regions_set = ret;
+	}
+
+	ret = ret && gst_imx_base_blitter_blit(chain_blitter->first);
+
+	/* Second stage: intermediate frame -> output frame */
+	if (ret)
+	{
+		ret =
+			gst_imx_base_blitter_set_input_buffer(chain_blitter->second, intermediate_frame) &&
+			gst_imx_base_blitter_set_output_buffer(chain_blitter->second, chain_blitter->output_frame);
+
+		/* Like with any other blitter, the regions stay valid until they are
+		 * set again, so they are only passed on after they changed */
+		if (ret && !(chain_blitter->second_regions_set))
+		{
+			if (chain_blitter->regions_set)
+				ret = gst_imx_base_blitter_set_output_regions(chain_blitter->second, &(chain_blitter->video_region), &(chain_blitter->output_region));
+			else
+				ret = gst_imx_base_blitter_set_output_regions(chain_blitter->second, NULL, NULL);
+			chain_blitter->second_regions_set = ret;
+		}
+
+		ret = ret && gst_imx_base_blitter_blit(chain_blitter->second);
+	}
+
+	gst_buffer_unref(intermediate_frame);
+
+	return ret;
+}
+
+
+static gboolean gst_imx_chain_blitter_flush(GstImxBaseBlitter *base_blitter)
+{
+	GstImxChainBlitter *chain_blitter = GST_IMX_CHAIN_BLITTER(base_blitter);
+	gboolean ret1, ret2;
+
+	ret1 = gst_imx_base_blitter_flush(chain_blitter->first);
+	ret2 = gst_imx_base_blitter_flush(chain_blitter->second);
+
+	return ret1 && ret2;
+}
+
+
+static GstImxBaseBlitter* gst_imx_chain_blitter_get_allocating_stage(GstImxBaseBlitter *preferred, GstImxBaseBlitter *other)
+{
+	/* Blitters which access the frames with the CPU can use any memory, while
+	 * the others need physically contiguous memory. Frames shared with such a
+	 * blitter therefore must come from its allocator. (The software blitter's
+	 * allocator for example hands out memory with physical address 0.) */
+	if (!(GST_IMX_BASE_BLITTER_GET_CLASS(preferred)->accepts_system_memory))
+		return preferred;
+	else if (!(GST_IMX_BASE_BLITTER_GET_CLASS(other)->accepts_system_memory))
+		return other;
+	else
+		return preferred;
+}
+
+
+static GstBufferPool* gst_imx_chain_blitter_acquire_intermediate_pool(GstImxChainBlitter *chain_blitter)
+{
+	/* Intermediate frames are written to by the first blitter, and read by the
+	 * second one. The pool is acquired through the chain blitter's pool registry,
+	 * if one is set, and released with gst_imx_base_blitter_release_bufferpool(). */
+
+	GstImxBaseBlitter *base_blitter = GST_IMX_BASE_BLITTER(chain_blitter);
+	GstImxBaseBlitter *stage = gst_imx_chain_blitter_get_allocating_stage(chain_blitter->first, chain_blitter->second);
+	GstCaps *caps;
+	GstAllocator *allocator;
+	GstBufferPool *pool;
+	/* Intermediate frames need cacheable memory only if one of the blitters accesses them with the CPU */
+	GstImxPhysMemCachePolicy cache_policy = (GST_IMX_BASE_BLITTER_GET_CLASS(chain_blitter->first)->accepts_system_memory || GST_IMX_BASE_BLITTER_GET_CLASS(chain_blitter->second)->accepts_system_memory) ? GST_IMX_PHYS_MEM_CACHE_POLICY_CACHED : GST_IMX_PHYS_MEM_CACHE_POLICY_UNCACHED;
+
+	allocator = gst_imx_base_blitter_get_phys_mem_allocator(stage);
+	if (allocator == NULL)
+	{
+		GST_ERROR_OBJECT(chain_blitter, "could not get physical memory allocator for intermediate frames");
+		return NULL;
+	}
+
+	GST_DEBUG_OBJECT(chain_blitter, "allocating intermediate frames with the allocator of %s blitter %" GST_PTR_FORMAT, (stage == chain_blitter->first) ? "first" : "second", (gpointer)stage);
+
+	caps = gst_video_info_to_caps(&(chain_blitter->intermediate_video_info));
+
+	if (base_blitter->pool_registry != NULL)
+	{
+		pool = gst_imx_phys_mem_pool_registry_acquire_pool(base_blitter->pool_registry, allocator, caps, chain_blitter->intermediate_video_info.size, 0, 0, 0, cache_policy);
+	}
+	else
+	{
+		pool = gst_imx_base_blitter_create_bufferpool(base_blitter, caps, chain_blitter->intermediate_video_info.size, 0, 0, allocator, NULL, cache_policy);
+		if ((pool != NULL) && !gst_buffer_pool_set_active(pool, TRUE))
+		{
+			GST_ERROR_OBJECT(chain_blitter, "could not activate intermediate buffer pool");
+			gst_object_unref(GST_OBJECT(pool));
+			pool = NULL;
+		}
+	}
+
+	gst_caps_unref(caps);
+	gst_object_unref(GST_OBJECT(allocator));
+
+	return pool;
+}
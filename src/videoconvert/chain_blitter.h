@@ -0,0 +1,90 @@
+/* i.MX blitter which chains two blitters together
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#ifndef GST_IMX_VIDEOCONVERT_CHAIN_BLITTER_H
+#define GST_IMX_VIDEOCONVERT_CHAIN_BLITTER_H
+
+#include "../common/base_blitter.h"
+
+
+G_BEGIN_DECLS
+
+
+typedef struct _GstImxChainBlitter GstImxChainBlitter;
+typedef struct _GstImxChainBlitterClass GstImxChainBlitterClass;
+
+
+#define GST_TYPE_IMX_CHAIN_BLITTER             (gst_imx_chain_blitter_get_type())
+#define GST_IMX_CHAIN_BLITTER(obj)             (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_IMX_CHAIN_BLITTER, GstImxChainBlitter))
+#define GST_IMX_CHAIN_BLITTER_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_IMX_CHAIN_BLITTER, GstImxChainBlitterClass))
+#define GST_IS_IMX_CHAIN_BLITTER(obj)          (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_IMX_CHAIN_BLITTER))
+#define GST_IS_IMX_CHAIN_BLITTER_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_IMX_CHAIN_BLITTER))
+
+
+/**
+ * The chain blitter performs a blit in two stages, using two other blitters.
+ * The first blitter converts the input frame into an intermediate frame, the
+ * second one converts the intermediate frame into the output frame. This is
+ * used when no single blitter supports a combination of input and output
+ * formats (for example, G2D cannot produce YUV frames, and the IPU cannot
+ * handle frames smaller than 64x64 pixels).
+ *
+ * Output regions are only passed to the second blitter; the first blitter
+ * always fills the entire intermediate frame. The intermediate frames are
+ * allocated with the allocator of the first blitter.
+ */
+struct _GstImxChainBlitter
+{
+	GstImxBaseBlitter parent;
+
+	GstImxBaseBlitter *first, *second;
+
+	/* Format and size of the intermediate frames */
+	GstVideoInfo intermediate_video_info;
+	GstBufferPool *intermediate_pool;
+
+	/* Currently set input and output frames; not ref'd */
+	GstBuffer *input_frame, *output_frame;
+
+	/* Regions from the last set_output_regions call; only valid if regions_set is TRUE */
+	GstImxBaseBlitterRegion video_region, output_region;
+	gboolean regions_set;
+	/* FALSE if the regions of the first/second blitter have not been set yet */
+	gboolean first_regions_set, second_regions_set;
+};
+
+
+struct _GstImxChainBlitterClass
+{
+	GstImxBaseBlitterClass parent_class;
+};
+
+
+GType gst_imx_chain_blitter_get_type(void);
+
+/* Creates a new chain blitter. Both blitters are ref'd. The intermediate
+ * video info's format and size must be supported as output by the first
+ * blitter and as input by the second one. */
+GstImxChainBlitter* gst_imx_chain_blitter_new(GstImxBaseBlitter *first, GstImxBaseBlitter *second, GstVideoInfo const *intermediate_video_info);
+
+
+G_END_DECLS
+
+
+#endif
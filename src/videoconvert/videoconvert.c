@@ -0,0 +1,700 @@
+/* Auto-selecting i.MX video convert element
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include "videoconvert.h"
+#include "chain_blitter.h"
+
+
+
+
+GST_DEBUG_CATEGORY_STATIC(imx_video_convert_debug);
+#define GST_CAT_DEFAULT imx_video_convert_debug
+
+
+enum
+{
+	PROP_0,
+	PROP_BACKEND,
+	PROP_ESTIMATED_COST,
+	PROP_ENGINE_THROUGHPUTS
+};
+
+
+/* Capability and cost table, in order of preference for equal costs.
+ * The throughput figures are approximate defaults, which only need to be
+ * accurate enough to rank the engines against each other. Figures measured
+ * on the actual board can be set with the engine-throughputs property. */
+static GstImxVideoConvertEngine const engines[] =
+{
+	{ "g2d", "imxg2dvideotransform",  1,  1, 4096, 4096, 300.0, GST_IMX_DISPATCH_BLITTER_CAPABILITY_SCALING | GST_IMX_DISPATCH_BLITTER_CAPABILITY_ROTATION },
+	{ "ipu", "imxipuvideotransform", 64, 64, 4096, 4096, 120.0, GST_IMX_DISPATCH_BLITTER_CAPABILITY_SCALING | GST_IMX_DISPATCH_BLITTER_CAPABILITY_ROTATION | GST_IMX_DISPATCH_BLITTER_CAPABILITY_DEINTERLACING },
+	{ "pxp", "imxpxpvideotransform",  1,  1, 2048, 2048,  80.0, GST_IMX_DISPATCH_BLITTER_CAPABILITY_SCALING | GST_IMX_DISPATCH_BLITTER_CAPABILITY_ROTATION },
+	{ "sw",  "imxswvideotransform",   1,  1, 8192, 8192,   8.0, GST_IMX_DISPATCH_BLITTER_CAPABILITY_SCALING | GST_IMX_DISPATCH_BLITTER_CAPABILITY_ROTATION },
+	{ NULL, NULL, 0, 0, 0, 0, 0.0, 0 }
+};
+
+
+/* Formats tried for the intermediate frames of two-stage chains */
+static GstVideoFormat const intermediate_formats[] =
+{
+	GST_VIDEO_FORMAT_I420,
+	GST_VIDEO_FORMAT_NV12,
+	GST_VIDEO_FORMAT_UYVY,
+	GST_VIDEO_FORMAT_YUY2,
+	GST_VIDEO_FORMAT_BGRx,
+	GST_VIDEO_FORMAT_RGBx,
+	GST_VIDEO_FORMAT_BGRA,
+	GST_VIDEO_FORMAT_RGBA,
+	GST_VIDEO_FORMAT_RGB16,
+	GST_VIDEO_FORMAT_UNKNOWN
+};
+
+
+static GstStaticPadTemplate static_sink_template = GST_STATIC_PAD_TEMPLATE(
+	"sink",
+	GST_PAD_SINK,
+	GST_PAD_ALWAYS,
+	GST_IMX_VIDEO_CONVERT_CAPS
+);
+
+
+static GstStaticPadTemplate static_src_template = GST_STATIC_PAD_TEMPLATE(
+	"src",
+	GST_PAD_SRC,
+	GST_PAD_ALWAYS,
+	GST_IMX_VIDEO_CONVERT_CAPS
+);
+
+
+G_DEFINE_TYPE(GstImxVideoConvert, gst_imx_video_convert, GST_TYPE_IMX_BLITTER_VIDEO_TRANSFORM)
+
+
+static void gst_imx_video_convert_finalize(GObject *object);
+static void gst_imx_video_convert_set_property(GObject *object, guint prop_id, GValue const *value, GParamSpec *pspec);
+static void gst_imx_video_convert_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec);
+
+gboolean gst_imx_video_convert_start(GstImxBlitterVideoTransform *blitter_video_transform);
+gboolean gst_imx_video_convert_stop(GstImxBlitterVideoTransform *blitter_video_transform);
+
+gboolean gst_imx_video_convert_are_video_infos_equal(GstImxBlitterVideoTransform *blitter_video_transform, GstVideoInfo const *in_info, GstVideoInfo const *out_info);
+
+gboolean gst_imx_video_convert_are_transforms_necessary(GstImxBlitterVideoTransform *blitter_video_transform, GstBuffer *input);
+
+gboolean gst_imx_video_convert_set_video_infos(GstImxBlitterVideoTransform *blitter_video_transform, GstVideoInfo const *in_info, GstVideoInfo const *out_info);
+
+static gboolean gst_imx_video_convert_select_backends(GstImxVideoConvert *video_convert, GstVideoInfo const *in_info, GstVideoInfo const *out_info, GstImxVideoConvertBackend **first, GstImxVideoConvertBackend **second, GstVideoInfo *intermediate_info, gdouble *cost);
+static GstImxVideoConvertBackend* gst_imx_video_convert_create_backend(GstImxVideoConvert *video_convert, GstImxVideoConvertEngine const *engine);
+static gboolean gst_imx_video_convert_activate_backend(GstImxVideoConvert *video_convert, GstImxVideoConvertBackend *backend);
+static void gst_imx_video_convert_deactivate_backend(GstImxVideoConvertBackend *backend);
+static void gst_imx_video_convert_free_backend(gpointer data);
+static gdouble gst_imx_video_convert_get_engine_throughput(GstImxVideoConvert *video_convert, GstImxVideoConvertEngine const *engine);
+static gboolean gst_imx_video_convert_backend_supports(GstImxVideoConvertBackend *backend, GstVideoFormat in_format, gint in_width, gint in_height, GstVideoFormat out_format, gint out_width, gint out_height);
+static gdouble gst_imx_video_convert_estimate_cost(GstImxVideoConvertBackend *backend, gint in_width, gint in_height, gint out_width, gint out_height);
+
+
+
+
+/* required functions declared by G_DEFINE_TYPE */
+
+void gst_imx_video_convert_class_init(GstImxVideoConvertClass *klass)
+{
+	GObjectClass *object_class;
+	GstImxBlitterVideoTransformClass *base_class;
+	GstElementClass *element_class;
+
+	GST_DEBUG_CATEGORY_INIT(imx_video_convert_debug, "imxvideoconvert", 0, "Freescale i.MX auto-selecting video convert");
+
+	object_class = G_OBJECT_CLASS(klass);
+	base_class = GST_IMX_BLITTER_VIDEO_TRANSFORM_CLASS(klass);
+	element_class = GST_ELEMENT_CLASS(klass);
+
+	gst_element_class_set_static_metadata(
+		element_class,
+		"Freescale video converter",
+		"Filter/Converter/Video/Scaler",
+		"Video conversion and scaling using the cheapest available i.MX blitter engine",
+		"Carlos Rafael Giani <dv@pseudoterminal.org>"
+	);
+
+	gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&static_sink_template));
+	gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&static_src_template));
+
+	object_class->finalize     = GST_DEBUG_FUNCPTR(gst_imx_video_convert_finalize);
+	object_class->set_property = GST_DEBUG_FUNCPTR(gst_imx_video_convert_set_property);
+	object_class->get_property = GST_DEBUG_FUNCPTR(gst_imx_video_convert_get_property);
+
+	base_class->start = GST_DEBUG_FUNCPTR(gst_imx_video_convert_start);
+	base_class->stop  = GST_DEBUG_FUNCPTR(gst_imx_video_convert_stop);
+
+	base_class->are_video_infos_equal = GST_DEBUG_FUNCPTR(gst_imx_video_convert_are_video_infos_equal);
+
+	base_class->are_transforms_necessary = GST_DEBUG_FUNCPTR(gst_imx_video_convert_are_transforms_necessary);
+
+	base_class->set_video_infos = GST_DEBUG_FUNCPTR(gst_imx_video_convert_set_video_infos);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_BACKEND,
+		g_param_spec_string(
+			"backend",
+			"Backend",
+			"Blitter engine(s) selected for the current caps (two engines are separated by a '+')",
+			NULL,
+			G_PARAM_READABLE | G_PARAM_STATIC_STRINGS
+		)
+	);
+	g_object_class_install_property(
+		object_class,
+		PROP_ESTIMATED_COST,
+		g_param_spec_double(
+			"estimated-cost",
+			"Estimated cost",
+			"Estimated time in milliseconds the selected backend needs for converting one frame",
+			0.0, G_MAXDOUBLE,
+			0.0,
+			G_PARAM_READABLE | G_PARAM_STATIC_STRINGS
+		)
+	);
+	g_object_class_install_property(
+		object_class,
+		PROP_ENGINE_THROUGHPUTS,
+		g_param_spec_string(
+			"engine-throughputs",
+			"Engine throughputs",
+			"Throughputs of the engines in megapixels per second (input + output pixels) used for estimating costs, for example \"g2d=300,ipu=120\"; engines which are not listed use built-in defaults. Takes effect in the NULL->READY state change",
+			NULL,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
+		)
+	);
+}
+
+
+void gst_imx_video_convert_init(GstImxVideoConvert *video_convert)
+{
+	video_convert->backends = g_ptr_array_new_with_free_func(gst_imx_video_convert_free_backend);
+	video_convert->selected_backend = NULL;
+	video_convert->estimated_cost = 0.0;
+	video_convert->engine_throughputs = NULL;
+}
+
+
+
+
+static void gst_imx_video_convert_finalize(GObject *object)
+{
+	GstImxVideoConvert *video_convert = GST_IMX_VIDEO_CONVERT(object);
+
+	g_ptr_array_free(video_convert->backends, TRUE);
+	g_free(video_convert->selected_backend);
+	g_free(video_convert->engine_throughputs);
+
+	G_OBJECT_CLASS(gst_imx_video_convert_parent_class)->finalize(object);
+}
+
+
+static void gst_imx_video_convert_set_property(GObject *object, guint prop_id, GValue const *value, GParamSpec *pspec)
+{
+	GstImxVideoConvert *video_convert = GST_IMX_VIDEO_CONVERT(object);
+
+	switch (prop_id)
+	{
+		case PROP_ENGINE_THROUGHPUTS:
+			GST_OBJECT_LOCK(video_convert);
+			g_free(video_convert->engine_throughputs);
+			video_convert->engine_throughputs = g_value_dup_string(value);
+			GST_OBJECT_UNLOCK(video_convert);
+			break;
+
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+			break;
+	}
+}
+
+
+static void gst_imx_video_convert_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
+{
+	GstImxVideoConvert *video_convert = GST_IMX_VIDEO_CONVERT(object);
+
+	/* The object lock is used instead of the blitter video transform mutex,
+	 * since the selection is notified while that mutex is locked */
+	switch (prop_id)
+	{
+		case PROP_BACKEND:
+			GST_OBJECT_LOCK(video_convert);
+			g_value_set_string(value, video_convert->selected_backend);
+			GST_OBJECT_UNLOCK(video_convert);
+			break;
+
+		case PROP_ESTIMATED_COST:
+			GST_OBJECT_LOCK(video_convert);
+			g_value_set_double(value, video_convert->estimated_cost);
+			GST_OBJECT_UNLOCK(video_convert);
+			break;
+
+		case PROP_ENGINE_THROUGHPUTS:
+			GST_OBJECT_LOCK(video_convert);
+			g_value_set_string(value, video_convert->engine_throughputs);
+			GST_OBJECT_UNLOCK(video_convert);
+			break;
+
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+			break;
+	}
+}
+
+
+gboolean gst_imx_video_convert_start(GstImxBlitterVideoTransform *blitter_video_transform)
+{
+	guint i;
+	GstImxVideoConvert *video_convert = GST_IMX_VIDEO_CONVERT(blitter_video_transform);
+	GstImxVideoConvertEngine const *engine;
+	GstImxVideoConvertBackend *backend;
+
+	/* This only creates the engines' elements; their engines
+	 * are opened once they are selected */
+	for (engine = engines; engine->name != NULL; ++engine)
+	{
+		backend = gst_imx_video_convert_create_backend(video_convert, engine);
+		if (backend != NULL)
+			g_ptr_array_add(video_convert->backends, backend);
+	}
+
+	/* The actual backend is selected once the caps are known; until
+	 * then, use the first one which can be opened */
+	for (i = 0; i < video_convert->backends->len; ++i)
+	{
+		backend = g_ptr_array_index(video_convert->backends, i);
+		if (gst_imx_video_convert_activate_backend(video_convert, backend))
+			break;
+	}
+
+	if (i == video_convert->backends->len)
+	{
+		GST_ERROR_OBJECT(video_convert, "no blitter engine is available");
+		return FALSE;
+	}
+
+	gst_imx_blitter_video_transform_set_blitter(blitter_video_transform, backend->blitter);
+
+	GST_OBJECT_LOCK(video_convert);
+	g_free(video_convert->selected_backend);
+	video_convert->selected_backend = NULL;
+	video_convert->estimated_cost = 0.0;
+	GST_OBJECT_UNLOCK(video_convert);
+
+	return TRUE;
+}
+
+
+gboolean gst_imx_video_convert_stop(GstImxBlitterVideoTransform *blitter_video_transform)
+{
+	GstImxVideoConvert *video_convert = GST_IMX_VIDEO_CONVERT(blitter_video_transform);
+
+	/* The base class still holds a reference to the selected blitter,
+	 * which it releases after this call */
+	g_ptr_array_set_size(video_convert->backends, 0);
+
+	return TRUE;
+}
+
+
+gboolean gst_imx_video_convert_are_video_infos_equal(G_GNUC_UNUSED GstImxBlitterVideoTransform *blitter_video_transform, GstVideoInfo const *in_info, GstVideoInfo const *out_info)
+{
+	return
+		(GST_VIDEO_INFO_WIDTH(in_info) == GST_VIDEO_INFO_WIDTH(out_info)) &&
+		(GST_VIDEO_INFO_HEIGHT(in_info) == GST_VIDEO_INFO_HEIGHT(out_info)) &&
+		(GST_VIDEO_INFO_FORMAT(in_info) == GST_VIDEO_INFO_FORMAT(out_info))
+		;
+}
+
+
+gboolean gst_imx_video_convert_are_transforms_necessary(G_GNUC_UNUSED GstImxBlitterVideoTransform *blitter_video_transform, G_GNUC_UNUSED GstBuffer *input)
+{
+	return FALSE;
+}
+
+
+gboolean gst_imx_video_convert_set_video_infos(GstImxBlitterVideoTransform *blitter_video_transform, GstVideoInfo const *in_info, GstVideoInfo const *out_info)
+{
+	guint i;
+	GstImxVideoConvert *video_convert = GST_IMX_VIDEO_CONVERT(blitter_video_transform);
+	GstImxVideoConvertBackend *first, *second;
+	GstVideoInfo intermediate_info;
+	gdouble cost;
+	gchar *selected_backend;
+	gboolean backend_changed, cost_changed;
+
+	/* Select the cheapest engine (or chain of engines), and open it. If an
+	 * engine cannot be opened, it is excluded, and the selection is repeated. */
+	do
+	{
+		if (!gst_imx_video_convert_select_backends(video_convert, in_info, out_info, &first, &second, &intermediate_info, &cost))
+		{
+			GST_ERROR_OBJECT(
+				video_convert,
+				"no engine or combination of engines can convert %s %dx%d to %s %dx%d",
+				gst_video_format_to_string(GST_VIDEO_INFO_FORMAT(in_info)), GST_VIDEO_INFO_WIDTH(in_info), GST_VIDEO_INFO_HEIGHT(in_info),
+				gst_video_format_to_string(GST_VIDEO_INFO_FORMAT(out_info)), GST_VIDEO_INFO_WIDTH(out_info), GST_VIDEO_INFO_HEIGHT(out_info)
+			);
+			return FALSE;
+		}
+	}
+	while (!gst_imx_video_convert_activate_backend(video_convert, first) || ((second != NULL) && !gst_imx_video_convert_activate_backend(video_convert, second)));
+
+	if (second == NULL)
+	{
+		gst_imx_blitter_video_transform_set_blitter(blitter_video_transform, first->blitter);
+		selected_backend = g_strdup(first->engine->name);
+
+		GST_INFO_OBJECT(video_convert, "selected engine %s (estimated cost: %f ms per frame)", selected_backend, cost);
+	}
+	else
+	{
+		GstImxChainBlitter *chain_blitter;
+
+		chain_blitter = gst_imx_chain_blitter_new(first->blitter, second->blitter, &intermediate_info);
+		if (chain_blitter == NULL)
+		{
+			GST_ERROR_OBJECT(video_convert, "could not create chain blitter");
+			return FALSE;
+		}
+
+		gst_imx_blitter_video_transform_set_blitter(blitter_video_transform, GST_IMX_BASE_BLITTER(chain_blitter));
+		gst_object_unref(GST_OBJECT(chain_blitter));
+
+		selected_backend = g_strdup_printf("%s+%s", first->engine->name, second->engine->name);
+
+		GST_INFO_OBJECT(
+			video_convert,
+			"selected engines %s with intermediate format %s %dx%d (estimated cost: %f ms per frame)",
+			selected_backend,
+			gst_video_format_to_string(GST_VIDEO_INFO_FORMAT(&intermediate_info)),
+			GST_VIDEO_INFO_WIDTH(&intermediate_info), GST_VIDEO_INFO_HEIGHT(&intermediate_info),
+			cost
+		);
+	}
+
+	/* Close the engines which are not used anymore. The blitter video
+	 * transform and the chain blitter hold references to the blitters
+	 * they still use, so these stay valid until they are replaced. */
+	for (i = 0; i < video_convert->backends->len; ++i)
+	{
+		GstImxVideoConvertBackend *backend = g_ptr_array_index(video_convert->backends, i);
+		if ((backend != first) && (backend != second))
+			gst_imx_video_convert_deactivate_backend(backend);
+	}
+
+	GST_OBJECT_LOCK(video_convert);
+	backend_changed = (g_strcmp0(selected_backend, video_convert->selected_backend) != 0);
+	cost_changed = (cost != video_convert->estimated_cost);
+	g_free(video_convert->selected_backend);
+	video_convert->selected_backend = selected_backend;
+	video_convert->estimated_cost = cost;
+	GST_OBJECT_UNLOCK(video_convert);
+
+	if (backend_changed)
+		g_object_notify(G_OBJECT(video_convert), "backend");
+	if (cost_changed)
+		g_object_notify(G_OBJECT(video_convert), "estimated-cost");
+
+	return TRUE;
+}
+
+
+static gboolean gst_imx_video_convert_select_backends(GstImxVideoConvert *video_convert, GstVideoInfo const *in_info, GstVideoInfo const *out_info, GstImxVideoConvertBackend **first_backend, GstImxVideoConvertBackend **second_backend, GstVideoInfo *intermediate_info, gdouble *selected_cost)
+{
+	guint i, j, k;
+	GstVideoFormat in_format = GST_VIDEO_INFO_FORMAT(in_info), out_format = GST_VIDEO_INFO_FORMAT(out_info);
+	gint in_width = GST_VIDEO_INFO_WIDTH(in_info), in_height = GST_VIDEO_INFO_HEIGHT(in_info);
+	gint out_width = GST_VIDEO_INFO_WIDTH(out_info), out_height = GST_VIDEO_INFO_HEIGHT(out_info);
+	GstImxVideoConvertBackend *best_single = NULL, *best_first = NULL, *best_second = NULL;
+	GstVideoFormat best_intermediate_format = GST_VIDEO_FORMAT_UNKNOWN;
+	gint best_intermediate_width = 0, best_intermediate_height = 0;
+	gdouble cost, best_cost = 0.0;
+
+	/* First, look for the cheapest engine which can do the job alone */
+	for (i = 0; i < video_convert->backends->len; ++i)
+	{
+		GstImxVideoConvertBackend *backend = g_ptr_array_index(video_convert->backends, i);
+
+		if (!gst_imx_video_convert_backend_supports(backend, in_format, in_width, in_height, out_format, out_width, out_height))
+			continue;
+
+		cost = gst_imx_video_convert_estimate_cost(backend, in_width, in_height, out_width, out_height);
+		GST_DEBUG_OBJECT(video_convert, "engine %s: estimated cost %f ms", backend->engine->name, cost);
+
+		if ((best_single == NULL) || (cost < best_cost))
+		{
+			best_single = backend;
+			best_cost = cost;
+		}
+	}
+
+	if (best_single != NULL)
+	{
+		*first_backend = best_single;
+		*second_backend = NULL;
+		*selected_cost = best_cost;
+		return TRUE;
+	}
+
+	/* No engine can do it alone; try all two-stage chains. The intermediate
+	 * frame either has the output size (the first stage scales) or the
+	 * input size (the second stage scales). */
+	for (i = 0; i < video_convert->backends->len; ++i)
+	{
+		GstImxVideoConvertBackend *first = g_ptr_array_index(video_convert->backends, i);
+
+		for (j = 0; j < video_convert->backends->len; ++j)
+		{
+			GstImxVideoConvertBackend *second = g_ptr_array_index(video_convert->backends, j);
+
+			if (first == second)
+				continue;
+
+			for (k = 0; intermediate_formats[k] != GST_VIDEO_FORMAT_UNKNOWN; ++k)
+			{
+				guint size_index;
+
+				for (size_index = 0; size_index < 2; ++size_index)
+				{
+					gint mid_width = (size_index == 0) ? out_width : in_width;
+					gint mid_height = (size_index == 0) ? out_height : in_height;
+
+					if (!gst_imx_video_convert_backend_supports(first, in_format, in_width, in_height, intermediate_formats[k], mid_width, mid_height))
+						continue;
+					if (!gst_imx_video_convert_backend_supports(second, intermediate_formats[k], mid_width, mid_height, out_format, out_width, out_height))
+						continue;
+
+					cost =
+						gst_imx_video_convert_estimate_cost(first, in_width, in_height, mid_width, mid_height) +
+						gst_imx_video_convert_estimate_cost(second, mid_width, mid_height, out_width, out_height);
+
+					if ((best_first == NULL) || (cost < best_cost))
+					{
+						best_first = first;
+						best_second = second;
+						best_intermediate_format = intermediate_formats[k];
+						best_intermediate_width = mid_width;
+						best_intermediate_height = mid_height;
+						best_cost = cost;
+					}
+				}
+			}
+		}
+	}
+
+	if (best_first == NULL)
+		return FALSE;
+
+	gst_video_info_set_format(intermediate_info, best_intermediate_format, best_intermediate_width, best_intermediate_height);
+	*first_backend = best_first;
+	*second_backend = best_second;
+	*selected_cost = best_cost;
+
+	return TRUE;
+}
+
+
+static GstImxVideoConvertBackend* gst_imx_video_convert_create_backend(GstImxVideoConvert *video_convert, GstImxVideoConvertEngine const *engine)
+{
+	GstElement *element;
+	GstPad *pad;
+	GstImxVideoConvertBackend *backend;
+
+	/* The engines are used through their video transform elements, so
+	 * that each engine's code exists only once, in its own plugin */
+	element = gst_element_factory_make(engine->factory_name, NULL);
+	if (element == NULL)
+	{
+		GST_DEBUG_OBJECT(video_convert, "engine %s not available: element %s not found", engine->name, engine->factory_name);
+		return NULL;
+	}
+
+	if (!GST_IS_IMX_BLITTER_VIDEO_TRANSFORM(element))
+	{
+		GST_WARNING_OBJECT(video_convert, "engine %s not available: element %s is not a blitter video transform", engine->name, engine->factory_name);
+		gst_object_unref(GST_OBJECT(element));
+		return NULL;
+	}
+
+	backend = g_slice_alloc0(sizeof(GstImxVideoConvertBackend));
+	backend->engine = engine;
+	backend->element = element;
+	backend->blitter = NULL;
+	backend->megapixels_per_second = gst_imx_video_convert_get_engine_throughput(video_convert, engine);
+	backend->failed = FALSE;
+
+	/* The pad template caps are available without opening the engine */
+	pad = gst_element_get_static_pad(element, "sink");
+	backend->sink_caps = gst_pad_get_pad_template_caps(pad);
+	gst_object_unref(GST_OBJECT(pad));
+
+	pad = gst_element_get_static_pad(element, "src");
+	backend->src_caps = gst_pad_get_pad_template_caps(pad);
+	gst_object_unref(GST_OBJECT(pad));
+
+	GST_DEBUG_OBJECT(video_convert, "engine %s available (throughput: %f MP/s)", engine->name, backend->megapixels_per_second);
+
+	return backend;
+}
+
+
+static gboolean gst_imx_video_convert_activate_backend(GstImxVideoConvert *video_convert, GstImxVideoConvertBackend *backend)
+{
+	if (backend->blitter != NULL)
+		return TRUE;
+	if (backend->failed)
+		return FALSE;
+
+	/* Switching to READY creates the element's blitter (which for example
+	 * fails if the engine's device cannot be opened) */
+	if (gst_element_set_state(backend->element, GST_STATE_READY) == GST_STATE_CHANGE_FAILURE)
+	{
+		GST_WARNING_OBJECT(video_convert, "engine %s not available: element %s could not be started", backend->engine->name, backend->engine->factory_name);
+		backend->failed = TRUE;
+		return FALSE;
+	}
+
+	backend->blitter = gst_object_ref(GST_IMX_BLITTER_VIDEO_TRANSFORM(backend->element)->blitter);
+
+	GST_DEBUG_OBJECT(video_convert, "opened engine %s", backend->engine->name);
+
+	return TRUE;
+}
+
+
+static void gst_imx_video_convert_deactivate_backend(GstImxVideoConvertBackend *backend)
+{
+	if (backend->blitter == NULL)
+		return;
+
+	gst_object_unref(GST_OBJECT(backend->blitter));
+	backend->blitter = NULL;
+
+	gst_element_set_state(backend->element, GST_STATE_NULL);
+}
+
+
+static void gst_imx_video_convert_free_backend(gpointer data)
+{
+	GstImxVideoConvertBackend *backend = (GstImxVideoConvertBackend *)data;
+
+	gst_imx_video_convert_deactivate_backend(backend);
+
+	gst_caps_unref(backend->sink_caps);
+	gst_caps_unref(backend->src_caps);
+	gst_object_unref(GST_OBJECT(backend->element));
+
+	g_slice_free1(sizeof(GstImxVideoConvertBackend), backend);
+}
+
+
+static gdouble gst_imx_video_convert_get_engine_throughput(GstImxVideoConvert *video_convert, GstImxVideoConvertEngine const *engine)
+{
+	gdouble throughput = engine->megapixels_per_second;
+	gchar **entries;
+	guint i;
+
+	GST_OBJECT_LOCK(video_convert);
+
+	if (video_convert->engine_throughputs == NULL)
+	{
+		GST_OBJECT_UNLOCK(video_convert);
+		return throughput;
+	}
+
+	/* The list has the format "name=value,name=value,..." */
+	entries = g_strsplit(video_convert->engine_throughputs, ",", -1);
+	GST_OBJECT_UNLOCK(video_convert);
+
+	for (i = 0; entries[i] != NULL; ++i)
+	{
+		gchar **name_value = g_strsplit(entries[i], "=", 2);
+
+		if ((name_value[0] != NULL) && (name_value[1] != NULL) && (g_strcmp0(g_strstrip(name_value[0]), engine->name) == 0))
+		{
+			gchar *end;
+			gdouble value = g_ascii_strtod(name_value[1], &end);
+
+			if ((end != name_value[1]) && (value > 0.0))
+				throughput = value;
+			else
+				GST_WARNING_OBJECT(video_convert, "invalid throughput \"%s\" for engine %s; using default", name_value[1], engine->name);
+		}
+
+		g_strfreev(name_value);
+	}
+
+	g_strfreev(entries);
+
+	return throughput;
+}
+
+
+static gboolean gst_imx_video_convert_backend_supports(GstImxVideoConvertBackend *backend, GstVideoFormat in_format, gint in_width, gint in_height, GstVideoFormat out_format, gint out_width, gint out_height)
+{
+	gboolean ret;
+	GstCaps *caps;
+	GstImxVideoConvertEngine const *engine = backend->engine;
+
+	if (backend->failed)
+		return FALSE;
+
+	if ((in_width < engine->min_width) || (in_height < engine->min_height) || (in_width > engine->max_width) || (in_height > engine->max_height))
+		return FALSE;
+	if ((out_width < engine->min_width) || (out_height < engine->min_height) || (out_width > engine->max_width) || (out_height > engine->max_height))
+		return FALSE;
+	if (((in_width != out_width) || (in_height != out_height)) && !(engine->capabilities & GST_IMX_DISPATCH_BLITTER_CAPABILITY_SCALING))
+		return FALSE;
+
+	caps = gst_caps_new_simple(
+		"video/x-raw",
+		"format", G_TYPE_STRING, gst_video_format_to_string(in_format),
+		"width", G_TYPE_INT, in_width,
+		"height", G_TYPE_INT, in_height,
+		NULL
+	);
+	ret = gst_caps_can_intersect(caps, backend->sink_caps);
+	gst_caps_unref(caps);
+
+	if (!ret)
+		return FALSE;
+
+	caps = gst_caps_new_simple(
+		"video/x-raw",
+		"format", G_TYPE_STRING, gst_video_format_to_string(out_format),
+		"width", G_TYPE_INT, out_width,
+		"height", G_TYPE_INT, out_height,
+		NULL
+	);
+	ret = gst_caps_can_intersect(caps, backend->src_caps);
+	gst_caps_unref(caps);
+
+	return ret;
+}
+
+
+static gdouble gst_imx_video_convert_estimate_cost(GstImxVideoConvertBackend *backend, gint in_width, gint in_height, gint out_width, gint out_height)
+{
+	gdouble megapixels = ((gdouble)in_width * in_height + (gdouble)out_width * out_height) / 1000000.0;
+	return megapixels / backend->megapixels_per_second * 1000.0;
+}
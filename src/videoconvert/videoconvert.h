@@ -0,0 +1,155 @@
+/* Auto-selecting i.MX video convert element
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#ifndef GST_IMX_VIDEOCONVERT_H
+#define GST_IMX_VIDEOCONVERT_H
+
+
+#include <gst/gst.h>
+#include "../common/blitter_video_transform.h"
+#include "../common/dispatch_blitter.h"
+#include "../common/phys_mem_caps.h"
+
+
+G_BEGIN_DECLS
+
+
+typedef struct _GstImxVideoConvert GstImxVideoConvert;
+typedef struct _GstImxVideoConvertClass GstImxVideoConvertClass;
+typedef struct _GstImxVideoConvertEngine GstImxVideoConvertEngine;
+typedef struct _GstImxVideoConvertBackend GstImxVideoConvertBackend;
+
+
+#define GST_TYPE_IMX_VIDEO_CONVERT             (gst_imx_video_convert_get_type())
+#define GST_IMX_VIDEO_CONVERT(obj)             (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_IMX_VIDEO_CONVERT, GstImxVideoConvert))
+#define GST_IMX_VIDEO_CONVERT_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_IMX_VIDEO_CONVERT, GstImxVideoConvertClass))
+#define GST_IS_IMX_VIDEO_CONVERT(obj)          (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_IMX_VIDEO_CONVERT))
+#define GST_IS_IMX_VIDEO_CONVERT_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_IMX_VIDEO_CONVERT))
+
+
+/* The formats are the union of the formats supported by the IPU, G2D,
+ * PxP, and software blitters. Which conversions are actually possible
+ * depends on which engines are present; this is checked when caps are set. */
+#define GST_IMX_VIDEO_CONVERT_VIDEO_FORMATS \
+	" { " \
+	"   RGB16 " \
+	" , BGR " \
+	" , RGB " \
+	" , BGRx " \
+	" , BGRA " \
+	" , RGBx " \
+	" , RGBA " \
+	" , ABGR " \
+	" , UYVY " \
+	" , YUY2 " \
+	" , YVYU " \
+	" , v308 " \
+	" , NV12 " \
+	" , NV21 " \
+	" , YV12 " \
+	" , I420 " \
+	" , Y42B " \
+	" , Y444 " \
+	" , GRAY8 " \
+	" } "
+
+#define GST_IMX_VIDEO_CONVERT_CAPS \
+	GST_STATIC_CAPS( \
+		GST_IMX_PHYS_MEM_VIDEO_CAPS_MAKE( \
+			"format = (string) " GST_IMX_VIDEO_CONVERT_VIDEO_FORMATS ", " \
+			"width = (int) [ 1, MAX ], " \
+			"height = (int) [ 1, MAX ], " \
+			"framerate = (fraction) [ 0, MAX ]" \
+		) \
+	)
+
+
+/**
+ * GstImxVideoConvertEngine:
+ *
+ * Entry in the capability and cost table. Formats are not part of the
+ * table; they are taken from the pad templates of the engine's video
+ * transform element. megapixels_per_second is the default throughput
+ * of a combined scale + color space conversion blit, with the number
+ * of input and output pixels added together; it can be overridden with
+ * the engine-throughputs property. capabilities lists the transforms
+ * the engine supports.
+ */
+struct _GstImxVideoConvertEngine
+{
+	gchar const *name;
+	gchar const *factory_name;
+	gint min_width, min_height, max_width, max_height;
+	gdouble megapixels_per_second;
+	GstImxDispatchBlitterCapabilities capabilities;
+};
+
+
+/**
+ * GstImxVideoConvertBackend:
+ *
+ * An engine which is available at runtime. The engine's video transform
+ * element is switched to the READY state (which creates its blitter and
+ * opens the device behind it) only while the engine is selected; blitter
+ * is NULL otherwise. failed is set if the element could not be started,
+ * which excludes the engine from the selection.
+ */
+struct _GstImxVideoConvertBackend
+{
+	GstImxVideoConvertEngine const *engine;
+	GstElement *element;
+	GstImxBaseBlitter *blitter;
+	GstCaps *sink_caps, *src_caps;
+	gdouble megapixels_per_second;
+	gboolean failed;
+};
+
+
+struct _GstImxVideoConvert
+{
+	GstImxBlitterVideoTransform parent;
+
+	/* Array of GstImxVideoConvertBackend pointers, in order of the engine table */
+	GPtrArray *backends;
+
+	/* Description of the currently used backend(s), for example "ipu" or
+	 * "ipu+g2d" for a two-stage chain; NULL if none is selected yet.
+	 * Protected by the object lock, like estimated_cost. */
+	gchar *selected_backend;
+	/* Estimated time in milliseconds needed for converting one frame */
+	gdouble estimated_cost;
+
+	/* Value of the engine-throughputs property; protected by the object lock */
+	gchar *engine_throughputs;
+};
+
+
+struct _GstImxVideoConvertClass
+{
+	GstImxBlitterVideoTransformClass parent_class;
+};
+
+
+GType gst_imx_video_convert_get_type(void);
+
+
+G_END_DECLS
+
+
+#endif
@@ -28,6 +28,7 @@
 #include "allocator.h"
 #include "../mem_blocks.h"
 #include "../common/phys_mem_meta.h"
+#include "../common/phys_mem_caps.h"
 #include "../utils.h"
 #include "../fb_buffer_pool.h"
 
@@ -75,21 +76,23 @@
  * The main problem with the VPU's way of handling output buffers is the case where all framebuffers are occupied.
  * Then, the wrapper cannot pick a framebuffer to decode into, and decoding fails. This can easily happen if
  * the GStreamer pipeline uses queues and downstream is not consuming the frames fast enough for some reason.
- * To counter this effect, a condition variable is used, which causes the handle_frame() function to wait until
- * a certain number of buffers are available. (One buffer is not enough sometimes.) A counter is used (called
- * "num_available_framebuffers"). This counts the number of available framebuffers, and initially equals the
- * number of allocated framebuffers. Every time VPU_DecDecodeBuf() reports that a frame was consumed (NOTE: not
- * to be confused with "a frame was decoded"), the counter is decremented. If the handle_frame() function is
- * entered with a num_available_framebuffers value that is less than the required minimum (checked by
- * gst_imx_vpu_framebuffers_wait_until_frames_available() ), the decoder waits until the condition variable is
- * signaled. A release_buffer() implementation inside fb_buffer_pool.c incremens the counter, and signals the
- * condition. The condition is also signaled if for some other reason the decoder should no longer wait
- * (for example, when stopping, or when switching format).
+ * To counter this effect, the handle_frame() function waits until a certain number of buffers are available.
+ * (One buffer is not enough sometimes.) A counter is used (called "num_available_framebuffers"). This counts the
+ * number of available framebuffers, and initially equals the number of allocated framebuffers. Every time
+ * VPU_DecDecodeBuf() reports that a frame was consumed (NOTE: not to be confused with "a frame was decoded"), the
+ * counter is decremented. If the handle_frame() function is entered with a num_available_framebuffers value that
+ * is less than the required minimum (checked by gst_imx_vpu_framebuffers_wait_until_frames_available() ), the
+ * decoder sleeps until it is woken up. A release_buffer() implementation inside fb_buffer_pool.c marks the
+ * framebuffer as released and wakes up the decoder, which then hands the framebuffer back to the VPU and
+ * increments the counter. (The release_buffer() function does not call the VPU wrapper itself, since the wrapper
+ * is not thread safe, and it would then have to wait for the decoder to finish VPU_DecDecodeBuf().) The decoder is
+ * also woken up if for some other reason it should no longer wait (for example, when stopping, or when switching
+ * format).
  *
  * Two additional counters exist: decremented_availbuf_counter and num_framebuffers_in_buffers . The former
  * counts the times num_available_framebuffers has been decremented. This is necessary to make sure the
- * value of num_available_framebuffers is not decremented in the release_buffer vfunc (in fb_buffer_pool.c) unless
- * it is required.
+ * value of num_available_framebuffers is not incremented when released framebuffers are handed back to the VPU
+ * unless it is required.
  * num_framebuffers_in_buffers counts how many VPU framebuffers are currently inside GstBuffers and have not been
  * made available again by calling VPU_DecOutFrameDisplayed() yet. This counter is necessary to handle the case
  * when recalculate_num_avail_framebuffers is true. Then, the value of num_additional_framebuffers is calculated
@@ -102,18 +105,27 @@
  * the VPU wrapper directly, but currently, no such function is present in the wrapper API, and without this
  * number, it is not possible to let the decoder wait until enough frames are free..)
  *
- * Currently, the minimum number of free output framebuffers is 6, meaning that the num_available_framebuffers
- * counter must always be at least at that value. Combined with the maximum number of frames h.264 could require
- * with frame reordering (which is 17 frames), this means that up to 23 frames will have to be allocated with the
- * physical memory allocators. For 1080p videos, this means (23*1920*1088*12/8 / 1048576) byte ~ 69 MB.
+ * The minimum number of free output framebuffers (the value the num_available_framebuffers counter must always
+ * be at least at) is chosen when the framebuffers are allocated. It is derived from the minimum number of buffers
+ * downstream requests in an allocation query, since that is how many frames downstream holds, and lies between
+ * GST_IMX_VPU_MIN_NUM_FREE_FRAMEBUFFERS (2) and GST_IMX_VPU_MAX_NUM_FREE_FRAMEBUFFERS (16). If the decoder had to
+ * wait for free framebuffers for an unusually long time (see gst_imx_vpu_framebuffers_wait_until_frames_available()),
+ * one more framebuffer is allocated the next time the framebuffers are allocated. Since the VPU wrapper cannot
+ * register additional framebuffers, a set in use cannot be extended; instead, the decoder is reopened at the next
+ * keyframe, which allocates a new set. This is only done if the stream headers are in the codec data (or if the
+ * stream has none, as with motion JPEG), since the new VPU instance must parse them again, and headers are not
+ * necessarily repeated in the stream. For other streams, the larger set is allocated at the next renegotiation.
+ * In the worst case, combined with the maximum number of frames h.264 could require with frame reordering (which
+ * is 17 frames), this means that up to 33 frames will have to be allocated with the physical memory allocators.
+ * For 1080p videos, this means (33*1920*1088*12/8 / 1048576) byte ~ 99 MB. Typically though, downstream holds
+ * one or two frames, so only 2 or 3 framebuffers are kept free instead of the 6 which used to be hard-coded.
  * (1088, because the VPU needs width and height values to be aligned to 16-pixel boundaries, and 12/8, because
  * 12 bit is the bit depth for the I420 format, 12/8 is the number of bytes per pixel. While the decoder can also
  * output I42B and Y444 for motion JPEG, it won't use that many frames then, so 12 bit is still a good pick.)
- * Adding the typical sizes of extra decoding buffers requested by the VPU, this sums up to 72 MB.
- * Therefore, it is recommended to make sure at least 72 MB RAM are available for a decoder instance. If multiple
- * streams need to be decoded at the same time, each one must have up to 72 MB available. This ensures the
- * decoder instance(s) can handle any kind of input stream. (In special cases the RAM usage might be
- * substantially less of course.)
+ * Adding the typical sizes of extra decoding buffers requested by the VPU, this sums up to 102 MB in the worst
+ * case. If multiple streams need to be decoded at the same time, each one can need up to that amount. (In
+ * practice, the RAM usage is substantially less, since streams rarely use 17 reference frames, and downstream
+ * rarely holds many frames.)
  */
 
 
@@ -132,6 +144,12 @@ enum
 
 #define DEFAULT_NUM_ADDITIONAL_FRAMEBUFFERS 0
 
+/* How late a frame must be for the decoder to skip all P and B frames, and
+ * to skip everything except keyframes, respectively. Any lateness causes
+ * non-reference B frames to be skipped. */
+#define QOS_NON_I_FRAMES_SKIP_LATENESS (100 * GST_MSECOND)
+#define QOS_NON_KEYFRAMES_SKIP_LATENESS (500 * GST_MSECOND)
+
 
 #define ALIGN_VAL_TO(LENGTH, ALIGN_SIZE)  ( ((guintptr)((LENGTH) + (ALIGN_SIZE) - 1) / (ALIGN_SIZE)) * (ALIGN_SIZE) )
 
@@ -199,12 +217,13 @@ static GstStaticPadTemplate static_src_template = GST_STATIC_PAD_TEMPLATE(
 	GST_PAD_SRC,
 	GST_PAD_ALWAYS,
 	GST_STATIC_CAPS(
-		"video/x-raw,"
-		"format = (string) { I420, I42B, Y444 }, "
-		"width = (int) [ 16, MAX ], "
-		"height = (int) [ 16, MAX ], "
-		"framerate = (fraction) [ 0, MAX ], "
-		"interlace-mode = { progressive, interleaved } "
+		GST_IMX_PHYS_MEM_VIDEO_CAPS_MAKE(
+			"format = (string) { I420, NV12, I42B, Y444 }, "
+			"width = (int) [ 16, MAX ], "
+			"height = (int) [ 16, MAX ], "
+			"framerate = (fraction) [ 0, MAX ], "
+			"interlace-mode = { progressive, interleaved } "
+		)
 	)
 );
 
@@ -216,6 +235,10 @@ G_DEFINE_TYPE(GstImxVpuDec, gst_imx_vpu_dec, GST_TYPE_VIDEO_DECODER)
 static gboolean gst_imx_vpu_dec_alloc_dec_mem_blocks(GstImxVpuDec *vpu_dec);
 static gboolean gst_imx_vpu_dec_free_dec_mem_blocks(GstImxVpuDec *vpu_dec);
 static gboolean gst_imx_vpu_dec_fill_param_set(GstImxVpuDec *vpu_dec, GstVideoCodecState *state, VpuDecOpenParam *open_param, GstBuffer **codec_data);
+static gboolean gst_imx_vpu_dec_downstream_prefers_nv12(GstImxVpuDec *vpu_dec);
+static guint gst_imx_vpu_dec_query_downstream_min_buffers(GstImxVpuDec *vpu_dec, GstVideoFormat fmt);
+static void gst_imx_vpu_dec_set_skip_level(GstImxVpuDec *vpu_dec, GstImxVpuDecSkipLevel skip_level);
+static void gst_imx_vpu_dec_update_skip_level(GstImxVpuDec *vpu_dec, GstVideoCodecFrame *frame);
 static void gst_imx_vpu_dec_close_decoder(GstImxVpuDec *vpu_dec);
 
 /* functions for the base class */
@@ -291,10 +314,15 @@ void gst_imx_vpu_dec_class_init(GstImxVpuDecClass *klass)
 void gst_imx_vpu_dec_init(GstImxVpuDec *vpu_dec)
 {
 	vpu_dec->vpu_inst_opened = FALSE;
+	vpu_dec->chroma_interleave = FALSE;
+	vpu_dec->skip_level = GST_IMX_VPU_DEC_SKIP_LEVEL_NONE;
 
 	vpu_dec->codec_data = NULL;
 	vpu_dec->current_framebuffers = NULL;
 	vpu_dec->num_additional_framebuffers = DEFAULT_NUM_ADDITIONAL_FRAMEBUFFERS;
+	vpu_dec->num_free_framebuffers = GST_IMX_VPU_MIN_NUM_FREE_FRAMEBUFFERS;
+	vpu_dec->num_starvation_framebuffers = 0;
+	vpu_dec->input_state = NULL;
 	vpu_dec->recalculate_num_avail_framebuffers = FALSE;
 	vpu_dec->current_output_state = NULL;
 
@@ -613,7 +641,11 @@ static gboolean gst_imx_vpu_dec_fill_param_set(GstImxVpuDec *vpu_dec, GstVideoCo
 	if (!format_set)
 		return FALSE;
 
-	open_param->nChromaInterleave = 0;
+	/* Motion JPEG is always decoded to planar frames, since the VPU only
+	 * interleaves 4:2:0 chroma, and the chroma subsampling of Motion JPEG
+	 * streams is not known before the first frame was parsed */
+	vpu_dec->chroma_interleave = (open_param->CodecFormat != VPU_V_MJPG) && gst_imx_vpu_dec_downstream_prefers_nv12(vpu_dec);
+	open_param->nChromaInterleave = vpu_dec->chroma_interleave ? 1 : 0;
 	open_param->nMapType = 0;
 	open_param->nTiled2LinearEnable = 0;
 	open_param->nEnableFileMode = 0;
@@ -626,6 +658,181 @@ static gboolean gst_imx_vpu_dec_fill_param_set(GstImxVpuDec *vpu_dec, GstVideoCo
 }
 
 
+static gboolean gst_imx_vpu_dec_downstream_prefers_nv12(GstImxVpuDec *vpu_dec)
+{
+	GstPad *srcpad;
+	GstCaps *template_caps, *unfiltered_peer_caps, *peer_caps;
+	guint structure_nr, value_nr;
+	gboolean prefers_nv12 = FALSE, found = FALSE;
+
+	/* The VPU can output I420 or NV12 frames for all formats except Motion JPEG.
+	 * Whichever of the two comes first in the downstream caps is used. If
+	 * downstream does not care (or if there is no downstream peer yet), the
+	 * template caps order applies, which puts I420 first.
+	 * The peer is queried without a filter, since peers intersect their caps
+	 * with the filter first, which keeps the filter's (that is, this element's)
+	 * format order. The intersection with the template caps is instead done
+	 * here, with the peer caps first, so the downstream order is preserved. */
+
+	srcpad = GST_VIDEO_DECODER_SRC_PAD(vpu_dec);
+	template_caps = gst_pad_get_pad_template_caps(srcpad);
+	unfiltered_peer_caps = gst_pad_peer_query_caps(srcpad, NULL);
+	peer_caps = gst_caps_intersect_full(unfiltered_peer_caps, template_caps, GST_CAPS_INTERSECT_FIRST);
+	gst_caps_unref(unfiltered_peer_caps);
+	gst_caps_unref(template_caps);
+
+	for (structure_nr = 0; !found && (structure_nr < gst_caps_get_size(peer_caps)); ++structure_nr)
+	{
+		GValue const *formats = gst_structure_get_value(gst_caps_get_structure(peer_caps, structure_nr), "format");
+		if (formats == NULL)
+			continue;
+
+		if (G_VALUE_HOLDS_STRING(formats))
+		{
+			gchar const *format = g_value_get_string(formats);
+			found = (g_strcmp0(format, "NV12") == 0) || (g_strcmp0(format, "I420") == 0);
+			prefers_nv12 = (g_strcmp0(format, "NV12") == 0);
+		}
+		else if (GST_VALUE_HOLDS_LIST(formats))
+		{
+			for (value_nr = 0; !found && (value_nr < gst_value_list_get_size(formats)); ++value_nr)
+			{
+				GValue const *value = gst_value_list_get_value(formats, value_nr);
+				gchar const *format;
+
+				if (!G_VALUE_HOLDS_STRING(value))
+					continue;
+
+				format = g_value_get_string(value);
+				found = (g_strcmp0(format, "NV12") == 0) || (g_strcmp0(format, "I420") == 0);
+				prefers_nv12 = (g_strcmp0(format, "NV12") == 0);
+			}
+		}
+	}
+
+	gst_caps_unref(peer_caps);
+
+	GST_INFO_OBJECT(vpu_dec, "downstream prefers %s", prefers_nv12 ? "NV12" : "I420");
+
+	return prefers_nv12;
+}
+
+
+static guint gst_imx_vpu_dec_query_downstream_min_buffers(GstImxVpuDec *vpu_dec, GstVideoFormat fmt)
+{
+	GstVideoInfo info;
+	GstCaps *caps;
+	GstQuery *query;
+	guint i, min_buffers = 0;
+
+	/* The framebuffers are allocated before the output caps are negotiated
+	 * (see the notes at the top), so decide_allocation's query cannot be used
+	 * here. Instead, downstream is asked with a separate allocation query for
+	 * caps describing the upcoming frames. Elements which do not answer it
+	 * (for example, because they are not negotiated yet) are assumed to hold
+	 * no frames.
+	 * A latency query is not used, since sinks answer it with the upstream
+	 * latency, which says nothing about the frames held downstream. */
+	gst_video_info_set_format(&info, fmt, vpu_dec->init_info.nPicWidth, vpu_dec->init_info.nPicHeight);
+	caps = gst_video_info_to_caps(&info);
+	query = gst_query_new_allocation(caps, TRUE);
+
+	if (gst_pad_peer_query(GST_VIDEO_DECODER_SRC_PAD(vpu_dec), query))
+	{
+		for (i = 0; i < gst_query_get_n_allocation_pools(query); ++i)
+		{
+			guint pool_min_buffers;
+			gst_query_parse_nth_allocation_pool(query, i, NULL, NULL, &pool_min_buffers, NULL);
+			min_buffers = MAX(min_buffers, pool_min_buffers);
+		}
+	}
+	else
+		GST_DEBUG_OBJECT(vpu_dec, "downstream did not answer allocation query");
+
+	gst_query_unref(query);
+	gst_caps_unref(caps);
+
+	return min_buffers;
+}
+
+
+static void gst_imx_vpu_dec_set_skip_level(GstImxVpuDec *vpu_dec, GstImxVpuDecSkipLevel skip_level)
+{
+	/* Keyframes-only uses the VPU's P and B frame skipping as well; the
+	 * non-keyframe I frames are dropped by handle_frame() before decoding */
+	static int const skip_modes[] =
+	{
+		VPU_DEC_SKIPNONE,
+		VPU_DEC_SKIPB,
+		VPU_DEC_SKIPPB,
+		VPU_DEC_SKIPPB
+	};
+	static gchar const *skip_level_names[] =
+	{
+		"none",
+		"B frames",
+		"non-I frames",
+		"non-keyframes"
+	};
+	VpuDecRetCode ret;
+	int config_param;
+
+	if (skip_level == vpu_dec->skip_level)
+		return;
+
+	config_param = skip_modes[skip_level];
+	ret = VPU_DecConfig(vpu_dec->handle, VPU_DEC_CONF_SKIPMODE, &config_param);
+	if (ret != VPU_DEC_RET_SUCCESS)
+	{
+		GST_WARNING_OBJECT(vpu_dec, "could not configure skip mode: %s", gst_imx_vpu_strerror(ret));
+		return;
+	}
+
+	GST_DEBUG_OBJECT(vpu_dec, "changed skip level from \"%s\" to \"%s\"", skip_level_names[vpu_dec->skip_level], skip_level_names[skip_level]);
+
+	vpu_dec->skip_level = skip_level;
+}
+
+
+static void gst_imx_vpu_dec_update_skip_level(GstImxVpuDec *vpu_dec, GstVideoCodecFrame *frame)
+{
+	GstClockTimeDiff max_decode_time;
+	GstImxVpuDecSkipLevel skip_level;
+
+	/* The base class keeps track of the QoS events from downstream. The
+	 * maximum decode time is negative if the frame is already late, and
+	 * G_MAXINT64 if no QoS information is available. */
+	max_decode_time = gst_video_decoder_get_max_decode_time(GST_VIDEO_DECODER(vpu_dec), frame);
+
+	if (max_decode_time < -QOS_NON_KEYFRAMES_SKIP_LATENESS)
+		skip_level = GST_IMX_VPU_DEC_SKIP_LEVEL_NON_KEYFRAMES;
+	else if (max_decode_time < -QOS_NON_I_FRAMES_SKIP_LATENESS)
+		skip_level = GST_IMX_VPU_DEC_SKIP_LEVEL_NON_I_FRAMES;
+	else if (max_decode_time < 0)
+		skip_level = GST_IMX_VPU_DEC_SKIP_LEVEL_B_FRAMES;
+	else
+		skip_level = GST_IMX_VPU_DEC_SKIP_LEVEL_NONE;
+
+	if (skip_level > vpu_dec->skip_level)
+	{
+		GST_LOG_OBJECT(vpu_dec, "frame is late by %" GST_TIME_FORMAT "; skipping more frames", GST_TIME_ARGS(-max_decode_time));
+		gst_imx_vpu_dec_set_skip_level(vpu_dec, skip_level);
+	}
+	else if (skip_level < vpu_dec->skip_level)
+	{
+		/* Above the B frame level, reference frames were skipped, and
+		 * the frames following them until the next keyframe would refer
+		 * to missing data. Therefore, these levels are only lowered at
+		 * keyframes. Non-reference B frames are not used by any other
+		 * frame, so skipping them can be stopped at any time. */
+		if (GST_VIDEO_CODEC_FRAME_IS_SYNC_POINT(frame))
+			gst_imx_vpu_dec_set_skip_level(vpu_dec, skip_level);
+		else if (vpu_dec->skip_level == GST_IMX_VPU_DEC_SKIP_LEVEL_B_FRAMES)
+			gst_imx_vpu_dec_set_skip_level(vpu_dec, GST_IMX_VPU_DEC_SKIP_LEVEL_NONE);
+	}
+}
+
+
 static void gst_imx_vpu_dec_close_decoder(GstImxVpuDec *vpu_dec)
 {
 	VpuDecRetCode dec_ret;
@@ -683,6 +890,8 @@ static gboolean gst_imx_vpu_dec_start(GstVideoDecoder *decoder)
 
 	vpu_dec->frame_table = g_hash_table_new(NULL, NULL);
 
+	vpu_dec->num_starvation_framebuffers = 0;
+
 	/* Allocate the work buffers
 	 * Note that these are independent of decoder instances, so they
 	 * are allocated before the VPU_DecOpen() call, and are not
@@ -738,6 +947,12 @@ static gboolean gst_imx_vpu_dec_stop(GstVideoDecoder *decoder)
 		vpu_dec->current_output_state = NULL;
 	}
 
+	if (vpu_dec->input_state != NULL)
+	{
+		gst_video_codec_state_unref(vpu_dec->input_state);
+		vpu_dec->input_state = NULL;
+	}
+
 	if (vpu_dec->frame_table != NULL)
 	{
 		g_hash_table_destroy(vpu_dec->frame_table);
@@ -779,6 +994,14 @@ static gboolean gst_imx_vpu_dec_set_format(GstVideoDecoder *decoder, GstVideoCod
 		GST_IMX_VPU_FRAMEBUFFERS_LOCK(vpu_dec->current_framebuffers);
 		gst_imx_vpu_framebuffers_set_flushing(vpu_dec->current_framebuffers, TRUE);
 		vpu_dec->current_framebuffers->decenc_states.dec.decoder_open = FALSE;
+
+		/* If the old set starved, keep one more framebuffer free in the next one */
+		if ((vpu_dec->current_framebuffers->num_starvations > 0) && (vpu_dec->num_free_framebuffers < GST_IMX_VPU_MAX_NUM_FREE_FRAMEBUFFERS))
+		{
+			vpu_dec->num_starvation_framebuffers++;
+			GST_INFO_OBJECT(decoder, "framebuffers starved %u time(s); allocating %u extra framebuffer(s) from now on", vpu_dec->current_framebuffers->num_starvations, vpu_dec->num_starvation_framebuffers);
+		}
+
 		GST_IMX_VPU_FRAMEBUFFERS_UNLOCK(vpu_dec->current_framebuffers);
 
 		gst_object_unref(vpu_dec->current_framebuffers);
@@ -837,6 +1060,7 @@ static gboolean gst_imx_vpu_dec_set_format(GstVideoDecoder *decoder, GstVideoCod
 		GST_ERROR_OBJECT(vpu_dec, "could not configure skip mode: %s", gst_imx_vpu_strerror(ret));
 		return FALSE;
 	}
+	vpu_dec->skip_level = GST_IMX_VPU_DEC_SKIP_LEVEL_NONE;
 
 	config_param = 0;
 	ret = VPU_DecConfig(vpu_dec->handle, VPU_DEC_CONF_BUFDELAY, &config_param);
@@ -857,6 +1081,15 @@ static gboolean gst_imx_vpu_dec_set_format(GstVideoDecoder *decoder, GstVideoCod
 	/* Ref the output state, to be able to add information from the init_info structure to it later */
 	vpu_dec->current_output_state = gst_video_codec_state_ref(state);
 
+	/* Keep the input state for reopening the decoder; state may be the old
+	 * input_state itself, so it is ref'd before the old one is unref'd */
+	{
+		GstVideoCodecState *old_input_state = vpu_dec->input_state;
+		vpu_dec->input_state = gst_video_codec_state_ref(state);
+		if (old_input_state != NULL)
+			gst_video_codec_state_unref(old_input_state);
+	}
+
 	/* Copy the buffer, to make sure the codec_data lifetime does not depend on the caps */
 	if (codec_data != NULL)
 		vpu_dec->codec_data = gst_buffer_copy(codec_data);
@@ -878,12 +1111,60 @@ static GstFlowReturn gst_imx_vpu_dec_handle_frame(GstVideoDecoder *decoder, GstV
 
 	vpu_dec = GST_IMX_VPU_DEC(decoder);
 
+	/* If the current framebuffer set starved, reopen the decoder at this
+	 * keyframe, so that a set with one more free framebuffer is allocated
+	 * (see the explanation at the top of this file). set_format() drains
+	 * the frames decoded so far before closing the old VPU instance. */
+	if ((cur_frame != NULL) && GST_VIDEO_CODEC_FRAME_IS_SYNC_POINT(cur_frame) && (vpu_dec->current_framebuffers != NULL) && (vpu_dec->input_state != NULL) && ((vpu_dec->codec_data != NULL) || vpu_dec->is_mjpeg))
+	{
+		guint num_starvations;
+
+		GST_IMX_VPU_FRAMEBUFFERS_LOCK(vpu_dec->current_framebuffers);
+		num_starvations = vpu_dec->current_framebuffers->num_starvations;
+		GST_IMX_VPU_FRAMEBUFFERS_UNLOCK(vpu_dec->current_framebuffers);
+
+		if ((num_starvations > 0) && (vpu_dec->num_free_framebuffers < GST_IMX_VPU_MAX_NUM_FREE_FRAMEBUFFERS))
+		{
+			GST_INFO_OBJECT(vpu_dec, "framebuffers starved; reopening decoder at keyframe to allocate more framebuffers");
+			if (!gst_imx_vpu_dec_set_format(decoder, vpu_dec->input_state))
+			{
+				GST_ERROR_OBJECT(vpu_dec, "could not reopen decoder with more framebuffers");
+				return GST_FLOW_ERROR;
+			}
+		}
+	}
+
+	/* If downstream is falling behind, skip frames instead of decoding
+	 * frames which arrive too late anyway. This is only done after the
+	 * VPU parsed the stream headers and the framebuffers were set up. */
+	if ((cur_frame != NULL) && (vpu_dec->current_framebuffers != NULL))
+	{
+		gst_imx_vpu_dec_update_skip_level(vpu_dec, cur_frame);
+
+		/* The VPU has no mode for skipping non-keyframe I frames, so
+		 * these are dropped here. The base class posts a QoS message for
+		 * each dropped frame, containing the number of decoded and
+		 * dropped frames. */
+		if ((vpu_dec->skip_level == GST_IMX_VPU_DEC_SKIP_LEVEL_NON_KEYFRAMES) && !GST_VIDEO_CODEC_FRAME_IS_SYNC_POINT(cur_frame))
+		{
+			GST_LOG_OBJECT(vpu_dec, "skipping non-keyframe input frame");
+			gst_video_decoder_drop_frame(decoder, cur_frame);
+			return GST_FLOW_OK;
+		}
+	}
+
 	memset(&in_data, 0, sizeof(in_data));
 
 	if (cur_frame != NULL)
 	{
 		gst_buffer_map(cur_frame->input_buffer, &in_map_info, GST_MAP_READ);
 
+		/* The VPU wrapper runs in stream mode, in which it ignores pPhyAddr
+		 * and always copies the access unit from pVirAddr into its own
+		 * bitstream buffer. (Only file mode reads pPhyAddr, but that mode
+		 * is not used, since it requires exactly one complete frame per
+		 * VPU_DecDecodeBuf() call.) Physically contiguous input therefore
+		 * would not avoid the copy. */
 		in_data.pPhyAddr = NULL;
 		in_data.pVirAddr = (unsigned char *)(in_map_info.data);
 		in_data.nSize = in_map_info.size;
@@ -902,16 +1183,18 @@ static GstFlowReturn gst_imx_vpu_dec_handle_frame(GstVideoDecoder *decoder, GstV
 		GST_LOG_OBJECT(vpu_dec, "setting extra codec data (%d byte)", codecdata_map_info.size);
 	}
 
-	/* Using a mutex here, since the VPU_DecDecodeBuf() call internally picks an
-	 * available framebuffer, and at the same time, the bufferpool release() function
-	 * might be returning a framebuffer to the list of available ones */
+	/* Using a mutex here, since the VPU wrapper is not thread safe, and the VPU
+	 * framebuffers might be accessed by other threads (during flushing for example).
+	 * Framebuffers released downstream in the meantime are handed back to the
+	 * VPU first, so VPU_DecDecodeBuf() can pick one of them */
 	if (vpu_dec->current_framebuffers != NULL)
 	{
 		GST_IMX_VPU_FRAMEBUFFERS_LOCK(vpu_dec->current_framebuffers);
+		gst_imx_vpu_framebuffers_return_released(vpu_dec->current_framebuffers);
 		dec_ret = VPU_DecDecodeBuf(vpu_dec->handle, &in_data, &buffer_ret_code);
 		if (vpu_dec->recalculate_num_avail_framebuffers)
 		{
-			vpu_dec->current_framebuffers->num_available_framebuffers = vpu_dec->current_framebuffers->num_framebuffers - vpu_dec->current_framebuffers->num_framebuffers_in_buffers;
+			g_atomic_int_set(&(vpu_dec->current_framebuffers->num_available_framebuffers), vpu_dec->current_framebuffers->num_framebuffers - g_atomic_int_get(&(vpu_dec->current_framebuffers->num_framebuffers_in_buffers)));
 			vpu_dec->recalculate_num_avail_framebuffers = FALSE;
 		}
 		GST_IMX_VPU_FRAMEBUFFERS_UNLOCK(vpu_dec->current_framebuffers);
@@ -959,7 +1242,7 @@ static GstFlowReturn gst_imx_vpu_dec_handle_frame(GstVideoDecoder *decoder, GstV
 			}
 		}
 		else
-			fmt = GST_VIDEO_FORMAT_I420;
+			fmt = vpu_dec->chroma_interleave ? GST_VIDEO_FORMAT_NV12 : GST_VIDEO_FORMAT_I420;
 
 		GST_LOG_OBJECT(vpu_dec, "using %s as video output format", gst_video_format_to_string(fmt));
 
@@ -970,10 +1253,21 @@ static GstFlowReturn gst_imx_vpu_dec_handle_frame(GstVideoDecoder *decoder, GstV
 			guint min_fbcount_indicated_by_vpu;
 			GstImxVpuFramebufferParams fbparams;
 			gst_imx_vpu_framebuffers_dec_init_info_to_params(&(vpu_dec->init_info), &fbparams);
+			fbparams.chroma_interleave = vpu_dec->chroma_interleave;
 
 			min_fbcount_indicated_by_vpu = (guint)(fbparams.min_framebuffer_count);
 
-			fbparams.min_framebuffer_count = min_fbcount_indicated_by_vpu + GST_IMX_VPU_MIN_NUM_FREE_FRAMEBUFFERS + vpu_dec->num_additional_framebuffers;
+			/* Keep enough framebuffers free for the frames downstream holds,
+			 * plus the one which is on its way downstream */
+			{
+				guint downstream_min_buffers = gst_imx_vpu_dec_query_downstream_min_buffers(vpu_dec, fmt);
+				vpu_dec->num_free_framebuffers = CLAMP(downstream_min_buffers + 1, GST_IMX_VPU_MIN_NUM_FREE_FRAMEBUFFERS, GST_IMX_VPU_MAX_NUM_FREE_FRAMEBUFFERS);
+				vpu_dec->num_free_framebuffers = MIN(vpu_dec->num_free_framebuffers + vpu_dec->num_starvation_framebuffers, GST_IMX_VPU_MAX_NUM_FREE_FRAMEBUFFERS);
+				GST_INFO_OBJECT(vpu_dec, "downstream holds up to %u frame(s); number of framebuffers that must be free: %u (%u because of earlier starvation)", downstream_min_buffers, vpu_dec->num_free_framebuffers, vpu_dec->num_starvation_framebuffers);
+			}
+			fbparams.min_num_free_framebuffers = vpu_dec->num_free_framebuffers;
+
+			fbparams.min_framebuffer_count = min_fbcount_indicated_by_vpu + vpu_dec->num_free_framebuffers + vpu_dec->num_additional_framebuffers;
 			GST_INFO_OBJECT(vpu_dec, "minimum number of framebuffers indicated by the VPU: %u  chosen number: %u", min_fbcount_indicated_by_vpu, fbparams.min_framebuffer_count);
 			GST_INFO_OBJECT(vpu_dec, "interlacing: %d", vpu_dec->init_info.nInterlace);
 
@@ -1005,7 +1299,15 @@ static GstFlowReturn gst_imx_vpu_dec_handle_frame(GstVideoDecoder *decoder, GstV
 			}
 
 			GST_VIDEO_INFO_INTERLACE_MODE(&(state->info)) = vpu_dec->init_info.nInterlace ? GST_VIDEO_INTERLACE_MODE_INTERLEAVED : GST_VIDEO_INTERLACE_MODE_PROGRESSIVE;
-			gst_video_decoder_set_output_state(decoder, fmt, state->info.width, state->info.height, state);
+			{
+				GstVideoCodecState *out_state = gst_video_decoder_set_output_state(decoder, fmt, state->info.width, state->info.height, state);
+
+				/* Decoded frames are always in physically contiguous memory, so announce
+				 * this to downstream if it supports the caps feature. The base class
+				 * uses these caps instead of generating system memory caps from the info. */
+				out_state->caps = gst_imx_phys_mem_caps_select_feature(GST_VIDEO_DECODER_SRC_PAD(decoder), gst_video_info_to_caps(&(out_state->info)));
+				gst_video_codec_state_unref(out_state);
+			}
 			gst_video_codec_state_unref(vpu_dec->current_output_state);
 
 			vpu_dec->current_output_state = NULL;
@@ -1055,7 +1357,7 @@ static GstFlowReturn gst_imx_vpu_dec_handle_frame(GstVideoDecoder *decoder, GstV
 	}
 
 	/* The following code block may cause a race condition if not synchronized;
-	 * the buffer pool release() function must not run at the same time */
+	 * released framebuffers must not be handed back to the VPU at the same time */
 	{
 		GST_IMX_VPU_FRAMEBUFFERS_LOCK(vpu_dec->current_framebuffers);
 
@@ -1102,14 +1404,14 @@ static GstFlowReturn gst_imx_vpu_dec_handle_frame(GstVideoDecoder *decoder, GstV
 		/* If VPU_DEC_OUTPUT_DROPPED is set, then the internal counter will not be modified */
 		if ((buffer_ret_code & VPU_DEC_ONE_FRM_CONSUMED) && !(buffer_ret_code & VPU_DEC_OUTPUT_DROPPED))
 		{
-			gint old_num_available_framebuffers = vpu_dec->current_framebuffers->num_available_framebuffers;
+			gint old_num_available_framebuffers = g_atomic_int_get(&(vpu_dec->current_framebuffers->num_available_framebuffers));
 
 			/* wait until frames are available or until flushing occurs */
 			gst_imx_vpu_framebuffers_wait_until_frames_available(vpu_dec->current_framebuffers);
 
-			vpu_dec->current_framebuffers->num_available_framebuffers--;
-			vpu_dec->current_framebuffers->decremented_availbuf_counter++;
-			GST_LOG_OBJECT(vpu_dec, "number of available buffers: %d -> %d -> %d", old_num_available_framebuffers, vpu_dec->current_framebuffers->num_available_framebuffers + 1, vpu_dec->current_framebuffers->num_available_framebuffers);
+			g_atomic_int_add(&(vpu_dec->current_framebuffers->num_available_framebuffers), -1);
+			g_atomic_int_inc(&(vpu_dec->current_framebuffers->decremented_availbuf_counter));
+			GST_LOG_OBJECT(vpu_dec, "number of available buffers: %d -> %d -> %d", old_num_available_framebuffers, g_atomic_int_get(&(vpu_dec->current_framebuffers->num_available_framebuffers)) + 1, g_atomic_int_get(&(vpu_dec->current_framebuffers->num_available_framebuffers)));
 		}
 
 		/* Unlock the mutex; the subsequent steps are safe */
@@ -1173,8 +1475,8 @@ static GstFlowReturn gst_imx_vpu_dec_handle_frame(GstVideoDecoder *decoder, GstV
 			/* wait until frames are available or until flushing occurs */
 			gst_imx_vpu_framebuffers_wait_until_frames_available(vpu_dec->current_framebuffers);
 
-			vpu_dec->current_framebuffers->num_available_framebuffers--;
-			vpu_dec->current_framebuffers->decremented_availbuf_counter++;
+			g_atomic_int_add(&(vpu_dec->current_framebuffers->num_available_framebuffers), -1);
+			g_atomic_int_inc(&(vpu_dec->current_framebuffers->decremented_availbuf_counter));
 
 			GST_IMX_VPU_FRAMEBUFFERS_UNLOCK(vpu_dec->current_framebuffers);
 		}
@@ -1318,8 +1620,8 @@ static GstFlowReturn gst_imx_vpu_dec_handle_frame(GstVideoDecoder *decoder, GstV
 			return GST_FLOW_ERROR;
 		}
 
-		vpu_dec->current_framebuffers->num_available_framebuffers++;
-		GST_DEBUG_OBJECT(vpu_dec, "number of available buffers after dropping mosaic frame: %d -> %d", vpu_dec->current_framebuffers->num_available_framebuffers - 1, vpu_dec->current_framebuffers->num_available_framebuffers);
+		g_atomic_int_inc(&(vpu_dec->current_framebuffers->num_available_framebuffers));
+		GST_DEBUG_OBJECT(vpu_dec, "number of available buffers after dropping mosaic frame: %d -> %d", g_atomic_int_get(&(vpu_dec->current_framebuffers->num_available_framebuffers)) - 1, g_atomic_int_get(&(vpu_dec->current_framebuffers->num_available_framebuffers)));
 		GST_IMX_VPU_FRAMEBUFFERS_UNLOCK(vpu_dec->current_framebuffers);
 	}
 	else if (buffer_ret_code & VPU_DEC_OUTPUT_DROPPED)
@@ -1328,6 +1630,7 @@ static GstFlowReturn gst_imx_vpu_dec_handle_frame(GstVideoDecoder *decoder, GstV
 		gst_video_codec_frame_unref(out_frame);
 		gst_video_decoder_drop_frame(decoder, out_frame);
 
+		/* This also happens for frames skipped because of the skip level */
 		GST_DEBUG_OBJECT(vpu_dec, "VPU dropped output frame internally");
 	}
 	else
@@ -1357,6 +1660,10 @@ static gboolean gst_imx_vpu_dec_flush(GstVideoDecoder *decoder)
 
 	vpu_dec->delay_sys_frame_numbers = FALSE;
 
+	/* The base class resets its QoS information when flushing; after a
+	 * seek, decoding starts again without skipping frames */
+	gst_imx_vpu_dec_set_skip_level(vpu_dec, GST_IMX_VPU_DEC_SKIP_LEVEL_NONE);
+
 	if (vpu_dec->current_framebuffers != NULL)
 	{
 		VpuDecRetCode ret = VPU_DEC_RET_SUCCESS;
@@ -1366,7 +1673,6 @@ static gboolean gst_imx_vpu_dec_flush(GstVideoDecoder *decoder)
 		GST_IMX_VPU_FRAMEBUFFERS_LOCK(vpu_dec->current_framebuffers);
 
 		gst_imx_vpu_framebuffers_exit_wait_loop(vpu_dec->current_framebuffers);
-		g_cond_signal(&(vpu_dec->current_framebuffers->cond));
 
 		if (vpu_dec->use_vpuwrapper_flush_call)
 		{
@@ -44,6 +44,21 @@ typedef struct _GstImxVpuDecClass GstImxVpuDecClass;
 #define GST_IS_IMX_VPU_DEC_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_IMX_VPU_DEC))
 
 
+/* Frame skipping levels used when downstream falls behind; each level
+ * skips more frames than the previous one */
+typedef enum
+{
+	GST_IMX_VPU_DEC_SKIP_LEVEL_NONE = 0,
+	/* skip non-reference B frames */
+	GST_IMX_VPU_DEC_SKIP_LEVEL_B_FRAMES,
+	/* skip all P and B frames */
+	GST_IMX_VPU_DEC_SKIP_LEVEL_NON_I_FRAMES,
+	/* skip everything except keyframes */
+	GST_IMX_VPU_DEC_SKIP_LEVEL_NON_KEYFRAMES
+}
+GstImxVpuDecSkipLevel;
+
+
 struct _GstImxVpuDec
 {
 	GstVideoDecoder parent;
@@ -54,6 +69,9 @@ struct _GstImxVpuDec
 	VpuMemInfo mem_info;
 
 	gboolean vpu_inst_opened, is_mjpeg, use_vpuwrapper_flush_call;
+	/* if true, the VPU outputs NV12 instead of I420 frames; chosen in
+	 * set_format() according to the format order of the downstream caps */
+	gboolean chroma_interleave;
 	VpuCodStd codec_format;
 
 	GstBuffer *codec_data;
@@ -63,6 +81,15 @@ struct _GstImxVpuDec
 	/* number of framebuffers allocated in addition to the minimum number indicated
 	 *by the VPU and the number of framebuffers that must be free at all times */
 	guint num_additional_framebuffers;
+	/* number of framebuffers which must be free before decoding; derived from
+	 * the number of frames downstream holds, plus num_starvation_framebuffers */
+	guint num_free_framebuffers;
+	/* number of framebuffers added to num_free_framebuffers because previous
+	 * framebuffer sets starved */
+	guint num_starvation_framebuffers;
+	/* input state from the last set_format() call; used for reopening the
+	 * decoder with a larger framebuffer set if the current one starved */
+	GstVideoCodecState *input_state;
 	/* if true, the number of available framebuffers will be recalculated
 	 * after the next VPU_DecDecodeBuf() call ; this value is true after the
 	 * reset() vfunc is called (not to be confused with VPU_DecReset() ) */
@@ -75,6 +102,10 @@ struct _GstImxVpuDec
 	gint last_sys_frame_number;
 	gboolean delay_sys_frame_numbers;
 
+	/* current frame skipping level; adjusted in handle_frame() according
+	 * to how late frames are, based on the QoS events from downstream */
+	GstImxVpuDecSkipLevel skip_level;
+
 	GstVideoCodecState *current_output_state;
 
 	GSList *virt_dec_mem_blocks, *phys_dec_mem_blocks;
@@ -80,6 +80,8 @@ static gboolean gst_imx_vpu_enc_alloc_phys_mem(GstImxPhysMemAllocator *allocator
 		memory->mapped_virt_addr = (gpointer)(mem_desc.nVirtAddr);
 		memory->phys_addr        = (gst_imx_phys_addr_t)(mem_desc.nPhyAddr);
 		memory->internal         = (gpointer)(mem_desc.nCpuAddr);
+		/* the VPU driver always maps its memory with write combining */
+		memory->cache_policy     = GST_IMX_PHYS_MEM_CACHE_POLICY_WRITE_COMBINED;
 
 		GST_DEBUG_OBJECT(allocator, "addresses: virt: %p phys: %" GST_IMX_PHYS_ADDR_FORMAT " cpu: %p", memory->mapped_virt_addr, memory->phys_addr, memory->internal);
 
@@ -135,6 +137,10 @@ static void gst_imx_vpu_enc_allocator_class_init(GstImxVpuEncAllocatorClass *kla
 	parent_class->map_phys_mem   = GST_DEBUG_FUNCPTR(gst_imx_vpu_enc_map_phys_mem);
 	parent_class->unmap_phys_mem = GST_DEBUG_FUNCPTR(gst_imx_vpu_enc_unmap_phys_mem);
 
+	/* the VPU library cannot export its memory, but the VPU
+	 * can use any physically contiguous memory */
+	parent_class->dmabuf_heap_backing = TRUE;
+
 	GST_DEBUG_CATEGORY_INIT(imx_vpu_enc_allocator_debug, "imxvpuencallocator", 0, "Freescale i.MX VPU encoder physical memory/allocator");
 }
 
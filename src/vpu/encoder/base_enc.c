@@ -24,6 +24,7 @@
 #include "../utils.h"
 #include "../../common/phys_mem_buffer_pool.h"
 #include "../../common/phys_mem_meta.h"
+#include "../../common/dmabuf.h"
 
 
 
@@ -47,6 +48,11 @@ enum
 #define DEFAULT_INTRA_REFRESH     0
 
 
+/* The VPU reads input frames in 16x16 macroblocks */
+#define GST_IMX_VPU_ENC_HORIZ_ALIGNMENT 16
+#define GST_IMX_VPU_ENC_VERT_ALIGNMENT  16
+
+
 #define ALIGN_VAL_TO(LENGTH, ALIGN_SIZE)  ( ((guintptr)((LENGTH) + (ALIGN_SIZE) - 1) / (ALIGN_SIZE)) * (ALIGN_SIZE) )
 
 
@@ -61,8 +67,12 @@ G_DEFINE_ABSTRACT_TYPE(GstImxVpuBaseEnc, gst_imx_vpu_base_enc, GST_TYPE_VIDEO_EN
 static gboolean gst_imx_vpu_base_enc_alloc_enc_mem_blocks(GstImxVpuBaseEnc *vpu_base_enc);
 static gboolean gst_imx_vpu_base_enc_free_enc_mem_blocks(GstImxVpuBaseEnc *vpu_base_enc);
 static void gst_imx_vpu_base_enc_close_encoder(GstImxVpuBaseEnc *vpu_base_enc);
+static void gst_imx_vpu_base_enc_release_internal_bufferpool(GstImxVpuBaseEnc *vpu_base_enc);
+static void gst_imx_vpu_base_enc_finalize(GObject *object);
 static void gst_imx_vpu_base_enc_set_property(GObject *object, guint prop_id, GValue const *value, GParamSpec *pspec);
 static void gst_imx_vpu_base_enc_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec);
+static GstStateChangeReturn gst_imx_vpu_base_enc_change_state(GstElement *element, GstStateChange transition);
+static void gst_imx_vpu_base_enc_set_context(GstElement *element, GstContext *context);
 
 /* functions for the base class */
 static gboolean gst_imx_vpu_base_enc_start(GstVideoEncoder *encoder);
@@ -70,6 +80,10 @@ static gboolean gst_imx_vpu_base_enc_stop(GstVideoEncoder *encoder);
 static gboolean gst_imx_vpu_base_enc_set_format(GstVideoEncoder *encoder, GstVideoCodecState *state);
 static GstFlowReturn gst_imx_vpu_base_enc_handle_frame(GstVideoEncoder *encoder, GstVideoCodecFrame *frame);
 static gboolean gst_imx_vpu_base_enc_propose_allocation(GstVideoEncoder *encoder, GstQuery *query);
+#if GST_CHECK_VERSION(1, 4, 0)
+static gboolean gst_imx_vpu_base_enc_sink_query(GstVideoEncoder *encoder, GstQuery *query);
+static gboolean gst_imx_vpu_base_enc_src_query(GstVideoEncoder *encoder, GstQuery *query);
+#endif
 
 
 
@@ -79,30 +93,41 @@ static gboolean gst_imx_vpu_base_enc_propose_allocation(GstVideoEncoder *encoder
 void gst_imx_vpu_base_enc_class_init(GstImxVpuBaseEncClass *klass)
 {
 	GObjectClass *object_class;
+	GstElementClass *element_class;
 	GstVideoEncoderClass *base_class;
 
 	GST_DEBUG_CATEGORY_INIT(imx_vpu_base_enc_debug, "imxvpubaseenc", 0, "Freescale i.MX VPU video encoder base class");
 
 	object_class = G_OBJECT_CLASS(klass);
+	element_class = GST_ELEMENT_CLASS(klass);
 	base_class = GST_VIDEO_ENCODER_CLASS(klass);
 
+	object_class->finalize        = GST_DEBUG_FUNCPTR(gst_imx_vpu_base_enc_finalize);
 	object_class->set_property    = GST_DEBUG_FUNCPTR(gst_imx_vpu_base_enc_set_property);
 	object_class->get_property    = GST_DEBUG_FUNCPTR(gst_imx_vpu_base_enc_get_property);
+	element_class->change_state   = GST_DEBUG_FUNCPTR(gst_imx_vpu_base_enc_change_state);
+	element_class->set_context    = GST_DEBUG_FUNCPTR(gst_imx_vpu_base_enc_set_context);
 	base_class->start             = GST_DEBUG_FUNCPTR(gst_imx_vpu_base_enc_start);
 	base_class->stop              = GST_DEBUG_FUNCPTR(gst_imx_vpu_base_enc_stop);
 	base_class->set_format        = GST_DEBUG_FUNCPTR(gst_imx_vpu_base_enc_set_format);
 	base_class->handle_frame      = GST_DEBUG_FUNCPTR(gst_imx_vpu_base_enc_handle_frame);
-
-	/* TODO: Memory-mapped writes into physically contiguous memory blocks are quite slow. This is
-	 * probably caused by the mapping type: if for example it is not mapped with write combining
-	 * enabled, random access to the memory will cause lots of wasteful cycles, explaining the
-	 * slowdown. Until this can be verified, the buffer pool is disabled; upstream does not get a
-	 * proposal for its allocation, and buffer contents end up copied over to a local physical
-	 * memory block by using memcpy(). Currently, doing that is ~3 times faster than letting
-	 * upstream write directly into physical memory blocks allocated by the proposed buffer pool.
-	 * (This also affects the IPU elements.)
+#if GST_CHECK_VERSION(1, 4, 0)
+	base_class->sink_query        = GST_DEBUG_FUNCPTR(gst_imx_vpu_base_enc_sink_query);
+	base_class->src_query         = GST_DEBUG_FUNCPTR(gst_imx_vpu_base_enc_src_query);
+#endif
+
+	/* TODO: Memory-mapped writes into physically contiguous memory blocks are quite slow. The
+	 * VPU memory is mapped with write combining, so sequential writes are fast, but random access
+	 * (which many upstream elements do) causes lots of wasteful cycles, explaining the slowdown.
+	 * Therefore, the buffer pool is disabled; upstream does not get a proposal for its allocation,
+	 * and buffer contents end up copied over to a local physical memory block by using memcpy().
+	 * Currently, doing that is ~3 times faster than letting upstream write directly into physical
+	 * memory blocks allocated by the proposed buffer pool. Both pools request write-combined
+	 * memory (see the GstImxPhysMemCachePolicy documentation), which is the right policy for
+	 * memory that the CPU only writes to.
+	 * propose_allocation therefore only publishes the VPU's alignment requirements.
 	 */
-	/*base_class->propose_allocation = GST_DEBUG_FUNCPTR(gst_imx_vpu_base_enc_propose_allocation);*/
+	base_class->propose_allocation = GST_DEBUG_FUNCPTR(gst_imx_vpu_base_enc_propose_allocation);
 
 	klass->set_open_params = NULL;
 	klass->get_output_caps = NULL;
@@ -167,8 +192,13 @@ void gst_imx_vpu_base_enc_init(GstImxVpuBaseEnc *vpu_base_enc)
 	vpu_base_enc->output_phys_buffer = NULL;
 	vpu_base_enc->framebuffers = NULL;
 
+	vpu_base_enc->pool_registry = NULL;
+
 	vpu_base_enc->internal_bufferpool = NULL;
+	vpu_base_enc->internal_bufferpool_registry = NULL;
 	vpu_base_enc->internal_input_buffer = NULL;
+	vpu_base_enc->imported_input_buffer = NULL;
+	vpu_base_enc->num_input_frame_copies = 0;
 
 	vpu_base_enc->virt_enc_mem_blocks = NULL;
 	vpu_base_enc->phys_enc_mem_blocks = NULL;
@@ -319,10 +349,11 @@ static void gst_imx_vpu_base_enc_close_encoder(GstImxVpuBaseEnc *vpu_base_enc)
 		gst_buffer_unref(vpu_base_enc->internal_input_buffer);
 		vpu_base_enc->internal_input_buffer = NULL;
 	}
-	if (vpu_base_enc->internal_bufferpool != NULL) {
-		gst_object_unref(vpu_base_enc->internal_bufferpool);
-		vpu_base_enc->internal_bufferpool = NULL;
+	if (vpu_base_enc->imported_input_buffer != NULL) {
+		gst_buffer_unref(vpu_base_enc->imported_input_buffer);
+		vpu_base_enc->imported_input_buffer = NULL;
 	}
+	gst_imx_vpu_base_enc_release_internal_bufferpool(vpu_base_enc);
 
 	if (vpu_base_enc->output_phys_buffer != NULL)
 	{
@@ -340,6 +371,25 @@ static void gst_imx_vpu_base_enc_close_encoder(GstImxVpuBaseEnc *vpu_base_enc)
 	}
 }
 
+
+static void gst_imx_vpu_base_enc_release_internal_bufferpool(GstImxVpuBaseEnc *vpu_base_enc)
+{
+	if (vpu_base_enc->internal_bufferpool == NULL)
+		return;
+
+	if (vpu_base_enc->internal_bufferpool_registry != NULL)
+	{
+		/* Shared pools must only be deactivated by the registry */
+		gst_imx_phys_mem_pool_registry_release_pool(vpu_base_enc->internal_bufferpool_registry, vpu_base_enc->internal_bufferpool);
+		gst_object_unref(GST_OBJECT(vpu_base_enc->internal_bufferpool_registry));
+		vpu_base_enc->internal_bufferpool_registry = NULL;
+	}
+	else
+		gst_object_unref(vpu_base_enc->internal_bufferpool);
+
+	vpu_base_enc->internal_bufferpool = NULL;
+}
+
 static gboolean gst_imx_vpu_base_enc_set_bitrate (GstImxVpuBaseEnc *vpu_base_enc)
 {
 	VpuEncRetCode ret;
@@ -413,6 +463,48 @@ static void gst_imx_vpu_base_enc_get_property(GObject *object, guint prop_id, GV
 }
 
 
+static void gst_imx_vpu_base_enc_finalize(GObject *object)
+{
+	GstImxVpuBaseEnc *vpu_base_enc = GST_IMX_VPU_BASE_ENC(object);
+
+	if (vpu_base_enc->pool_registry != NULL)
+		gst_object_unref(GST_OBJECT(vpu_base_enc->pool_registry));
+
+	G_OBJECT_CLASS(gst_imx_vpu_base_enc_parent_class)->finalize(object);
+}
+
+
+static GstStateChangeReturn gst_imx_vpu_base_enc_change_state(GstElement *element, GstStateChange transition)
+{
+	GstImxVpuBaseEnc *vpu_base_enc = GST_IMX_VPU_BASE_ENC(element);
+
+	switch (transition)
+	{
+		case GST_STATE_CHANGE_NULL_TO_READY:
+			/* The internal bufferpool is taken from the registry
+			 * if it is needed, so make sure the registry is there */
+			gst_imx_phys_mem_pool_registry_ensure(element, &(vpu_base_enc->pool_registry));
+			break;
+
+		default:
+			break;
+	}
+
+	return GST_ELEMENT_CLASS(gst_imx_vpu_base_enc_parent_class)->change_state(element, transition);
+}
+
+
+static void gst_imx_vpu_base_enc_set_context(GstElement *element, GstContext *context)
+{
+	GstImxVpuBaseEnc *vpu_base_enc = GST_IMX_VPU_BASE_ENC(element);
+
+	gst_imx_phys_mem_pool_registry_handle_set_context(element, context, &(vpu_base_enc->pool_registry));
+
+	if (GST_ELEMENT_CLASS(gst_imx_vpu_base_enc_parent_class)->set_context != NULL)
+		GST_ELEMENT_CLASS(gst_imx_vpu_base_enc_parent_class)->set_context(element, context);
+}
+
+
 static gboolean gst_imx_vpu_base_enc_start(GstVideoEncoder *encoder)
 {
 	VpuEncRetCode ret;
@@ -628,6 +720,20 @@ static GstFlowReturn gst_imx_vpu_base_enc_handle_frame(GstVideoEncoder *encoder,
 
 	phys_mem_meta = GST_IMX_PHYS_MEM_META_GET(frame->input_buffer);
 
+	if (vpu_base_enc->imported_input_buffer != NULL)
+	{
+		gst_buffer_unref(vpu_base_enc->imported_input_buffer);
+		vpu_base_enc->imported_input_buffer = NULL;
+	}
+
+	/* DMA-BUF buffers from other elements can be read by the VPU directly
+	 * if their physical address can be resolved */
+	if ((phys_mem_meta == NULL) && ((vpu_base_enc->imported_input_buffer = gst_imx_dmabuf_import_buffer(frame->input_buffer)) != NULL))
+	{
+		GST_LOG_OBJECT(vpu_base_enc, "imported DMA-BUF input buffer");
+		phys_mem_meta = GST_IMX_PHYS_MEM_META_GET(vpu_base_enc->imported_input_buffer);
+	}
+
 	/* If the incoming frame's buffer is not using physically contiguous memory,
 	 * it needs to be copied to the internal input buffer, otherwise the VPU
 	 * encoder cannot read the frame */
@@ -638,6 +744,7 @@ static GstFlowReturn gst_imx_vpu_base_enc_handle_frame(GstVideoEncoder *encoder,
 		GstVideoFrame temp_input_video_frame, temp_incoming_video_frame;
 
 		GST_LOG_OBJECT(vpu_base_enc, "input buffer not physically contiguous - frame copy is necessary");
+		gst_imx_phys_mem_caps_count_fallback_copy(GST_OBJECT(vpu_base_enc), &(vpu_base_enc->num_input_frame_copies));
 
 		if (vpu_base_enc->internal_input_buffer == NULL)
 		{
@@ -649,25 +756,50 @@ static GstFlowReturn gst_imx_vpu_base_enc_handle_frame(GstVideoEncoder *encoder,
 
 			if (vpu_base_enc->internal_bufferpool == NULL)
 			{
-				/* Internal bufferpool does not exist yet - create it now,
-				 * so that it can in turn create the internal input buffer */
+				/* Internal bufferpool does not exist yet - get it now,
+				 * so that it can in turn create the internal input buffer.
+				 * A shared pool from the registry is preferred, so the
+				 * copies do not occupy a set of blocks of their own. */
 
 				GstStructure *config;
 				GstCaps *caps;
 				GstAllocator *allocator;
-
-				GST_DEBUG_OBJECT(vpu_base_enc, "creating internal bufferpool");
+				GstImxPhysMemPoolRegistry *pool_registry;
 
 				caps = gst_video_info_to_caps(&(vpu_base_enc->video_info));
-				vpu_base_enc->internal_bufferpool = gst_imx_phys_mem_buffer_pool_new(FALSE);
 				allocator = gst_imx_vpu_enc_allocator_obtain();
 
-				config = gst_buffer_pool_get_config(vpu_base_enc->internal_bufferpool);
-				gst_buffer_pool_config_set_params(config, caps, vpu_base_enc->video_info.size, 2, 0);
-				gst_buffer_pool_config_set_allocator(config, allocator, NULL);
-				gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_IMX_PHYS_MEM);
-				gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_VIDEO_META);
-				gst_buffer_pool_set_config(vpu_base_enc->internal_bufferpool, config);
+				GST_OBJECT_LOCK(vpu_base_enc);
+				pool_registry = (vpu_base_enc->pool_registry != NULL) ? GST_IMX_PHYS_MEM_POOL_REGISTRY(gst_object_ref(GST_OBJECT(vpu_base_enc->pool_registry))) : NULL;
+				GST_OBJECT_UNLOCK(vpu_base_enc);
+
+				if (pool_registry != NULL)
+				{
+					vpu_base_enc->internal_bufferpool = gst_imx_phys_mem_pool_registry_acquire_pool(pool_registry, allocator, caps, vpu_base_enc->video_info.size, 2, GST_IMX_VPU_ENC_HORIZ_ALIGNMENT, GST_IMX_VPU_ENC_VERT_ALIGNMENT, GST_IMX_PHYS_MEM_CACHE_POLICY_WRITE_COMBINED);
+					if (vpu_base_enc->internal_bufferpool != NULL)
+					{
+						GST_DEBUG_OBJECT(vpu_base_enc, "using shared pool %" GST_PTR_FORMAT " from the registry as internal bufferpool", (gpointer)(vpu_base_enc->internal_bufferpool));
+						vpu_base_enc->internal_bufferpool_registry = pool_registry;
+					}
+					else
+						gst_object_unref(GST_OBJECT(pool_registry));
+				}
+
+				if (vpu_base_enc->internal_bufferpool == NULL)
+				{
+					GST_DEBUG_OBJECT(vpu_base_enc, "creating internal bufferpool");
+
+					vpu_base_enc->internal_bufferpool = gst_imx_phys_mem_buffer_pool_new(FALSE);
+
+					config = gst_buffer_pool_get_config(vpu_base_enc->internal_bufferpool);
+					gst_buffer_pool_config_set_params(config, caps, vpu_base_enc->video_info.size, 2, 0);
+					gst_buffer_pool_config_set_allocator(config, allocator, NULL);
+					gst_imx_phys_mem_buffer_pool_config_set_cache_policy(config, GST_IMX_PHYS_MEM_CACHE_POLICY_WRITE_COMBINED);
+					gst_imx_phys_mem_buffer_pool_config_set_alignment(config, GST_IMX_VPU_ENC_HORIZ_ALIGNMENT, GST_IMX_VPU_ENC_VERT_ALIGNMENT);
+					gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_IMX_PHYS_MEM);
+					gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+					gst_buffer_pool_set_config(vpu_base_enc->internal_bufferpool, config);
+				}
 
 				gst_caps_unref(caps);
 
@@ -678,7 +810,7 @@ static GstFlowReturn gst_imx_vpu_base_enc_handle_frame(GstVideoEncoder *encoder,
 				}
 			}
 
-			/* Future versions of this code may propose the internal bufferpool upstream;
+			/* Shared pools from the registry are already active;
 			 * hence the is_active check */
 			if (!gst_buffer_pool_is_active(vpu_base_enc->internal_bufferpool))
 				gst_buffer_pool_set_active(vpu_base_enc->internal_bufferpool, TRUE);
@@ -713,9 +845,12 @@ static GstFlowReturn gst_imx_vpu_base_enc_handle_frame(GstVideoEncoder *encoder,
 	{
 		/* Physical memory metadata found -> buffer is physically contiguous
 		 * It can be used directly as input for the VPU encoder */
-		input_buffer = frame->input_buffer;
+		input_buffer = (vpu_base_enc->imported_input_buffer != NULL) ? vpu_base_enc->imported_input_buffer : frame->input_buffer;
 	}
 
+	/* The VPU reads the frame, so any CPU writes must be visible to it */
+	gst_imx_phys_mem_buffer_begin_device_access(input_buffer, GST_MAP_READ);
+
 	/* Set up physical addresses for the input framebuffer */
 	{
 		gsize *plane_offsets;
@@ -918,39 +1053,44 @@ static GstFlowReturn gst_imx_vpu_base_enc_handle_frame(GstVideoEncoder *encoder,
 
 static gboolean gst_imx_vpu_base_enc_propose_allocation(GstVideoEncoder *encoder, GstQuery *query)
 {
-	GstStructure *config;
-	GstCaps *caps;
-	gboolean need_pool;
-	GstVideoInfo info;
-	GstBufferPool *pool;
-	GstAllocator *allocator;
-
-	gst_query_parse_allocation (query, &caps, &need_pool);
-
-	if (need_pool) {
-		if (caps == NULL) {
-			GST_WARNING_OBJECT(encoder, "no caps");
-			return FALSE;
-		}
+	/* No pool is proposed here; input frames which are not physically
+	 * contiguous are copied to the internal bufferpool instead. But upstream
+	 * elements which allocate physically contiguous frames are told about
+	 * the padding the VPU needs, so these frames can be encoded directly. */
+	gst_query_add_allocation_meta(query, GST_VIDEO_META_API_TYPE, NULL);
+	gst_imx_phys_mem_buffer_pool_query_add_alignment(query, GST_IMX_VPU_ENC_HORIZ_ALIGNMENT, GST_IMX_VPU_ENC_VERT_ALIGNMENT);
+
+	return GST_VIDEO_ENCODER_CLASS(gst_imx_vpu_base_enc_parent_class)->propose_allocation(encoder, query);
+}
 
-		if (!gst_video_info_from_caps (&info, caps)) {
-			GST_WARNING_OBJECT(encoder, "invalid caps");
-			return FALSE;
-		}
 
-		pool = gst_imx_phys_mem_buffer_pool_new(FALSE);
-		allocator = gst_imx_vpu_enc_allocator_obtain();
+#if GST_CHECK_VERSION(1, 4, 0)
 
-		config = gst_buffer_pool_get_config(pool);
-		gst_buffer_pool_config_set_params(config, caps, info.size, 2, 0);
-		gst_buffer_pool_config_set_allocator(config, allocator, NULL);
-		gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_IMX_PHYS_MEM);
-		gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_VIDEO_META);
-		gst_buffer_pool_set_config(pool, config);
+static gboolean gst_imx_vpu_base_enc_sink_query(GstVideoEncoder *encoder, GstQuery *query)
+{
+	GstImxVpuBaseEnc *vpu_base_enc = GST_IMX_VPU_BASE_ENC(encoder);
 
-		gst_query_add_allocation_pool (query, pool, info.size, 2, 0);
-		gst_object_unref (pool);
+	if (gst_imx_phys_mem_pool_registry_handle_context_query(GST_ELEMENT(encoder), query, &(vpu_base_enc->pool_registry)))
+	{
+		GST_LOG_OBJECT(encoder, "answered pool registry context query");
+		return TRUE;
 	}
 
-	return TRUE;
+	return GST_VIDEO_ENCODER_CLASS(gst_imx_vpu_base_enc_parent_class)->sink_query(encoder, query);
 }
+
+
+static gboolean gst_imx_vpu_base_enc_src_query(GstVideoEncoder *encoder, GstQuery *query)
+{
+	GstImxVpuBaseEnc *vpu_base_enc = GST_IMX_VPU_BASE_ENC(encoder);
+
+	if (gst_imx_phys_mem_pool_registry_handle_context_query(GST_ELEMENT(encoder), query, &(vpu_base_enc->pool_registry)))
+	{
+		GST_LOG_OBJECT(encoder, "answered pool registry context query");
+		return TRUE;
+	}
+
+	return GST_VIDEO_ENCODER_CLASS(gst_imx_vpu_base_enc_parent_class)->src_query(encoder, query);
+}
+
+#endif
@@ -28,6 +28,8 @@
 #include <vpu_wrapper.h>
 
 #include "../../common/phys_mem_allocator.h"
+#include "../../common/phys_mem_caps.h"
+#include "../../common/phys_mem_pool_registry.h"
 #include "../framebuffers.h"
 
 
@@ -64,8 +66,22 @@ struct _GstImxVpuBaseEnc
 	GstImxVpuFramebuffers *framebuffers;
 	GstImxPhysMemory *output_phys_buffer;
 
+	/* Pool registry shared with the other physical memory
+	 * elements; obtained in the NULL->READY state change.
+	 * Protected by the object lock. */
+	GstImxPhysMemPoolRegistry *pool_registry;
+
 	GstBufferPool *internal_bufferpool;
+	/* Registry the internal bufferpool was acquired from, or
+	 * NULL if it is a private pool */
+	GstImxPhysMemPoolRegistry *internal_bufferpool_registry;
 	GstBuffer *internal_input_buffer;
+	/* Imported version of the current input buffer if it consists of
+	 * DMA-BUF memory; is unref'd when the next frame is encoded */
+	GstBuffer *imported_input_buffer;
+	/* Number of input frames that had to be copied to the internal
+	 * input buffer because they were not physically contiguous */
+	guint64 num_input_frame_copies;
 
 	GSList *virt_enc_mem_blocks, *phys_enc_mem_blocks;
 
@@ -48,11 +48,12 @@ static GstStaticPadTemplate static_sink_template = GST_STATIC_PAD_TEMPLATE(
 	GST_PAD_SINK,
 	GST_PAD_ALWAYS,
 	GST_STATIC_CAPS(
-		"video/x-raw,"
-		"format = (string) I420, "
-		"width = (int) [ 48, 1920, 8 ], "
-		"height = (int) [ 32, 1080, 8 ], "
-		"framerate = (fraction) [ 0, MAX ]"
+		GST_IMX_PHYS_MEM_VIDEO_CAPS_MAKE(
+			"format = (string) I420, "
+			"width = (int) [ 48, 1920, 8 ], "
+			"height = (int) [ 32, 1080, 8 ], "
+			"framerate = (fraction) [ 0, MAX ]"
+		)
 	)
 );
 
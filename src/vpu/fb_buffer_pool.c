@@ -101,14 +101,25 @@ static gboolean gst_imx_vpu_fb_buffer_pool_set_config(GstBufferPool *pool, GstSt
 		return FALSE;
 	}
 
+	if ((GST_VIDEO_INFO_N_PLANES(&info) == 2) != (vpu_pool->framebuffers->chroma_interleave))
+	{
+		GST_ERROR_OBJECT(pool, "caps format %s does not match the framebuffer layout (chroma interleave: %d)", gst_video_format_to_string(GST_VIDEO_INFO_FORMAT(&info)), vpu_pool->framebuffers->chroma_interleave);
+		return FALSE;
+	}
+
 	vpu_pool->video_info = info;
 
+	/* With chroma interleave (NV12), the second plane is the CbCr plane,
+	 * and a third plane does not exist */
 	vpu_pool->video_info.stride[0] = vpu_pool->framebuffers->y_stride;
 	vpu_pool->video_info.stride[1] = vpu_pool->framebuffers->uv_stride;
-	vpu_pool->video_info.stride[2] = vpu_pool->framebuffers->uv_stride;
 	vpu_pool->video_info.offset[0] = 0;
 	vpu_pool->video_info.offset[1] = vpu_pool->framebuffers->y_size;
-	vpu_pool->video_info.offset[2] = vpu_pool->framebuffers->y_size + vpu_pool->framebuffers->u_size;
+	if (GST_VIDEO_INFO_N_PLANES(&info) > 2)
+	{
+		vpu_pool->video_info.stride[2] = vpu_pool->framebuffers->uv_stride;
+		vpu_pool->video_info.offset[2] = vpu_pool->framebuffers->y_size + vpu_pool->framebuffers->u_size;
+	}
 	vpu_pool->video_info.size = vpu_pool->framebuffers->total_size;
 
 	vpu_pool->add_videometa = gst_buffer_pool_config_has_option(config, GST_BUFFER_POOL_OPTION_VIDEO_META);
@@ -177,34 +188,23 @@ static void gst_imx_vpu_fb_buffer_pool_release_buffer(GstBufferPool *pool, GstBu
 
 	if (vpu_pool->framebuffers->registration_state == GST_IMX_VPU_FRAMEBUFFERS_DECODER_REGISTERED)
 	{
-		VpuDecRetCode dec_ret;
 		GstImxVpuBufferMeta *vpu_meta;
 		GstImxPhysMemMeta *phys_mem_meta;
 
 		vpu_meta = GST_IMX_VPU_BUFFER_META_GET(buffer);
 		phys_mem_meta = GST_IMX_PHYS_MEM_META_GET(buffer);
 
-		GST_IMX_VPU_FRAMEBUFFERS_LOCK(vpu_pool->framebuffers);
+		/* Not locking the framebuffers here; the framebuffer is only marked as
+		 * released, and handed back to the VPU by the decoding thread (see
+		 * gst_imx_vpu_framebuffers_release_framebuffer() ) */
 
 		if ((vpu_meta->framebuffer != NULL) && (phys_mem_meta != NULL) && (phys_mem_meta->phys_addr != 0))
 		{
 			if (vpu_meta->not_displayed_yet && vpu_pool->framebuffers->decenc_states.dec.decoder_open)
 			{
-				dec_ret = VPU_DecOutFrameDisplayed(vpu_pool->framebuffers->decenc_states.dec.handle, vpu_meta->framebuffer);
-				if (dec_ret != VPU_DEC_RET_SUCCESS)
-					GST_ERROR_OBJECT(pool, "clearing display framebuffer failed: %s", gst_imx_vpu_strerror(dec_ret));
-				else
-				{
-					vpu_meta->not_displayed_yet = FALSE;
-					if (vpu_pool->framebuffers->decremented_availbuf_counter > 0)
-					{
-						vpu_pool->framebuffers->num_available_framebuffers++;
-						vpu_pool->framebuffers->decremented_availbuf_counter--;
-						vpu_pool->framebuffers->num_framebuffers_in_buffers--;
-						GST_LOG_OBJECT(pool, "number of available buffers: %d -> %d", vpu_pool->framebuffers->num_available_framebuffers - 1, vpu_pool->framebuffers->num_available_framebuffers);
-					}
-					GST_LOG_OBJECT(pool, "cleared buffer %p", (gpointer)buffer);
-				}
+				gst_imx_vpu_framebuffers_release_framebuffer(vpu_pool->framebuffers, vpu_meta->framebuffer);
+				vpu_meta->not_displayed_yet = FALSE;
+				GST_LOG_OBJECT(pool, "released buffer %p", (gpointer)buffer);
 			}
 			else if (!vpu_pool->framebuffers->decenc_states.dec.decoder_open)
 				GST_DEBUG_OBJECT(pool, "not clearing buffer %p, since VPU decoder is closed", (gpointer)buffer);
@@ -222,10 +222,6 @@ static void gst_imx_vpu_fb_buffer_pool_release_buffer(GstBufferPool *pool, GstBu
 		 * removing the now-unused memory blocks immediately avoids buildup of unused but
 		 * still allocated memory */
 		gst_buffer_remove_all_memory(buffer);
-
-		g_cond_signal(&(vpu_pool->framebuffers->cond));
-
-		GST_IMX_VPU_FRAMEBUFFERS_UNLOCK(vpu_pool->framebuffers);
 	}
 
 	GST_BUFFER_POOL_CLASS(gst_imx_vpu_fb_buffer_pool_parent_class)->release_buffer(pool, buffer);
@@ -347,9 +343,7 @@ gboolean gst_imx_vpu_set_buffer_contents(GstBuffer *buffer, GstImxVpuFramebuffer
 		);
 	}
 
-	GST_IMX_VPU_FRAMEBUFFERS_LOCK(framebuffers);
-	framebuffers->num_framebuffers_in_buffers++;
-	GST_IMX_VPU_FRAMEBUFFERS_UNLOCK(framebuffers);
+	g_atomic_int_inc(&(framebuffers->num_framebuffers_in_buffers));
 
 	/* remove any existing memory blocks */
 	gst_buffer_remove_all_memory(buffer);
@@ -39,6 +39,7 @@ G_DEFINE_TYPE(GstImxVpuFramebuffers, gst_imx_vpu_framebuffers, GST_TYPE_OBJECT)
 
 
 static gboolean gst_imx_vpu_framebuffers_configure(GstImxVpuFramebuffers *framebuffers, GstImxVpuFramebufferParams *params, GstAllocator *allocator);
+static void gst_imx_vpu_framebuffers_wake_up(GstImxVpuFramebuffers *framebuffers);
 static void gst_imx_vpu_framebuffers_finalize(GObject *object);
 
 
@@ -65,8 +66,12 @@ void gst_imx_vpu_framebuffers_init(GstImxVpuFramebuffers *framebuffers)
 	framebuffers->num_available_framebuffers = 0;
 	framebuffers->decremented_availbuf_counter = 0;
 	framebuffers->num_framebuffers_in_buffers = 0;
+	framebuffers->min_num_free_framebuffers = 0;
+	framebuffers->num_starvations = 0;
 	framebuffers->fb_mem_blocks = NULL;
 
+	framebuffers->chroma_interleave = FALSE;
+
 	framebuffers->y_stride = framebuffers->uv_stride = 0;
 	framebuffers->y_size = framebuffers->u_size = framebuffers->v_size = framebuffers->mv_size = 0;
 	framebuffers->total_size = 0;
@@ -74,8 +79,18 @@ void gst_imx_vpu_framebuffers_init(GstImxVpuFramebuffers *framebuffers)
 	framebuffers->flushing = FALSE;
 	framebuffers->exit_loop = FALSE;
 
+	framebuffers->released_flags = NULL;
+
+	framebuffers->wakeup_seqnum = 0;
+	framebuffers->num_waiters = 0;
+
+	framebuffers->num_lock_contentions = 0;
+	framebuffers->num_sleeps = 0;
+	framebuffers->num_wakeups = 0;
+
 	g_mutex_init(&(framebuffers->available_fb_mutex));
-	g_cond_init(&(framebuffers->cond));
+	g_mutex_init(&(framebuffers->wakeup_mutex));
+	g_cond_init(&(framebuffers->wakeup_cond));
 }
 
 
@@ -150,6 +165,8 @@ void gst_imx_vpu_framebuffers_dec_init_info_to_params(VpuDecInitInfo *init_info,
 	params->mjpeg_source_format = init_info->nMjpgSourceFormat;
 	params->interlace = init_info->nInterlace;
 	params->address_alignment = init_info->nAddressAlignment;
+	params->min_num_free_framebuffers = GST_IMX_VPU_MIN_NUM_FREE_FRAMEBUFFERS;
+	params->chroma_interleave = FALSE;
 }
 
 
@@ -161,6 +178,92 @@ void gst_imx_vpu_framebuffers_enc_init_info_to_params(VpuEncInitInfo *init_info,
 	params->mjpeg_source_format = 0;
 	params->interlace = 0;
 	params->address_alignment = init_info->nAddressAlignment;
+	params->min_num_free_framebuffers = 0;
+	params->chroma_interleave = FALSE;
+}
+
+
+void gst_imx_vpu_framebuffers_lock(GstImxVpuFramebuffers *framebuffers)
+{
+	if (!g_mutex_trylock(&(framebuffers->available_fb_mutex)))
+	{
+		g_atomic_int_inc(&(framebuffers->num_lock_contentions));
+		g_mutex_lock(&(framebuffers->available_fb_mutex));
+	}
+}
+
+
+/* Releasing buffers downstream must not contend with the decoding thread,
+ * which holds the lock during the (potentially slow) VPU_DecDecodeBuf() call.
+ * Therefore, releasing a framebuffer only sets its flag in released_flags.
+ * Since the VPU wrapper is not thread safe, the decoding thread itself then
+ * hands the flagged framebuffers back to the VPU, either right before decoding,
+ * or while it waits for free framebuffers.
+ *
+ * Waking up the decoding thread works like an eventcount: releasing threads
+ * increment wakeup_seqnum, and only take wakeup_mutex to broadcast wakeup_cond
+ * if a thread is actually sleeping. The sleeping thread registers itself in
+ * num_waiters before it checks if wakeup_seqnum changed since it last looked
+ * for released framebuffers, so a wakeup cannot get lost. */
+
+
+void gst_imx_vpu_framebuffers_release_framebuffer(GstImxVpuFramebuffers *framebuffers, VpuFrameBuffer *framebuffer)
+{
+	guint idx;
+
+	if ((framebuffers->framebuffers == NULL) || (framebuffer < framebuffers->framebuffers) || (framebuffer >= (framebuffers->framebuffers + framebuffers->num_framebuffers)))
+	{
+		GST_DEBUG_OBJECT(framebuffers, "framebuffer %p does not belong to this framebuffers object; ignoring", (gpointer)framebuffer);
+		return;
+	}
+
+	idx = framebuffer - framebuffers->framebuffers;
+
+	if (g_atomic_int_compare_and_exchange(&(framebuffers->released_flags[idx]), 0, 1))
+		GST_LOG_OBJECT(framebuffers, "framebuffer %p released", (gpointer)framebuffer);
+	else
+		GST_DEBUG_OBJECT(framebuffers, "framebuffer %p already released", (gpointer)framebuffer);
+
+	gst_imx_vpu_framebuffers_wake_up(framebuffers);
+}
+
+
+void gst_imx_vpu_framebuffers_return_released(GstImxVpuFramebuffers *framebuffers)
+{
+	guint i;
+	VpuDecRetCode dec_ret;
+
+	if (framebuffers->released_flags == NULL)
+		return;
+
+	for (i = 0; i < framebuffers->num_framebuffers; ++i)
+	{
+		if (!g_atomic_int_compare_and_exchange(&(framebuffers->released_flags[i]), 1, 0))
+			continue;
+
+		if ((framebuffers->registration_state != GST_IMX_VPU_FRAMEBUFFERS_DECODER_REGISTERED) || !(framebuffers->decenc_states.dec.decoder_open))
+		{
+			GST_DEBUG_OBJECT(framebuffers, "not clearing framebuffer %p, since VPU decoder is closed", (gpointer)&(framebuffers->framebuffers[i]));
+			continue;
+		}
+
+		dec_ret = VPU_DecOutFrameDisplayed(framebuffers->decenc_states.dec.handle, &(framebuffers->framebuffers[i]));
+		if (dec_ret != VPU_DEC_RET_SUCCESS)
+		{
+			GST_ERROR_OBJECT(framebuffers, "clearing display framebuffer failed: %s", gst_imx_vpu_strerror(dec_ret));
+			continue;
+		}
+
+		if (g_atomic_int_get(&(framebuffers->decremented_availbuf_counter)) > 0)
+		{
+			g_atomic_int_inc(&(framebuffers->num_available_framebuffers));
+			g_atomic_int_add(&(framebuffers->decremented_availbuf_counter), -1);
+			g_atomic_int_add(&(framebuffers->num_framebuffers_in_buffers), -1);
+			GST_LOG_OBJECT(framebuffers, "number of available buffers: %d -> %d", g_atomic_int_get(&(framebuffers->num_available_framebuffers)) - 1, g_atomic_int_get(&(framebuffers->num_available_framebuffers)));
+		}
+
+		GST_LOG_OBJECT(framebuffers, "cleared framebuffer %p", (gpointer)&(framebuffers->framebuffers[i]));
+	}
 }
 
 
@@ -169,15 +272,65 @@ void gst_imx_vpu_framebuffers_set_flushing(GstImxVpuFramebuffers *framebuffers,
 	GST_LOG_OBJECT(framebuffers, "setting flushing value to %d", flushing ? 1 : 0);
 	framebuffers->flushing = flushing;
 	if (flushing)
-		g_cond_signal(&(framebuffers->cond));
+		gst_imx_vpu_framebuffers_wake_up(framebuffers);
 }
 
 
 void gst_imx_vpu_framebuffers_wait_until_frames_available(GstImxVpuFramebuffers *framebuffers)
 {
+	gint64 end_time;
+	gboolean starved = FALSE;
+
 	GST_LOG_OBJECT(framebuffers, "flushing = %d  exit_loop = %d", framebuffers->flushing ? 1 : 0, framebuffers->exit_loop ? 1 : 0);
-	while ((framebuffers->num_available_framebuffers < GST_IMX_VPU_MIN_NUM_FREE_FRAMEBUFFERS) && !(framebuffers->flushing) && !(framebuffers->exit_loop))
-		g_cond_wait(&(framebuffers->cond), &(framebuffers->available_fb_mutex));
+
+	/* Waiting is normal when downstream consumes frames slower than the VPU
+	 * decodes them. But if no framebuffer becomes free for a long time,
+	 * downstream probably needs more frames than there are framebuffers
+	 * before it releases any. This is counted, so the decoder can allocate
+	 * more framebuffers the next time it allocates a set. */
+	end_time = g_get_monotonic_time() + GST_IMX_VPU_FRAMEBUFFERS_STARVATION_TIMEOUT;
+	while (TRUE)
+	{
+		gint seqnum;
+		gboolean timed_out = FALSE;
+
+		seqnum = g_atomic_int_get(&(framebuffers->wakeup_seqnum));
+
+		gst_imx_vpu_framebuffers_return_released(framebuffers);
+
+		if ((g_atomic_int_get(&(framebuffers->num_available_framebuffers)) >= framebuffers->min_num_free_framebuffers) || framebuffers->flushing || framebuffers->exit_loop)
+			break;
+
+		/* Sleep until a framebuffer is released, or flushing is set, or the
+		 * wait loop is exited; the lock must not be held meanwhile, since
+		 * setting the flushing and exit_loop flags requires it */
+		g_atomic_int_inc(&(framebuffers->num_sleeps));
+		GST_IMX_VPU_FRAMEBUFFERS_UNLOCK(framebuffers);
+
+		g_mutex_lock(&(framebuffers->wakeup_mutex));
+		g_atomic_int_inc(&(framebuffers->num_waiters));
+		while (g_atomic_int_get(&(framebuffers->wakeup_seqnum)) == seqnum)
+		{
+			if (starved)
+				g_cond_wait(&(framebuffers->wakeup_cond), &(framebuffers->wakeup_mutex));
+			else if (!g_cond_wait_until(&(framebuffers->wakeup_cond), &(framebuffers->wakeup_mutex), end_time))
+			{
+				starved = TRUE;
+				timed_out = TRUE;
+				break;
+			}
+		}
+		g_atomic_int_add(&(framebuffers->num_waiters), -1);
+		g_mutex_unlock(&(framebuffers->wakeup_mutex));
+
+		GST_IMX_VPU_FRAMEBUFFERS_LOCK(framebuffers);
+
+		if (timed_out)
+		{
+			framebuffers->num_starvations++;
+			GST_DEBUG_OBJECT(framebuffers, "framebuffers starved: available: %d  required: %d  in buffers: %d", g_atomic_int_get(&(framebuffers->num_available_framebuffers)), framebuffers->min_num_free_framebuffers, g_atomic_int_get(&(framebuffers->num_framebuffers_in_buffers)));
+		}
+	}
 	framebuffers->exit_loop = FALSE;
 }
 
@@ -185,6 +338,21 @@ void gst_imx_vpu_framebuffers_wait_until_frames_available(GstImxVpuFramebuffers
 void gst_imx_vpu_framebuffers_exit_wait_loop(GstImxVpuFramebuffers *framebuffers)
 {
 	framebuffers->exit_loop = TRUE;
+	gst_imx_vpu_framebuffers_wake_up(framebuffers);
+}
+
+
+static void gst_imx_vpu_framebuffers_wake_up(GstImxVpuFramebuffers *framebuffers)
+{
+	g_atomic_int_inc(&(framebuffers->wakeup_seqnum));
+
+	if (g_atomic_int_get(&(framebuffers->num_waiters)) > 0)
+	{
+		g_atomic_int_inc(&(framebuffers->num_wakeups));
+		g_mutex_lock(&(framebuffers->wakeup_mutex));
+		g_cond_broadcast(&(framebuffers->wakeup_cond));
+		g_mutex_unlock(&(framebuffers->wakeup_mutex));
+	}
 }
 
 
@@ -198,8 +366,10 @@ static gboolean gst_imx_vpu_framebuffers_configure(GstImxVpuFramebuffers *frameb
 
 	framebuffers->num_framebuffers = params->min_framebuffer_count;
 	framebuffers->num_available_framebuffers = framebuffers->num_framebuffers;
+	framebuffers->min_num_free_framebuffers = params->min_num_free_framebuffers;
 	framebuffers->decremented_availbuf_counter = 0;
 	framebuffers->framebuffers = (VpuFrameBuffer *)g_slice_alloc(sizeof(VpuFrameBuffer) * framebuffers->num_framebuffers);
+	framebuffers->released_flags = (volatile gint *)g_slice_alloc0(sizeof(gint) * framebuffers->num_framebuffers);
 
 	framebuffers->allocator = allocator;
 
@@ -212,11 +382,26 @@ static gboolean gst_imx_vpu_framebuffers_configure(GstImxVpuFramebuffers *frameb
 	framebuffers->y_stride = framebuffers->pic_width;
 	framebuffers->y_size = framebuffers->y_stride * framebuffers->pic_height;
 
+	g_assert(!(params->chroma_interleave) || (params->mjpeg_source_format == 0));
+	framebuffers->chroma_interleave = params->chroma_interleave;
+
 	switch (params->mjpeg_source_format)
 	{
-		case 0: /* I420 (4:2:0) */
-			framebuffers->uv_stride = framebuffers->y_stride / 2;
-			framebuffers->u_size = framebuffers->v_size = framebuffers->mv_size = framebuffers->y_size / 4;
+		case 0: /* I420 (4:2:0) or NV12 (4:2:0 with interleaved chroma) */
+			if (framebuffers->chroma_interleave)
+			{
+				/* The interleaved CbCr plane has as many bytes per row as
+				 * the Y plane, and half as many rows; the Cr plane is unused */
+				framebuffers->uv_stride = framebuffers->y_stride;
+				framebuffers->u_size = framebuffers->y_size / 2;
+				framebuffers->v_size = 0;
+				framebuffers->mv_size = framebuffers->y_size / 4;
+			}
+			else
+			{
+				framebuffers->uv_stride = framebuffers->y_stride / 2;
+				framebuffers->u_size = framebuffers->v_size = framebuffers->mv_size = framebuffers->y_size / 4;
+			}
 			break;
 		case 1: /* Y42B (4:2:2 horizontal) */
 			framebuffers->uv_stride = framebuffers->y_stride / 2;
@@ -242,15 +427,16 @@ static gboolean gst_imx_vpu_framebuffers_configure(GstImxVpuFramebuffers *frameb
 	framebuffers->total_size = framebuffers->y_size + framebuffers->u_size + framebuffers->v_size + framebuffers->mv_size + alignment;
 	GST_INFO_OBJECT(
 		framebuffers,
-		"framebuffer requested width/height: %u/%u  actual width/height (after alignment): %u/%u  Y stride: %u",
+		"framebuffer requested width/height: %u/%u  actual width/height (after alignment): %u/%u  Y stride: %u  chroma interleave: %d",
 		params->pic_width, params->pic_height,
 		framebuffers->pic_width, framebuffers->pic_height,
-		framebuffers->y_stride
+		framebuffers->y_stride,
+		framebuffers->chroma_interleave
 	);
 	GST_INFO_OBJECT(
 		framebuffers,
-		"num framebuffers:  total: %u  available: %d",
-		framebuffers->num_framebuffers, framebuffers->num_available_framebuffers
+		"num framebuffers:  total: %u  available: %d  min free: %d",
+		framebuffers->num_framebuffers, framebuffers->num_available_framebuffers, framebuffers->min_num_free_framebuffers
 	);
 	GST_INFO_OBJECT(
 		framebuffers,
@@ -299,6 +485,14 @@ static gboolean gst_imx_vpu_framebuffers_configure(GstImxVpuFramebuffers *frameb
 		framebuffer->pbufVirtCr    = virt_ptr + framebuffers->y_size + framebuffers->u_size;
 		framebuffer->pbufVirtMvCol = virt_ptr + framebuffers->y_size + framebuffers->u_size + framebuffers->v_size;
 
+		/* The VPU ignores the Cr pointers in chroma interleave mode; point them
+		 * at the CbCr plane instead of the Mv plane, which follows it directly */
+		if (framebuffers->chroma_interleave)
+		{
+			framebuffer->pbufCr = framebuffer->pbufCb;
+			framebuffer->pbufVirtCr = framebuffer->pbufVirtCb;
+		}
+
 		framebuffer->pbufY_tilebot = 0;
 		framebuffer->pbufCb_tilebot = 0;
 		framebuffer->pbufVirtY_tilebot = 0;
@@ -315,11 +509,20 @@ static void gst_imx_vpu_framebuffers_finalize(GObject *object)
 
 	GST_IMX_VPU_FRAMEBUFFERS_LOCK(framebuffers);
 	gst_imx_vpu_framebuffers_set_flushing(framebuffers, TRUE);
-	g_cond_signal(&(framebuffers->cond));
 	GST_IMX_VPU_FRAMEBUFFERS_UNLOCK(framebuffers);
 
+	GST_INFO_OBJECT(
+		framebuffers,
+		"framebuffers lock contentions: %d  sleeps while waiting for free framebuffers: %d  wakeups: %d  starvations: %u",
+		g_atomic_int_get(&(framebuffers->num_lock_contentions)),
+		g_atomic_int_get(&(framebuffers->num_sleeps)),
+		g_atomic_int_get(&(framebuffers->num_wakeups)),
+		framebuffers->num_starvations
+	);
+
 	g_mutex_clear(&(framebuffers->available_fb_mutex));
-	g_cond_clear(&(framebuffers->cond));
+	g_mutex_clear(&(framebuffers->wakeup_mutex));
+	g_cond_clear(&(framebuffers->wakeup_cond));
 
 	GST_INFO_OBJECT(framebuffers, "freeing framebuffer memory");
 
@@ -329,6 +532,12 @@ static void gst_imx_vpu_framebuffers_finalize(GObject *object)
 		framebuffers->framebuffers = NULL;
 	}
 
+	if (framebuffers->released_flags != NULL)
+	{
+		g_slice_free1(sizeof(gint) * framebuffers->num_framebuffers, (gpointer)(framebuffers->released_flags));
+		framebuffers->released_flags = NULL;
+	}
+
 	gst_imx_vpu_free_phys_mem_blocks((GstImxPhysMemAllocator *)(framebuffers->allocator), &(framebuffers->fb_mem_blocks));
 
 	G_OBJECT_CLASS(gst_imx_vpu_framebuffers_parent_class)->finalize(object);
@@ -39,7 +39,15 @@ typedef struct _GstImxVpuFramebuffersClass GstImxVpuFramebuffersClass;
 #define GST_IS_IMX_VPU_FRAMEBUFFERS(obj)          (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_IMX_VPU_FRAMEBUFFERS))
 #define GST_IS_IMX_VPU_FRAMEBUFFERS_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_IMX_VPU_FRAMEBUFFERS))
 
-#define GST_IMX_VPU_MIN_NUM_FREE_FRAMEBUFFERS 6
+/* Bounds for the number of framebuffers which must be free before the decoder
+ * may decode the next frame. The decoder picks a value in between, based on how
+ * many frames downstream holds (see decoder.c). */
+#define GST_IMX_VPU_MIN_NUM_FREE_FRAMEBUFFERS 2
+#define GST_IMX_VPU_MAX_NUM_FREE_FRAMEBUFFERS 16
+
+/* If no framebuffer becomes free within this time (in microseconds) while
+ * waiting for free framebuffers, the framebuffers are considered starved */
+#define GST_IMX_VPU_FRAMEBUFFERS_STARVATION_TIMEOUT (500 * G_TIME_SPAN_MILLISECOND)
 
 
 typedef enum
@@ -78,12 +86,41 @@ struct _GstImxVpuFramebuffers
 
 	VpuFrameBuffer *framebuffers;
 	guint num_framebuffers;
-	gint num_available_framebuffers, decremented_availbuf_counter, num_framebuffers_in_buffers;
+	/* framebuffer availability counters; accessed atomically */
+	volatile gint num_available_framebuffers, decremented_availbuf_counter, num_framebuffers_in_buffers;
+	/* gst_imx_vpu_framebuffers_wait_until_frames_available() waits until at least
+	 * this many framebuffers are available */
+	gint min_num_free_framebuffers;
+	/* number of times waiting for free framebuffers exceeded
+	 * GST_IMX_VPU_FRAMEBUFFERS_STARVATION_TIMEOUT */
+	guint num_starvations;
 	GSList *fb_mem_blocks;
+	/* serializes VPU wrapper calls and protects the registration state,
+	 * decenc_states, flushing, and exit_loop */
 	GMutex available_fb_mutex;
-	GCond cond;
 	gboolean flushing, exit_loop;
 
+	/* One flag per framebuffer, set atomically when a buffer containing the
+	 * framebuffer was released downstream; the decoding thread hands flagged
+	 * framebuffers back to the VPU (see framebuffers.c) */
+	volatile gint *released_flags;
+
+	/* Wakeup of a thread waiting for free framebuffers; releasing threads
+	 * only take wakeup_mutex if num_waiters is nonzero */
+	GMutex wakeup_mutex;
+	GCond wakeup_cond;
+	volatile gint wakeup_seqnum, num_waiters;
+
+	/* Contention statistics: number of times available_fb_mutex was already
+	 * locked when it was to be taken, number of times a thread had to sleep
+	 * until framebuffers were released, and number of times a releasing
+	 * thread had to wake up a sleeping one */
+	volatile gint num_lock_contentions, num_sleeps, num_wakeups;
+
+	/* if true, the framebuffers contain one plane with interleaved Cb and Cr
+	 * samples instead of separate Cb and Cr planes (NV12 instead of I420) */
+	gboolean chroma_interleave;
+
 	int y_stride, uv_stride;
 	int y_size, u_size, v_size, mv_size;
 	int total_size;
@@ -106,12 +143,15 @@ typedef struct
 		min_framebuffer_count,
 		mjpeg_source_format,
 		interlace,
-		address_alignment;
+		address_alignment,
+		min_num_free_framebuffers;
+	/* only supported with the 4:2:0 MJPEG source format (= mjpeg_source_format 0) */
+	gboolean chroma_interleave;
 }
 GstImxVpuFramebufferParams;
 
 
-#define GST_IMX_VPU_FRAMEBUFFERS_LOCK(framebuffers)   (g_mutex_lock(&(((GstImxVpuFramebuffers*)(framebuffers))->available_fb_mutex)))
+#define GST_IMX_VPU_FRAMEBUFFERS_LOCK(framebuffers)   (gst_imx_vpu_framebuffers_lock((GstImxVpuFramebuffers*)(framebuffers)))
 #define GST_IMX_VPU_FRAMEBUFFERS_UNLOCK(framebuffers) (g_mutex_unlock(&(((GstImxVpuFramebuffers*)(framebuffers))->available_fb_mutex)))
 
 
@@ -126,8 +166,24 @@ gboolean gst_imx_vpu_framebuffers_register_with_encoder(GstImxVpuFramebuffers *f
 void gst_imx_vpu_framebuffers_dec_init_info_to_params(VpuDecInitInfo *init_info, GstImxVpuFramebufferParams *params);
 void gst_imx_vpu_framebuffers_enc_init_info_to_params(VpuEncInitInfo *init_info, GstImxVpuFramebufferParams *params);
 
-/* NOTE: the three functions below must be called with a lock held on framebuffers! */
+/* Locks available_fb_mutex, counting contention. Use GST_IMX_VPU_FRAMEBUFFERS_LOCK instead of calling this directly. */
+void gst_imx_vpu_framebuffers_lock(GstImxVpuFramebuffers *framebuffers);
+
+/* Marks the framebuffer as released, and wakes up a thread waiting for free
+ * framebuffers. Does not take the lock, so buffer pools can call it when
+ * buffers are released, without contending with the decoding thread. The
+ * framebuffer is handed back to the VPU (with VPU_DecOutFrameDisplayed())
+ * by the next gst_imx_vpu_framebuffers_return_released() call. Framebuffers
+ * which do not belong to this set are ignored. */
+void gst_imx_vpu_framebuffers_release_framebuffer(GstImxVpuFramebuffers *framebuffers, VpuFrameBuffer *framebuffer);
+
+/* NOTE: the four functions below must be called with a lock held on framebuffers! */
+/* Hands released framebuffers back to the VPU, and updates the availability
+ * counters. Must be called before VPU_DecDecodeBuf(). Released framebuffers
+ * are discarded if the decoder is no longer open. */
+void gst_imx_vpu_framebuffers_return_released(GstImxVpuFramebuffers *framebuffers);
 void gst_imx_vpu_framebuffers_set_flushing(GstImxVpuFramebuffers *framebuffers, gboolean flushing);
+/* Unlocks the framebuffers while sleeping */
 void gst_imx_vpu_framebuffers_wait_until_frames_available(GstImxVpuFramebuffers *framebuffers);
 void gst_imx_vpu_framebuffers_exit_wait_loop(GstImxVpuFramebuffers *framebuffers);
 